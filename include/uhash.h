@@ -20,6 +20,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(UHASH_ENABLE_COUNTERS) || !defined(UHASH_RANDOM_SEED)
+    #include <time.h>
+#endif
+
 // #########
 // # Types #
 // #########
@@ -66,6 +70,239 @@ typedef enum uhash_ret {
 
 } uhash_ret;
 
+/**
+ * Custom allocator, which can be assigned to hash tables when they are created.
+ * Callbacks are always passed the size of the blocks they operate on, so that
+ * arena and pool allocators need not keep track of it.
+ *
+ * @public @memberof UHash
+ */
+typedef struct UHashAllocator {
+
+    /// User data, passed to all callbacks.
+    void *ctx;
+
+    /// Allocates a new block of memory.
+    void *(*alloc_fn)(void *ctx, size_t size);
+
+    /// Resizes a block of memory, allocating a new one if ptr is NULL (old_size is then 0).
+    void *(*realloc_fn)(void *ctx, void *ptr, size_t old_size, size_t size);
+
+    /// Releases a block of memory. It is never called with a NULL pointer.
+    void (*free_fn)(void *ctx, void *ptr, size_t size);
+
+} UHashAllocator;
+
+/**
+ * Executor for parallel set operations, usually backed by a thread pool.
+ * Work is split into a fixed number of tasks, each identified by its index.
+ *
+ * @public @memberof UHash
+ */
+typedef struct UHashExecutor {
+
+    /// User data, passed to the callback.
+    void *ctx;
+
+    /// Number of tasks work is split into, usually the number of worker threads.
+    unsigned n_tasks;
+
+    /// Runs task(arg, i) for each i in [0, n), possibly in parallel, returning once all are done.
+    void (*run_fn)(void *ctx, unsigned n, void (*task)(void *arg, unsigned i), void *arg);
+
+} UHashExecutor;
+
+/**
+ * Length-aware string view, usable as a hash table key. The viewed characters
+ * need not be NULL-terminated, and are not owned by the view.
+ *
+ * @public @memberof UHash
+ */
+typedef struct UHashStrView {
+
+    /// Pointer to the first character.
+    char const *data;
+
+    /// Number of characters.
+    size_t length;
+
+    /// Precomputed hash, or zero if it must be computed by the hash function.
+    uhash_uint hash;
+
+} UHashStrView;
+
+/**
+ * Header of hash table images, followed by the flags, keys and values of the table,
+ * each starting at a multiple of 64 bytes.
+ *
+ * @public @memberof UHash
+ */
+typedef struct UHashImageHeader {
+
+    /// Magic number, also telling apart images written on platforms of different endianness.
+    uint32_t magic;
+
+    /// Format version.
+    uint16_t version;
+
+    /// Bucket layout.
+    uint8_t layout;
+
+    /// Size of uhash_uint.
+    uint8_t uint_size;
+
+    /// User-defined identifier of the hash function.
+    uint32_t hash_id;
+
+    /// Size of the keys.
+    uint32_t key_size;
+
+    /// Size of the values, zero for sets.
+    uint32_t val_size;
+
+    /// Reserved, always zero.
+    uint32_t reserved;
+
+    /// Number of buckets.
+    uint64_t n_buckets;
+
+    /// Number of occupied buckets, including deleted ones.
+    uint64_t n_occupied;
+
+    /// Number of elements.
+    uint64_t count;
+
+    /// Size of the flags in bytes.
+    uint64_t flags_size;
+
+} UHashImageHeader;
+
+/**
+ * Header of the chunks of hash table streams, followed by the records of the chunk.
+ * Each record is made of a key, followed by a value if the record size exceeds the key size.
+ *
+ * @public @memberof UHash
+ */
+typedef struct UHashStreamChunk {
+
+    /// Magic number, also telling apart streams written on platforms of different endianness.
+    uint32_t magic;
+
+    /// Nonzero if the records are keys to delete, zero if they are entries to insert or update.
+    uint32_t deletion;
+
+    /// Size of the keys.
+    uint32_t key_size;
+
+    /// Size of the values, zero for sets and deletions.
+    uint32_t val_size;
+
+    /// Number of records.
+    uint32_t count;
+
+} UHashStreamChunk;
+
+/**
+ * State of a hash table stream, written one chunk at a time via the specified callback.
+ *
+ * @public @memberof UHash
+ */
+typedef struct UHashStream {
+
+    /// Callback writing the specified bytes, returning UHASH_ERR on failure.
+    uhash_ret (*write_fn)(void *ctx, void const *data, size_t size);
+
+    /// User data, passed to the callback.
+    void *ctx;
+
+    /// Next bucket to visit, which can be saved to resume the stream later.
+    uhash_uint cursor;
+
+    /// True once all chunks have been written.
+    bool done;
+
+} UHashStream;
+
+/// Number of bins of the probe length histogram of UHashStats.
+#define UHASH_STATS_BINS 16
+
+/**
+ * Operation counters, maintained by hash tables if UHASH_ENABLE_COUNTERS is defined.
+ *
+ * @public @memberof UHash
+ */
+typedef struct UHashCounters {
+
+    /// Number of lookups.
+    uint64_t gets;
+
+    /// Number of buckets (groups for the SIMD layout) probed by lookups beyond the first one.
+    uint64_t get_probes;
+
+    /// Number of insertions.
+    uint64_t puts;
+
+    /// Number of buckets (groups for the SIMD layout) probed by insertions beyond the first one.
+    uint64_t put_probes;
+
+    /// Number of rehashes.
+    uint64_t rehashes;
+
+    /// Time spent rehashing, in clock ticks (see CLOCKS_PER_SEC).
+    uint64_t rehash_time;
+
+} UHashCounters;
+
+/**
+ * Statistics about the buckets of a hash table, computed by uhash_stats.
+ * Probe lengths are the number of buckets (groups for the SIMD layout) that are probed
+ * before finding a key, excluding its home bucket.
+ *
+ * @public @memberof UHash
+ */
+typedef struct UHashStats {
+
+    /// Number of elements.
+    uhash_uint count;
+
+    /// Number of buckets.
+    uhash_uint n_buckets;
+
+    /// Number of deleted buckets that have not been reused yet.
+    uhash_uint tombstones;
+
+    /// Ratio of elements to buckets.
+    double load_factor;
+
+    /// Ratio of deleted buckets to buckets.
+    double tombstone_ratio;
+
+    /// Size of the buckets in bytes.
+    size_t bytes;
+
+    /// Size of the buckets divided by the number of elements.
+    double bytes_per_entry;
+
+    /// Mean probe length.
+    double mean_probe;
+
+    /// Maximum probe length.
+    uhash_uint max_probe;
+
+    /// Number of keys per probe length, the last bin counting longer probe sequences as well.
+    uhash_uint probe_hist[UHASH_STATS_BINS];
+
+    /// Length of the longest run of consecutive occupied buckets.
+    uhash_uint max_run;
+
+    /// Mean length of the runs of consecutive occupied buckets.
+    double mean_run;
+
+    /// Operation counters, zero unless UHASH_ENABLE_COUNTERS is defined.
+    UHashCounters counters;
+
+} UHashStats;
+
 // #############
 // # Constants #
 // #############
@@ -88,11 +325,87 @@ typedef enum uhash_ret {
  */
 #define UHASH_VAL_IGNORE char
 
-/// Hash table maximum load factor.
+/// Default maximum load factor of hash tables (see uhash_set_max_load).
 #ifndef UHASH_MAX_LOAD
     #define UHASH_MAX_LOAD 0.77
 #endif
 
+/**
+ * Load factor under which hash tables having had keys deleted are shrunk by the next insertion.
+ * Tables are shrunk to a load factor between 0.25 and 0.5, so this should be kept well below
+ * 0.25 to avoid resizing back and forth. Set it to 0 to disable automatic shrinking.
+ */
+#ifndef UHASH_SHRINK_LOAD
+    #define UHASH_SHRINK_LOAD 0.1
+#endif
+
+/**
+ * Number of buckets migrated by each operation on hash tables with incremental resizing.
+ * Must be at least 4 for migrations to complete before the new buckets fill up.
+ * Shrinking migrations scale it by the ratio between the old and new number of buckets.
+ */
+#ifndef UHASH_INC_STEP
+    #define UHASH_INC_STEP 32
+#endif
+
+/**
+ * Default maximum load factor of hash tables using the SIMD control byte layout.
+ * Tag matching keeps probes short, so they can run fuller than regular tables.
+ */
+#ifndef UHASH_SIMD_MAX_LOAD
+    #define UHASH_SIMD_MAX_LOAD 0.875
+#endif
+
+/**
+ * Default maximum load factor of cuckoo hash tables, excluding their stash.
+ * Keys can be placed in either of two groups of buckets, so they can run fuller than other tables.
+ */
+#ifndef UHASH_CUCKOO_MAX_LOAD
+    #define UHASH_CUCKOO_MAX_LOAD 0.9
+#endif
+
+/**
+ * Number of probes after which an insertion into a seeded hash table is considered
+ * a sign of hash flooding, so that the next uhash_put reseeds the table (see UHASH_DECL_SEEDED).
+ */
+#ifndef UHASH_FLOOD_PROBES
+    #define UHASH_FLOOD_PROBES 128
+#endif
+
+/**
+ * Expression returning a random uint64_t, used to seed hash tables (see UHASH_DECL_SEEDED).
+ * It is mixed with the addresses of the table and of the stack, so the default, based on the
+ * current time, suffices if addresses are randomized. Define it to read from a CSPRNG otherwise.
+ */
+#ifndef UHASH_RANDOM_SEED
+    #define UHASH_RANDOM_SEED() ((uint64_t)time(NULL) << 32U ^ (uint64_t)clock())
+#endif
+
+/**
+ * Number of reader counters of concurrent hash tables, each in its own cache line.
+ * Readers pick one based on the address of their stack, so that they rarely contend.
+ * Must be a power of 2.
+ */
+#ifndef UHASH_CONC_STRIPES
+    #define UHASH_CONC_STRIPES 8
+#endif
+
+/**
+ * Size in bytes of the first chunk of the string arena of interning tables.
+ * Each following chunk doubles in size, up to 256 times this value.
+ */
+#ifndef UHASH_ARENA_CHUNK
+    #define UHASH_ARENA_CHUNK 4096
+#endif
+
+/**
+ * Size in bytes of the buffer chunks of streamed hash tables are assembled in,
+ * enlarged if needed to fit at least one entry.
+ */
+#ifndef UHASH_STREAM_BUF
+    #define UHASH_STREAM_BUF 4096
+#endif
+
 // ###############
 // # Private API #
 // ###############
@@ -140,8 +453,160 @@ typedef enum uhash_ret {
     #define p_uhash_analyzer_assert(c)
 #endif
 
+// SIMD instruction sets used by the control byte layout (define UHASH_NO_SIMD to disable).
+#ifndef UHASH_NO_SIMD
+    #if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+        #define P_UHASH_SSE2
+        #include <emmintrin.h>
+    #elif defined __ARM_NEON && (defined __aarch64__ || defined _M_ARM64)
+        #define P_UHASH_NEON
+        #include <arm_neon.h>
+    #endif
+#endif
+
+// Count trailing zeros of a non-zero 32 bit word.
+#if (defined __clang__ && __clang_major__ >= 3) || (defined __GNUC__ && __GNUC__ >= 4)
+    #define p_uhash_ctz32(x) ((unsigned)__builtin_ctz(x))
+#elif defined _MSC_VER
+    #include <intrin.h>
+    p_uhash_static_inline unsigned p_uhash_ctz32(uint32_t x) {
+        unsigned long i;
+        _BitScanForward(&i, x);
+        return (unsigned)i;
+    }
+#else
+    p_uhash_static_inline unsigned p_uhash_ctz32(uint32_t x) {
+        unsigned i = 0;
+        for (; !(x & 1U); x >>= 1U) ++i;
+        return i;
+    }
+#endif
+
+// Count the set bits of a 32 bit word.
+#if (defined __clang__ && __clang_major__ >= 3) || (defined __GNUC__ && __GNUC__ >= 4)
+    #define p_uhash_popcount32(x) ((unsigned)__builtin_popcount(x))
+#else
+    p_uhash_static_inline unsigned p_uhash_popcount32(uint32_t x) {
+        unsigned n = 0;
+        for (; x; x &= x - 1) ++n;
+        return n;
+    }
+#endif
+
+// Prefetches the cache line containing the specified address.
+#if (defined __clang__ && __clang_major__ >= 3) || (defined __GNUC__ && __GNUC__ >= 4)
+    #define p_uhash_prefetch(addr) __builtin_prefetch(addr)
+#elif defined P_UHASH_SSE2
+    #define p_uhash_prefetch(addr) _mm_prefetch((char const *)(addr), _MM_HINT_T0)
+#else
+    #define p_uhash_prefetch(addr) ((void)(addr))
+#endif
+
+// Atomic operations, used by concurrent hash tables.
+#if (defined __clang__ && __clang_major__ >= 3) ||                                                  \
+    (defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+    #define P_UHASH_ATOMICS
+    #define p_uhash_atomic_load(ptr, order) __atomic_load_n(ptr, __ATOMIC_##order)
+    #define p_uhash_atomic_store(ptr, val, order) __atomic_store_n(ptr, val, __ATOMIC_##order)
+    #define p_uhash_atomic_add(ptr, val, order) __atomic_add_fetch(ptr, val, __ATOMIC_##order)
+    #define p_uhash_atomic_sub(ptr, val, order) __atomic_sub_fetch(ptr, val, __ATOMIC_##order)
+    #define p_uhash_atomic_exchange(ptr, val, order) __atomic_exchange_n(ptr, val, __ATOMIC_##order)
+#endif
+
+// Reference counting of buckets shared by copy-on-write clones.
+#ifdef P_UHASH_ATOMICS
+    #define p_uhash_ref_load(ptr) p_uhash_atomic_load(ptr, ACQUIRE)
+    #define p_uhash_ref_add(ptr) p_uhash_atomic_add(ptr, 1U, RELAXED)
+    #define p_uhash_ref_sub(ptr) p_uhash_atomic_sub(ptr, 1U, ACQ_REL)
+#else
+    #define p_uhash_ref_load(ptr) (*(ptr))
+    #define p_uhash_ref_add(ptr) (++*(ptr))
+    #define p_uhash_ref_sub(ptr) (--*(ptr))
+#endif
+
+// Spin-wait hint.
+#if defined P_UHASH_SSE2
+    #define p_uhash_cpu_relax() _mm_pause()
+#elif defined __aarch64__ && (defined __GNUC__ || defined __clang__)
+    #define p_uhash_cpu_relax() __asm__ __volatile__("yield")
+#else
+    #define p_uhash_cpu_relax() ((void)0)
+#endif
+
+// Assumed cache line size.
+#define P_UHASH_CACHE_LINE 64U
+
+// Number of keys whose buckets are prefetched together by batched operations.
+#define P_UHASH_BATCH_SIZE 16
+
+// Bucket layouts of hash table images, NONE if a layout cannot be stored in images.
+#define P_UHASH_LAYOUT_NONE 0U
+#define P_UHASH_LAYOUT_FLAGS 1U
+#define P_UHASH_LAYOUT_SIMD 2U
+#define P_UHASH_LAYOUT_RH 3U
+#define P_UHASH_LAYOUT_FASTRANGE 4U
+#define P_UHASH_LAYOUT_CUCKOO 5U
+
+// Layouts of tables with bit-packed values also record the number of bits per value.
+#define P_UHASH_LAYOUT_MASK 0xFU
+#define P_UHASH_LAYOUT_PACKED(layout, bits) ((layout) ? (layout) | ((unsigned)(bits) << 4U) : 0U)
+
+// Hash table image constants.
+#define P_UHASH_IMAGE_MAGIC 0x4d494855U
+#define P_UHASH_IMAGE_VERSION 1U
+
+// Magic number of the chunks of hash table streams.
+#define P_UHASH_STREAM_MAGIC 0x53484855U
+
+// Rounds a size up to the alignment of the sections of hash table images.
+#define p_uhash_image_align(size)                                                                   \
+    (((size) + P_UHASH_CACHE_LINE - 1) / P_UHASH_CACHE_LINE * P_UHASH_CACHE_LINE)
+
+/*
+ * Operation counters (define UHASH_ENABLE_COUNTERS to enable them).
+ * Counters are not part of the logical state of tables, so they are updated through const
+ * pointers. They are not atomic: concurrent readers may lose updates.
+ */
+#ifdef UHASH_ENABLE_COUNTERS
+    #define P_UHASH_DEF_COUNTERS UHashCounters counters;
+    #define p_uhash_count(h, field, n)                                                              \
+        (((UHashCounters *)(uintptr_t)&(h)->counters)->field += (uint64_t)(n))
+    #define p_uhash_timer_start(t) uint64_t const t = (uint64_t)clock()
+    #define p_uhash_count_time(h, t) p_uhash_count(h, rehash_time, (uint64_t)clock() - (t))
+    #define p_uhash_get_counters(h, out) (*(out) = (h)->counters)
+#else
+    #define P_UHASH_DEF_COUNTERS
+    #define p_uhash_count(h, field, n) ((void)(h))
+    #define p_uhash_timer_start(t) ((void)0)
+    #define p_uhash_count_time(h, t) ((void)(h))
+    #define p_uhash_get_counters(h, out) ((void)(h), (void)(out))
+#endif
+
+// Returns the number of steps of triangular probing from bucket 'from' to bucket 'to'.
+p_uhash_static_inline uhash_uint p_uhash_tri_dist(uhash_uint from, uhash_uint to, uhash_uint mask) {
+    uhash_uint step = 0;
+    while (from != to && step <= mask) from = (from + (++step)) & mask;
+    return step;
+}
+
+// Number of bucket ranges keys are partitioned into by parallel bulk insertion.
+#define P_UHASH_PAR_PARTS 256U
+
+// Number of buckets needed to hold the specified number of keys without growing, whose upper
+// bound (see p_uhash_bound) is greater than the number of keys, as required by uhash_resize.
+#define p_uhash_fit(count, max_load) ((uhash_uint)(((count) + 1) / (max_load)) + 1)
+
+// Memory management, via the specified allocator or the UHASH_MALLOC family if it is NULL.
+#define p_uhash_malloc(a, size) ((a) ? (a)->alloc_fn((a)->ctx, size) : UHASH_MALLOC(size))
+#define p_uhash_realloc(a, ptr, old_size, size)                                                     \
+    ((a) ? (a)->realloc_fn((a)->ctx, (void *)(ptr), (ptr) ? (old_size) : 0, size)                   \
+         : UHASH_REALLOC((void *)(ptr), size))
+#define p_uhash_free(a, ptr, size)                                                                  \
+    ((a) ? ((ptr) ? (a)->free_fn((a)->ctx, (void *)(ptr), size) : (void)0)                          \
+         : (void)UHASH_FREE((void *)(ptr)))
+
 // Flags manipulation macros.
-#define p_uhf_size(m) ((m) < 16 ? 1 : (m) >> 4U)
+#define p_uhf_size(m) ((m) < 16 ? 1 : ((m) + 15U) >> 4U)
 #define p_uhf_isempty(flag, i) ((flag[i >> 4U] >> ((i & 0xfU) << 1U)) & 2U)
 #define p_uhf_isdel(flag, i) ((flag[i >> 4U] >> ((i & 0xfU) << 1U)) & 1U)
 #define p_uhf_iseither(flag, i) ((flag[i >> 4U] >> ((i & 0xfU) << 1U)) & 3U)
@@ -151,1392 +616,8414 @@ typedef enum uhash_ret {
 #define p_uhf_set_isdel_true(flag, i) (flag[i >> 4U] |= 1UL << ((i & 0xfU) << 1U))
 
 /*
- * Computes the maximum number of elements that the table can contain
- * before it needs to be resized in order to keep its load factor under UHASH_MAX_LOAD.
+ * Control byte manipulation macros (SIMD layout).
  *
- * @param n_buckets [uhash_uint] Number of buckets.
- * @return [uhash_uint] Upper bound.
+ * Each bucket has one control byte: empty and deleted buckets have the high bit set,
+ * while occupied buckets store a 7 bit tag derived from the hash of their key.
+ * Buckets are probed in aligned groups of P_UHC_GROUP_SIZE control bytes.
  */
-#define p_uhash_upper_bound(n_buckets) ((uhash_uint)((n_buckets) * UHASH_MAX_LOAD + 0.5))
+#define P_UHC_EMPTY 0x80U
+#define P_UHC_DELETED 0xfeU
+#define P_UHC_GROUP_SIZE 16U
+
+// Number of buckets stored inline by tables with inline storage (a single group).
+#define P_UHASH_SBO_BUCKETS P_UHC_GROUP_SIZE
+#define p_uhc_isfull(ctrl, i) (!((ctrl)[i] & 0x80U))
+#define p_uhc_tag(hash) ((uint8_t)(((uint32_t)(hash) * 0x9e3779b1U) >> 25U))
+#define p_uhc_group(ctrl, g) ((ctrl) + ((g) << 4U))
 
 /*
- * Karl Nelson <kenelson@ece.ucdavis.edu>'s X31 string hash function.
- *
- * @param key [char const *] The string to hash.
- * @return [uhash_uint] The hash value.
+ * Robin Hood metadata: one byte per bucket, either P_UHC_EMPTY or the distance of the key
+ * from its home bucket, which cannot exceed P_UHR_MAX_DIST.
  */
-p_uhash_static_inline uhash_uint p_uhash_x31_str_hash(char const *key) {
-    uhash_uint h = (uhash_uint)*key;
-    if (h) for (++key ; *key; ++key) h = (h << 5U) - h + (uhash_uint)(*key);
-    return h;
-}
-
-#define p_uhash_cast_hash(key) (uhash_uint)(key)
-#define p_uhash_int8_hash(key) p_uhash_cast_hash(key)
-#define p_uhash_int16_hash(key) p_uhash_cast_hash(key)
-
-#if defined UHASH_TINY
-    #define p_uhash_uint_next_power_2(x) (                                                          \
-        --(x),                                                                                      \
-        (x)|=(x)>>1U, (x)|=(x)>>2U, (x)|=(x)>>4U, (x)|=(x)>>8U,                                     \
-        ++(x)                                                                                       \
-    )
-    #define p_uhash_int32_hash(key) (uhash_uint)((key) >> 17U ^ (key) ^ (key) << 6U)
-    #define p_uhash_int64_hash(key) (uhash_uint)(                                                   \
-        (key) >> 49U ^ (key) >> 33U ^ (key) >> 17U ^ (key) ^                                        \
-        (key) << 6U ^ (key) << 23U ^ (key) << 39U                                                   \
-    )
-#elif defined UHASH_HUGE
-    #define p_uhash_uint_next_power_2(x) (                                                          \
-        --(x),                                                                                      \
-        (x)|=(x)>>1U, (x)|=(x)>>2U, (x)|=(x)>>4U, (x)|=(x)>>8U, (x)|=(x)>>16U, (x)|=(x)>>32U,       \
-        ++(x)                                                                                       \
-    )
-    #define p_uhash_int32_hash(key) p_uhash_cast_hash(key)
-    #define p_uhash_int64_hash(key) p_uhash_cast_hash(key)
-#else
-    #define p_uhash_uint_next_power_2(x) (                                                          \
-        --(x),                                                                                      \
-        (x)|=(x)>>1U, (x)|=(x)>>2U, (x)|=(x)>>4U, (x)|=(x)>>8U, (x)|=(x)>>16U,                      \
-        ++(x)                                                                                       \
-    )
-    #define p_uhash_int32_hash(key) p_uhash_cast_hash(key)
-    #define p_uhash_int64_hash(key) (uhash_uint)((key) >> 33U ^ (key) ^ (key) << 11U)
-#endif
+#define P_UHR_MAX_DIST 0x7fU
 
-#define P_UHASH_DEF_TYPE_HEAD(T, uh_key, uh_val)                                                    \
-    typedef struct UHash_##T {                                                                      \
-        /** @cond */                                                                                \
-        uhash_uint n_buckets;                                                                       \
-        uhash_uint n_occupied;                                                                      \
-        uhash_uint count;                                                                           \
-        uint32_t *flags;                                                                            \
-        uh_key *keys;                                                                               \
-        uh_val *vals;                                                                               \
-        /** @endcond */
+/*
+ * Cuckoo layout metadata: SIMD control bytes, probed in groups of P_UHK_SLOTS buckets.
+ * Tables have a power of 2 of groups, followed by a stash group holding the keys
+ * that could not be placed in either of their groups within P_UHK_MAX_KICKS evictions.
+ */
+#define P_UHK_SLOTS 8U
+#define P_UHK_ALL ((1U << P_UHK_SLOTS) - 1U)
+#define P_UHK_MAX_KICKS 64U
+#define P_UHK_MAX_GROUPS ((uhash_uint)(UHASH_UINT_MAX >> 4U) + 1U)
+#define p_uhk_group(ctrl, g) ((ctrl) + (g) * P_UHK_SLOTS)
+#define p_uhk_mask(n_buckets) ((n_buckets) / P_UHK_SLOTS - 2U)
 
-#define P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)                                                    \
-    } UHash_##T;                                                                                    \
-                                                                                                    \
-    /** @cond */                                                                                    \
-    typedef uh_key uhash_##T##_key;                                                                 \
-    typedef uh_val uhash_##T##_val;                                                                 \
-    /** @endcond */
+/*
+ * Concurrent layout metadata: SIMD control bytes, plus a pending state for buckets
+ * whose key has been inserted, but whose value has not been published yet.
+ */
+#define P_UHCC_PENDING 0xfdU
+#define p_uhcc_isused(c) ((c) != P_UHC_EMPTY && (c) != P_UHC_DELETED)
 
 /*
- * Defines a new hash table type.
+ * Checks whether a bucket is occupied, regardless of the flags layout.
+ * The layout is selected at compile time based on the size of the flag type.
  *
- * @param T [symbol] Hash table name.
- * @param uh_key [type] Hash table key type.
- * @param uh_val [type] Hash table value type.
+ * @param flags [uint32_t * or uint8_t *] Flags or control bytes.
+ * @param i [uhash_uint] Bucket index.
+ * @return [bool] True if the bucket is occupied, false otherwise.
  */
-#define P_UHASH_DEF_TYPE(T, uh_key, uh_val)                                                         \
-    P_UHASH_DEF_TYPE_HEAD(T, uh_key, uh_val)                                                        \
-    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+#define p_uhash_exists(flags, i)                                                                    \
+    (sizeof(*(flags)) == 1 ? p_uhc_isfull(flags, i) : !p_uhf_iseither(flags, i))
 
 /*
- * Defines a new hash table type with per-instance hash and equality functions.
+ * Returns the first occupied bucket at or after bucket i, regardless of the flags layout.
  *
- * @param T [symbol] Hash table name.
- * @param uh_key [type] Hash table key type.
- * @param uh_val [type] Hash table value type.
+ * @param flags [uint32_t * or uint8_t *] Flags or control bytes.
+ * @param n [uhash_uint] Number of buckets.
+ * @param i [uhash_uint] Bucket index.
+ * @return [uhash_uint] Index of the occupied bucket, or n if there is none.
  */
-#define P_UHASH_DEF_TYPE_PI(T, uh_key, uh_val)                                                      \
-    P_UHASH_DEF_TYPE_HEAD(T, uh_key, uh_val)                                                        \
-    uhash_uint (*hfunc)(uh_key key);                                                                \
-    bool (*efunc)(uh_key lhs, uh_key rhs);                                                          \
-    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+#define p_uhash_next(flags, n, i)                                                                   \
+    (sizeof(*(flags)) == 1 ? p_uhc_next((uint8_t const *)(void const *)(flags), n, i)               \
+                           : p_uhf_next((uint32_t const *)(void const *)(flags), n, i))
 
 /*
- * Generates function declarations for the specified hash table type.
+ * Iterates over the occupied buckets of a hash table.
  *
- * @param T [symbol] Hash table name.
- * @param SCOPE [scope] Scope of the declarations.
- * @param uh_key [type] Hash table key type.
- * @param uh_val [type] Hash table value type.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param i [symbol] Name of the bucket index variable.
  */
-#define P_UHASH_DECL(T, SCOPE, uh_key, uh_val)                                                      \
-    /** @cond */                                                                                    \
-    SCOPE void uhash_free_##T(UHash_##T *h);                                                        \
-    SCOPE uhash_ret uhash_copy_##T(UHash_##T const *src, UHash_##T *dest);                          \
-    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest);                   \
-    SCOPE void uhash_clear_##T(UHash_##T *h);                                                       \
-    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key);                                 \
-    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets);                       \
-    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx);                       \
-    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x);                                        \
-    SCOPE UHash_##T* uhmap_alloc_##T(void);                                                         \
-    SCOPE uh_val uhmap_get_##T(UHash_##T const *h, uh_key key, uh_val if_missing);                  \
-    SCOPE uhash_ret uhmap_set_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *existing);        \
-    SCOPE uhash_ret uhmap_add_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *existing);        \
-    SCOPE bool uhmap_replace_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *replaced);         \
-    SCOPE bool uhmap_remove_##T(UHash_##T *h, uh_key key, uh_key *r_key, uh_val *r_val);            \
-    SCOPE UHash_##T* uhset_alloc_##T(void);                                                         \
-    SCOPE uhash_ret uhset_insert_##T(UHash_##T *h, uh_key key, uh_key *existing);                   \
-    SCOPE uhash_ret uhset_insert_all_##T(UHash_##T *h, uh_key const *items, uhash_uint n);          \
-    SCOPE bool uhset_replace_##T(UHash_##T *h, uh_key key, uh_key *replaced);                       \
-    SCOPE bool uhset_remove_##T(UHash_##T *h, uh_key key, uh_key *removed);                         \
-    SCOPE bool uhset_is_superset_##T(UHash_##T const *h1, UHash_##T const *h2);                     \
-    SCOPE uhash_ret uhset_union_##T(UHash_##T *h1, UHash_##T const *h2);                            \
-    SCOPE void uhset_intersect_##T(UHash_##T *h1, UHash_##T const *h2);                             \
-    SCOPE uhash_uint uhset_hash_##T(UHash_##T const *h);                                            \
-    SCOPE uh_key uhset_get_any_##T(UHash_##T const *h, uh_key if_empty);                            \
-    /** @endcond */
+#define p_uhash_for_buckets(h, i)                                                                   \
+    for (uhash_uint i = p_uhash_next((h)->flags, (h)->n_buckets, 0); i < (h)->n_buckets;            \
+         i = p_uhash_next((h)->flags, (h)->n_buckets, i + 1))
 
 /*
- * Generates function declarations for the specified hash table type
- * with per-instance hash and equality functions.
+ * Returns a bit mask of the buckets in the group whose control byte equals the specified one.
  *
- * @param T [symbol] Hash table name.
- * @param SCOPE [scope] Scope of the declarations.
- * @param uh_key [type] Hash table key type.
- * @param uh_val [type] Hash table value type.
+ * @param group [uint8_t const *] First control byte of the group.
+ * @param c [uint8_t] Control byte.
+ * @return [uint32_t] Bit mask, one bit per bucket.
  */
-#define P_UHASH_DECL_PI(T, SCOPE, uh_key, uh_val)                                                   \
-    P_UHASH_DECL(T, SCOPE, uh_key, uh_val)                                                          \
-    /** @cond */                                                                                    \
-    SCOPE UHash_##T* uhmap_alloc_pi_##T(uhash_uint (*hash_func)(uh_key key),                        \
-                                        bool (*equal_func)(uh_key lhs, uh_key rhs));                \
-    SCOPE UHash_##T* uhset_alloc_pi_##T(uhash_uint (*hash_func)(uh_key key),                        \
-                                        bool (*equal_func)(uh_key lhs, uh_key rhs));                \
-    /** @endcond */
+p_uhash_static_inline uint32_t p_uhc_match(uint8_t const *group, uint8_t c) {
+#if defined P_UHASH_SSE2
+    __m128i const g = _mm_loadu_si128((__m128i const *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+#elif defined P_UHASH_NEON
+    static uint8_t const bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t const m = vandq_u8(vceqq_u8(vld1q_u8(group), vdupq_n_u8(c)), vld1q_u8(bits));
+    return (uint32_t)vaddv_u8(vget_low_u8(m)) | ((uint32_t)vaddv_u8(vget_high_u8(m)) << 8U);
+#else
+    uint32_t m = 0;
+    for (unsigned i = 0; i < P_UHC_GROUP_SIZE; ++i) m |= (uint32_t)(group[i] == c) << i;
+    return m;
+#endif
+}
 
 /*
- * Generates allocation function definitions for the specified hash table type.
+ * Returns a bit mask of the free (empty or deleted) buckets in the group.
  *
- * @param T [symbol] Hash table name.
- * @param SCOPE [scope] Scope of the definitions.
+ * @param group [uint8_t const *] First control byte of the group.
+ * @return [uint32_t] Bit mask, one bit per bucket.
  */
-#define P_UHASH_IMPL_ALLOC(T, SCOPE)                                                                \
-                                                                                                    \
-    SCOPE UHash_##T *uhset_alloc_##T(void) {                                                        \
-        UHash_##T *set = UHASH_MALLOC(sizeof(UHash_##T));                                           \
-        if (set) *set = (UHash_##T) { 0 };                                                          \
-        return set;                                                                                 \
+p_uhash_static_inline uint32_t p_uhc_match_free(uint8_t const *group) {
+#if defined P_UHASH_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((__m128i const *)group));
+#elif defined P_UHASH_NEON
+    static uint8_t const bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t const m = vandq_u8(vcgeq_u8(vld1q_u8(group), vdupq_n_u8(0x80U)), vld1q_u8(bits));
+    return (uint32_t)vaddv_u8(vget_low_u8(m)) | ((uint32_t)vaddv_u8(vget_high_u8(m)) << 8U);
+#else
+    uint32_t m = 0;
+    for (unsigned i = 0; i < P_UHC_GROUP_SIZE; ++i) m |= (uint32_t)(group[i] >> 7U) << i;
+    return m;
+#endif
+}
+
+#define p_uhc_match_empty(group) p_uhc_match(group, P_UHC_EMPTY)
+
+/*
+ * Returns a bit mask of the buckets in the cuckoo group whose control byte equals
+ * the specified one. Groups are compared as a single 8 byte word.
+ *
+ * @param group [uint8_t const *] First control byte of the group.
+ * @param c [uint8_t] Control byte.
+ * @return [uint32_t] Bit mask, one bit per bucket.
+ */
+p_uhash_static_inline uint32_t p_uhk_match(uint8_t const *group, uint8_t c) {
+#if defined P_UHASH_SSE2
+    __m128i const g = _mm_loadl_epi64((__m128i const *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c))) & P_UHK_ALL;
+#elif defined P_UHASH_NEON
+    static uint8_t const bits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    return (uint32_t)vaddv_u8(vand_u8(vceq_u8(vld1_u8(group), vdup_n_u8(c)), vld1_u8(bits)));
+#else
+    uint32_t m = 0;
+    for (unsigned i = 0; i < P_UHK_SLOTS; ++i) m |= (uint32_t)(group[i] == c) << i;
+    return m;
+#endif
+}
+
+/*
+ * Returns a bit mask of the free buckets in the cuckoo group.
+ *
+ * @param group [uint8_t const *] First control byte of the group.
+ * @return [uint32_t] Bit mask, one bit per bucket.
+ */
+p_uhash_static_inline uint32_t p_uhk_match_free(uint8_t const *group) {
+#if defined P_UHASH_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadl_epi64((__m128i const *)group)) & P_UHK_ALL;
+#elif defined P_UHASH_NEON
+    static uint8_t const bits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    return (uint32_t)vaddv_u8(vand_u8(vcge_u8(vld1_u8(group), vdup_n_u8(0x80U)), vld1_u8(bits)));
+#else
+    uint32_t m = 0;
+    for (unsigned i = 0; i < P_UHK_SLOTS; ++i) m |= (uint32_t)(group[i] >> 7U) << i;
+    return m;
+#endif
+}
+
+/*
+ * Returns the other group of a key in a cuckoo table, its home group being (hash & mask).
+ * The two groups always differ, so that keys can be moved from one to the other.
+ *
+ * @param hash [uhash_uint] Hash of the key.
+ * @param mask [uhash_uint] Number of groups, minus one.
+ * @return [uhash_uint] Group index.
+ */
+p_uhash_static_inline uhash_uint p_uhk_alt(uhash_uint hash, uhash_uint mask) {
+    uhash_uint const off = (uhash_uint)(((uint64_t)hash * 0x9e3779b97f4a7c15ULL) >> 32U) & mask;
+    return (hash & mask) ^ (off ? off : 1U);
+}
+
+/*
+ * Checks whether tables with the specified image layout can have the specified number of buckets.
+ *
+ * @param layout [unsigned] Image layout.
+ * @param n_buckets [uint64_t] Number of buckets.
+ * @return [bool] True if the number of buckets is valid, false otherwise.
+ */
+p_uhash_static_inline bool p_uhash_layout_fits(unsigned layout, uint64_t n_buckets) {
+    layout &= P_UHASH_LAYOUT_MASK;
+    if (layout == P_UHASH_LAYOUT_FASTRANGE) return true;
+
+    if (layout == P_UHASH_LAYOUT_CUCKOO && n_buckets) {
+        // A power of 2 of groups, at least two, followed by the stash.
+        if (n_buckets % P_UHK_SLOTS || n_buckets < 3 * P_UHK_SLOTS) return false;
+        n_buckets = n_buckets / P_UHK_SLOTS - 1;
     }
 
+    return !(n_buckets & (n_buckets - 1));
+}
+
 /*
- * Generates allocation function definitions for the specified hash table type
- * with per-instance hash and equality functions.
+ * Returns the first occupied bucket at or after bucket i in the 2-bit flags layout,
+ * or n if there is none. Flags are scanned a word (16 buckets) at a time.
  *
- * @param T [symbol] Hash table name.
- * @param SCOPE [scope] Scope of the definitions.
- * @param uh_key [type] Hash table key type.
- * @param default_hfunc [(uh_key) -> uhash_uint] Default hash function (can be NULL).
- * @param default_efunc [(uh_key, uh_key) -> bool] Default equality function (can be NULL).
+ * @param flags [uint32_t const *] Flags.
+ * @param n [uhash_uint] Number of buckets.
+ * @param i [uhash_uint] Bucket index.
+ * @return [uhash_uint] Index of the occupied bucket.
  */
-#define P_UHASH_IMPL_ALLOC_PI(T, SCOPE, uh_key, default_hfunc, default_efunc)                       \
-                                                                                                    \
-    SCOPE UHash_##T *uhset_alloc_##T(void) {                                                        \
-        UHash_##T *set = UHASH_MALLOC(sizeof(UHash_##T));                                           \
-        if (set) *set = (UHash_##T) {                                                               \
-            .hfunc = default_hfunc,                                                                 \
-            .efunc = default_efunc                                                                  \
-        };                                                                                          \
-        return set;                                                                                 \
-    }                                                                                               \
-                                                                                                    \
-    SCOPE UHash_##T* uhmap_alloc_pi_##T(uhash_uint (*hash_func)(uh_key key),                        \
-                                        bool (*equal_func)(uh_key lhs, uh_key rhs)) {               \
-        UHash_##T *h = uhmap_alloc_##T();                                                           \
-        h->hfunc = hash_func;                                                                       \
-        h->efunc = equal_func;                                                                      \
-        return h;                                                                                   \
-    }                                                                                               \
-                                                                                                    \
-    SCOPE UHash_##T* uhset_alloc_pi_##T(uhash_uint (*hash_func)(uh_key key),                        \
-                                        bool (*equal_func)(uh_key lhs, uh_key rhs)) {               \
-        UHash_##T *h = uhset_alloc_##T();                                                           \
-        h->hfunc = hash_func;                                                                       \
-        h->efunc = equal_func;                                                                      \
-        return h;                                                                                   \
+p_uhash_static_inline uhash_uint p_uhf_next(uint32_t const *flags, uhash_uint n, uhash_uint i) {
+    if (i >= n) return n;
+    uhash_uint const n_words = p_uhf_size(n);
+    uhash_uint w = i >> 4U;
+
+    // Bit 2k is set if bucket k of the word is occupied, that is if both of its flags are unset.
+    uint32_t m = ~(flags[w] | flags[w] >> 1U) & 0x55555555U & (0xffffffffU << ((i & 0xfU) << 1U));
+
+    while (!m) {
+        if (++w == n_words) return n;
+        m = ~(flags[w] | flags[w] >> 1U) & 0x55555555U;
+    }
+
+    i = (w << 4U) + (p_uhash_ctz32(m) >> 1U);
+    return i < n ? i : n;
+}
+
+/*
+ * Returns the first occupied bucket at or after bucket i in control byte layouts,
+ * or n if there is none. Control bytes are scanned a SIMD group at a time if possible,
+ * otherwise 8 at a time.
+ *
+ * @param ctrl [uint8_t const *] Control bytes.
+ * @param n [uhash_uint] Number of buckets.
+ * @param i [uhash_uint] Bucket index.
+ * @return [uhash_uint] Index of the occupied bucket.
+ */
+p_uhash_static_inline uhash_uint p_uhc_next(uint8_t const *ctrl, uhash_uint n, uhash_uint i) {
+#if defined P_UHASH_SSE2 || defined P_UHASH_NEON
+    for (; i < n && n - i >= (uhash_uint)P_UHC_GROUP_SIZE; i += P_UHC_GROUP_SIZE) {
+        uint32_t const m = ~p_uhc_match_free(ctrl + i) & 0xffffU;
+        if (m) return i + p_uhash_ctz32(m);
+    }
+#else
+    for (uint64_t w; i < n && n - i >= 8; i += 8) {
+        // Skips 8 free buckets at a time, since free control bytes have their high bit set.
+        memcpy(&w, ctrl + i, sizeof(w));
+        if (~w & 0x8080808080808080ULL) break;
+    }
+#endif
+    for (; i < n; ++i) {
+        if (p_uhc_isfull(ctrl, i)) return i;
     }
+    return n;
+}
 
 /*
- * Generates common function definitions for the specified hash table type.
+ * Returns the maximum load factor of a table, or the specified default if it has none.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @param default_load [double] Default maximum load factor.
+ * @return [double] Maximum load factor.
+ */
+#define p_uhash_load(h, default_load) ((h)->max_load > 0 ? (h)->max_load : (default_load))
+
+/*
+ * Computes the maximum number of occupied buckets for the specified load factor,
+ * always leaving at least one bucket free.
+ *
+ * @param n_buckets [uhash_uint] Number of buckets.
+ * @param max_load [double] Maximum load factor.
+ * @return [uhash_uint] Upper bound.
+ */
+p_uhash_static_inline uhash_uint p_uhash_bound(uhash_uint n_buckets, double max_load) {
+    uhash_uint const bound = (uhash_uint)(n_buckets * max_load + 0.5);
+    return bound < n_buckets || !n_buckets ? bound : n_buckets - 1;
+}
+
+/*
+ * Computes the maximum number of elements that the table can contain
+ * before it needs to be resized in order to keep its load factor under its maximum
+ * (UHASH_MAX_LOAD by default). Tables cache it in their 'max_occupied' field.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @param n_buckets [uhash_uint] Number of buckets.
+ * @return [uhash_uint] Upper bound.
+ */
+#define p_uhash_upper_bound(h, n_buckets) p_uhash_bound(n_buckets, p_uhash_load(h, UHASH_MAX_LOAD))
+
+/*
+ * Computes the number of elements under which the table should be shrunk.
+ *
+ * @param n_buckets [uhash_uint] Number of buckets.
+ * @return [uhash_uint] Lower bound.
+ */
+#define p_uhash_lower_bound(n_buckets) ((uhash_uint)((n_buckets) * UHASH_SHRINK_LOAD))
+
+/*
+ * Returns the largest bucket count that the specified hash table type can store.
  *
  * @param T [symbol] Hash table name.
- * @param SCOPE [scope] Scope of the definitions.
- * @param uh_key [type] Hash table key type.
- * @param uh_val [type] Hash table value type.
- * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
- * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ * @return [uhash_uint] Maximum number of buckets.
  */
-#define P_UHASH_IMPL_COMMON(T, SCOPE, uh_key, uh_val, hash_func, equal_func)                        \
-                                                                                                    \
-    SCOPE void uhash_free_##T(UHash_##T *h) {                                                       \
-        if (!h) return;                                                                             \
-        UHASH_FREE((void *)h->keys);                                                                \
-        UHASH_FREE((void *)h->vals);                                                                \
-        UHASH_FREE(h->flags);                                                                       \
-        UHASH_FREE(h);                                                                              \
-    }                                                                                               \
-                                                                                                    \
-    SCOPE uhash_ret uhash_copy_##T(UHash_##T const *src, UHash_##T *dest) {                         \
-        uhash_ret ret = uhash_copy_as_set_##T(src, dest);                                           \
-                                                                                                    \
-        if (ret == UHASH_OK && src->vals) {                                                         \
-            uhash_uint n_buckets = src->n_buckets;                                                  \
-            uh_val *new_vals = UHASH_REALLOC(dest->vals, n_buckets * sizeof(uh_val));               \
-            if (new_vals) {                                                                         \
-                memcpy(new_vals, src->vals, n_buckets * sizeof(uh_val));                            \
-                dest->vals = new_vals;                                                              \
-            } else {                                                                                \
-                ret = UHASH_ERR;                                                                    \
-            }                                                                                       \
-        }                                                                                           \
-                                                                                                    \
-        return ret;                                                                                 \
-    }                                                                                               \
-                                                                                                    \
-    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest) {                  \
-        uhash_ret ret = UHASH_OK;                                                                   \
-                                                                                                    \
-        uhash_uint n_buckets = src->n_buckets;                                                      \
-        uhash_uint n_flags = p_uhf_size(n_buckets);                                                 \
-                                                                                                    \
-        uint32_t *new_flags = UHASH_REALLOC(dest->flags, n_flags * sizeof(uint32_t));               \
-        uh_key *new_keys = UHASH_REALLOC(dest->keys, n_buckets * sizeof(uh_key));                   \
-                                                                                                    \
-        if (new_flags && new_keys) {                                                                \
-            memcpy(new_flags, src->flags, n_flags * sizeof(uint32_t));                              \
-            memcpy(new_keys, src->keys, n_buckets * sizeof(uh_key));                                \
-            dest->flags = new_flags;                                                                \
-            dest->keys = new_keys;                                                                  \
-            dest->n_buckets = n_buckets;                                                            \
-            dest->n_occupied = src->n_occupied;                                                     \
-            dest->count = src->count;                                                               \
-        } else {                                                                                    \
-            ret = UHASH_ERR;                                                                        \
-        }                                                                                           \
-                                                                                                    \
-        return ret;                                                                                 \
-    }                                                                                               \
-                                                                                                    \
-    SCOPE void uhash_clear_##T(UHash_##T *h) {                                                      \
-        if (h && h->flags) {                                                                        \
-            memset(h->flags, 0xaa, p_uhf_size(h->n_buckets) * sizeof(uint32_t));                    \
-            h->count = h->n_occupied = 0;                                                           \
-        }                                                                                           \
-    }                                                                                               \
-                                                                                                    \
-    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key) {                                \
-        if (!h->n_buckets) return UHASH_INDEX_MISSING;                                              \
-                                                                                                    \
-        uhash_uint const mask = h->n_buckets - 1;                                                   \
-        uhash_uint i = (uhash_uint)(hash_func(key)) & mask;                                         \
-        uhash_uint step = 0;                                                                        \
-        uhash_uint const last = i;                                                                  \
-                                                                                                    \
-        while (!p_uhf_isempty(h->flags, i) &&                                                       \
-               (p_uhf_isdel(h->flags, i) || !equal_func(h->keys[i], key))) {                        \
-            i = (i + (++step)) & mask;                                                              \
-            if (i == last) return UHASH_INDEX_MISSING;                                              \
-        }                                                                                           \
-                                                                                                    \
-        return p_uhf_iseither(h->flags, i) ? UHASH_INDEX_MISSING : i;                               \
-    }                                                                                               \
-                                                                                                    \
-    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets) {                      \
-        /* Uses (0.25*n_buckets) bytes instead of [sizeof(uh_key+uh_val)+.25]*n_buckets. */         \
-        uint32_t *new_flags = NULL;                                                                 \
-        uhash_uint j = 1;                                                                           \
-        {                                                                                           \
-            p_uhash_uint_next_power_2(new_n_buckets);                                               \
-            if (new_n_buckets < 4) new_n_buckets = 4;                                               \
-                                                                                                    \
-            if (h->count >= p_uhash_upper_bound(new_n_buckets)) {                                   \
-                /* Requested size is too small. */                                                  \
-                j = 0;                                                                              \
-            } else {                                                                                \
-                /* Hash table size needs to be changed (shrink or expand): rehash. */               \
-                new_flags = UHASH_MALLOC(p_uhf_size(new_n_buckets) * sizeof(uint32_t));             \
-                if (!new_flags) return UHASH_ERR;                                                   \
-                                                                                                    \
-                memset(new_flags, 0xaa, p_uhf_size(new_n_buckets) * sizeof(uint32_t));              \
-                                                                                                    \
-                if (h->n_buckets < new_n_buckets) {                                                 \
-                    /* Expand. */                                                                   \
-                    uh_key *new_keys = UHASH_REALLOC(h->keys, new_n_buckets * sizeof(uh_key));      \
-                                                                                                    \
-                    if (!new_keys) {                                                                \
-                        UHASH_FREE(new_flags);                                                      \
-                        return UHASH_ERR;                                                           \
-                    }                                                                               \
-                                                                                                    \
-                    h->keys = new_keys;                                                             \
-                                                                                                    \
-                    if (h->vals) {                                                                  \
-                        uh_val *nvals = UHASH_REALLOC(h->vals, new_n_buckets * sizeof(uh_val));     \
-                                                                                                    \
-                        if (!nvals) {                                                               \
-                            UHASH_FREE(new_flags);                                                  \
-                            return UHASH_ERR;                                                       \
-                        }                                                                           \
-                                                                                                    \
-                        h->vals = nvals;                                                            \
-                    }                                                                               \
-                } /* Otherwise shrink. */                                                           \
-            }                                                                                       \
-        }                                                                                           \
-                                                                                                    \
-        if (!j) return UHASH_OK;                                                                    \
-                                                                                                    \
-        /* Rehashing is needed. */                                                                  \
-        for (j = 0; j != h->n_buckets; ++j) {                                                       \
-            if (p_uhf_iseither(h->flags, j)) continue;                                              \
-                                                                                                    \
-            uhash_uint const new_mask = new_n_buckets - 1;                                          \
-            uh_key key = h->keys[j];                                                                \
-            uh_val val = {0};                                                                       \
-            if (h->vals) val = h->vals[j];                                                          \
-            p_uhf_set_isdel_true(h->flags, j);                                                      \
-                                                                                                    \
-            while (true) {                                                                          \
-                /* Kick-out process; sort of like in Cuckoo hashing. */                             \
-                uhash_uint i = (uhash_uint)(hash_func(key)) & new_mask;                             \
-                uhash_uint step = 0;                                                                \
+#define p_uhash_idx_max(T) ((uhash_uint)(uhash_##T##_idx)-1)
+
+/*
+ * Checks whether the table should be shrunk.
+ * Only tables that had keys deleted since they were last resized or cleared are shrunk,
+ * so that explicitly resized ones are not.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [bool] True if the table should be shrunk, false otherwise.
+ */
+#define p_uhash_should_shrink(h)                                                                    \
+    (((h)->removed || (h)->n_occupied > (h)->count) &&                                              \
+     (h)->count < p_uhash_lower_bound((h)->n_buckets))
+
+/*
+ * Checks whether a table that reached its upper bound should be rehashed at the same size,
+ * clearing its deleted buckets, rather than expanded. This requires at most half of its buckets
+ * to be in use, and rehashing to leave room for at least a quarter of its upper bound.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [bool] True if the table should be rehashed at the same size, false otherwise.
+ */
+#define p_uhash_should_compact(h)                                                                   \
+    ((h)->n_buckets > ((h)->count << 1U) &&                                                         \
+     (h)->count < (h)->max_occupied - ((h)->max_occupied >> 2U))
+
+/*
+ * Same as p_uhash_upper_bound, for hash tables using the SIMD control byte layout
+ * (UHASH_SIMD_MAX_LOAD by default).
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @param n_buckets [uhash_uint] Number of buckets.
+ * @return [uhash_uint] Upper bound.
+ */
+#define p_uhash_simd_upper_bound(h, n_buckets)                                                      \
+    p_uhash_bound(n_buckets, p_uhash_load(h, UHASH_SIMD_MAX_LOAD))
+
+/*
+ * Same as p_uhash_upper_bound, for cuckoo hash tables (UHASH_CUCKOO_MAX_LOAD by default).
+ * The stash only holds keys that could not be placed elsewhere, so it is not counted.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @param n_buckets [uhash_uint] Number of buckets.
+ * @return [uhash_uint] Upper bound.
+ */
+#define p_uhash_cuckoo_upper_bound(h, n_buckets)                                                    \
+    p_uhash_bound((n_buckets) ? (n_buckets) - P_UHK_SLOTS : 0,                                      \
+                  p_uhash_load(h, UHASH_CUCKOO_MAX_LOAD))
+
+/*
+ * Karl Nelson <kenelson@ece.ucdavis.edu>'s X31 string hash function.
+ *
+ * @param key [char const *] The string to hash.
+ * @return [uhash_uint] The hash value.
+ */
+p_uhash_static_inline uhash_uint p_uhash_x31_str_hash(char const *key) {
+    uhash_uint h = (uhash_uint)*key;
+    if (h) for (++key ; *key; ++key) h = (h << 5U) - h + (uhash_uint)(*key);
+    return h;
+}
+
+#define p_uhash_cast_hash(key) (uhash_uint)(key)
+#define p_uhash_int8_hash(key) p_uhash_cast_hash(key)
+#define p_uhash_int16_hash(key) p_uhash_cast_hash(key)
+
+// Folds a 64 bit hash into a uhash_uint.
+#if defined UHASH_TINY
+    #define p_uhash_fold64(h) (uhash_uint)((h) ^ (h) >> 16U ^ (h) >> 32U ^ (h) >> 48U)
+#elif defined UHASH_HUGE
+    #define p_uhash_fold64(h) (uhash_uint)(h)
+#else
+    #define p_uhash_fold64(h) (uhash_uint)((h) ^ (h) >> 32U)
+#endif
+
+/*
+ * MurmurHash3's 32 bit finalizer.
+ *
+ * @param key [uint32_t] The integer.
+ * @return [uint32_t] Mixed integer, all of whose bits depend on all bits of the key.
+ */
+p_uhash_static_inline uint32_t p_uhash_fmix32(uint32_t key) {
+    key ^= key >> 16U;
+    key *= 0x85ebca6bU;
+    key ^= key >> 13U;
+    key *= 0xc2b2ae35U;
+    return key ^ key >> 16U;
+}
+
+/*
+ * MurmurHash3's 64 bit finalizer.
+ *
+ * @param key [uint64_t] The integer.
+ * @return [uint64_t] Mixed integer, all of whose bits depend on all bits of the key.
+ */
+p_uhash_static_inline uint64_t p_uhash_fmix64(uint64_t key) {
+    key ^= key >> 33U;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33U;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    return key ^ key >> 33U;
+}
+
+#if defined __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 p_uhash_uint128;
+#elif defined _MSC_VER && defined _M_X64
+    #include <intrin.h>
+    #pragma intrinsic(_umul128)
+#endif
+
+/*
+ * Multiplies two 64 bit integers, storing the low and high halves of the product.
+ *
+ * @param a [uint64_t *] First factor, replaced by the low half of the product.
+ * @param b [uint64_t *] Second factor, replaced by the high half of the product.
+ */
+p_uhash_static_inline void p_uhash_mum(uint64_t *a, uint64_t *b) {
+#if defined __SIZEOF_INT128__
+    p_uhash_uint128 const r = (p_uhash_uint128)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64U);
+#elif defined _MSC_VER && defined _M_X64
+    *a = _umul128(*a, *b, b);
+#else
+    uint64_t const ha = *a >> 32U, hb = *b >> 32U, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t const rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t const t = rl + (rm0 << 32U), lo = t + (rm1 << 32U);
+    *b = rh + (rm0 >> 32U) + (rm1 >> 32U) + (t < rl) + (lo < t);
+    *a = lo;
+#endif
+}
+
+/*
+ * Multiplies two 64 bit integers, folding the product.
+ *
+ * @param a [uint64_t] First factor.
+ * @param b [uint64_t] Second factor.
+ * @return [uint64_t] XOR of the low and high halves of the product.
+ */
+p_uhash_static_inline uint64_t p_uhash_mix(uint64_t a, uint64_t b) {
+    p_uhash_mum(&a, &b);
+    return a ^ b;
+}
+
+// Unaligned native-endian reads, used by p_uhash_wyhash.
+p_uhash_static_inline uint64_t p_uhash_read64(uint8_t const *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+p_uhash_static_inline uint64_t p_uhash_read32(uint8_t const *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * Wang Yi's wyhash (final version 4), reading 8 bytes at a time and 48 bytes
+ * per iteration in three independent lanes for long inputs.
+ *
+ * @param key [void const *] Pointer to the bytes to hash.
+ * @param len [size_t] Number of bytes.
+ * @param seed [uint64_t] Seed.
+ * @return [uint64_t] The hash value.
+ */
+p_uhash_static_inline uint64_t p_uhash_wyhash(void const *key, size_t len, uint64_t seed) {
+    static uint64_t const s[] = {
+        0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+    };
+    uint8_t const *p = key;
+    uint64_t a = 0, b = 0;
+    seed ^= p_uhash_mix(seed ^ s[0], s[1]);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t const off = (len >> 3U) << 2U;
+            a = p_uhash_read32(p) << 32U | p_uhash_read32(p + off);
+            b = p_uhash_read32(p + len - 4) << 32U | p_uhash_read32(p + len - 4 - off);
+        } else if (len) {
+            a = (uint64_t)p[0] << 16U | (uint64_t)p[len >> 1U] << 8U | p[len - 1];
+        }
+    } else {
+        size_t i = len;
+
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = p_uhash_mix(p_uhash_read64(p) ^ s[1], p_uhash_read64(p + 8) ^ seed);
+                see1 = p_uhash_mix(p_uhash_read64(p + 16) ^ s[2], p_uhash_read64(p + 24) ^ see1);
+                see2 = p_uhash_mix(p_uhash_read64(p + 32) ^ s[3], p_uhash_read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        for (; i > 16; i -= 16, p += 16) {
+            seed = p_uhash_mix(p_uhash_read64(p) ^ s[1], p_uhash_read64(p + 8) ^ seed);
+        }
+
+        a = p_uhash_read64(p + i - 16);
+        b = p_uhash_read64(p + i - 8);
+    }
+
+    a ^= s[1];
+    b ^= seed;
+    p_uhash_mum(&a, &b);
+    return p_uhash_mix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
+/*
+ * Hash function for 64 bit integers, mixing the key with a seed as wyhash does.
+ *
+ * @param key [uint64_t] The integer.
+ * @param seed [uint64_t] Seed.
+ * @return [uint64_t] The hash value.
+ */
+p_uhash_static_inline uint64_t p_uhash_int_seeded_hash(uint64_t key, uint64_t seed) {
+    return p_uhash_mix(key ^ seed ^ 0x2d358dccaa6c78a5ULL, seed ^ 0x8bb84b93962eacc9ULL);
+}
+
+/*
+ * Derives a new seed for a hash table from UHASH_RANDOM_SEED, its previous seed,
+ * and the addresses of the table and of the stack.
+ *
+ * @param h [void const *] The hash table.
+ * @param prev [uint64_t] Previous seed of the table.
+ * @return [uint64_t] The new seed, always different from the previous one.
+ */
+p_uhash_static_inline uint64_t p_uhash_seed(void const *h, uint64_t prev) {
+    uint64_t const addr = (uint64_t)(uintptr_t)h ^ (uint64_t)(uintptr_t)&prev << 16U;
+    uint64_t const entropy = (uint64_t)(UHASH_RANDOM_SEED());
+    // fmix64 is a bijection, and it is never a fixed point in practice.
+    return p_uhash_fmix64(prev ^ p_uhash_mix(addr ^ 0xa0761d6478bd642fULL,
+                                             entropy ^ 0xe7037ed1a0b428dbULL));
+}
+
+/*
+ * Hash function for string views, reusing their precomputed hash if present.
+ *
+ * @param key [UHashStrView] The string view.
+ * @return [uhash_uint] The hash value.
+ */
+p_uhash_static_inline uhash_uint p_uhash_strv_hash(UHashStrView key) {
+    return key.hash ? key.hash : p_uhash_fold64(p_uhash_wyhash(key.data, key.length, 0));
+}
+
+/*
+ * Equality function for string views. Characters are only compared if the lengths match,
+ * and if the hashes match as well in case both are precomputed.
+ *
+ * @param a [UHashStrView] LHS of the equality relation.
+ * @param b [UHashStrView] RHS of the equality relation.
+ * @return [bool] True if a is equal to b, false otherwise.
+ */
+p_uhash_static_inline bool p_uhash_strv_equals(UHashStrView a, UHashStrView b) {
+    if (a.length != b.length || (a.hash && b.hash && a.hash != b.hash)) return false;
+    return a.data == b.data || !a.length || memcmp(a.data, b.data, a.length) == 0;
+}
+
+/*
+ * Creates a string view, optionally precomputing its hash.
+ *
+ * @param data [char const *] Pointer to the first character.
+ * @param length [size_t] Number of characters.
+ * @param hashed [bool] True if the hash should be precomputed.
+ * @return [UHashStrView] The string view.
+ */
+p_uhash_static_inline UHashStrView p_uhash_strv(char const *data, size_t length, bool hashed) {
+    UHashStrView view = { .data = data, .length = length };
+    if (hashed) view.hash = p_uhash_strv_hash(view);
+    return view;
+}
+
+#if defined UHASH_TINY
+    #define p_uhash_uint_next_power_2(x) (                                                          \
+        --(x),                                                                                      \
+        (x)|=(x)>>1U, (x)|=(x)>>2U, (x)|=(x)>>4U, (x)|=(x)>>8U,                                     \
+        ++(x)                                                                                       \
+    )
+    #define p_uhash_int32_hash(key) (uhash_uint)((key) >> 17U ^ (key) ^ (key) << 6U)
+    #define p_uhash_int64_hash(key) (uhash_uint)(                                                   \
+        (key) >> 49U ^ (key) >> 33U ^ (key) >> 17U ^ (key) ^                                        \
+        (key) << 6U ^ (key) << 23U ^ (key) << 39U                                                   \
+    )
+#elif defined UHASH_HUGE
+    #define p_uhash_uint_next_power_2(x) (                                                          \
+        --(x),                                                                                      \
+        (x)|=(x)>>1U, (x)|=(x)>>2U, (x)|=(x)>>4U, (x)|=(x)>>8U, (x)|=(x)>>16U, (x)|=(x)>>32U,       \
+        ++(x)                                                                                       \
+    )
+    #define p_uhash_int32_hash(key) p_uhash_cast_hash(key)
+    #define p_uhash_int64_hash(key) p_uhash_cast_hash(key)
+#else
+    #define p_uhash_uint_next_power_2(x) (                                                          \
+        --(x),                                                                                      \
+        (x)|=(x)>>1U, (x)|=(x)>>2U, (x)|=(x)>>4U, (x)|=(x)>>8U, (x)|=(x)>>16U,                      \
+        ++(x)                                                                                       \
+    )
+    #define p_uhash_int32_hash(key) p_uhash_cast_hash(key)
+    #define p_uhash_int64_hash(key) (uhash_uint)((key) >> 33U ^ (key) ^ (key) << 11U)
+#endif
+
+/*
+ * Bucket indexing of the 2-bit flags layout. Tables have a power of 2 number of buckets
+ * and use triangular probing, unless UHASH_GROWTH_FACTOR is defined: tables then grow by
+ * that factor and can have any number of buckets, since hashes are mapped to buckets via
+ * multiply-shift (fastrange) reduction and probing is linear.
+ *
+ * - p_uhf_round(n): rounds the requested number of buckets in place.
+ * - p_uhf_grow(n): number of buckets requested when growing a table having n buckets.
+ * - p_uhf_home(hash, n): home bucket of a hash.
+ * - p_uhf_probe(i, step, n): bucket following bucket i, at the specified probe step.
+ * - p_uhf_dist(from, to, n): number of probe steps from bucket 'from' to bucket 'to'.
+ */
+#ifdef UHASH_GROWTH_FACTOR
+    /* Reduction uses the high bits, so hashes are scrambled by a Fibonacci multiplier first. */
+    #if defined UHASH_TINY
+        #define p_uhash_fastrange(x, n)                                                             \
+            (uhash_uint)(((uint32_t)(uint16_t)((x) * 0x9e37U) * (n)) >> 16U)
+    #elif defined UHASH_HUGE && defined __SIZEOF_INT128__
+        __extension__ typedef unsigned __int128 p_uhash_uint128;
+        #define p_uhash_fastrange(x, n)                                                             \
+            (uhash_uint)(((p_uhash_uint128)((x) * 0x9e3779b97f4a7c15ULL) * (n)) >> 64U)
+    #elif defined UHASH_HUGE
+        #define p_uhash_fastrange(x, n) (uhash_uint)(((x) * 0x9e3779b97f4a7c15ULL) % (n))
+    #else
+        #define p_uhash_fastrange(x, n)                                                             \
+            (uhash_uint)(((uint64_t)(uint32_t)((x) * 0x9e3779b9U) * (n)) >> 32U)
+    #endif
+    #define P_UHF_LAYOUT P_UHASH_LAYOUT_FASTRANGE
+    #define p_uhf_round(n) ((void)(n))
+    #define p_uhf_grow(n)                                                                           \
+        ((n) * (UHASH_GROWTH_FACTOR) < (double)UHASH_UINT_MAX                                       \
+         ? (uhash_uint)((n) * (UHASH_GROWTH_FACTOR)) + 1 : UHASH_UINT_MAX)
+    #define p_uhf_max(max) (max)
+    #define p_uhf_home(hash, n) p_uhash_fastrange(hash, n)
+    #define p_uhf_probe(i, step, n) ((void)(step), (i) + 1 == (n) ? 0 : (i) + 1)
+    #define p_uhf_dist(from, to, n) ((to) >= (from) ? (to) - (from) : (to) + (n) - (from))
+#else
+    #define P_UHF_LAYOUT P_UHASH_LAYOUT_FLAGS
+    #define p_uhf_round(n) p_uhash_uint_next_power_2(n)
+    #define p_uhf_grow(n) ((n) + 1)
+    #define p_uhf_max(max) ((max) / 2 + 1)
+    #define p_uhf_home(hash, n) ((hash) & ((n) - 1))
+    #define p_uhf_probe(i, step, n) (((i) + (step)) & ((n) - 1))
+    #define p_uhf_dist(from, to, n) p_uhash_tri_dist(from, to, (n) - 1)
+#endif
+
+/*
+ * Chunk of a string arena, followed by its bytes.
+ */
+typedef struct UHashArenaChunk {
+    struct UHashArenaChunk *next;
+    size_t size;
+} UHashArenaChunk;
+
+/*
+ * Arena of bytes, allocated in chunks and released all at once.
+ * Allocations never move, and are carved out of the most recent chunk.
+ */
+typedef struct UHashArena {
+    UHashArenaChunk *head;
+    size_t used;
+} UHashArena;
+
+/*
+ * Reader counters of concurrent hash tables.
+ *
+ * Readers register in the counter of the current epoch before accessing the buckets.
+ * The writer retires buckets by advancing the epoch, then waiting for the counters
+ * of the previous epoch to drop to zero before freeing them.
+ */
+typedef struct UHashConcStripe {
+    unsigned count[2];
+    unsigned char pad[P_UHASH_CACHE_LINE - 2 * sizeof(unsigned)];
+} UHashConcStripe;
+
+#ifdef P_UHASH_ATOMICS
+
+/*
+ * Registers a reader in the current epoch.
+ *
+ * @param stripes [UHashConcStripe *] Reader counters.
+ * @param epoch [unsigned *] Epoch.
+ * @return [unsigned *] Counter to pass to p_uhash_conc_exit.
+ */
+p_uhash_static_inline unsigned *p_uhash_conc_enter(UHashConcStripe *stripes, unsigned *epoch) {
+    // Threads run on distinct stacks, so the address of a local tells them apart.
+    uintptr_t const addr = (uintptr_t)(void *)&stripes;
+    uint32_t const s = (uint32_t)((addr >> 12U) ^ (addr >> 20U)) * 0x9e3779b1U;
+    UHashConcStripe *stripe = stripes + (s >> 24U) % UHASH_CONC_STRIPES;
+
+    for (;;) {
+        unsigned const e = p_uhash_atomic_load(epoch, SEQ_CST);
+        unsigned *counter = stripe->count + (e & 1U);
+        p_uhash_atomic_add(counter, 1U, SEQ_CST);
+        // If the epoch changed meanwhile, the writer may not be waiting for this counter.
+        if (p_uhash_atomic_load(epoch, SEQ_CST) == e) return counter;
+        p_uhash_atomic_sub(counter, 1U, RELEASE);
+    }
+}
+
+/*
+ * Unregisters a reader.
+ *
+ * @param counter [unsigned *] Counter returned by p_uhash_conc_enter.
+ */
+p_uhash_static_inline void p_uhash_conc_exit(unsigned *counter) {
+    p_uhash_atomic_sub(counter, 1U, RELEASE);
+}
+
+/*
+ * Advances the epoch, waiting for readers registered in the previous one.
+ * Buckets unpublished before calling this function can be freed once it returns.
+ *
+ * @param stripes [UHashConcStripe *] Reader counters.
+ * @param epoch [unsigned *] Epoch.
+ */
+p_uhash_static_inline void p_uhash_conc_synchronize(UHashConcStripe *stripes, unsigned *epoch) {
+    unsigned const e = *epoch;
+    p_uhash_atomic_store(epoch, e + 1U, SEQ_CST);
+
+    for (unsigned i = 0; i < UHASH_CONC_STRIPES; ++i) {
+        while (p_uhash_atomic_load(stripes[i].count + (e & 1U), SEQ_CST)) p_uhash_cpu_relax();
+    }
+}
+
+/*
+ * Acquires a spinlock.
+ *
+ * @param lock [unsigned *] Lock, zero if not held.
+ */
+p_uhash_static_inline void p_uhash_spin_lock(unsigned *lock) {
+    while (p_uhash_atomic_exchange(lock, 1U, ACQUIRE)) {
+        while (p_uhash_atomic_load(lock, RELAXED)) p_uhash_cpu_relax();
+    }
+}
+
+/*
+ * Releases a spinlock.
+ *
+ * @param lock [unsigned *] Lock.
+ */
+p_uhash_static_inline void p_uhash_spin_unlock(unsigned *lock) {
+    p_uhash_atomic_store(lock, 0U, RELEASE);
+}
+
+#endif
+
+/*
+ * Returns the number of tasks parallel operations should be split into.
+ *
+ * @param ex [UHashExecutor const *] Executor, can be NULL.
+ * @return [unsigned] Number of tasks, 1 if work should be done by the calling thread.
+ */
+p_uhash_static_inline unsigned p_uhash_par_tasks(UHashExecutor const *ex) {
+    return ex && ex->run_fn && ex->n_tasks > 1 ? ex->n_tasks : 1;
+}
+
+/*
+ * Returns the start of the range of [0, len) assigned to the specified task.
+ * The range of task t ends where that of task t + 1 starts.
+ *
+ * @param len [uhash_uint] Length of the whole range.
+ * @param n_tasks [unsigned] Number of tasks.
+ * @param t [unsigned] Task index, up to n_tasks.
+ * @return [uhash_uint] Start of the range.
+ */
+p_uhash_static_inline uhash_uint p_uhash_par_bound(uhash_uint len, unsigned n_tasks, unsigned t) {
+    uhash_uint const chunk = len / n_tasks + (len % n_tasks != 0);
+    uhash_uint const bound = chunk * t;
+    return bound < len ? bound : len;
+}
+
+#ifdef _OPENMP
+
+/*
+ * Runs tasks via OpenMP.
+ */
+p_uhash_static_inline void p_uhash_omp_run(void *ctx, unsigned n,
+                                           void (*task)(void *arg, unsigned i), void *arg) {
+    (void)ctx;
+    _Pragma("omp parallel for schedule(static, 1)")
+    for (int i = 0; i < (int)n; ++i) task(arg, (unsigned)i);
+}
+
+#endif
+
+// Number of shards of a sharded hash table.
+#define p_uhash_n_shards(h) (sizeof((h)->shards) / sizeof(*(h)->shards))
+
+/*
+ * Returns the number of bytes needed to pack the specified number of values.
+ *
+ * @param n [size_t] Number of values.
+ * @param bits [unsigned] Bits per value (1, 2 or 4).
+ * @return [size_t] Number of bytes.
+ */
+p_uhash_static_inline size_t p_uhash_packed_size(size_t n, unsigned bits) {
+    return (n * bits + 7U) >> 3U;
+}
+
+/*
+ * Reads a value from an array of bit-packed values.
+ *
+ * @param vals [uint8_t const *] Packed values.
+ * @param i [uhash_uint] Index of the value.
+ * @param bits [unsigned] Bits per value (1, 2 or 4).
+ * @return [uint8_t] Value.
+ */
+p_uhash_static_inline uint8_t p_uhash_packed_get(uint8_t const *vals, uhash_uint i, unsigned bits) {
+    unsigned const per_byte = 8U / bits;
+    unsigned const shift = (unsigned)(i % per_byte) * bits;
+    return (uint8_t)((vals[i / per_byte] >> shift) & ((1U << bits) - 1U));
+}
+
+/*
+ * Writes a value to an array of bit-packed values, discarding its excess bits.
+ *
+ * @param vals [uint8_t *] Packed values.
+ * @param i [uhash_uint] Index of the value.
+ * @param val [uint8_t] Value.
+ * @param bits [unsigned] Bits per value (1, 2 or 4).
+ */
+p_uhash_static_inline void p_uhash_packed_set(uint8_t *vals, uhash_uint i, uint8_t val,
+                                              unsigned bits) {
+    unsigned const per_byte = 8U / bits;
+    unsigned const shift = (unsigned)(i % per_byte) * bits;
+    unsigned const mask = ((1U << bits) - 1U) << shift;
+    uint8_t *byte = vals + i / per_byte;
+    *byte = (uint8_t)((*byte & ~mask) | (((unsigned)val << shift) & mask));
+}
+
+/*
+ * Hash cache accessors, used by P_UHASH_IMPL_CORE to optionally store the hash of each key.
+ *
+ * - P_UHASH_HC_NONE: hashes are not cached, and are recomputed when needed.
+ * - P_UHASH_HC_BUCKETS: hashes are stored in a 'hashes' array, next to 'keys' and 'vals'.
+ */
+#define P_UHASH_HC_NONE_ENABLED 0
+#define P_UHASH_HC_NONE_GET(h) ((uhash_uint *)NULL)
+#define P_UHASH_HC_NONE_SET(h, p) ((void)(p))
+#define P_UHASH_HC_BUCKETS_ENABLED 1
+#define P_UHASH_HC_BUCKETS_GET(h) ((h)->hashes)
+#define P_UHASH_HC_BUCKETS_SET(h, p) ((h)->hashes = (p))
+
+/*
+ * Value storage accessors, used by P_UHASH_IMPL_CORE to optionally bit-pack values.
+ *
+ * - P_UHASH_VS_PLAIN: values are stored in a 'vals' array of uh_val.
+ * - P_UHASH_VS_PACKED: values are stored in a 'vals' byte array,
+ *   using P_UHASH_VAL_BITS_##T bits each.
+ * - P_UHASH_VS_SEEDED: values are stored as with P_UHASH_VS_PLAIN, but keys are placed based on
+ *   the seed of the table, so that the buckets have no image layout.
+ */
+#define P_UHASH_VS_PLAIN_SIZE(T, n) ((size_t)(n) * sizeof(uhash_##T##_val))
+#define P_UHASH_VS_PLAIN_GET(T, vals, i) ((vals)[i])
+#define P_UHASH_VS_PLAIN_SET(T, vals, i, v) ((vals)[i] = (v))
+#define P_UHASH_VS_PLAIN_LAYOUT(T, layout) (layout)
+#define P_UHASH_VS_PACKED_SIZE(T, n) p_uhash_packed_size(n, P_UHASH_VAL_BITS_##T)
+#define P_UHASH_VS_PACKED_GET(T, vals, i) p_uhash_packed_get(vals, i, P_UHASH_VAL_BITS_##T)
+#define P_UHASH_VS_PACKED_SET(T, vals, i, v) p_uhash_packed_set(vals, i, v, P_UHASH_VAL_BITS_##T)
+#define P_UHASH_VS_PACKED_LAYOUT(T, layout) P_UHASH_LAYOUT_PACKED(layout, P_UHASH_VAL_BITS_##T)
+#define P_UHASH_VS_SEEDED_SIZE(T, n) P_UHASH_VS_PLAIN_SIZE(T, n)
+#define P_UHASH_VS_SEEDED_GET(T, vals, i) P_UHASH_VS_PLAIN_GET(T, vals, i)
+#define P_UHASH_VS_SEEDED_SET(T, vals, i, v) P_UHASH_VS_PLAIN_SET(T, vals, i, v)
+#define P_UHASH_VS_SEEDED_LAYOUT(T, layout) P_UHASH_LAYOUT_NONE
+
+#define P_UHASH_DEF_TYPE_HEAD(T, uh_flag, uh_idx, uh_key, uh_val)                                   \
+    /** @cond */                                                                                    \
+    typedef uh_idx uhash_##T##_idx;                                                                 \
+    /** @endcond */                                                                                 \
                                                                                                     \
-                while (!p_uhf_isempty(new_flags, i)) i = (i + (++step)) & new_mask;                 \
-                p_uhf_set_isempty_false(new_flags, i);                                              \
+    typedef struct UHash_##T {                                                                      \
+        /** @cond */                                                                                \
+        uhash_##T##_idx n_buckets;                                                                  \
+        uhash_##T##_idx n_occupied;                                                                 \
+        uhash_##T##_idx count;                                                                      \
+        uh_flag *flags;                                                                             \
+        uh_key *keys;                                                                               \
+        uh_val *vals;                                                                               \
+        UHashAllocator const *allocator;                                                            \
+        unsigned *refs;                                                                             \
+        double max_load;                                                                            \
+        uhash_##T##_idx max_occupied;                                                               \
+        bool removed;                                                                               \
+        P_UHASH_DEF_COUNTERS                                                                        \
+        /** @endcond */
+
+#define P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)                                                    \
+    } UHash_##T;                                                                                    \
                                                                                                     \
-                if (i < h->n_buckets && !p_uhf_iseither(h->flags, i)) {                             \
-                    /* Kick out the existing element. */                                            \
-                    { uh_key tmp = h->keys[i]; h->keys[i] = key; key = tmp; }                       \
-                    if (h->vals) { uh_val tmp = h->vals[i]; h->vals[i] = val; val = tmp; }          \
-                    /* Mark it as deleted in the old hash table. */                                 \
-                    p_uhf_set_isdel_true(h->flags, i);                                              \
-                } else {                                                                            \
-                    /* Write the element and jump out of the loop. */                               \
-                    h->keys[i] = key;                                                               \
-                    if (h->vals) h->vals[i] = val;                                                  \
-                    break;                                                                          \
-                }                                                                                   \
-            }                                                                                       \
-        }                                                                                           \
-                                                                                                    \
-        if (h->n_buckets > new_n_buckets) {                                                         \
-            /* Shrink the hash table. */                                                            \
-            h->keys = UHASH_REALLOC(h->keys, new_n_buckets * sizeof(uh_key));                       \
-            if (h->vals) h->vals = UHASH_REALLOC(h->vals, new_n_buckets * sizeof(uh_val));          \
-        }                                                                                           \
+    /** @cond */                                                                                    \
+    typedef uh_key uhash_##T##_key;                                                                 \
+    typedef uh_val uhash_##T##_val;                                                                 \
+    /** @endcond */
+
+/*
+ * Defines a new hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE(T, uh_key, uh_val) P_UHASH_DEF_TYPE_IDX(T, uh_key, uh_val, uhash_uint)
+
+/*
+ * Defines a new hash table type storing its bucket and element counts as the specified type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param uh_idx [type] Unsigned integer type of the stored counts, no wider than uhash_uint.
+ */
+#define P_UHASH_DEF_TYPE_IDX(T, uh_key, uh_val, uh_idx)                                             \
+    P_UHASH_DEF_TYPE_HEAD(T, uint32_t, uh_idx, uh_key, uh_val)                                      \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type that caches the hash of each key.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_CH(T, uh_key, uh_val)                                                      \
+    P_UHASH_DEF_TYPE_HEAD(T, uint32_t, uhash_uint, uh_key, uh_val)                                  \
+    uhash_uint *hashes;                                                                             \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type with incremental resizing.
+ * While resizing, the 'old_' fields hold the buckets that are yet to be migrated.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_INC(T, uh_key, uh_val)                                                     \
+    P_UHASH_DEF_TYPE_HEAD(T, uint32_t, uhash_uint, uh_key, uh_val)                                  \
+    uhash_uint old_n_buckets;                                                                       \
+    uhash_uint old_pos;                                                                             \
+    uint32_t *old_flags;                                                                            \
+    uh_key *old_keys;                                                                               \
+    uh_val *old_vals;                                                                               \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type using Robin Hood probing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_RH(T, uh_key, uh_val)                                                      \
+    P_UHASH_DEF_TYPE_HEAD(T, uint8_t, uhash_uint, uh_key, uh_val)                                   \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type using bucketized cuckoo hashing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_CUCKOO(T, uh_key, uh_val)                                                  \
+    P_UHASH_DEF_TYPE_HEAD(T, uint8_t, uhash_uint, uh_key, uh_val)                                   \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type using the SIMD control byte layout.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_SIMD(T, uh_key, uh_val)                                                    \
+    P_UHASH_DEF_TYPE_HEAD(T, uint8_t, uhash_uint, uh_key, uh_val)                                   \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type using the SIMD control byte layout,
+ * with inline storage for the buckets of small tables.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_SBO(T, uh_key, uh_val)                                                     \
+    P_UHASH_DEF_TYPE_HEAD(T, uint8_t, uhash_uint, uh_key, uh_val)                                   \
+    uint8_t sbo_flags[P_UHASH_SBO_BUCKETS];                                                         \
+    uh_key sbo_keys[P_UHASH_SBO_BUCKETS];                                                           \
+    uh_val sbo_vals[P_UHASH_SBO_BUCKETS];                                                           \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type supporting concurrent readers.
+ * The 'view' field points to the buckets published to readers.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_CONC(T, uh_key, uh_val)                                                    \
+    /** @cond */                                                                                    \
+    typedef struct UHashView_##T {                                                                  \
+        uhash_uint n_buckets;                                                                       \
+        uint8_t *flags;                                                                             \
+        uh_key *keys;                                                                               \
+        uh_val *vals;                                                                               \
+    } UHashView_##T;                                                                                \
+    /** @endcond */                                                                                 \
+    P_UHASH_DEF_TYPE_HEAD(T, uint8_t, uhash_uint, uh_key, uh_val)                                   \
+    UHashView_##T views[2];                                                                         \
+    UHashView_##T *view;                                                                            \
+    uhash_uint pending;                                                                             \
+    uint8_t pending_tag;                                                                            \
+    unsigned epoch;                                                                                 \
+    UHashConcStripe readers[UHASH_CONC_STRIPES];                                                    \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type whose values are bit-packed unsigned integers.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param bits [integer] Bits per value (1, 2 or 4).
+ */
+#define P_UHASH_DEF_TYPE_PACKED(T, uh_key, bits)                                                    \
+    P_UHASH_DEF_TYPE(T, uh_key, uint8_t)                                                            \
+    /** @cond */                                                                                    \
+    enum { P_UHASH_VAL_BITS_##T = (bits) };                                                         \
+    /** @endcond */
+
+/*
+ * Defines a new sharded hash table type, whose shards are hash tables of type T_shard.
+ *
+ * @param T [symbol] Sharded hash table name.
+ * @param n_shards [integer] Number of shards.
+ */
+#define P_UHASH_DEF_TYPE_SHARDED(T, n_shards)                                                       \
+    /** @cond */                                                                                    \
+    typedef struct UHashShard_##T {                                                                 \
+        UHash_##T##_shard *table;                                                                   \
+        unsigned lock;                                                                              \
+        unsigned char pad[P_UHASH_CACHE_LINE - sizeof(void *) - sizeof(unsigned)];                  \
+    } UHashShard_##T;                                                                               \
+    /** @endcond */                                                                                 \
                                                                                                     \
-        /* Free the working space. */                                                               \
-        UHASH_FREE(h->flags);                                                                       \
-        h->flags = new_flags;                                                                       \
-        h->n_buckets = new_n_buckets;                                                               \
-        h->n_occupied = h->count;                                                                   \
+    typedef struct UHashSharded_##T {                                                               \
+        /** @cond */                                                                                \
+        UHashShard_##T shards[n_shards];                                                            \
+        /** @endcond */                                                                             \
+    } UHashSharded_##T;
+
+/*
+ * Defines a new string interning table type, whose strings are indexed by a hash table
+ * of type T_table.
+ *
+ * @param T [symbol] Interning table name.
+ */
+#define P_UHASH_DEF_TYPE_INTERN(T)                                                                  \
+    typedef struct UHashIntern_##T {                                                                \
+        /** @cond */                                                                                \
+        UHash_##T##_table *table;                                                                   \
+        UHashArena arena;                                                                           \
+        /** @endcond */                                                                             \
+    } UHashIntern_##T;
+
+/*
+ * Defines the entry type of a new cache type, used as the value type of its table.
+ *
+ * @param T [symbol] Cache name.
+ * @param uh_val [type] Cache value type.
+ */
+#define P_UHASH_DEF_TYPE_CACHE_ENTRY(T, uh_val)                                                     \
+    /** @cond */                                                                                    \
+    typedef struct UHashCacheEntry_##T {                                                            \
+        uh_val val;                                                                                 \
+        bool used;                                                                                  \
+    } UHashCacheEntry_##T;                                                                          \
+    /** @endcond */
+
+/*
+ * Defines a new cache type, whose entries are stored in a hash table of type T_table.
+ *
+ * @param T [symbol] Cache name.
+ * @param uh_key [type] Cache key type.
+ * @param uh_val [type] Cache value type.
+ */
+#define P_UHASH_DEF_TYPE_CACHE(T, uh_key, uh_val)                                                   \
+    typedef struct UHashCache_##T {                                                                 \
+        /** @cond */                                                                                \
+        UHash_##T##_table *table;                                                                   \
+        uhash_uint capacity;                                                                        \
+        uhash_uint hand;                                                                            \
+        void (*evict)(uh_key key, uh_val val, void *data);                                          \
+        void *evict_data;                                                                           \
+        /** @endcond */                                                                             \
+    } UHashCache_##T;                                                                               \
                                                                                                     \
-        return UHASH_OK;                                                                            \
+    /** @cond */                                                                                    \
+    typedef uh_key uhcache_##T##_key;                                                               \
+    typedef uh_val uhcache_##T##_val;                                                               \
+    /** @endcond */
+
+/*
+ * Defines a new hash table type with per-instance hash and equality functions.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_PI(T, uh_key, uh_val)                                                      \
+    P_UHASH_DEF_TYPE_HEAD(T, uint32_t, uhash_uint, uh_key, uh_val)                                  \
+    uhash_uint (*hfunc)(uh_key key);                                                                \
+    bool (*efunc)(uh_key lhs, uh_key rhs);                                                          \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Defines a new hash table type with a per-instance hash seed.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DEF_TYPE_SEEDED(T, uh_key, uh_val)                                                  \
+    P_UHASH_DEF_TYPE_HEAD(T, uint32_t, uhash_uint, uh_key, uh_val)                                  \
+    uint64_t seed;                                                                                  \
+    uhash_uint reseed_count;                                                                        \
+    bool flooded;                                                                                   \
+    P_UHASH_DEF_TYPE_FOOT(T, uh_key, uh_val)
+
+/*
+ * Generates function declarations shared by all hash table variants.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the declarations.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DECL_COMMON(T, SCOPE, uh_key, uh_val)                                               \
+    /** @cond */                                                                                    \
+    SCOPE void uhash_free_##T(UHash_##T *h);                                                        \
+    SCOPE uhash_ret uhash_copy_##T(UHash_##T const *src, UHash_##T *dest);                          \
+    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest);                   \
+    SCOPE uhash_ret uhash_copy_into_##T(UHash_##T const *src, UHash_##T *dest);                     \
+    SCOPE UHash_##T *uhash_clone_##T(UHash_##T *src);                                               \
+    SCOPE uhash_ret uhash_unshare_##T(UHash_##T *h);                                                \
+    SCOPE void uhash_clear_##T(UHash_##T *h);                                                       \
+    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key);                                 \
+    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets);                       \
+    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx);                       \
+    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x);                                        \
+    SCOPE uhash_uint uhash_get_with_hash_##T(UHash_##T const *h, uh_key key, uhash_uint hash);      \
+    SCOPE uhash_ret uhash_put_with_hash_##T(UHash_##T *h, uh_key key, uhash_uint hash,              \
+                                            uhash_uint *idx);                                       \
+    SCOPE uh_val uhmap_get_with_hash_##T(UHash_##T const *h, uh_key key, uhash_uint hash,           \
+                                         uh_val if_missing);                                        \
+    SCOPE UHash_##T* uhmap_alloc_##T(void);                                                         \
+    SCOPE UHash_##T* uhmap_alloc_with_##T(UHashAllocator const *allocator);                         \
+    SCOPE uh_val uhmap_get_##T(UHash_##T const *h, uh_key key, uh_val if_missing);                  \
+    SCOPE uhash_ret uhmap_set_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *existing);        \
+    SCOPE uhash_ret uhmap_add_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *existing);        \
+    SCOPE bool uhmap_replace_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *replaced);         \
+    SCOPE bool uhmap_remove_##T(UHash_##T *h, uh_key key, uh_key *r_key, uh_val *r_val);            \
+    SCOPE UHash_##T* uhset_alloc_##T(void);                                                         \
+    SCOPE UHash_##T* uhset_alloc_with_##T(UHashAllocator const *allocator);                         \
+    SCOPE uhash_ret uhset_insert_##T(UHash_##T *h, uh_key key, uh_key *existing);                   \
+    SCOPE uhash_ret uhset_insert_all_##T(UHash_##T *h, uh_key const *items, uhash_uint n);          \
+    SCOPE uhash_ret uhset_insert_batch_##T(UHash_##T *h, uh_key const *items, uhash_uint n);        \
+    SCOPE void uhash_get_batch_##T(UHash_##T const *h, uh_key const *keys, uhash_uint n,            \
+                                   uhash_uint *idx);                                                \
+    SCOPE void uhmap_get_batch_##T(UHash_##T const *h, uh_key const *keys, uhash_uint n,            \
+                                   uh_val *vals, uh_val if_missing);                                \
+    SCOPE uhash_ret uhash_reserve_##T(UHash_##T *h, uhash_uint count);                              \
+    SCOPE uhash_ret uhash_set_max_load_##T(UHash_##T *h, double max_load);                          \
+    SCOPE UHash_##T* uhmap_alloc_load_##T(double max_load);                                         \
+    SCOPE UHash_##T* uhset_alloc_load_##T(double max_load);                                         \
+    SCOPE uhash_ret uhash_compact_##T(UHash_##T *h);                                                \
+    SCOPE bool uhset_replace_##T(UHash_##T *h, uh_key key, uh_key *replaced);                       \
+    SCOPE bool uhset_remove_##T(UHash_##T *h, uh_key key, uh_key *removed);                         \
+    SCOPE bool uhset_is_superset_##T(UHash_##T const *h1, UHash_##T const *h2);                     \
+    SCOPE uhash_ret uhset_union_##T(UHash_##T *h1, UHash_##T const *h2);                            \
+    SCOPE void uhset_intersect_##T(UHash_##T *h1, UHash_##T const *h2);                             \
+    SCOPE UHash_##T *uhset_union_many_##T(UHash_##T const *const *sets, uhash_uint n);              \
+    SCOPE UHash_##T *uhset_intersect_many_##T(UHash_##T const *const *sets, uhash_uint n);          \
+    SCOPE uhash_uint uhset_hash_##T(UHash_##T const *h);                                            \
+    SCOPE uh_key uhset_get_any_##T(UHash_##T const *h, uh_key if_empty);                            \
+    SCOPE uhash_ret uhset_insert_all_par_##T(UHash_##T *h, uh_key const *items, uhash_uint n,       \
+                                             UHashExecutor const *ex);                              \
+    SCOPE bool uhset_is_superset_par_##T(UHash_##T const *h1, UHash_##T const *h2,                  \
+                                         UHashExecutor const *ex);                                  \
+    SCOPE uhash_ret uhset_union_par_##T(UHash_##T *h1, UHash_##T const *h2,                         \
+                                        UHashExecutor const *ex);                                   \
+    SCOPE void uhset_intersect_par_##T(UHash_##T *h1, UHash_##T const *h2,                          \
+                                       UHashExecutor const *ex);                                    \
+    SCOPE size_t uhash_image_size_##T(UHash_##T const *h);                                          \
+    SCOPE uhash_ret uhash_image_write_##T(UHash_##T const *h, uint32_t hash_id, void *buf,          \
+                                          size_t size);                                             \
+    SCOPE uhash_ret uhash_image_load_##T(UHash_##T *h, uint32_t hash_id, void const *image,         \
+                                         size_t size);                                              \
+    SCOPE uhash_ret uhash_stream_write_##T(UHash_##T const *h, UHash_##T const *prev,               \
+                                           UHashStream *s);                                         \
+    SCOPE uhash_ret uhash_stream_apply_##T(UHash_##T *h, void const *data, size_t size,             \
+                                           size_t *consumed);                                       \
+    SCOPE void uhash_stats_##T(UHash_##T const *h, UHashStats *stats);                              \
+    /** @endcond */
+
+/*
+ * Generates function declarations for the specified hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the declarations.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DECL(T, SCOPE, uh_key, uh_val)                                                      \
+    P_UHASH_DECL_COMMON(T, SCOPE, uh_key, uh_val)                                                   \
+    /** @cond */                                                                                    \
+    p_uhash_static_inline void p_uhash_iter_prepare_##T(UHash_##T const *h) { (void)h; }            \
+    p_uhash_static_inline void p_uhash_publish_##T(UHash_##T *h, uhash_uint i) {                    \
+        (void)h; (void)i;                                                                           \
     }                                                                                               \
-                                                                                                    \
-    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx) {                      \
-        p_uhash_analyzer_assert(h->flags);                                                          \
-                                                                                                    \
-        uhash_uint x;                                                                               \
-                                                                                                    \
-        if (h->n_occupied >= p_uhash_upper_bound(h->n_buckets)) {                                   \
-            /* Update the hash table. */                                                            \
-            if (h->n_buckets > (h->count << 1U)) {                                                  \
-                if (uhash_resize_##T(h, h->n_buckets - 1)) {                                        \
-                    /* Clear "deleted" elements. */                                                 \
-                    if (idx) *idx = UHASH_INDEX_MISSING;                                            \
-                    return UHASH_ERR;                                                               \
-                }                                                                                   \
-            } else if (uhash_resize_##T(h, h->n_buckets + 1)) {                                     \
-                /* Expand the hash table. */                                                        \
-                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
-                return UHASH_ERR;                                                                   \
-            }                                                                                       \
-        }                                                                                           \
-        /* TODO: implement automatic shrinking; resize() already supports shrinking. */             \
-        {                                                                                           \
-            uhash_uint const mask = h->n_buckets - 1;                                               \
-            uhash_uint i = (uhash_uint)(hash_func(key)) & mask;                                     \
-            uhash_uint step = 0;                                                                    \
-            uhash_uint site = h->n_buckets;                                                         \
-            x = site;                                                                               \
-                                                                                                    \
-            if (p_uhf_isempty(h->flags, i)) {                                                       \
-                /* Speed up. */                                                                     \
-                x = i;                                                                              \
-            } else {                                                                                \
-                uhash_uint const last = i;                                                          \
-                                                                                                    \
-                while (!p_uhf_isempty(h->flags, i) &&                                               \
-                       (p_uhf_isdel(h->flags, i) || !equal_func(h->keys[i], key))) {                \
-                    if (p_uhf_isdel(h->flags, i)) site = i;                                         \
-                    i = (i + (++step)) & mask;                                                      \
-                                                                                                    \
-                    if (i == last) {                                                                \
-                        x = site;                                                                   \
-                        break;                                                                      \
-                    }                                                                               \
-                }                                                                                   \
-                                                                                                    \
-                if (x == h->n_buckets) {                                                            \
-                    x = (p_uhf_isempty(h->flags, i) && site != h->n_buckets) ? site : i;            \
-                }                                                                                   \
-            }                                                                                       \
-        }                                                                                           \
-                                                                                                    \
-        uhash_ret ret;                                                                              \
-                                                                                                    \
-        if (p_uhf_isempty(h->flags, x)) {                                                           \
-            /* Not present at all. */                                                               \
-            h->keys[x] = key;                                                                       \
-            p_uhf_set_isboth_false(h->flags, x);                                                    \
-            h->count++;                                                                             \
-            h->n_occupied++;                                                                        \
-            ret = UHASH_INSERTED;                                                                   \
-        } else if (p_uhf_isdel(h->flags, x)) {                                                      \
-            /* Deleted. */                                                                          \
-            h->keys[x] = key;                                                                       \
-            p_uhf_set_isboth_false(h->flags, x);                                                    \
-            h->count++;                                                                             \
-            ret = UHASH_INSERTED;                                                                   \
-        } else {                                                                                    \
-            /* Don't touch h->keys[x] if present and not deleted. */                                \
-            ret = UHASH_PRESENT;                                                                    \
-        }                                                                                           \
-                                                                                                    \
-        if (idx) *idx = (x == h->n_buckets ? UHASH_INDEX_MISSING : x);                              \
-        return ret;                                                                                 \
+    p_uhash_static_inline void p_uhash_watch_probes_##T(UHash_##T *h, uhash_uint probes) {          \
+        (void)h; (void)probes;                                                                      \
     }                                                                                               \
+    p_uhash_static_inline void p_uhash_guard_##T(UHash_##T *h) { (void)h; }                         \
+    p_uhash_static_inline void p_uhash_copy_seed_##T(UHash_##T *h, UHash_##T const *src) {          \
+        (void)h; (void)src;                                                                         \
+    }                                                                                               \
+    p_uhash_static_inline UHash_##T const *p_uhash_unseeded_##T(UHash_##T const *h,                 \
+                                                               UHash_##T *tmp) {                    \
+        (void)tmp;                                                                                  \
+        return h;                                                                                   \
+    }                                                                                               \
+    /** @endcond */
+
+/*
+ * Generates function declarations for the specified hash table type with a per-instance seed.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the declarations.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DECL_SEEDED(T, SCOPE, uh_key, uh_val)                                               \
+    P_UHASH_DECL_COMMON(T, SCOPE, uh_key, uh_val)                                                   \
+    /** @cond */                                                                                    \
+    SCOPE uhash_ret uhash_reseed_##T(UHash_##T *h);                                                 \
+    p_uhash_static_inline void p_uhash_iter_prepare_##T(UHash_##T const *h) { (void)h; }            \
+    p_uhash_static_inline void p_uhash_publish_##T(UHash_##T *h, uhash_uint i) {                    \
+        (void)h; (void)i;                                                                           \
+    }                                                                                               \
+    /* Long probe sequences flag the table, so that the next uhash_put reseeds it. */               \
+    p_uhash_static_inline void p_uhash_watch_probes_##T(UHash_##T *h, uhash_uint probes) {          \
+        if (probes > UHASH_FLOOD_PROBES && h->count >= h->reseed_count) h->flooded = true;          \
+    }                                                                                               \
+    p_uhash_static_inline void p_uhash_guard_##T(UHash_##T *h) {                                    \
+        /* On failure, the table keeps working with its previous seed. */                           \
+        if (h->flooded) (void)uhash_reseed_##T(h);                                                  \
+    }                                                                                               \
+    p_uhash_static_inline void p_uhash_copy_seed_##T(UHash_##T *h, UHash_##T const *src) {          \
+        h->seed = src->seed;                                                                        \
+    }                                                                                               \
+    /* Returns a shallow copy of the table using the zero seed, for hashing its keys as a set. */   \
+    p_uhash_static_inline UHash_##T const *p_uhash_unseeded_##T(UHash_##T const *h,                 \
+                                                               UHash_##T *tmp) {                    \
+        *tmp = *h;                                                                                  \
+        tmp->seed = 0;                                                                              \
+        return tmp;                                                                                 \
+    }                                                                                               \
+    /** @endcond */
+
+/*
+ * Generates function declarations for the specified hash table type with incremental resizing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the declarations.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DECL_INC(T, SCOPE, uh_key, uh_val)                                                  \
+    P_UHASH_DECL_COMMON(T, SCOPE, uh_key, uh_val)                                                   \
+    /** @cond */                                                                                    \
+    SCOPE void uhash_rehash_finish_##T(UHash_##T *h);                                               \
+    p_uhash_static_inline void p_uhash_iter_prepare_##T(UHash_##T const *h) {                       \
+        /* Iteration is O(n) anyway: complete pending migrations so that it only visits 'keys'. */  \
+        if (h && h->old_flags) uhash_rehash_finish_##T((UHash_##T *)h);                             \
+    }                                                                                               \
+    p_uhash_static_inline void p_uhash_publish_##T(UHash_##T *h, uhash_uint i) {                    \
+        (void)h; (void)i;                                                                           \
+    }                                                                                               \
+    p_uhash_static_inline UHash_##T const *p_uhash_unseeded_##T(UHash_##T const *h,                 \
+                                                               UHash_##T *tmp) {                    \
+        (void)tmp;                                                                                  \
+        return h;                                                                                   \
+    }                                                                                               \
+    /** @endcond */
+
+/*
+ * Generates function declarations for the specified hash table type with concurrent readers.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the declarations.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DECL_CONC(T, SCOPE, uh_key, uh_val)                                                 \
+    P_UHASH_DECL_COMMON(T, SCOPE, uh_key, uh_val)                                                   \
+    /** @cond */                                                                                    \
+    SCOPE bool uhash_conc_contains_##T(UHash_##T const *h, uh_key key);                             \
+    SCOPE uh_val uhmap_conc_get_##T(UHash_##T const *h, uh_key key, uh_val if_missing);             \
+    SCOPE void uhash_conc_publish_##T(UHash_##T *h, uhash_uint i);                                  \
+    p_uhash_static_inline void p_uhash_iter_prepare_##T(UHash_##T const *h) { (void)h; }            \
+    p_uhash_static_inline UHash_##T const *p_uhash_unseeded_##T(UHash_##T const *h,                 \
+                                                               UHash_##T *tmp) {                    \
+        (void)tmp;                                                                                  \
+        return h;                                                                                   \
+    }                                                                                               \
+    /** @endcond */
+
+/*
+ * Generates function declarations for the specified hash table type
+ * with per-instance hash and equality functions.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the declarations.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DECL_PI(T, SCOPE, uh_key, uh_val)                                                   \
+    P_UHASH_DECL(T, SCOPE, uh_key, uh_val)                                                          \
+    /** @cond */                                                                                    \
+    SCOPE UHash_##T* uhmap_alloc_pi_##T(uhash_uint (*hash_func)(uh_key key),                        \
+                                        bool (*equal_func)(uh_key lhs, uh_key rhs));                \
+    SCOPE UHash_##T* uhset_alloc_pi_##T(uhash_uint (*hash_func)(uh_key key),                        \
+                                        bool (*equal_func)(uh_key lhs, uh_key rhs));                \
+    SCOPE UHash_##T* uhmap_alloc_pi_with_##T(uhash_uint (*hash_func)(uh_key key),                   \
+                                             bool (*equal_func)(uh_key lhs, uh_key rhs),            \
+                                             UHashAllocator const *allocator);                      \
+    SCOPE UHash_##T* uhset_alloc_pi_with_##T(uhash_uint (*hash_func)(uh_key key),                   \
+                                             bool (*equal_func)(uh_key lhs, uh_key rhs),            \
+                                             UHashAllocator const *allocator);                      \
+    /** @endcond */
+
+/*
+ * Prepends the hash table in scope to the arguments of a call, so that functions taking it
+ * can be passed as hash or equality functions (e.g. "p_uhash_seeded_hash_##T P_UHASH_H_ARGS").
+ */
+#define P_UHASH_H_ARGS(...) (h, __VA_ARGS__)
+
+/*
+ * Generates function declarations for the specified string interning table type.
+ *
+ * @param T [symbol] Interning table name.
+ * @param SCOPE [scope] Scope of the declarations.
+ */
+#define P_UHASH_DECL_INTERN(T, SCOPE)                                                               \
+    /** @cond */                                                                                    \
+    SCOPE UHashIntern_##T *uhash_intern_alloc_with_##T(UHashAllocator const *allocator);            \
+    SCOPE UHashIntern_##T *uhash_intern_alloc_##T(void);                                            \
+    SCOPE void uhash_intern_free_##T(UHashIntern_##T *h);                                           \
+    SCOPE void uhash_intern_clear_##T(UHashIntern_##T *h);                                          \
+    SCOPE char const *uhash_intern_##T(UHashIntern_##T *h, char const *str, size_t length);         \
+    SCOPE char const *uhash_intern_get_##T(UHashIntern_##T const *h, char const *str,               \
+                                           size_t length);                                          \
+    /** @endcond */
+
+/*
+ * Generates function declarations for the specified cache type.
+ *
+ * @param T [symbol] Cache name.
+ * @param SCOPE [scope] Scope of the declarations.
+ * @param uh_key [type] Cache key type.
+ * @param uh_val [type] Cache value type.
+ */
+#define P_UHASH_DECL_CACHE(T, SCOPE, uh_key, uh_val)                                                \
+    /** @cond */                                                                                    \
+    SCOPE UHashCache_##T *uhcache_alloc_with_##T(uhash_uint capacity,                               \
+                                                 UHashAllocator const *allocator);                  \
+    SCOPE UHashCache_##T *uhcache_alloc_##T(uhash_uint capacity);                                   \
+    SCOPE void uhcache_free_##T(UHashCache_##T *h);                                                 \
+    SCOPE void uhcache_clear_##T(UHashCache_##T *h);                                                \
+    SCOPE void uhcache_set_evict_##T(UHashCache_##T *h,                                             \
+                                     void (*func)(uh_key key, uh_val val, void *data),              \
+                                     void *data);                                                   \
+    SCOPE uh_val uhcache_get_##T(UHashCache_##T *h, uh_key key, uh_val if_missing);                 \
+    SCOPE bool uhcache_contains_##T(UHashCache_##T const *h, uh_key key);                           \
+    SCOPE uhash_ret uhcache_put_##T(UHashCache_##T *h, uh_key key, uh_val val);                     \
+    SCOPE bool uhcache_remove_##T(UHashCache_##T *h, uh_key key, uh_val *r_val);                    \
+    /** @endcond */
+
+/*
+ * Generates function declarations for the specified sharded hash table type.
+ *
+ * @param T [symbol] Sharded hash table name.
+ * @param SCOPE [scope] Scope of the declarations.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_DECL_SHARDED(T, SCOPE, uh_key, uh_val)                                              \
+    /** @cond */                                                                                    \
+    SCOPE UHashSharded_##T *uhmap_sharded_alloc_##T(void);                                          \
+    SCOPE UHashSharded_##T *uhset_sharded_alloc_##T(void);                                          \
+    SCOPE void uhash_sharded_free_##T(UHashSharded_##T *h);                                         \
+    SCOPE uhash_uint uhash_sharded_count_##T(UHashSharded_##T *h);                                  \
+    SCOPE uhash_uint uhash_sharded_lock_##T(UHashSharded_##T *h, uh_key key);                       \
+    SCOPE void uhash_sharded_unlock_##T(UHashSharded_##T *h, uhash_uint i);                         \
+    SCOPE bool uhash_sharded_contains_##T(UHashSharded_##T *h, uh_key key);                         \
+    SCOPE uh_val uhmap_sharded_get_##T(UHashSharded_##T *h, uh_key key, uh_val if_missing);         \
+    SCOPE uhash_ret uhmap_sharded_set_##T(UHashSharded_##T *h, uh_key key, uh_val value,            \
+                                          uh_val *existing);                                        \
+    SCOPE uhash_ret uhmap_sharded_add_##T(UHashSharded_##T *h, uh_key key, uh_val value,            \
+                                          uh_val *existing);                                        \
+    SCOPE bool uhmap_sharded_remove_##T(UHashSharded_##T *h, uh_key key, uh_val *r_val);            \
+    SCOPE uhash_ret uhset_sharded_insert_##T(UHashSharded_##T *h, uh_key key);                      \
+    SCOPE bool uhset_sharded_remove_##T(UHashSharded_##T *h, uh_key key);                           \
+    SCOPE uhash_ret uhash_sharded_merge_##T(UHashSharded_##T *dest, UHashSharded_##T *src);         \
+    /** @endcond */
+
+/*
+ * Generates allocation function definitions for the specified hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ */
+#define P_UHASH_IMPL_ALLOC(T, SCOPE)                                                                \
                                                                                                     \
-    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x) {                                       \
-        if (!p_uhf_iseither(h->flags, x)) {                                                         \
-            p_uhf_set_isdel_true(h->flags, x);                                                      \
-            h->count--;                                                                             \
-        }                                                                                           \
+    SCOPE UHash_##T *uhset_alloc_with_##T(UHashAllocator const *allocator) {                        \
+        UHash_##T *set = p_uhash_malloc(allocator, sizeof(UHash_##T));                              \
+        if (set) *set = (UHash_##T) { .allocator = allocator };                                     \
+        return set;                                                                                 \
     }                                                                                               \
                                                                                                     \
-    SCOPE UHash_##T* uhmap_alloc_##T(void) {                                                        \
-        UHash_##T *map = uhset_alloc_##T();                                                         \
+    SCOPE UHash_##T *uhset_alloc_##T(void) {                                                        \
+        return uhset_alloc_with_##T(NULL);                                                          \
+    }
+
+/*
+ * Generates allocation function definitions for the specified hash table type
+ * with per-instance hash and equality functions.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param default_hfunc [(uh_key) -> uhash_uint] Default hash function (can be NULL).
+ * @param default_efunc [(uh_key, uh_key) -> bool] Default equality function (can be NULL).
+ */
+#define P_UHASH_IMPL_ALLOC_PI(T, SCOPE, uh_key, default_hfunc, default_efunc)                       \
                                                                                                     \
-        if (uhash_resize_##T(map, 1)) {                                                             \
-            uhash_free_##T(map);                                                                    \
-            return NULL;                                                                            \
-        }                                                                                           \
+    /* Calls the default functions directly if the table uses them, so that they are inlined. */    \
+    p_uhash_static_inline uhash_uint p_uhash_pi_hash_##T(UHash_##T const *h, uh_key key) {          \
+        uhash_uint (*const hfunc)(uh_key key) = default_hfunc;                                      \
+        return hfunc && h->hfunc == hfunc ? hfunc(key) : h->hfunc(key);                             \
+    }                                                                                               \
                                                                                                     \
-        map->vals = UHASH_MALLOC(map->n_buckets * sizeof(uh_val));                                  \
+    p_uhash_static_inline bool p_uhash_pi_equal_##T(UHash_##T const *h, uh_key lhs, uh_key rhs) {   \
+        bool (*const efunc)(uh_key lhs, uh_key rhs) = default_efunc;                                \
+        return efunc && h->efunc == efunc ? efunc(lhs, rhs) : h->efunc(lhs, rhs);                   \
+    }                                                                                               \
                                                                                                     \
-        if (!map->vals) {                                                                           \
-            uhash_free_##T(map);                                                                    \
-            return NULL;                                                                            \
+    SCOPE UHash_##T *uhset_alloc_with_##T(UHashAllocator const *allocator) {                        \
+        UHash_##T *set = p_uhash_malloc(allocator, sizeof(UHash_##T));                              \
+        if (set) *set = (UHash_##T) {                                                               \
+            .allocator = allocator,                                                                 \
+            .hfunc = default_hfunc,                                                                 \
+            .efunc = default_efunc                                                                  \
+        };                                                                                          \
+        return set;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T *uhset_alloc_##T(void) {                                                        \
+        return uhset_alloc_with_##T(NULL);                                                          \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T* uhmap_alloc_pi_with_##T(uhash_uint (*hash_func)(uh_key key),                   \
+                                             bool (*equal_func)(uh_key lhs, uh_key rhs),            \
+                                             UHashAllocator const *allocator) {                     \
+        UHash_##T *h = uhmap_alloc_with_##T(allocator);                                             \
+        if (h) {                                                                                    \
+            h->hfunc = hash_func;                                                                   \
+            h->efunc = equal_func;                                                                  \
         }                                                                                           \
+        return h;                                                                                   \
+    }                                                                                               \
                                                                                                     \
-        return map;                                                                                 \
+    SCOPE UHash_##T* uhset_alloc_pi_with_##T(uhash_uint (*hash_func)(uh_key key),                   \
+                                             bool (*equal_func)(uh_key lhs, uh_key rhs),            \
+                                             UHashAllocator const *allocator) {                     \
+        UHash_##T *h = uhset_alloc_with_##T(allocator);                                             \
+        if (h) {                                                                                    \
+            h->hfunc = hash_func;                                                                   \
+            h->efunc = equal_func;                                                                  \
+        }                                                                                           \
+        return h;                                                                                   \
     }                                                                                               \
                                                                                                     \
-    SCOPE uh_val uhmap_get_##T(UHash_##T const *h, uh_key key, uh_val if_missing) {                 \
-        p_uhash_analyzer_assert(h->vals);                                                           \
-        uhash_uint k = uhash_get_##T(h, key);                                                       \
-        return k == UHASH_INDEX_MISSING ? if_missing : h->vals[k];                                  \
+    SCOPE UHash_##T* uhmap_alloc_pi_##T(uhash_uint (*hash_func)(uh_key key),                        \
+                                        bool (*equal_func)(uh_key lhs, uh_key rhs)) {               \
+        return uhmap_alloc_pi_with_##T(hash_func, equal_func, NULL);                                \
     }                                                                                               \
                                                                                                     \
-    SCOPE uhash_ret uhmap_set_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *existing) {       \
-        p_uhash_analyzer_assert(h->vals);                                                           \
+    SCOPE UHash_##T* uhset_alloc_pi_##T(uhash_uint (*hash_func)(uh_key key),                        \
+                                        bool (*equal_func)(uh_key lhs, uh_key rhs)) {               \
+        return uhset_alloc_pi_with_##T(hash_func, equal_func, NULL);                                \
+    }
+
+/*
+ * Generates allocation, hashing and reseeding function definitions for the specified
+ * hash table type with a per-instance hash seed.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param hash_func [(uh_key, uint64_t) -> uhash_uint] Seeded hash function or expression.
+ */
+#define P_UHASH_IMPL_ALLOC_SEEDED(T, SCOPE, uh_key, hash_func)                                      \
                                                                                                     \
-        uhash_uint k;                                                                               \
-        uhash_ret ret = uhash_put_##T(h, key, &k);                                                  \
+    p_uhash_static_inline uhash_uint p_uhash_seeded_hash_##T(UHash_##T const *h, uh_key key) {      \
+        return (uhash_uint)(hash_func(key, h->seed));                                               \
+    }                                                                                               \
                                                                                                     \
-        if (ret != UHASH_ERR) {                                                                     \
-            if (ret == UHASH_PRESENT && existing) *existing = h->vals[k];                           \
-            h->vals[k] = value;                                                                     \
-        }                                                                                           \
+    SCOPE UHash_##T *uhset_alloc_with_##T(UHashAllocator const *allocator) {                        \
+        UHash_##T *set = p_uhash_malloc(allocator, sizeof(UHash_##T));                              \
+        if (set) *set = (UHash_##T) { .allocator = allocator, .seed = p_uhash_seed(set, 0) };       \
+        return set;                                                                                 \
+    }                                                                                               \
                                                                                                     \
-        return ret;                                                                                 \
+    SCOPE UHash_##T *uhset_alloc_##T(void) {                                                        \
+        return uhset_alloc_with_##T(NULL);                                                          \
     }                                                                                               \
                                                                                                     \
-    SCOPE uhash_ret uhmap_add_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *existing) {       \
-        p_uhash_analyzer_assert(h->vals);                                                           \
+    SCOPE uhash_ret uhash_reseed_##T(UHash_##T *h) {                                                \
+        uint64_t const seed = h->seed;                                                              \
+        uhash_uint n_buckets = h->n_buckets;                                                        \
+        h->seed = p_uhash_seed(h, seed);                                                            \
+        h->flooded = false;                                                                         \
+        if (!n_buckets) return UHASH_OK;                                                            \
                                                                                                     \
-        uhash_uint k;                                                                               \
-        uhash_ret ret = uhash_put_##T(h, key, &k);                                                  \
+        /* Rehashing in place needs room for all the keys. */                                       \
+        if (h->count >= p_uhash_upper_bound(h, n_buckets)) n_buckets = p_uhf_grow(n_buckets);       \
                                                                                                     \
-        if (ret == UHASH_INSERTED) {                                                                \
-            h->vals[k] = value;                                                                     \
-        } else if (ret == UHASH_PRESENT && existing) {                                              \
-            *existing = h->vals[k];                                                                 \
+        if (h->count < p_uhash_upper_bound(h, n_buckets) && !uhash_resize_##T(h, n_buckets)) {      \
+            /* Flooding is only acted upon again once the table has doubled. */                     \
+            h->reseed_count = h->count > UHASH_UINT_MAX / 2 ? UHASH_UINT_MAX :                      \
+                              (uhash_uint)(h->count << 1U);                                         \
+            return UHASH_OK;                                                                        \
         }                                                                                           \
                                                                                                     \
-        return ret;                                                                                 \
-    }                                                                                               \
+        h->seed = seed;                                                                             \
+        return UHASH_ERR;                                                                           \
+    }
+
+/*
+ * Generates bucket storage function definitions for the specified hash table type,
+ * keeping metadata, keys and values in separate allocations.
+ * Bucket allocation functions are only used by layouts having one metadata byte per bucket.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param NAME [symbol] Infix of the generated function names.
+ */
+#define P_UHASH_IMPL_STORAGE_SPLIT(T, SCOPE, uh_key, uh_val, NAME)                                  \
                                                                                                     \
-    SCOPE bool uhmap_replace_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *replaced) {        \
-        p_uhash_analyzer_assert(h->vals);                                                           \
-        uhash_uint k = uhash_get_##T(h, key);                                                       \
-        if (k == UHASH_INDEX_MISSING) return false;                                                 \
-        if (replaced) *replaced = h->vals[k];                                                       \
-        h->vals[k] = value;                                                                         \
-        return true;                                                                                \
+    p_uhash_static_inline void p_uhash_##NAME##_free_##T(UHash_##T const *h, uhash_uint n,          \
+                                                        uint8_t *flags, uh_key *keys,               \
+                                                        uh_val *vals) {                             \
+        p_uhash_free(h->allocator, flags, n);                                                       \
+        p_uhash_free(h->allocator, keys, n * sizeof(uh_key));                                       \
+        p_uhash_free(h->allocator, vals, n * sizeof(uh_val));                                       \
     }                                                                                               \
                                                                                                     \
-    SCOPE bool uhmap_remove_##T(UHash_##T *h, uh_key key, uh_key *r_key, uh_val *r_val) {           \
-        uhash_uint k = uhash_get_##T(h, key);                                                       \
-        if (k == UHASH_INDEX_MISSING) return false;                                                 \
-        if (r_key) *r_key = h->keys[k];                                                             \
-        if (r_val) *r_val = h->vals[k];                                                             \
-        uhash_delete_##T(h, k);                                                                     \
-        return true;                                                                                \
+    p_uhash_static_inline uhash_ret p_uhash_##NAME##_alloc_##T(UHash_##T *h, uhash_uint n,          \
+                                                              bool with_vals, uint8_t **flags,      \
+                                                              uh_key **keys, uh_val **vals) {       \
+        *flags = p_uhash_malloc(h->allocator, n);                                                   \
+        *keys = p_uhash_malloc(h->allocator, n * sizeof(uh_key));                                   \
+        *vals = with_vals ? p_uhash_malloc(h->allocator, n * sizeof(uh_val)) : NULL;                \
+        if (*flags && *keys && (*vals || !with_vals)) return UHASH_OK;                              \
+        p_uhash_##NAME##_free_##T(h, n, *flags, *keys, *vals);                                      \
+        return UHASH_ERR;                                                                           \
     }                                                                                               \
                                                                                                     \
-    SCOPE uhash_ret uhset_insert_##T(UHash_##T *h, uh_key key, uh_key *existing) {                  \
-        uhash_uint k;                                                                               \
-        uhash_ret ret = uhash_put_##T(h, key, &k);                                                  \
-        if (ret == UHASH_PRESENT && existing) *existing = h->keys[k];                               \
-        return ret;                                                                                 \
+    p_uhash_static_inline uhash_ret p_uhash_##NAME##_fit_vals_##T(UHash_##T *h) {                   \
+        /* Existing values are always sized to the buckets. */                                      \
+        if (h->vals) return UHASH_OK;                                                               \
+        h->vals = p_uhash_malloc(h->allocator, h->n_buckets * sizeof(uh_val));                      \
+        return h->vals ? UHASH_OK : UHASH_ERR;                                                      \
     }                                                                                               \
                                                                                                     \
-    SCOPE uhash_ret uhset_insert_all_##T(UHash_##T *h, uh_key const *items, uhash_uint n) {         \
-        if (uhash_resize_##T(h, n)) return UHASH_ERR;                                               \
-        uhash_ret ret = UHASH_PRESENT;                                                              \
-                                                                                                    \
-        for (uhash_uint i = 0; i < n; ++i) {                                                        \
-            uhash_ret l_ret = uhset_insert_##T(h, items[i], NULL);                                  \
-            if (l_ret == UHASH_ERR) return UHASH_ERR;                                               \
-            if (l_ret == UHASH_INSERTED) ret = UHASH_INSERTED;                                      \
-        }                                                                                           \
+    p_uhash_static_inline bool p_uhash_##NAME##_inline_##T(UHash_##T const *h) {                    \
+        (void)h;                                                                                    \
+        return false;                                                                               \
+    }
+
+/*
+ * Generates bucket storage function definitions for the specified hash table type,
+ * keeping metadata, keys and values in a single allocation.
+ * Only supported by layouts having one metadata byte per bucket.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param NAME [symbol] Infix of the generated function names.
+ */
+#define P_UHASH_IMPL_STORAGE_BLOCK(T, SCOPE, uh_key, uh_val, NAME)                                  \
                                                                                                     \
-        return ret;                                                                                 \
+    p_uhash_static_inline size_t p_uhash_##NAME##_vals_offset_##T(uhash_uint n) {                   \
+        /* Alignment divides the size of a type, so this keeps values aligned. */                   \
+        return (n * sizeof(uh_key) + sizeof(uh_val) - 1) / sizeof(uh_val) * sizeof(uh_val);         \
     }                                                                                               \
                                                                                                     \
-    SCOPE bool uhset_replace_##T(UHash_##T *h, uh_key key, uh_key *replaced) {                      \
-        uhash_uint k = uhash_get_##T(h, key);                                                       \
-        if (k == UHASH_INDEX_MISSING) return false;                                                 \
-        if (replaced) *replaced = h->keys[k];                                                       \
-        h->keys[k] = key;                                                                           \
-        return true;                                                                                \
+    p_uhash_static_inline size_t p_uhash_##NAME##_size_##T(uhash_uint n, bool with_vals) {          \
+        return n + (with_vals ? p_uhash_##NAME##_vals_offset_##T(n) + n * sizeof(uh_val)            \
+                              : n * sizeof(uh_key));                                                \
     }                                                                                               \
                                                                                                     \
-    SCOPE bool uhset_remove_##T(UHash_##T *h, uh_key key, uh_key *removed) {                        \
-        uhash_uint k = uhash_get_##T(h, key);                                                       \
-        if (k == UHASH_INDEX_MISSING) return false;                                                 \
-        if (removed) *removed = h->keys[k];                                                         \
-        uhash_delete_##T(h, k);                                                                     \
-        return true;                                                                                \
+    p_uhash_static_inline void p_uhash_##NAME##_free_##T(UHash_##T const *h, uhash_uint n,          \
+                                                        uint8_t *flags, uh_key *keys,               \
+                                                        uh_val *vals) {                             \
+        (void)flags;                                                                                \
+        /* Keys are at the start of the block. */                                                   \
+        p_uhash_free(h->allocator, keys, p_uhash_##NAME##_size_##T(n, vals != NULL));               \
     }                                                                                               \
                                                                                                     \
-    SCOPE bool uhset_is_superset_##T(UHash_##T const *h1, UHash_##T const *h2) {                    \
-        for (uhash_uint i = 0; i != h2->n_buckets; ++i) {                                           \
-            if (uhash_exists(h2, i) && uhash_get_##T(h1, h2->keys[i]) == UHASH_INDEX_MISSING) {     \
-                return false;                                                                       \
-            }                                                                                       \
-        }                                                                                           \
-        return true;                                                                                \
+    p_uhash_static_inline uhash_ret p_uhash_##NAME##_alloc_##T(UHash_##T *h, uhash_uint n,          \
+                                                              bool with_vals, uint8_t **flags,      \
+                                                              uh_key **keys, uh_val **vals) {       \
+        /* Layout: keys, values (if any), metadata. */                                              \
+        size_t const size = p_uhash_##NAME##_size_##T(n, with_vals);                                \
+        unsigned char *block = p_uhash_malloc(h->allocator, size);                                  \
+        if (!block) return UHASH_ERR;                                                               \
+        *keys = (uh_key *)(void *)block;                                                            \
+        *vals = with_vals ? (uh_val *)(void *)(block + p_uhash_##NAME##_vals_offset_##T(n)) : NULL; \
+        *flags = (uint8_t *)(block + size - n);                                                     \
+        return UHASH_OK;                                                                            \
     }                                                                                               \
                                                                                                     \
-    SCOPE uhash_ret uhset_union_##T(UHash_##T *h1, UHash_##T const *h2) {                           \
-        for (uhash_uint i = 0; i != h2->n_buckets; ++i) {                                           \
-            if (uhash_exists(h2, i) && uhset_insert_##T(h1, h2->keys[i], NULL) == UHASH_ERR) {      \
-                return UHASH_ERR;                                                                   \
-            }                                                                                       \
+    p_uhash_static_inline uhash_ret p_uhash_##NAME##_fit_vals_##T(UHash_##T *h) {                   \
+        /* Existing values are always sized to the buckets, otherwise move to a larger block. */    \
+        uint8_t *flags;                                                                             \
+        uh_key *keys;                                                                               \
+        uh_val *vals;                                                                               \
+                                                                                                    \
+        if (h->vals) return UHASH_OK;                                                               \
+        if (p_uhash_##NAME##_alloc_##T(h, h->n_buckets, true, &flags, &keys, &vals)) {              \
+            return UHASH_ERR;                                                                       \
         }                                                                                           \
+                                                                                                    \
+        memcpy(flags, h->flags, h->n_buckets);                                                      \
+        memcpy(keys, h->keys, h->n_buckets * sizeof(uh_key));                                       \
+        p_uhash_##NAME##_free_##T(h, h->n_buckets, h->flags, h->keys, NULL);                        \
+        h->flags = flags;                                                                           \
+        h->keys = keys;                                                                             \
+        h->vals = vals;                                                                             \
         return UHASH_OK;                                                                            \
     }                                                                                               \
                                                                                                     \
-    SCOPE void uhset_intersect_##T(UHash_##T *h1, UHash_##T const *h2) {                            \
-        for (uhash_uint i = 0; i != h1->n_buckets; ++i) {                                           \
-            if (uhash_exists(h1, i) && uhash_get_##T(h2, h1->keys[i]) == UHASH_INDEX_MISSING) {     \
-                uhash_delete_##T(h1, i);                                                            \
-            }                                                                                       \
-        }                                                                                           \
+    p_uhash_static_inline bool p_uhash_##NAME##_inline_##T(UHash_##T const *h) {                    \
+        (void)h;                                                                                    \
+        return false;                                                                               \
+    }
+
+/*
+ * Bucket storage used by layouts having one metadata byte per bucket
+ * (define UHASH_SINGLE_ALLOC to allocate them as a single block).
+ */
+#ifdef UHASH_SINGLE_ALLOC
+    #define P_UHASH_IMPL_STORAGE_BYTES P_UHASH_IMPL_STORAGE_BLOCK
+#else
+    #define P_UHASH_IMPL_STORAGE_BYTES P_UHASH_IMPL_STORAGE_SPLIT
+#endif
+
+/*
+ * Generates bucket storage function definitions for the specified hash table type,
+ * keeping the buckets of small tables in the inline buffer of the table.
+ * Larger tables use P_UHASH_IMPL_STORAGE_BYTES.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param NAME [symbol] Infix of the generated function names.
+ */
+#define P_UHASH_IMPL_STORAGE_INLINE(T, SCOPE, uh_key, uh_val, NAME)                                 \
+    P_UHASH_IMPL_STORAGE_BYTES(T, SCOPE, uh_key, uh_val, NAME##_heap)                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_##NAME##_free_##T(UHash_##T const *h, uhash_uint n,          \
+                                                        uint8_t *flags, uh_key *keys,               \
+                                                        uh_val *vals) {                             \
+        if (keys == h->sbo_keys) return;                                                            \
+        p_uhash_##NAME##_heap_free_##T(h, n, flags, keys, vals);                                    \
     }                                                                                               \
                                                                                                     \
-    SCOPE uhash_uint uhset_hash_##T(UHash_##T const *h) {                                           \
-        uhash_uint hash = 0;                                                                        \
-        for (uhash_uint i = 0; i != h->n_buckets; ++i) {                                            \
-            if (uhash_exists(h, i)) hash ^= hash_func(h->keys[i]);                                  \
+    p_uhash_static_inline uhash_ret p_uhash_##NAME##_alloc_##T(UHash_##T *h, uhash_uint n,          \
+                                                              bool with_vals, uint8_t **flags,      \
+                                                              uh_key **keys, uh_val **vals) {       \
+        /* The inline buffer cannot be reused while in use, as resizing reads the old buckets. */   \
+        if (n <= P_UHASH_SBO_BUCKETS && h->keys != h->sbo_keys) {                                   \
+            *flags = h->sbo_flags;                                                                  \
+            *keys = h->sbo_keys;                                                                    \
+            *vals = with_vals ? h->sbo_vals : NULL;                                                 \
+            return UHASH_OK;                                                                        \
         }                                                                                           \
-        return hash;                                                                                \
+        return p_uhash_##NAME##_heap_alloc_##T(h, n, with_vals, flags, keys, vals);                 \
     }                                                                                               \
                                                                                                     \
-    SCOPE uh_key uhset_get_any_##T(UHash_##T const *h, uh_key if_empty) {                           \
-        uhash_uint i = 0;                                                                           \
-        while(i != h->n_buckets && !uhash_exists(h, i)) ++i;                                        \
-        return i == h->n_buckets ? if_empty : h->keys[i];                                           \
+    p_uhash_static_inline uhash_ret p_uhash_##NAME##_fit_vals_##T(UHash_##T *h) {                   \
+        if (h->keys != h->sbo_keys) return p_uhash_##NAME##_heap_fit_vals_##T(h);                   \
+        h->vals = h->sbo_vals;                                                                      \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline bool p_uhash_##NAME##_inline_##T(UHash_##T const *h) {                    \
+        return h->keys == h->sbo_keys;                                                              \
+    }
+
+/*
+ * Generates function definitions managing the reference count of buckets shared
+ * by copy-on-write clones. Tables own their buckets exclusively if 'refs' is NULL.
+ *
+ * @param T [symbol] Hash table name.
+ */
+#define P_UHASH_IMPL_REFS(T)                                                                        \
+                                                                                                    \
+    /* Returns whether the buckets are shared, taking ownership if other clones released them. */   \
+    p_uhash_static_inline bool p_uhash_shared_##T(UHash_##T *h) {                                   \
+        if (!h->refs) return false;                                                                 \
+        if (p_uhash_ref_load(h->refs) > 1) return true;                                             \
+        p_uhash_free(h->allocator, h->refs, sizeof(*h->refs));                                      \
+        h->refs = NULL;                                                                             \
+        return false;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Drops the reference to the buckets, returning true if they must be freed by the caller. */   \
+    p_uhash_static_inline bool p_uhash_unref_##T(UHash_##T *h) {                                    \
+        if (!h->refs) return true;                                                                  \
+        bool const last = !p_uhash_ref_sub(h->refs);                                                \
+        if (last) p_uhash_free(h->allocator, h->refs, sizeof(*h->refs));                            \
+        h->refs = NULL;                                                                             \
+        return last;                                                                                \
+    }
+
+/*
+ * Generates value accessors for the specified hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_val [type] Hash table value type.
+ * @param VS [symbol] Value storage accessors (P_UHASH_VS_PLAIN or P_UHASH_VS_PACKED).
+ */
+#define P_UHASH_IMPL_VALS(T, uh_val, VS)                                                            \
+                                                                                                    \
+    p_uhash_static_inline uh_val p_uhash_val_##T(UHash_##T const *h, uhash_uint i) {                \
+        return VS##_GET(T, h->vals, i);                                                             \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_set_val_##T(UHash_##T *h, uhash_uint i, uh_val val) {        \
+        VS##_SET(T, h->vals, i, val);                                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the size of the values of the specified number of buckets. */                        \
+    p_uhash_static_inline size_t p_uhash_vals_size_##T(size_t n) {                                  \
+        return VS##_SIZE(T, n);                                                                     \
     }
 
-// ##############
-// # Public API #
-// ##############
+/*
+ * Generates core function definitions for the specified hash table type (2-bit flags layout).
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ * @param HC [symbol] Hash cache accessors (P_UHASH_HC_NONE or P_UHASH_HC_BUCKETS).
+ * @param VS [symbol] Value storage accessors (P_UHASH_VS_PLAIN, _PACKED or _SEEDED).
+ */
+#define P_UHASH_IMPL_CORE(T, SCOPE, uh_key, uh_val, hash_func, equal_func, HC, VS)                  \
+    P_UHASH_IMPL_REFS(T)                                                                            \
+    P_UHASH_IMPL_VALS(T, uh_val, VS)                                                                \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_storage_fit_vals_##T(UHash_##T *h) {                    \
+        /* Existing values are always sized to the buckets. */                                      \
+        if (h->vals) return UHASH_OK;                                                               \
+        h->vals = p_uhash_malloc(h->allocator, VS##_SIZE(T, h->n_buckets));                         \
+        return h->vals ? UHASH_OK : UHASH_ERR;                                                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_buckets_free_##T(UHash_##T const *h) {                       \
+        UHashAllocator const *a = h->allocator;                                                     \
+        p_uhash_free(a, h->keys, h->n_buckets * sizeof(uh_key));                                    \
+        p_uhash_free(a, h->vals, VS##_SIZE(T, h->n_buckets));                                       \
+        p_uhash_free(a, HC##_GET(h), h->n_buckets * sizeof(uhash_uint));                            \
+        p_uhash_free(a, h->flags, p_uhf_size(h->n_buckets) * sizeof(uint32_t));                     \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline bool p_uhash_shareable_##T(UHash_##T const *h) {                          \
+        (void)h;                                                                                    \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    /* Gives the table its own buckets if they are shared, copying their contents if requested. */  \
+    p_uhash_static_inline uhash_ret p_uhash_unshare_##T(UHash_##T *h, bool copy) {                  \
+        if (!p_uhash_shared_##T(h)) return UHASH_OK;                                                \
+                                                                                                    \
+        UHash_##T old = *h;                                                                         \
+        uhash_uint const n = h->n_buckets;                                                          \
+        size_t const flags_size = p_uhf_size(n) * sizeof(uint32_t);                                 \
+        uhash_uint const *old_hashes = HC##_GET(&old);                                              \
+                                                                                                    \
+        h->flags = p_uhash_malloc(h->allocator, flags_size);                                        \
+        h->keys = p_uhash_malloc(h->allocator, n * sizeof(uh_key));                                 \
+        h->vals = old.vals ? p_uhash_malloc(h->allocator, VS##_SIZE(T, n)) : NULL;                  \
+        HC##_SET(h, old_hashes ? p_uhash_malloc(h->allocator, n * sizeof(uhash_uint)) : NULL);      \
+                                                                                                    \
+        if (!h->flags || !h->keys || (old.vals && !h->vals) || (old_hashes && !HC##_GET(h))) {      \
+            p_uhash_buckets_free_##T(h);                                                            \
+            *h = old;                                                                               \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (copy) {                                                                                 \
+            memcpy(h->flags, old.flags, flags_size);                                                \
+            memcpy(h->keys, old.keys, n * sizeof(uh_key));                                          \
+            if (old.vals) memcpy(h->vals, old.vals, VS##_SIZE(T, n));                               \
+            uhash_uint *hashes = HC##_GET(h);                                                       \
+            if (old_hashes) memcpy(hashes, old_hashes, n * sizeof(uhash_uint));                     \
+        }                                                                                           \
+                                                                                                    \
+        h->refs = NULL;                                                                             \
+        if (p_uhash_unref_##T(&old)) p_uhash_buckets_free_##T(&old);                                \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_free_##T(UHash_##T *h) {                                                       \
+        if (!h) return;                                                                             \
+        if (p_uhash_unref_##T(h)) p_uhash_buckets_free_##T(h);                                      \
+        p_uhash_free(h->allocator, h, sizeof(*h));                                                  \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest) {                  \
+        /* Shared buckets are resized in place below, so they cannot be reused. */                  \
+        if (p_uhash_unshare_##T(dest, false)) return UHASH_ERR;                                     \
+        uhash_ret ret = UHASH_OK;                                                                   \
+                                                                                                    \
+        uhash_uint n_buckets = src->n_buckets;                                                      \
+        uhash_uint n_flags = p_uhf_size(n_buckets);                                                 \
+                                                                                                    \
+        uint32_t *new_flags = p_uhash_realloc(dest->allocator, dest->flags,                         \
+                                              p_uhf_size(dest->n_buckets) * sizeof(uint32_t),       \
+                                              n_flags * sizeof(uint32_t));                          \
+        uh_key *new_keys = p_uhash_realloc(dest->allocator, dest->keys,                             \
+                                           dest->n_buckets * sizeof(uh_key),                        \
+                                           n_buckets * sizeof(uh_key));                             \
+                                                                                                    \
+        /* Values are not copied, but the buckets of maps must have room for them. */               \
+        uh_val *new_vals = NULL;                                                                    \
+                                                                                                    \
+        if (dest->vals) {                                                                           \
+            new_vals = p_uhash_realloc(dest->allocator, dest->vals,                                 \
+                                       VS##_SIZE(T, dest->n_buckets), VS##_SIZE(T, n_buckets));     \
+            if (new_vals) dest->vals = new_vals;                                                    \
+        }                                                                                           \
+        uhash_uint const *src_hashes = HC##_GET(src);                                               \
+        uhash_uint *new_hashes = NULL;                                                              \
+                                                                                                    \
+        if (HC##_ENABLED && src_hashes) {                                                           \
+            new_hashes = p_uhash_realloc(dest->allocator, HC##_GET(dest),                           \
+                                         dest->n_buckets * sizeof(uhash_uint),                      \
+                                         n_buckets * sizeof(uhash_uint));                           \
+            if (new_hashes) {                                                                       \
+                memcpy(new_hashes, src_hashes, n_buckets * sizeof(uhash_uint));                     \
+                HC##_SET(dest, new_hashes);                                                         \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (new_flags && new_keys && (new_vals || !dest->vals) && (new_hashes || !src_hashes)) {    \
+            memcpy(new_flags, src->flags, n_flags * sizeof(uint32_t));                              \
+            memcpy(new_keys, src->keys, n_buckets * sizeof(uh_key));                                \
+            dest->flags = new_flags;                                                                \
+            dest->keys = new_keys;                                                                  \
+            dest->n_buckets = (uhash_##T##_idx)n_buckets;                                           \
+            dest->max_occupied = (uhash_##T##_idx)p_uhash_upper_bound(dest, dest->n_buckets);       \
+            dest->n_occupied = src->n_occupied;                                                     \
+            dest->count = src->count;                                                               \
+            p_uhash_copy_seed_##T(dest, src);                                                       \
+        } else {                                                                                    \
+            ret = UHASH_ERR;                                                                        \
+        }                                                                                           \
+                                                                                                    \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_clear_##T(UHash_##T *h) {                                                      \
+        if (h && h->flags && !p_uhash_unshare_##T(h, false)) {                                      \
+            memset(h->flags, 0xaa, p_uhf_size(h->n_buckets) * sizeof(uint32_t));                    \
+            h->count = h->n_occupied = 0;                                                           \
+            h->removed = false;                                                                     \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_get_h_##T(UHash_##T const *h, uh_key key,              \
+                                                       uhash_uint hash) {                           \
+        p_uhash_count(h, gets, 1);                                                                  \
+        if (!h->n_buckets) return UHASH_INDEX_MISSING;                                              \
+                                                                                                    \
+        uhash_uint const *hashes = HC##_GET(h);                                                     \
+        uhash_uint const n = h->n_buckets;                                                          \
+        uhash_uint i = p_uhf_home(hash, n);                                                         \
+        uhash_uint step = 0;                                                                        \
+        uhash_uint const last = i;                                                                  \
+                                                                                                    \
+        while (!p_uhf_isempty(h->flags, i) &&                                                       \
+               (p_uhf_isdel(h->flags, i) || (hashes && hashes[i] != hash) ||                        \
+                !equal_func(h->keys[i], key))) {                                                    \
+            p_uhash_count(h, get_probes, 1);                                                        \
+            i = p_uhf_probe(i, ++step, n);                                                          \
+            if (i == last) return UHASH_INDEX_MISSING;                                              \
+        }                                                                                           \
+                                                                                                    \
+        return p_uhf_iseither(h->flags, i) ? UHASH_INDEX_MISSING : i;                               \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets) {                      \
+        /* Uses (0.25*n_buckets) bytes instead of [sizeof(uh_key+uh_val)+.25]*n_buckets. */         \
+        uint32_t *new_flags = NULL;                                                                 \
+        uhash_uint j = 1;                                                                           \
+        {                                                                                           \
+            /* The bucket count, once rounded, must fit the type of the stored counts. */           \
+            uhash_uint const max_buckets = p_uhf_max(p_uhash_idx_max(T));                           \
+            if (new_n_buckets > max_buckets) return UHASH_ERR;                                      \
+                                                                                                    \
+            p_uhf_round(new_n_buckets);                                                             \
+            if (new_n_buckets < 4) new_n_buckets = 4;                                               \
+                                                                                                    \
+            if (h->count >= p_uhash_upper_bound(h, new_n_buckets)) {                                \
+                /* Requested size is too small. */                                                  \
+                j = 0;                                                                              \
+            } else {                                                                                \
+                /* Hash table size needs to be changed (shrink or expand): rehash. */               \
+                if (p_uhash_unshare_##T(h, true)) return UHASH_ERR;                                 \
+                new_flags = p_uhash_malloc(h->allocator,                                            \
+                                           p_uhf_size(new_n_buckets) * sizeof(uint32_t));           \
+                if (!new_flags) return UHASH_ERR;                                                   \
+                                                                                                    \
+                memset(new_flags, 0xaa, p_uhf_size(new_n_buckets) * sizeof(uint32_t));              \
+                                                                                                    \
+                if (h->n_buckets < new_n_buckets) {                                                 \
+                    /* Expand. */                                                                   \
+                    uh_key *new_keys = p_uhash_realloc(h->allocator, h->keys,                       \
+                                                       h->n_buckets * sizeof(uh_key),               \
+                                                       new_n_buckets * sizeof(uh_key));             \
+                                                                                                    \
+                    if (!new_keys) {                                                                \
+                        p_uhash_free(h->allocator, new_flags,                                       \
+                                     p_uhf_size(new_n_buckets) * sizeof(uint32_t));                 \
+                        return UHASH_ERR;                                                           \
+                    }                                                                               \
+                                                                                                    \
+                    h->keys = new_keys;                                                             \
+                                                                                                    \
+                    if (h->vals) {                                                                  \
+                        uh_val *nvals = p_uhash_realloc(h->allocator, h->vals,                      \
+                                                        VS##_SIZE(T, h->n_buckets),                 \
+                                                        VS##_SIZE(T, new_n_buckets));               \
+                                                                                                    \
+                        if (!nvals) {                                                               \
+                            p_uhash_free(h->allocator, new_flags,                                   \
+                                         p_uhf_size(new_n_buckets) * sizeof(uint32_t));             \
+                            return UHASH_ERR;                                                       \
+                        }                                                                           \
+                                                                                                    \
+                        h->vals = nvals;                                                            \
+                    }                                                                               \
+                                                                                                    \
+                    if (HC##_ENABLED) {                                                             \
+                        uhash_uint *nhashes = p_uhash_realloc(h->allocator, HC##_GET(h),            \
+                                                              h->n_buckets * sizeof(uhash_uint),    \
+                                                              new_n_buckets * sizeof(uhash_uint));  \
+                                                                                                    \
+                        if (!nhashes) {                                                             \
+                            p_uhash_free(h->allocator, new_flags,                                   \
+                                         p_uhf_size(new_n_buckets) * sizeof(uint32_t));             \
+                            return UHASH_ERR;                                                       \
+                        }                                                                           \
+                                                                                                    \
+                        HC##_SET(h, nhashes);                                                       \
+                    }                                                                               \
+                } /* Otherwise shrink. */                                                           \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (!j) return UHASH_OK;                                                                    \
+                                                                                                    \
+        /* Rehashing is needed. */                                                                  \
+        p_uhash_timer_start(t0);                                                                    \
+        uhash_uint *hashes = HC##_GET(h);                                                           \
+                                                                                                    \
+        for (j = 0; j != h->n_buckets; ++j) {                                                       \
+            if (p_uhf_iseither(h->flags, j)) continue;                                              \
+                                                                                                    \
+            uh_key key = h->keys[j];                                                                \
+            uh_val val = {0};                                                                       \
+            if (h->vals) val = VS##_GET(T, h->vals, j);                                             \
+            /* Cached hashes are reused rather than recomputed. */                                  \
+            uhash_uint hash = hashes ? hashes[j] : (uhash_uint)(hash_func(key));                    \
+            p_uhf_set_isdel_true(h->flags, j);                                                      \
+                                                                                                    \
+            while (true) {                                                                          \
+                /* Kick-out process; sort of like in Cuckoo hashing. */                             \
+                uhash_uint i = p_uhf_home(hash, new_n_buckets);                                     \
+                uhash_uint step = 0;                                                                \
+                                                                                                    \
+                while (!p_uhf_isempty(new_flags, i)) i = p_uhf_probe(i, ++step, new_n_buckets);     \
+                p_uhf_set_isempty_false(new_flags, i);                                              \
+                                                                                                    \
+                if (i < h->n_buckets && !p_uhf_iseither(h->flags, i)) {                             \
+                    /* Kick out the existing element. */                                            \
+                    { uh_key tmp = h->keys[i]; h->keys[i] = key; key = tmp; }                       \
+                    if (h->vals) {                                                                  \
+                        uh_val tmp = VS##_GET(T, h->vals, i);                                       \
+                        VS##_SET(T, h->vals, i, val);                                               \
+                        val = tmp;                                                                  \
+                    }                                                                               \
+                    if (hashes) {                                                                   \
+                        uhash_uint tmp = hashes[i]; hashes[i] = hash; hash = tmp;                   \
+                    } else {                                                                        \
+                        hash = (uhash_uint)(hash_func(key));                                        \
+                    }                                                                               \
+                    /* Mark it as deleted in the old hash table. */                                 \
+                    p_uhf_set_isdel_true(h->flags, i);                                              \
+                } else {                                                                            \
+                    /* Write the element and jump out of the loop. */                               \
+                    h->keys[i] = key;                                                               \
+                    if (h->vals) VS##_SET(T, h->vals, i, val);                                      \
+                    if (hashes) hashes[i] = hash;                                                   \
+                    break;                                                                          \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (h->n_buckets > new_n_buckets) {                                                         \
+            /* Shrink the hash table. */                                                            \
+            h->keys = p_uhash_realloc(h->allocator, h->keys, h->n_buckets * sizeof(uh_key),         \
+                                      new_n_buckets * sizeof(uh_key));                              \
+            if (h->vals) h->vals = p_uhash_realloc(h->allocator, h->vals,                           \
+                                                   VS##_SIZE(T, h->n_buckets),                      \
+                                                   VS##_SIZE(T, new_n_buckets));                    \
+            if (hashes) {                                                                           \
+                hashes = p_uhash_realloc(h->allocator, hashes, h->n_buckets * sizeof(uhash_uint),   \
+                                         new_n_buckets * sizeof(uhash_uint));                       \
+                HC##_SET(h, hashes);                                                                \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        /* Free the working space. */                                                               \
+        p_uhash_free(h->allocator, h->flags, p_uhf_size(h->n_buckets) * sizeof(uint32_t));          \
+        h->flags = new_flags;                                                                       \
+        h->n_buckets = (uhash_##T##_idx)new_n_buckets;                                              \
+        h->max_occupied = (uhash_##T##_idx)p_uhash_upper_bound(h, h->n_buckets);                    \
+        h->n_occupied = h->count;                                                                   \
+        h->removed = false;                                                                         \
+        p_uhash_count(h, rehashes, 1);                                                              \
+        p_uhash_count_time(h, t0);                                                                  \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_put_h_##T(UHash_##T *h, uh_key key, uhash_uint hash,    \
+                                                      uhash_uint *idx) {                            \
+        p_uhash_count(h, puts, 1);                                                                  \
+        p_uhash_analyzer_assert(h->flags);                                                          \
+                                                                                                    \
+        uhash_uint x;                                                                               \
+                                                                                                    \
+        if (h->n_occupied >= h->max_occupied) {                                                     \
+            /* Update the hash table. */                                                            \
+            if (p_uhash_should_compact(h)) {                                                        \
+                if (uhash_resize_##T(h, h->n_buckets)) {                                            \
+                    /* Clear "deleted" elements. */                                                 \
+                    if (idx) *idx = UHASH_INDEX_MISSING;                                            \
+                    return UHASH_ERR;                                                               \
+                }                                                                                   \
+            } else if (uhash_resize_##T(h, p_uhf_grow(h->n_buckets)) ||                             \
+                       h->n_occupied >= h->max_occupied) {                                          \
+                /* Expand the hash table, failing if it cannot grow any further. */                 \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+        } else if (p_uhash_should_shrink(h)) {                                                      \
+            /* Shrink the hash table; on failure, keep using the current buckets. */                \
+            (void)uhash_resize_##T(h, h->count << 1U);                                              \
+        }                                                                                           \
+                                                                                                    \
+        if (p_uhash_unshare_##T(h, true)) {                                                         \
+            if (idx) *idx = UHASH_INDEX_MISSING;                                                    \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        uhash_uint *hashes = HC##_GET(h);                                                           \
+        {                                                                                           \
+            uhash_uint const n = h->n_buckets;                                                      \
+            uhash_uint i = p_uhf_home(hash, n);                                                     \
+            uhash_uint step = 0;                                                                    \
+            uhash_uint site = n;                                                                    \
+            x = site;                                                                               \
+                                                                                                    \
+            if (p_uhf_isempty(h->flags, i)) {                                                       \
+                /* Speed up. */                                                                     \
+                x = i;                                                                              \
+            } else {                                                                                \
+                uhash_uint const last = i;                                                          \
+                                                                                                    \
+                while (!p_uhf_isempty(h->flags, i) &&                                               \
+                       (p_uhf_isdel(h->flags, i) || (hashes && hashes[i] != hash) ||                \
+                        !equal_func(h->keys[i], key))) {                                            \
+                    if (p_uhf_isdel(h->flags, i)) site = i;                                         \
+                    p_uhash_count(h, put_probes, 1);                                                \
+                    i = p_uhf_probe(i, ++step, n);                                                  \
+                                                                                                    \
+                    if (i == last) {                                                                \
+                        x = site;                                                                   \
+                        break;                                                                      \
+                    }                                                                               \
+                }                                                                                   \
+                                                                                                    \
+                p_uhash_watch_probes_##T(h, step);                                                  \
+                                                                                                    \
+                if (x == h->n_buckets) {                                                            \
+                    x = (p_uhf_isempty(h->flags, i) && site != h->n_buckets) ? site : i;            \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        uhash_ret ret;                                                                              \
+                                                                                                    \
+        if (p_uhf_isempty(h->flags, x)) {                                                           \
+            /* Not present at all. */                                                               \
+            h->keys[x] = key;                                                                       \
+            if (hashes) hashes[x] = hash;                                                           \
+            p_uhf_set_isboth_false(h->flags, x);                                                    \
+            h->count++;                                                                             \
+            h->n_occupied++;                                                                        \
+            ret = UHASH_INSERTED;                                                                   \
+        } else if (p_uhf_isdel(h->flags, x)) {                                                      \
+            /* Deleted. */                                                                          \
+            h->keys[x] = key;                                                                       \
+            if (hashes) hashes[x] = hash;                                                           \
+            p_uhf_set_isboth_false(h->flags, x);                                                    \
+            h->count++;                                                                             \
+            ret = UHASH_INSERTED;                                                                   \
+        } else {                                                                                    \
+            /* Don't touch h->keys[x] if present and not deleted. */                                \
+            ret = UHASH_PRESENT;                                                                    \
+        }                                                                                           \
+                                                                                                    \
+        if (idx) *idx = (x == h->n_buckets ? UHASH_INDEX_MISSING : x);                              \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline unsigned p_uhash_layout_##T(void) {                                       \
+        return VS##_LAYOUT(T, HC##_ENABLED ? P_UHASH_LAYOUT_NONE : P_UHF_LAYOUT);                   \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the number of buckets needed to hold the specified number of keys. */                \
+    p_uhash_static_inline uhash_uint p_uhash_fit_##T(UHash_##T const *h, uhash_uint count) {        \
+        return p_uhash_fit(count, p_uhash_load(h, UHASH_MAX_LOAD));                                 \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_home_##T(UHash_##T const *h, uhash_uint hash) {        \
+        return p_uhf_home(hash, h->n_buckets);                                                      \
+    }                                                                                               \
+                                                                                                    \
+    /* Hashes the key of a bucket of src as h would, reusing the cached hash if possible. */        \
+    p_uhash_static_inline uhash_uint p_uhash_key_hash_##T(UHash_##T const *h, UHash_##T const *src, \
+                                                         uhash_uint i) {                            \
+        (void)h;                                                                                    \
+        if (HC##_ENABLED) return HC##_GET(src)[i];                                                  \
+        return (uhash_uint)(hash_func(src->keys[i]));                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the probe length of the key in bucket i. */                                          \
+    p_uhash_static_inline uhash_uint p_uhash_probe_len_##T(UHash_##T const *h, uhash_uint i) {      \
+        uhash_uint const n = h->n_buckets;                                                          \
+        return p_uhf_dist(p_uhf_home(p_uhash_key_hash_##T(h, h, i), n), i, n);                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline size_t p_uhash_bytes_##T(UHash_##T const *h) {                            \
+        if (!h->n_buckets) return 0;                                                                \
+        size_t const bucket = sizeof(uh_key) + (HC##_ENABLED ? sizeof(uhash_uint) : 0);             \
+        return p_uhf_size(h->n_buckets) * sizeof(uint32_t) + h->n_buckets * bucket +                \
+               (h->vals ? VS##_SIZE(T, h->n_buckets) : 0);                                          \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_prefetch_##T(UHash_##T const *h, uhash_uint hash) {          \
+        if (!h->n_buckets) return;                                                                  \
+        uhash_uint const i = p_uhf_home(hash, h->n_buckets);                                        \
+        p_uhash_prefetch(h->flags + (i >> 4U));                                                     \
+        p_uhash_prefetch(h->keys + i);                                                              \
+        if (HC##_ENABLED) p_uhash_prefetch(HC##_GET(h) + i);                                        \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key) {                                \
+        return p_uhash_get_h_##T(h, key, (uhash_uint)(hash_func(key)));                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx) {                      \
+        p_uhash_guard_##T(h);                                                                       \
+        return p_uhash_put_h_##T(h, key, (uhash_uint)(hash_func(key)), idx);                        \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x) {                                       \
+        if (!p_uhf_iseither(h->flags, x) && !p_uhash_unshare_##T(h, true)) {                        \
+            p_uhf_set_isdel_true(h->flags, x);                                                      \
+            h->count--;                                                                             \
+            h->removed = true;                                                                      \
+        }                                                                                           \
+    }
+
+/*
+ * Generates core function definitions for the specified hash table type (SIMD control byte layout).
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ * @param STORAGE [symbol] Bucket storage generator (e.g. P_UHASH_IMPL_STORAGE_BYTES).
+ */
+#define P_UHASH_IMPL_CORE_SIMD(T, SCOPE, uh_key, uh_val, hash_func, equal_func, STORAGE)            \
+    STORAGE(T, SCOPE, uh_key, uh_val, storage)                                                      \
+                                                                                                    \
+    P_UHASH_IMPL_REFS(T)                                                                            \
+    P_UHASH_IMPL_VALS(T, uh_val, P_UHASH_VS_PLAIN)                                                  \
+                                                                                                    \
+    p_uhash_static_inline bool p_uhash_shareable_##T(UHash_##T const *h) {                          \
+        /* Inline buckets are part of the table. */                                                 \
+        return !p_uhash_storage_inline_##T(h);                                                      \
+    }                                                                                               \
+                                                                                                    \
+    /* Gives the table its own buckets if they are shared, copying their contents if requested. */  \
+    p_uhash_static_inline uhash_ret p_uhash_unshare_##T(UHash_##T *h, bool copy) {                  \
+        if (!p_uhash_shared_##T(h)) return UHASH_OK;                                                \
+                                                                                                    \
+        uhash_uint const n = h->n_buckets;                                                          \
+        uint8_t *flags;                                                                             \
+        uh_key *keys;                                                                               \
+        uh_val *vals;                                                                               \
+                                                                                                    \
+        if (p_uhash_storage_alloc_##T(h, n, h->vals != NULL, &flags, &keys, &vals)) {               \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (copy) {                                                                                 \
+            memcpy(flags, h->flags, n);                                                             \
+            memcpy(keys, h->keys, n * sizeof(uh_key));                                              \
+            if (vals) memcpy(vals, h->vals, n * sizeof(uh_val));                                    \
+        }                                                                                           \
+                                                                                                    \
+        if (p_uhash_unref_##T(h)) p_uhash_storage_free_##T(h, n, h->flags, h->keys, h->vals);       \
+        h->flags = flags;                                                                           \
+        h->keys = keys;                                                                             \
+        h->vals = vals;                                                                             \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_free_##T(UHash_##T *h) {                                                       \
+        if (!h) return;                                                                             \
+        UHashAllocator const *a = h->allocator;                                                     \
+        if (p_uhash_unref_##T(h)) {                                                                 \
+            p_uhash_storage_free_##T(h, h->n_buckets, h->flags, h->keys, h->vals);                  \
+        }                                                                                           \
+        p_uhash_free(a, h, sizeof(*h));                                                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest) {                  \
+        uhash_uint n_buckets = src->n_buckets;                                                      \
+                                                                                                    \
+        /* Buckets of the same size are reused, unless they are shared. */                          \
+        if (n_buckets != dest->n_buckets || !dest->keys || p_uhash_shared_##T(dest)) {              \
+            uint8_t *new_flags;                                                                     \
+            uh_key *new_keys;                                                                       \
+            uh_val *new_vals;                                                                       \
+                                                                                                    \
+            /* Values are not copied, but the buckets of maps must have room for them. */           \
+            if (p_uhash_storage_alloc_##T(dest, n_buckets, dest->vals != NULL,                      \
+                                          &new_flags, &new_keys, &new_vals)) {                      \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+                                                                                                    \
+            if (p_uhash_unref_##T(dest)) {                                                          \
+                p_uhash_storage_free_##T(dest, dest->n_buckets, dest->flags, dest->keys,            \
+                                         dest->vals);                                               \
+            }                                                                                       \
+                                                                                                    \
+            dest->flags = new_flags;                                                                \
+            dest->keys = new_keys;                                                                  \
+            dest->vals = new_vals;                                                                  \
+            dest->n_buckets = n_buckets;                                                            \
+            dest->max_occupied = p_uhash_simd_upper_bound(dest, dest->n_buckets);                   \
+        }                                                                                           \
+                                                                                                    \
+        if (n_buckets) {                                                                            \
+            memcpy(dest->flags, src->flags, n_buckets);                                             \
+            memcpy(dest->keys, src->keys, n_buckets * sizeof(uh_key));                              \
+        }                                                                                           \
+                                                                                                    \
+        dest->n_occupied = src->n_occupied;                                                         \
+        dest->count = src->count;                                                                   \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_clear_##T(UHash_##T *h) {                                                      \
+        if (h && h->flags && !p_uhash_unshare_##T(h, false)) {                                      \
+            memset(h->flags, P_UHC_EMPTY, h->n_buckets);                                            \
+            h->count = h->n_occupied = 0;                                                           \
+            h->removed = false;                                                                     \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_get_h_##T(UHash_##T const *h, uh_key key,              \
+                                                       uhash_uint hash) {                           \
+        p_uhash_count(h, gets, 1);                                                                  \
+        if (!h->n_buckets) return UHASH_INDEX_MISSING;                                              \
+                                                                                                    \
+        uint8_t const tag = p_uhc_tag(hash);                                                        \
+        uhash_uint const group_mask = (h->n_buckets >> 4U) - 1;                                     \
+        uhash_uint g = hash & group_mask;                                                           \
+                                                                                                    \
+        for (uhash_uint step = 0; step <= group_mask; g = (g + (++step)) & group_mask) {            \
+            uint8_t const *group = p_uhc_group(h->flags, g);                                        \
+                                                                                                    \
+            for (uint32_t m = p_uhc_match(group, tag); m; m &= m - 1) {                             \
+                /* Full key comparisons only happen on tag matches. */                              \
+                uhash_uint const i = (g << 4U) + p_uhash_ctz32(m);                                  \
+                if (equal_func(h->keys[i], key)) return i;                                          \
+            }                                                                                       \
+                                                                                                    \
+            /* Probing stops at the first group having an empty bucket. */                          \
+            if (p_uhc_match_empty(group)) break;                                                    \
+            p_uhash_count(h, get_probes, 1);                                                        \
+        }                                                                                           \
+                                                                                                    \
+        return UHASH_INDEX_MISSING;                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets) {                      \
+        p_uhash_uint_next_power_2(new_n_buckets);                                                   \
+        if (new_n_buckets < P_UHC_GROUP_SIZE) new_n_buckets = P_UHC_GROUP_SIZE;                     \
+                                                                                                    \
+        /* Requested size is too small. */                                                          \
+        if (h->count >= p_uhash_simd_upper_bound(h, new_n_buckets)) return UHASH_OK;                \
+                                                                                                    \
+        uint8_t *new_flags;                                                                         \
+        uh_key *new_keys;                                                                           \
+        uh_val *new_vals;                                                                           \
+                                                                                                    \
+        if (p_uhash_storage_alloc_##T(h, new_n_buckets, h->vals != NULL,                            \
+                                      &new_flags, &new_keys, &new_vals)) {                          \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_timer_start(t0);                                                                    \
+        memset(new_flags, P_UHC_EMPTY, new_n_buckets);                                              \
+        uhash_uint const group_mask = (new_n_buckets >> 4U) - 1;                                    \
+                                                                                                    \
+        p_uhash_for_buckets(h, j) {                                                                 \
+            /* Keys are unique and there are no deleted buckets: take the first empty one. */       \
+            uhash_uint const hash = (uhash_uint)(hash_func(h->keys[j]));                            \
+            uhash_uint g = hash & group_mask;                                                       \
+            uint32_t m;                                                                             \
+                                                                                                    \
+            for (uhash_uint step = 0; !(m = p_uhc_match_empty(p_uhc_group(new_flags, g)));) {       \
+                g = (g + (++step)) & group_mask;                                                    \
+            }                                                                                       \
+                                                                                                    \
+            uhash_uint const i = (g << 4U) + p_uhash_ctz32(m);                                      \
+            new_flags[i] = p_uhc_tag(hash);                                                         \
+            new_keys[i] = h->keys[j];                                                               \
+            if (new_vals) new_vals[i] = h->vals[j];                                                 \
+        }                                                                                           \
+                                                                                                    \
+        /* Shared buckets are left to the other clones. */                                          \
+        if (p_uhash_unref_##T(h)) {                                                                 \
+            p_uhash_storage_free_##T(h, h->n_buckets, h->flags, h->keys, h->vals);                  \
+        }                                                                                           \
+                                                                                                    \
+        h->flags = new_flags;                                                                       \
+        h->keys = new_keys;                                                                         \
+        h->vals = new_vals;                                                                         \
+        h->n_buckets = new_n_buckets;                                                               \
+        h->max_occupied = p_uhash_simd_upper_bound(h, h->n_buckets);                                \
+        h->n_occupied = h->count;                                                                   \
+        h->removed = false;                                                                         \
+        p_uhash_count(h, rehashes, 1);                                                              \
+        p_uhash_count_time(h, t0);                                                                  \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_put_h_##T(UHash_##T *h, uh_key key, uhash_uint hash,    \
+                                                      uhash_uint *idx) {                            \
+        p_uhash_count(h, puts, 1);                                                                  \
+        if (h->n_occupied >= h->max_occupied) {                                                     \
+            /* Clear deleted buckets if there are enough of them, otherwise expand. */              \
+            uhash_uint const n = p_uhash_should_compact(h) ? h->n_buckets : h->n_buckets + 1;       \
+            if (uhash_resize_##T(h, n)) {                                                           \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+        } else if (p_uhash_should_shrink(h)) {                                                      \
+            /* Shrink the hash table; on failure, keep using the current buckets. */                \
+            (void)uhash_resize_##T(h, h->count << 1U);                                              \
+        }                                                                                           \
+                                                                                                    \
+        if (p_uhash_unshare_##T(h, true)) {                                                         \
+            if (idx) *idx = UHASH_INDEX_MISSING;                                                    \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_analyzer_assert(h->flags);                                                          \
+                                                                                                    \
+        uint8_t const tag = p_uhc_tag(hash);                                                        \
+        uhash_uint const group_mask = (h->n_buckets >> 4U) - 1;                                     \
+        uhash_uint g = hash & group_mask;                                                           \
+        uhash_uint site = h->n_buckets;                                                             \
+                                                                                                    \
+        for (uhash_uint step = 0; step <= group_mask; g = (g + (++step)) & group_mask) {            \
+            uint8_t const *group = p_uhc_group(h->flags, g);                                        \
+                                                                                                    \
+            for (uint32_t m = p_uhc_match(group, tag); m; m &= m - 1) {                             \
+                uhash_uint const i = (g << 4U) + p_uhash_ctz32(m);                                  \
+                if (equal_func(h->keys[i], key)) {                                                  \
+                    /* Don't touch h->keys[i] if present. */                                        \
+                    if (idx) *idx = i;                                                              \
+                    return UHASH_PRESENT;                                                           \
+                }                                                                                   \
+            }                                                                                       \
+                                                                                                    \
+            if (site == h->n_buckets) {                                                             \
+                /* Remember the first free bucket, reusing deleted ones. */                         \
+                uint32_t const m = p_uhc_match_free(group);                                         \
+                if (m) site = (g << 4U) + p_uhash_ctz32(m);                                         \
+            }                                                                                       \
+                                                                                                    \
+            if (p_uhc_match_empty(group)) break;                                                    \
+            p_uhash_count(h, put_probes, 1);                                                        \
+        }                                                                                           \
+                                                                                                    \
+        if (site == h->n_buckets) {                                                                 \
+            /* Unreachable as long as UHASH_SIMD_MAX_LOAD is lower than 1. */                       \
+            if (idx) *idx = UHASH_INDEX_MISSING;                                                    \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (h->flags[site] == P_UHC_EMPTY) h->n_occupied++;                                         \
+        h->flags[site] = tag;                                                                       \
+        h->keys[site] = key;                                                                        \
+        h->count++;                                                                                 \
+                                                                                                    \
+        if (idx) *idx = site;                                                                       \
+        return UHASH_INSERTED;                                                                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline unsigned p_uhash_layout_##T(void) {                                       \
+        return P_UHASH_LAYOUT_SIMD;                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the number of buckets needed to hold the specified number of keys. */                \
+    p_uhash_static_inline uhash_uint p_uhash_fit_##T(UHash_##T const *h, uhash_uint count) {        \
+        return p_uhash_fit(count, p_uhash_load(h, UHASH_SIMD_MAX_LOAD));                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_home_##T(UHash_##T const *h, uhash_uint hash) {        \
+        return (hash & ((h->n_buckets >> 4U) - 1)) << 4U;                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_key_hash_##T(UHash_##T const *h, UHash_##T const *src, \
+                                                         uhash_uint i) {                            \
+        (void)h;                                                                                    \
+        return (uhash_uint)(hash_func(src->keys[i]));                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the probe length of the key in bucket i. */                                          \
+    p_uhash_static_inline uhash_uint p_uhash_probe_len_##T(UHash_##T const *h, uhash_uint i) {      \
+        uhash_uint const group_mask = (h->n_buckets >> 4U) - 1;                                     \
+        return p_uhash_tri_dist(p_uhash_key_hash_##T(h, h, i) & group_mask, i >> 4U, group_mask);   \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline size_t p_uhash_bytes_##T(UHash_##T const *h) {                            \
+        return h->n_buckets * (1 + sizeof(uh_key) + (h->vals ? sizeof(uh_val) : 0));                \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_prefetch_##T(UHash_##T const *h, uhash_uint hash) {          \
+        if (!h->n_buckets) return;                                                                  \
+        uhash_uint const g = hash & ((h->n_buckets >> 4U) - 1);                                     \
+        p_uhash_prefetch(p_uhc_group(h->flags, g));                                                 \
+        p_uhash_prefetch(h->keys + (g << 4U));                                                      \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key) {                                \
+        return p_uhash_get_h_##T(h, key, (uhash_uint)(hash_func(key)));                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx) {                      \
+        return p_uhash_put_h_##T(h, key, (uhash_uint)(hash_func(key)), idx);                        \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x) {                                       \
+        if (p_uhc_isfull(h->flags, x) && !p_uhash_unshare_##T(h, true)) {                           \
+            /*                                                                                      \
+             * Probes stop at groups having an empty bucket, so if the group already has one        \
+             * the bucket can be marked as empty rather than deleted.                               \
+             */                                                                                     \
+            if (p_uhc_match_empty(p_uhc_group(h->flags, x >> 4U))) {                                \
+                h->flags[x] = P_UHC_EMPTY;                                                          \
+                h->n_occupied--;                                                                    \
+            } else {                                                                                \
+                h->flags[x] = P_UHC_DELETED;                                                        \
+            }                                                                                       \
+            h->count--;                                                                             \
+            h->removed = true;                                                                      \
+        }                                                                                           \
+    }
+
+/*
+ * Generates core function definitions for the specified hash table type
+ * (2-bit flags layout, incremental resizing).
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ */
+#define P_UHASH_IMPL_CORE_INC(T, SCOPE, uh_key, uh_val, hash_func, equal_func)                      \
+    P_UHASH_IMPL_STORAGE_SPLIT(T, SCOPE, uh_key, uh_val, storage)                                   \
+    P_UHASH_IMPL_VALS(T, uh_val, P_UHASH_VS_PLAIN)                                                  \
+                                                                                                    \
+    /* Buckets are never shared. */                                                                 \
+    p_uhash_static_inline bool p_uhash_shareable_##T(UHash_##T const *h) {                          \
+        (void)h;                                                                                    \
+        return false;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_unshare_##T(UHash_##T *h, bool copy) {                  \
+        (void)h;                                                                                    \
+        (void)copy;                                                                                 \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_inc_find_##T(UHash_##T const *h,                       \
+                                                          uint32_t const *flags,                    \
+                                                          uh_key const *keys,                       \
+                                                          uhash_uint n_buckets,                     \
+                                                          uh_key key, uhash_uint hash) {            \
+        uhash_uint const mask = n_buckets - 1;                                                      \
+        uhash_uint i = hash & mask;                                                                 \
+        uhash_uint step = 0;                                                                        \
+        uhash_uint const last = i;                                                                  \
+                                                                                                    \
+        while (!p_uhf_isempty(flags, i) && (p_uhf_isdel(flags, i) || !equal_func(keys[i], key))) {  \
+            /* Lookups in the old buckets by insertions are counted as lookups as well. */          \
+            p_uhash_count(h, get_probes, 1);                                                        \
+            i = (i + (++step)) & mask;                                                              \
+            if (i == last) return UHASH_INDEX_MISSING;                                              \
+        }                                                                                           \
+                                                                                                    \
+        return p_uhf_iseither(flags, i) ? UHASH_INDEX_MISSING : i;                                  \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_inc_free_old_##T(UHash_##T *h) {                             \
+        p_uhash_free(h->allocator, h->old_keys, h->old_n_buckets * sizeof(uh_key));                 \
+        p_uhash_free(h->allocator, h->old_vals, h->old_n_buckets * sizeof(uh_val));                 \
+        p_uhash_free(h->allocator, h->old_flags, p_uhf_size(h->old_n_buckets) * sizeof(uint32_t));  \
+        h->old_keys = NULL;                                                                         \
+        h->old_vals = NULL;                                                                         \
+        h->old_flags = NULL;                                                                        \
+        h->old_n_buckets = h->old_pos = 0;                                                          \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_inc_migrate_##T(UHash_##T *h, uhash_uint j) {          \
+        /* Keys are unique across both tables: take the first free bucket. */                       \
+        uhash_uint const mask = h->n_buckets - 1;                                                   \
+        uhash_uint i = (uhash_uint)(hash_func(h->old_keys[j])) & mask;                              \
+        uhash_uint step = 0;                                                                        \
+                                                                                                    \
+        while (!p_uhf_iseither(h->flags, i)) i = (i + (++step)) & mask;                             \
+        if (p_uhf_isempty(h->flags, i)) h->n_occupied++;                                            \
+                                                                                                    \
+        p_uhf_set_isboth_false(h->flags, i);                                                        \
+        h->keys[i] = h->old_keys[j];                                                                \
+        if (h->old_vals) h->vals[i] = h->old_vals[j];                                               \
+        p_uhf_set_isdel_true(h->old_flags, j);                                                      \
+                                                                                                    \
+        return i;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_inc_step_##T(UHash_##T *h, uhash_uint n) {                   \
+        if (!h->old_flags) return;                                                                  \
+        p_uhash_timer_start(t0);                                                                    \
+                                                                                                    \
+        /* The fewer buckets of shrinking tables fill up faster, so walk the old ones faster. */    \
+        if (h->old_n_buckets > h->n_buckets) {                                                      \
+            uhash_uint const ratio = h->old_n_buckets / h->n_buckets;                               \
+            n = n > UHASH_UINT_MAX / ratio ? UHASH_UINT_MAX : (uhash_uint)(n * ratio);              \
+        }                                                                                           \
+                                                                                                    \
+        uhash_uint const end = h->old_n_buckets - h->old_pos > n ? h->old_pos + n                   \
+                                                                 : h->old_n_buckets;                \
+        for (; h->old_pos != end; ++h->old_pos) {                                                   \
+            if (!p_uhf_iseither(h->old_flags, h->old_pos)) p_uhash_inc_migrate_##T(h, h->old_pos);  \
+        }                                                                                           \
+                                                                                                    \
+        if (h->old_pos == h->old_n_buckets) p_uhash_inc_free_old_##T(h);                            \
+        p_uhash_count_time(h, t0);                                                                  \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_inc_start_##T(UHash_##T *h, uhash_uint new_n_buckets) { \
+        p_uhash_uint_next_power_2(new_n_buckets);                                                   \
+        if (new_n_buckets < 4) new_n_buckets = 4;                                                   \
+                                                                                                    \
+        /* Requested size is too small. */                                                          \
+        if (h->count >= p_uhash_upper_bound(h, new_n_buckets)) return UHASH_OK;                     \
+                                                                                                    \
+        uhash_uint const n_flags = p_uhf_size(new_n_buckets);                                       \
+        uint32_t *new_flags = p_uhash_malloc(h->allocator, n_flags * sizeof(uint32_t));             \
+        uh_key *new_keys = p_uhash_malloc(h->allocator, new_n_buckets * sizeof(uh_key));            \
+        uh_val *new_vals = h->vals ? p_uhash_malloc(h->allocator, new_n_buckets * sizeof(uh_val))   \
+                                   : NULL;                                                          \
+                                                                                                    \
+        if (!(new_flags && new_keys && (new_vals || !h->vals))) {                                   \
+            p_uhash_free(h->allocator, new_flags, p_uhf_size(new_n_buckets) * sizeof(uint32_t));    \
+            p_uhash_free(h->allocator, new_keys, new_n_buckets * sizeof(uh_key));                   \
+            p_uhash_free(h->allocator, new_vals, new_n_buckets * sizeof(uh_val));                   \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        memset(new_flags, 0xaa, n_flags * sizeof(uint32_t));                                        \
+                                                                                                    \
+        if (h->count) {                                                                             \
+            /* The current buckets are migrated by subsequent operations. */                        \
+            h->old_flags = h->flags;                                                                \
+            h->old_keys = h->keys;                                                                  \
+            h->old_vals = h->vals;                                                                  \
+            h->old_n_buckets = h->n_buckets;                                                        \
+            h->old_pos = 0;                                                                         \
+        } else {                                                                                    \
+            p_uhash_free(h->allocator, h->flags, p_uhf_size(h->n_buckets) * sizeof(uint32_t));      \
+            p_uhash_free(h->allocator, h->keys, h->n_buckets * sizeof(uh_key));                     \
+            p_uhash_free(h->allocator, h->vals, h->n_buckets * sizeof(uh_val));                     \
+        }                                                                                           \
+                                                                                                    \
+        h->flags = new_flags;                                                                       \
+        h->keys = new_keys;                                                                         \
+        h->vals = new_vals;                                                                         \
+        h->n_buckets = new_n_buckets;                                                               \
+        h->max_occupied = p_uhash_upper_bound(h, h->n_buckets);                                     \
+        h->n_occupied = 0;                                                                          \
+        h->removed = false;                                                                         \
+        p_uhash_count(h, rehashes, 1);                                                              \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_rehash_finish_##T(UHash_##T *h) {                                              \
+        p_uhash_inc_step_##T(h, UHASH_INDEX_MISSING);                                               \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_free_##T(UHash_##T *h) {                                                       \
+        if (!h) return;                                                                             \
+        UHashAllocator const *a = h->allocator;                                                     \
+        p_uhash_inc_free_old_##T(h);                                                                \
+        p_uhash_free(a, h->keys, h->n_buckets * sizeof(uh_key));                                    \
+        p_uhash_free(a, h->vals, h->n_buckets * sizeof(uh_val));                                    \
+        p_uhash_free(a, h->flags, p_uhf_size(h->n_buckets) * sizeof(uint32_t));                     \
+        p_uhash_free(a, h, sizeof(*h));                                                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest) {                  \
+        p_uhash_iter_prepare_##T(src);                                                              \
+        p_uhash_inc_free_old_##T(dest);                                                             \
+                                                                                                    \
+        uhash_ret ret = UHASH_OK;                                                                   \
+        uhash_uint n_buckets = src->n_buckets;                                                      \
+        uhash_uint n_flags = p_uhf_size(n_buckets);                                                 \
+                                                                                                    \
+        uint32_t *new_flags = p_uhash_realloc(dest->allocator, dest->flags,                         \
+                                              p_uhf_size(dest->n_buckets) * sizeof(uint32_t),       \
+                                              n_flags * sizeof(uint32_t));                          \
+        uh_key *new_keys = p_uhash_realloc(dest->allocator, dest->keys,                             \
+                                           dest->n_buckets * sizeof(uh_key),                        \
+                                           n_buckets * sizeof(uh_key));                             \
+                                                                                                    \
+        /* Values are not copied, but the buckets of maps must have room for them. */               \
+        uh_val *new_vals = NULL;                                                                    \
+                                                                                                    \
+        if (dest->vals) {                                                                           \
+            new_vals = p_uhash_realloc(dest->allocator, dest->vals,                                 \
+                                       dest->n_buckets * sizeof(uh_val),                            \
+                                       n_buckets * sizeof(uh_val));                                 \
+            if (new_vals) dest->vals = new_vals;                                                    \
+        }                                                                                           \
+                                                                                                    \
+        if (new_flags && new_keys && (new_vals || !dest->vals)) {                                   \
+            memcpy(new_flags, src->flags, n_flags * sizeof(uint32_t));                              \
+            memcpy(new_keys, src->keys, n_buckets * sizeof(uh_key));                                \
+            dest->flags = new_flags;                                                                \
+            dest->keys = new_keys;                                                                  \
+            dest->n_buckets = n_buckets;                                                            \
+            dest->max_occupied = p_uhash_upper_bound(dest, dest->n_buckets);                        \
+            dest->n_occupied = src->n_occupied;                                                     \
+            dest->count = src->count;                                                               \
+        } else {                                                                                    \
+            ret = UHASH_ERR;                                                                        \
+        }                                                                                           \
+                                                                                                    \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_clear_##T(UHash_##T *h) {                                                      \
+        if (h && h->flags) {                                                                        \
+            p_uhash_inc_free_old_##T(h);                                                            \
+            memset(h->flags, 0xaa, p_uhf_size(h->n_buckets) * sizeof(uint32_t));                    \
+            h->count = h->n_occupied = 0;                                                           \
+            h->removed = false;                                                                     \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_get_h_##T(UHash_##T const *h, uh_key key,              \
+                                                       uhash_uint hash) {                           \
+        p_uhash_count(h, gets, 1);                                                                  \
+        if (!h->n_buckets) return UHASH_INDEX_MISSING;                                              \
+                                                                                                    \
+        /* Lookups advance the migration as well, so they need exclusive access. */                 \
+        UHash_##T *mh = (UHash_##T *)h;                                                             \
+        p_uhash_inc_step_##T(mh, UHASH_INC_STEP);                                                   \
+                                                                                                    \
+        uhash_uint i = p_uhash_inc_find_##T(h, h->flags, h->keys, h->n_buckets, key, hash);         \
+                                                                                                    \
+        if (i == UHASH_INDEX_MISSING && h->old_flags) {                                             \
+            /* Keys found in the old buckets are moved, so that the returned index is valid. */     \
+            i = p_uhash_inc_find_##T(h, h->old_flags, h->old_keys, h->old_n_buckets, key,           \
+                                     hash);                                                         \
+            if (i != UHASH_INDEX_MISSING) i = p_uhash_inc_migrate_##T(mh, i);                       \
+        }                                                                                           \
+                                                                                                    \
+        return i;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets) {                      \
+        /* Explicit resizing is not amortized. */                                                   \
+        uhash_rehash_finish_##T(h);                                                                 \
+        uhash_ret ret = p_uhash_inc_start_##T(h, new_n_buckets);                                    \
+        uhash_rehash_finish_##T(h);                                                                 \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_put_h_##T(UHash_##T *h, uh_key key, uhash_uint hash,    \
+                                                      uhash_uint *idx) {                            \
+        p_uhash_count(h, puts, 1);                                                                  \
+        p_uhash_inc_step_##T(h, UHASH_INC_STEP);                                                    \
+                                                                                                    \
+        /* Keys yet to be migrated count as well, so that finishing the migration never runs        \
+           out of free buckets. */                                                                  \
+        if (h->n_occupied >= h->max_occupied || h->count >= h->max_occupied) {                      \
+            /* Only one migration at a time: only reached if UHASH_INC_STEP is too low. */          \
+            uhash_rehash_finish_##T(h);                                                             \
+            /* Clear deleted buckets if there are enough of them, otherwise expand. */              \
+            uhash_uint const n = p_uhash_should_compact(h) ? h->n_buckets : h->n_buckets + 1;       \
+                                                                                                    \
+            if (p_uhash_inc_start_##T(h, n)) {                                                      \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+        } else if (!h->old_flags && p_uhash_should_shrink(h)) {                                     \
+            /* Shrink the hash table; on failure, keep using the current buckets. */                \
+            (void)p_uhash_inc_start_##T(h, h->count << 1U);                                         \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_analyzer_assert(h->flags);                                                          \
+                                                                                                    \
+        if (h->old_flags) {                                                                         \
+            uhash_uint const j = p_uhash_inc_find_##T(h, h->old_flags, h->old_keys,                 \
+                                                      h->old_n_buckets, key, hash);                 \
+            if (j != UHASH_INDEX_MISSING) {                                                         \
+                uhash_uint const i = p_uhash_inc_migrate_##T(h, j);                                 \
+                if (idx) *idx = i;                                                                  \
+                return UHASH_PRESENT;                                                               \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        uhash_uint const mask = h->n_buckets - 1;                                                   \
+        uhash_uint i = hash & mask;                                                                 \
+        uhash_uint step = 0;                                                                        \
+        uhash_uint site = h->n_buckets;                                                             \
+        uhash_uint const last = i;                                                                  \
+                                                                                                    \
+        while (!p_uhf_isempty(h->flags, i)) {                                                       \
+            if (p_uhf_isdel(h->flags, i)) {                                                         \
+                if (site == h->n_buckets) site = i;                                                 \
+            } else if (equal_func(h->keys[i], key)) {                                               \
+                /* Don't touch h->keys[i] if present and not deleted. */                            \
+                if (idx) *idx = i;                                                                  \
+                return UHASH_PRESENT;                                                               \
+            }                                                                                       \
+            p_uhash_count(h, put_probes, 1);                                                        \
+            i = (i + (++step)) & mask;                                                              \
+            if (i == last) break;                                                                   \
+        }                                                                                           \
+                                                                                                    \
+        if (site == h->n_buckets) {                                                                 \
+            if (!p_uhf_isempty(h->flags, i)) {                                                      \
+                /* Unreachable as long as UHASH_MAX_LOAD is lower than 1. */                        \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+            site = i;                                                                               \
+            h->n_occupied++;                                                                        \
+        }                                                                                           \
+                                                                                                    \
+        h->keys[site] = key;                                                                        \
+        p_uhf_set_isboth_false(h->flags, site);                                                     \
+        h->count++;                                                                                 \
+                                                                                                    \
+        if (idx) *idx = site;                                                                       \
+        return UHASH_INSERTED;                                                                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline unsigned p_uhash_layout_##T(void) {                                       \
+        return P_UHASH_LAYOUT_FLAGS;                                                                \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the number of buckets needed to hold the specified number of keys. */                \
+    p_uhash_static_inline uhash_uint p_uhash_fit_##T(UHash_##T const *h, uhash_uint count) {        \
+        return p_uhash_fit(count, p_uhash_load(h, UHASH_MAX_LOAD));                                 \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_home_##T(UHash_##T const *h, uhash_uint hash) {        \
+        return hash & (h->n_buckets - 1);                                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_key_hash_##T(UHash_##T const *h, UHash_##T const *src, \
+                                                         uhash_uint i) {                            \
+        (void)h;                                                                                    \
+        return (uhash_uint)(hash_func(src->keys[i]));                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the probe length of the key in bucket i. */                                          \
+    p_uhash_static_inline uhash_uint p_uhash_probe_len_##T(UHash_##T const *h, uhash_uint i) {      \
+        uhash_uint const mask = h->n_buckets - 1;                                                   \
+        return p_uhash_tri_dist(p_uhash_key_hash_##T(h, h, i) & mask, i, mask);                     \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline size_t p_uhash_bytes_##T(UHash_##T const *h) {                            \
+        size_t const bucket = sizeof(uh_key) + (h->vals ? sizeof(uh_val) : 0);                      \
+        size_t bytes = h->n_buckets * bucket;                                                       \
+        if (h->n_buckets) bytes += p_uhf_size(h->n_buckets) * sizeof(uint32_t);                     \
+        if (h->old_flags) bytes += p_uhf_size(h->old_n_buckets) * sizeof(uint32_t) +                \
+                                   h->old_n_buckets * bucket;                                       \
+        return bytes;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_prefetch_##T(UHash_##T const *h, uhash_uint hash) {          \
+        if (!h->n_buckets) return;                                                                  \
+        uhash_uint const i = hash & (h->n_buckets - 1);                                             \
+        p_uhash_prefetch(h->flags + (i >> 4U));                                                     \
+        p_uhash_prefetch(h->keys + i);                                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key) {                                \
+        return p_uhash_get_h_##T(h, key, (uhash_uint)(hash_func(key)));                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx) {                      \
+        return p_uhash_put_h_##T(h, key, (uhash_uint)(hash_func(key)), idx);                        \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x) {                                       \
+        if (!p_uhf_iseither(h->flags, x)) {                                                         \
+            p_uhf_set_isdel_true(h->flags, x);                                                      \
+            h->count--;                                                                             \
+            h->removed = true;                                                                      \
+        }                                                                                           \
+        p_uhash_inc_step_##T(h, UHASH_INC_STEP);                                                    \
+    }
+
+/*
+ * Generates core function definitions for the specified hash table type
+ * (Robin Hood probing with backward-shift deletion).
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ */
+#define P_UHASH_IMPL_CORE_RH(T, SCOPE, uh_key, uh_val, hash_func, equal_func)                       \
+    P_UHASH_IMPL_STORAGE_BYTES(T, SCOPE, uh_key, uh_val, storage)                                   \
+                                                                                                    \
+    P_UHASH_IMPL_REFS(T)                                                                            \
+    P_UHASH_IMPL_VALS(T, uh_val, P_UHASH_VS_PLAIN)                                                  \
+                                                                                                    \
+    p_uhash_static_inline bool p_uhash_shareable_##T(UHash_##T const *h) {                          \
+        /* Inline buckets are part of the table. */                                                 \
+        return !p_uhash_storage_inline_##T(h);                                                      \
+    }                                                                                               \
+                                                                                                    \
+    /* Gives the table its own buckets if they are shared, copying their contents if requested. */  \
+    p_uhash_static_inline uhash_ret p_uhash_unshare_##T(UHash_##T *h, bool copy) {                  \
+        if (!p_uhash_shared_##T(h)) return UHASH_OK;                                                \
+                                                                                                    \
+        uhash_uint const n = h->n_buckets;                                                          \
+        uint8_t *flags;                                                                             \
+        uh_key *keys;                                                                               \
+        uh_val *vals;                                                                               \
+                                                                                                    \
+        if (p_uhash_storage_alloc_##T(h, n, h->vals != NULL, &flags, &keys, &vals)) {               \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (copy) {                                                                                 \
+            memcpy(flags, h->flags, n);                                                             \
+            memcpy(keys, h->keys, n * sizeof(uh_key));                                              \
+            if (vals) memcpy(vals, h->vals, n * sizeof(uh_val));                                    \
+        }                                                                                           \
+                                                                                                    \
+        if (p_uhash_unref_##T(h)) p_uhash_storage_free_##T(h, n, h->flags, h->keys, h->vals);       \
+        h->flags = flags;                                                                           \
+        h->keys = keys;                                                                             \
+        h->vals = vals;                                                                             \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_free_##T(UHash_##T *h) {                                                       \
+        if (!h) return;                                                                             \
+        UHashAllocator const *a = h->allocator;                                                     \
+        if (p_uhash_unref_##T(h)) {                                                                 \
+            p_uhash_storage_free_##T(h, h->n_buckets, h->flags, h->keys, h->vals);                  \
+        }                                                                                           \
+        p_uhash_free(a, h, sizeof(*h));                                                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest) {                  \
+        uhash_uint n_buckets = src->n_buckets;                                                      \
+                                                                                                    \
+        /* Buckets of the same size are reused, unless they are shared. */                          \
+        if (n_buckets != dest->n_buckets || !dest->keys || p_uhash_shared_##T(dest)) {              \
+            uint8_t *new_flags;                                                                     \
+            uh_key *new_keys;                                                                       \
+            uh_val *new_vals;                                                                       \
+                                                                                                    \
+            /* Values are not copied, but the buckets of maps must have room for them. */           \
+            if (p_uhash_storage_alloc_##T(dest, n_buckets, dest->vals != NULL,                      \
+                                          &new_flags, &new_keys, &new_vals)) {                      \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+                                                                                                    \
+            if (p_uhash_unref_##T(dest)) {                                                          \
+                p_uhash_storage_free_##T(dest, dest->n_buckets, dest->flags, dest->keys,            \
+                                         dest->vals);                                               \
+            }                                                                                       \
+                                                                                                    \
+            dest->flags = new_flags;                                                                \
+            dest->keys = new_keys;                                                                  \
+            dest->vals = new_vals;                                                                  \
+            dest->n_buckets = n_buckets;                                                            \
+            dest->max_occupied = p_uhash_upper_bound(dest, dest->n_buckets);                        \
+        }                                                                                           \
+                                                                                                    \
+        if (n_buckets) {                                                                            \
+            memcpy(dest->flags, src->flags, n_buckets);                                             \
+            memcpy(dest->keys, src->keys, n_buckets * sizeof(uh_key));                              \
+        }                                                                                           \
+                                                                                                    \
+        dest->n_occupied = src->n_occupied;                                                         \
+        dest->count = src->count;                                                                   \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_clear_##T(UHash_##T *h) {                                                      \
+        if (h && h->flags && !p_uhash_unshare_##T(h, false)) {                                      \
+            memset(h->flags, P_UHC_EMPTY, h->n_buckets);                                            \
+            h->count = h->n_occupied = 0;                                                           \
+            h->removed = false;                                                                     \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_get_h_##T(UHash_##T const *h, uh_key key,              \
+                                                       uhash_uint hash) {                           \
+        p_uhash_count(h, gets, 1);                                                                  \
+        if (!h->n_buckets) return UHASH_INDEX_MISSING;                                              \
+                                                                                                    \
+        uhash_uint const mask = h->n_buckets - 1;                                                   \
+        uhash_uint i = hash & mask;                                                                 \
+                                                                                                    \
+        /* Probing stops at the first bucket whose key is closer to its home than ours would be. */ \
+        for (uint8_t d = 0; p_uhc_isfull(h->flags, i) && h->flags[i] >= d; ++d) {                   \
+            if (h->flags[i] == d && equal_func(h->keys[i], key)) return i;                          \
+            p_uhash_count(h, get_probes, 1);                                                        \
+            i = (i + 1) & mask;                                                                     \
+        }                                                                                           \
+                                                                                                    \
+        return UHASH_INDEX_MISSING;                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets) {                      \
+        p_uhash_uint_next_power_2(new_n_buckets);                                                   \
+        if (new_n_buckets < 4) new_n_buckets = 4;                                                   \
+                                                                                                    \
+        /* Requested size is too small. */                                                          \
+        if (h->count >= p_uhash_upper_bound(h, new_n_buckets)) return UHASH_OK;                     \
+                                                                                                    \
+        uint8_t *new_flags;                                                                         \
+        uh_key *new_keys;                                                                           \
+        uh_val *new_vals;                                                                           \
+                                                                                                    \
+        if (p_uhash_storage_alloc_##T(h, new_n_buckets, h->vals != NULL,                            \
+                                      &new_flags, &new_keys, &new_vals)) {                          \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_timer_start(t0);                                                                    \
+        memset(new_flags, P_UHC_EMPTY, new_n_buckets);                                              \
+        uhash_uint const mask = new_n_buckets - 1;                                                  \
+                                                                                                    \
+        p_uhash_for_buckets(h, j) {                                                                 \
+            uh_key key = h->keys[j];                                                                \
+            uh_val val = {0};                                                                       \
+            if (h->vals) val = h->vals[j];                                                          \
+            uhash_uint i = (uhash_uint)(hash_func(key)) & mask;                                     \
+            uint8_t d = 0;                                                                          \
+                                                                                                    \
+            /* Keys are unique: swap with richer keys until reaching an empty bucket. */            \
+            while (p_uhc_isfull(new_flags, i)) {                                                    \
+                if (new_flags[i] < d) {                                                             \
+                    { uint8_t tmp = new_flags[i]; new_flags[i] = d; d = tmp; }                      \
+                    { uh_key tmp = new_keys[i]; new_keys[i] = key; key = tmp; }                     \
+                    if (new_vals) { uh_val tmp = new_vals[i]; new_vals[i] = val; val = tmp; }       \
+                }                                                                                   \
+                i = (i + 1) & mask;                                                                 \
+                                                                                                    \
+                if (++d > P_UHR_MAX_DIST) {                                                         \
+                    /* Probe sequence too long to be stored: retry with more buckets, unless        \
+                     * they are sparse, meaning that too many keys share the same home. */          \
+                    p_uhash_storage_free_##T(h, new_n_buckets, new_flags, new_keys, new_vals);      \
+                    if (h->count < p_uhash_upper_bound(h, new_n_buckets) / 2) return UHASH_ERR;     \
+                    return uhash_resize_##T(h, new_n_buckets + 1);                                  \
+                }                                                                                   \
+            }                                                                                       \
+                                                                                                    \
+            new_flags[i] = d;                                                                       \
+            new_keys[i] = key;                                                                      \
+            if (new_vals) new_vals[i] = val;                                                        \
+        }                                                                                           \
+                                                                                                    \
+        /* Shared buckets are left to the other clones. */                                          \
+        if (p_uhash_unref_##T(h)) {                                                                 \
+            p_uhash_storage_free_##T(h, h->n_buckets, h->flags, h->keys, h->vals);                  \
+        }                                                                                           \
+                                                                                                    \
+        h->flags = new_flags;                                                                       \
+        h->keys = new_keys;                                                                         \
+        h->vals = new_vals;                                                                         \
+        h->n_buckets = new_n_buckets;                                                               \
+        h->max_occupied = p_uhash_upper_bound(h, h->n_buckets);                                     \
+        h->n_occupied = h->count;                                                                   \
+        h->removed = false;                                                                         \
+        p_uhash_count(h, rehashes, 1);                                                              \
+        p_uhash_count_time(h, t0);                                                                  \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_put_h_##T(UHash_##T *h, uh_key key, uhash_uint hash,    \
+                                                      uhash_uint *idx) {                            \
+        p_uhash_count(h, puts, 1);                                                                  \
+        if (h->n_occupied >= h->max_occupied) {                                                     \
+            if (uhash_resize_##T(h, h->n_buckets + 1)) {                                            \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+        } else if (p_uhash_should_shrink(h)) {                                                      \
+            /* Shrink the hash table; on failure, keep using the current buckets. */                \
+            (void)uhash_resize_##T(h, h->count << 1U);                                              \
+        }                                                                                           \
+                                                                                                    \
+        if (p_uhash_unshare_##T(h, true)) {                                                         \
+            if (idx) *idx = UHASH_INDEX_MISSING;                                                    \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_analyzer_assert(h->flags);                                                          \
+                                                                                                    \
+        uhash_uint const mask = h->n_buckets - 1;                                                   \
+        uhash_uint i = hash & mask;                                                                 \
+        uint8_t d = 0;                                                                              \
+                                                                                                    \
+        for (; p_uhc_isfull(h->flags, i) && h->flags[i] >= d; ++d) {                                \
+            if (h->flags[i] == d && equal_func(h->keys[i], key)) {                                  \
+                /* Don't touch h->keys[i] if present. */                                            \
+                if (idx) *idx = i;                                                                  \
+                return UHASH_PRESENT;                                                               \
+            }                                                                                       \
+            p_uhash_count(h, put_probes, 1);                                                        \
+            i = (i + 1) & mask;                                                                     \
+        }                                                                                           \
+                                                                                                    \
+        /* The key goes in bucket i, and the run of keys starting there is shifted right. */        \
+        uhash_uint e = i;                                                                           \
+        bool overflow = d > P_UHR_MAX_DIST;                                                         \
+                                                                                                    \
+        for (; !overflow && p_uhc_isfull(h->flags, e); e = (e + 1) & mask) {                        \
+            overflow = h->flags[e] == P_UHR_MAX_DIST;                                               \
+        }                                                                                           \
+                                                                                                    \
+        if (overflow) {                                                                             \
+            /* Probe sequence too long to be stored: grow the hash table and retry,                 \
+             * unless it is sparse, meaning that too many keys share the same home. */              \
+            uhash_uint const n_buckets = h->n_buckets;                                              \
+            if (h->count < h->max_occupied / 2 || uhash_resize_##T(h, n_buckets + 1) ||             \
+                h->n_buckets == n_buckets) {                                                        \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+            return p_uhash_put_h_##T(h, key, hash, idx);                                            \
+        }                                                                                           \
+                                                                                                    \
+        for (uhash_uint j = e; j != i; j = (j - 1) & mask) {                                        \
+            uhash_uint const p = (j - 1) & mask;                                                    \
+            h->flags[j] = (uint8_t)(h->flags[p] + 1);                                               \
+            h->keys[j] = h->keys[p];                                                                \
+            if (h->vals) h->vals[j] = h->vals[p];                                                   \
+        }                                                                                           \
+                                                                                                    \
+        h->flags[i] = d;                                                                            \
+        h->keys[i] = key;                                                                           \
+        h->count++;                                                                                 \
+        h->n_occupied++;                                                                            \
+                                                                                                    \
+        if (idx) *idx = i;                                                                          \
+        return UHASH_INSERTED;                                                                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline unsigned p_uhash_layout_##T(void) {                                       \
+        return P_UHASH_LAYOUT_RH;                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the number of buckets needed to hold the specified number of keys. */                \
+    p_uhash_static_inline uhash_uint p_uhash_fit_##T(UHash_##T const *h, uhash_uint count) {        \
+        return p_uhash_fit(count, p_uhash_load(h, UHASH_MAX_LOAD));                                 \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_home_##T(UHash_##T const *h, uhash_uint hash) {        \
+        return hash & (h->n_buckets - 1);                                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_key_hash_##T(UHash_##T const *h, UHash_##T const *src, \
+                                                         uhash_uint i) {                            \
+        (void)h;                                                                                    \
+        return (uhash_uint)(hash_func(src->keys[i]));                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the probe length of the key in bucket i. */                                          \
+    p_uhash_static_inline uhash_uint p_uhash_probe_len_##T(UHash_##T const *h, uhash_uint i) {      \
+        /* Probe lengths are stored in the metadata bytes. */                                       \
+        return h->flags[i];                                                                         \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline size_t p_uhash_bytes_##T(UHash_##T const *h) {                            \
+        return h->n_buckets * (1 + sizeof(uh_key) + (h->vals ? sizeof(uh_val) : 0));                \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_prefetch_##T(UHash_##T const *h, uhash_uint hash) {          \
+        if (!h->n_buckets) return;                                                                  \
+        uhash_uint const i = hash & (h->n_buckets - 1);                                             \
+        p_uhash_prefetch(h->flags + i);                                                             \
+        p_uhash_prefetch(h->keys + i);                                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key) {                                \
+        return p_uhash_get_h_##T(h, key, (uhash_uint)(hash_func(key)));                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx) {                      \
+        return p_uhash_put_h_##T(h, key, (uhash_uint)(hash_func(key)), idx);                        \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x) {                                       \
+        if (!p_uhc_isfull(h->flags, x) || p_uhash_unshare_##T(h, true)) return;                     \
+                                                                                                    \
+        /* Backward-shift deletion: the following keys move closer to their home bucket. */         \
+        uhash_uint const mask = h->n_buckets - 1;                                                   \
+        uhash_uint next = (x + 1) & mask;                                                           \
+                                                                                                    \
+        while (p_uhc_isfull(h->flags, next) && h->flags[next]) {                                    \
+            h->flags[x] = (uint8_t)(h->flags[next] - 1);                                            \
+            h->keys[x] = h->keys[next];                                                             \
+            if (h->vals) h->vals[x] = h->vals[next];                                                \
+            x = next;                                                                               \
+            next = (next + 1) & mask;                                                               \
+        }                                                                                           \
+                                                                                                    \
+        h->flags[x] = P_UHC_EMPTY;                                                                  \
+        h->count--;                                                                                 \
+        h->removed = true;                                                                          \
+        h->n_occupied--;                                                                            \
+    }
+
+/*
+ * Generates core function definitions for the specified hash table type
+ * (2-choice bucketized cuckoo hashing with a stash).
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ */
+#define P_UHASH_IMPL_CORE_CUCKOO(T, SCOPE, uh_key, uh_val, hash_func, equal_func)                   \
+    P_UHASH_IMPL_STORAGE_BYTES(T, SCOPE, uh_key, uh_val, storage)                                   \
+                                                                                                    \
+    P_UHASH_IMPL_REFS(T)                                                                            \
+    P_UHASH_IMPL_VALS(T, uh_val, P_UHASH_VS_PLAIN)                                                  \
+                                                                                                    \
+    p_uhash_static_inline bool p_uhash_shareable_##T(UHash_##T const *h) {                          \
+        /* Inline buckets are part of the table. */                                                 \
+        return !p_uhash_storage_inline_##T(h);                                                      \
+    }                                                                                               \
+                                                                                                    \
+    /* Gives the table its own buckets if they are shared, copying their contents if requested. */  \
+    p_uhash_static_inline uhash_ret p_uhash_unshare_##T(UHash_##T *h, bool copy) {                  \
+        if (!p_uhash_shared_##T(h)) return UHASH_OK;                                                \
+                                                                                                    \
+        uhash_uint const n = h->n_buckets;                                                          \
+        uint8_t *flags;                                                                             \
+        uh_key *keys;                                                                               \
+        uh_val *vals;                                                                               \
+                                                                                                    \
+        if (p_uhash_storage_alloc_##T(h, n, h->vals != NULL, &flags, &keys, &vals)) {               \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (copy) {                                                                                 \
+            memcpy(flags, h->flags, n);                                                             \
+            memcpy(keys, h->keys, n * sizeof(uh_key));                                              \
+            if (vals) memcpy(vals, h->vals, n * sizeof(uh_val));                                    \
+        }                                                                                           \
+                                                                                                    \
+        if (p_uhash_unref_##T(h)) p_uhash_storage_free_##T(h, n, h->flags, h->keys, h->vals);       \
+        h->flags = flags;                                                                           \
+        h->keys = keys;                                                                             \
+        h->vals = vals;                                                                             \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_free_##T(UHash_##T *h) {                                                       \
+        if (!h) return;                                                                             \
+        UHashAllocator const *a = h->allocator;                                                     \
+        if (p_uhash_unref_##T(h)) {                                                                 \
+            p_uhash_storage_free_##T(h, h->n_buckets, h->flags, h->keys, h->vals);                  \
+        }                                                                                           \
+        p_uhash_free(a, h, sizeof(*h));                                                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest) {                  \
+        uhash_uint n_buckets = src->n_buckets;                                                      \
+                                                                                                    \
+        /* Buckets of the same size are reused, unless they are shared. */                          \
+        if (n_buckets != dest->n_buckets || !dest->keys || p_uhash_shared_##T(dest)) {              \
+            uint8_t *new_flags;                                                                     \
+            uh_key *new_keys;                                                                       \
+            uh_val *new_vals;                                                                       \
+                                                                                                    \
+            /* Values are not copied, but the buckets of maps must have room for them. */           \
+            if (p_uhash_storage_alloc_##T(dest, n_buckets, dest->vals != NULL,                      \
+                                          &new_flags, &new_keys, &new_vals)) {                      \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+                                                                                                    \
+            if (p_uhash_unref_##T(dest)) {                                                          \
+                p_uhash_storage_free_##T(dest, dest->n_buckets, dest->flags, dest->keys,            \
+                                         dest->vals);                                               \
+            }                                                                                       \
+                                                                                                    \
+            dest->flags = new_flags;                                                                \
+            dest->keys = new_keys;                                                                  \
+            dest->vals = new_vals;                                                                  \
+            dest->n_buckets = n_buckets;                                                            \
+            dest->max_occupied = p_uhash_cuckoo_upper_bound(dest, dest->n_buckets);                 \
+        }                                                                                           \
+                                                                                                    \
+        if (n_buckets) {                                                                            \
+            memcpy(dest->flags, src->flags, n_buckets);                                             \
+            memcpy(dest->keys, src->keys, n_buckets * sizeof(uh_key));                              \
+        }                                                                                           \
+                                                                                                    \
+        dest->n_occupied = src->n_occupied;                                                         \
+        dest->count = src->count;                                                                   \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_clear_##T(UHash_##T *h) {                                                      \
+        if (h && h->flags && !p_uhash_unshare_##T(h, false)) {                                      \
+            memset(h->flags, P_UHC_EMPTY, h->n_buckets);                                            \
+            h->count = h->n_occupied = 0;                                                           \
+            h->removed = false;                                                                     \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the bucket of the key in group g, or UHASH_INDEX_MISSING if it is not there. */      \
+    p_uhash_static_inline uhash_uint p_uhash_cuckoo_find_##T(UHash_##T const *h, uh_key key,        \
+                                                            uhash_uint g, uint8_t tag) {            \
+        uhash_uint const first = g * P_UHK_SLOTS;                                                   \
+        for (uint32_t m = p_uhk_match(h->flags + first, tag); m; m &= m - 1) {                      \
+            uhash_uint const i = first + p_uhash_ctz32(m);                                          \
+            if (equal_func(h->keys[i], key)) return i;                                              \
+        }                                                                                           \
+        return UHASH_INDEX_MISSING;                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    /* Looks the key up in its groups, then in the stash, counting the extra groups probed. */      \
+    p_uhash_static_inline uhash_uint p_uhash_cuckoo_lookup_##T(UHash_##T const *h, uh_key key,      \
+                                                              uhash_uint hash,                      \
+                                                              uhash_uint *probes) {                 \
+        uhash_uint const mask = p_uhk_mask(h->n_buckets);                                           \
+        uhash_uint const g1 = hash & mask, g2 = p_uhk_alt(hash, mask);                              \
+        uint8_t const tag = p_uhc_tag(hash);                                                        \
+                                                                                                    \
+        uhash_uint i = p_uhash_cuckoo_find_##T(h, key, g1, tag);                                    \
+        if (i != UHASH_INDEX_MISSING) return i;                                                     \
+                                                                                                    \
+        *probes = 1;                                                                                \
+        i = p_uhash_cuckoo_find_##T(h, key, g2, tag);                                               \
+        if (i != UHASH_INDEX_MISSING) return i;                                                     \
+                                                                                                    \
+        /* Keys are only stashed if both of their groups are full. */                               \
+        if (p_uhk_match_free(p_uhk_group(h->flags, g1)) ||                                          \
+            p_uhk_match_free(p_uhk_group(h->flags, g2))) {                                          \
+            return UHASH_INDEX_MISSING;                                                             \
+        }                                                                                           \
+                                                                                                    \
+        *probes = 2;                                                                                \
+        return p_uhash_cuckoo_find_##T(h, key, mask + 1, tag);                                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_get_h_##T(UHash_##T const *h, uh_key key,              \
+                                                       uhash_uint hash) {                           \
+        p_uhash_count(h, gets, 1);                                                                  \
+        if (!h->n_buckets) return UHASH_INDEX_MISSING;                                              \
+                                                                                                    \
+        uhash_uint probes = 0;                                                                      \
+        uhash_uint const i = p_uhash_cuckoo_lookup_##T(h, key, hash, &probes);                      \
+        p_uhash_count(h, get_probes, probes);                                                       \
+        return i;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    /*                                                                                              \
+     * Places a missing key in the specified buckets, storing the index of its bucket in idx.       \
+     * If both groups of the key are full, keys are displaced to their other group,                 \
+     * evicting random keys, and the last displaced key is stashed after P_UHK_MAX_KICKS            \
+     * evictions. Returns false, leaving the buckets untouched, if the stash is full as well.       \
+     */                                                                                             \
+    p_uhash_static_inline bool p_uhash_cuckoo_place_##T(uint8_t *flags, uh_key *keys,               \
+                                                        uh_val *vals, uhash_uint n_groups,          \
+                                                        uh_key key, uh_val const *val,              \
+                                                        uhash_uint hash, uhash_uint *idx) {         \
+        uhash_uint const mask = n_groups - 1;                                                       \
+        uhash_uint const g1 = hash & mask, g2 = p_uhk_alt(hash, mask);                              \
+        uint32_t const free1 = p_uhk_match_free(p_uhk_group(flags, g1));                            \
+        uint32_t const free2 = p_uhk_match_free(p_uhk_group(flags, g2));                            \
+        uint32_t const stash_free = p_uhk_match_free(p_uhk_group(flags, n_groups));                 \
+                                                                                                    \
+        if (free1 || free2) {                                                                       \
+            /* The emptier group is picked, which keeps groups balanced. */                         \
+            bool const first = p_uhash_popcount32(free1) >= p_uhash_popcount32(free2);              \
+            uhash_uint const x = (first ? g1 : g2) * P_UHK_SLOTS +                                  \
+                                 p_uhash_ctz32(first ? free1 : free2);                              \
+            flags[x] = p_uhc_tag(hash);                                                             \
+            keys[x] = key;                                                                          \
+            if (vals && val) vals[x] = *val;                                                        \
+            *idx = x;                                                                               \
+            return true;                                                                            \
+        }                                                                                           \
+                                                                                                    \
+        if (!stash_free) return false;                                                              \
+                                                                                                    \
+        /* A random key of either group makes room for the inserted one. */                         \
+        uint32_t r = (uint32_t)hash * 1103515245U + 12345U;                                         \
+        uhash_uint const x = (r >> 31U ? g2 : g1) * P_UHK_SLOTS + (r >> 16U) % P_UHK_SLOTS;         \
+        uh_key carry = keys[x];                                                                     \
+        uh_val carry_val = {0};                                                                     \
+        if (vals) carry_val = vals[x];                                                              \
+                                                                                                    \
+        flags[x] = p_uhc_tag(hash);                                                                 \
+        keys[x] = key;                                                                              \
+        if (vals && val) vals[x] = *val;                                                            \
+        *idx = x;                                                                                   \
+                                                                                                    \
+        /* Each evicted key moves to its other group, evicting a random key if it is full. */       \
+        uhash_uint i = x;                                                                           \
+        uhash_uint carry_hash = (uhash_uint)(hash_func(carry));                                     \
+                                                                                                    \
+        for (unsigned kicks = 0;; ++kicks) {                                                        \
+            uhash_uint g = carry_hash & mask;                                                       \
+            if (g == i / P_UHK_SLOTS) g = p_uhk_alt(carry_hash, mask);                              \
+            uint32_t const m = p_uhk_match_free(p_uhk_group(flags, g));                             \
+                                                                                                    \
+            if (m) {                                                                                \
+                i = g * P_UHK_SLOTS + p_uhash_ctz32(m);                                             \
+                break;                                                                              \
+            }                                                                                       \
+                                                                                                    \
+            if (kicks == P_UHK_MAX_KICKS) {                                                         \
+                /* Both groups of the key are full, as the stash requires. */                       \
+                i = n_groups * P_UHK_SLOTS + p_uhash_ctz32(stash_free);                             \
+                break;                                                                              \
+            }                                                                                       \
+                                                                                                    \
+            /* The inserted key is never evicted. */                                                \
+            r = r * 1103515245U + 12345U;                                                           \
+            i = g * P_UHK_SLOTS + (r >> 16U) % P_UHK_SLOTS;                                         \
+            if (i == x) i = g * P_UHK_SLOTS + (i + 1) % P_UHK_SLOTS;                                \
+                                                                                                    \
+            flags[i] = p_uhc_tag(carry_hash);                                                       \
+            { uh_key tmp = keys[i]; keys[i] = carry; carry = tmp; }                                 \
+            if (vals) { uh_val tmp = vals[i]; vals[i] = carry_val; carry_val = tmp; }               \
+            carry_hash = (uhash_uint)(hash_func(carry));                                            \
+        }                                                                                           \
+                                                                                                    \
+        flags[i] = p_uhc_tag(carry_hash);                                                           \
+        keys[i] = carry;                                                                            \
+        if (vals) vals[i] = carry_val;                                                              \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets) {                      \
+        /* Buckets are split into a power of 2 of groups, at least two, followed by the stash. */   \
+        uhash_uint n_groups = new_n_buckets > 2 * P_UHK_SLOTS                                       \
+                            ? (new_n_buckets - 1) / P_UHK_SLOTS : 2;                                \
+        p_uhash_uint_next_power_2(n_groups);                                                        \
+        if (n_groups > P_UHK_MAX_GROUPS) n_groups = P_UHK_MAX_GROUPS;                               \
+        new_n_buckets = (n_groups + 1) * P_UHK_SLOTS;                                               \
+                                                                                                    \
+        /* Requested size is too small. */                                                          \
+        if (h->n_buckets && h->count >= p_uhash_cuckoo_upper_bound(h, new_n_buckets)) {             \
+            return UHASH_OK;                                                                        \
+        }                                                                                           \
+                                                                                                    \
+        uint8_t *new_flags;                                                                         \
+        uh_key *new_keys;                                                                           \
+        uh_val *new_vals;                                                                           \
+                                                                                                    \
+        if (p_uhash_storage_alloc_##T(h, new_n_buckets, h->vals != NULL,                            \
+                                      &new_flags, &new_keys, &new_vals)) {                          \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_timer_start(t0);                                                                    \
+        memset(new_flags, P_UHC_EMPTY, new_n_buckets);                                              \
+                                                                                                    \
+        p_uhash_for_buckets(h, j) {                                                                 \
+            uh_key const key = h->keys[j];                                                          \
+            uhash_uint i;                                                                           \
+                                                                                                    \
+            if (!p_uhash_cuckoo_place_##T(new_flags, new_keys, new_vals, n_groups, key,             \
+                                          h->vals ? h->vals + j : NULL,                             \
+                                          (uhash_uint)(hash_func(key)), &i)) {                      \
+                /* Retry with more buckets, unless there are already plenty of them. */             \
+                p_uhash_storage_free_##T(h, new_n_buckets, new_flags, new_keys, new_vals);          \
+                if (n_groups == P_UHK_MAX_GROUPS ||                                                 \
+                    h->count < p_uhash_cuckoo_upper_bound(h, new_n_buckets) / 2) {                  \
+                    return UHASH_ERR;                                                               \
+                }                                                                                   \
+                return uhash_resize_##T(h, new_n_buckets + 1);                                      \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        /* Shared buckets are left to the other clones. */                                          \
+        if (p_uhash_unref_##T(h)) {                                                                 \
+            p_uhash_storage_free_##T(h, h->n_buckets, h->flags, h->keys, h->vals);                  \
+        }                                                                                           \
+                                                                                                    \
+        h->flags = new_flags;                                                                       \
+        h->keys = new_keys;                                                                         \
+        h->vals = new_vals;                                                                         \
+        h->n_buckets = new_n_buckets;                                                               \
+        h->max_occupied = p_uhash_cuckoo_upper_bound(h, h->n_buckets);                              \
+        h->n_occupied = h->count;                                                                   \
+        h->removed = false;                                                                         \
+        p_uhash_count(h, rehashes, 1);                                                              \
+        p_uhash_count_time(h, t0);                                                                  \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_put_h_##T(UHash_##T *h, uh_key key, uhash_uint hash,    \
+                                                      uhash_uint *idx) {                            \
+        p_uhash_count(h, puts, 1);                                                                  \
+        if (h->n_occupied >= h->max_occupied) {                                                     \
+            if (uhash_resize_##T(h, h->n_buckets + 1)) {                                            \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+        } else if (p_uhash_should_shrink(h)) {                                                      \
+            /* Shrink the hash table, which keeps at least two groups and the stash. */             \
+            (void)uhash_resize_##T(h, h->count << 1U);                                              \
+        }                                                                                           \
+                                                                                                    \
+        if (p_uhash_unshare_##T(h, true)) {                                                         \
+            if (idx) *idx = UHASH_INDEX_MISSING;                                                    \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_analyzer_assert(h->flags);                                                          \
+                                                                                                    \
+        uhash_uint probes = 0;                                                                      \
+        uhash_uint i = p_uhash_cuckoo_lookup_##T(h, key, hash, &probes);                            \
+        p_uhash_count(h, put_probes, probes);                                                       \
+                                                                                                    \
+        if (i != UHASH_INDEX_MISSING) {                                                             \
+            /* Don't touch h->keys[i] if present. */                                                \
+            if (idx) *idx = i;                                                                      \
+            return UHASH_PRESENT;                                                                   \
+        }                                                                                           \
+                                                                                                    \
+        if (!p_uhash_cuckoo_place_##T(h->flags, h->keys, h->vals, p_uhk_mask(h->n_buckets) + 1,     \
+                                      key, NULL, hash, &i)) {                                       \
+            /* Both groups of the key and the stash are full: grow the hash table and retry,        \
+             * unless it is sparse, meaning that too many keys share the same groups. */            \
+            uhash_uint const n_buckets = h->n_buckets;                                              \
+            if (h->count < h->max_occupied / 2 || uhash_resize_##T(h, n_buckets + 1) ||             \
+                h->n_buckets == n_buckets) {                                                        \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+            return p_uhash_put_h_##T(h, key, hash, idx);                                            \
+        }                                                                                           \
+                                                                                                    \
+        h->count++;                                                                                 \
+        h->n_occupied++;                                                                            \
+                                                                                                    \
+        if (idx) *idx = i;                                                                          \
+        return UHASH_INSERTED;                                                                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline unsigned p_uhash_layout_##T(void) {                                       \
+        return P_UHASH_LAYOUT_CUCKOO;                                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the number of buckets needed to hold the specified number of keys. */                \
+    p_uhash_static_inline uhash_uint p_uhash_fit_##T(UHash_##T const *h, uhash_uint count) {        \
+        /* The stash does not count towards the load factor. */                                     \
+        return p_uhash_fit(count, p_uhash_load(h, UHASH_CUCKOO_MAX_LOAD)) + P_UHK_SLOTS;            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_home_##T(UHash_##T const *h, uhash_uint hash) {        \
+        return (hash & p_uhk_mask(h->n_buckets)) * P_UHK_SLOTS;                                     \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_key_hash_##T(UHash_##T const *h, UHash_##T const *src, \
+                                                         uhash_uint i) {                            \
+        (void)h;                                                                                    \
+        return (uhash_uint)(hash_func(src->keys[i]));                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the probe length of the key in bucket i. */                                          \
+    p_uhash_static_inline uhash_uint p_uhash_probe_len_##T(UHash_##T const *h, uhash_uint i) {      \
+        /* Zero for keys in their home group, one in their other group, two in the stash. */        \
+        uhash_uint const mask = p_uhk_mask(h->n_buckets), g = i / P_UHK_SLOTS;                      \
+        if (g > mask) return 2;                                                                     \
+        return g != ((uhash_uint)(hash_func(h->keys[i])) & mask);                                   \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline size_t p_uhash_bytes_##T(UHash_##T const *h) {                            \
+        return h->n_buckets * (1 + sizeof(uh_key) + (h->vals ? sizeof(uh_val) : 0));                \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_prefetch_##T(UHash_##T const *h, uhash_uint hash) {          \
+        if (!h->n_buckets) return;                                                                  \
+        uhash_uint const i = p_uhash_home_##T(h, hash);                                             \
+        p_uhash_prefetch(h->flags + i);                                                             \
+        p_uhash_prefetch(h->keys + i);                                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key) {                                \
+        return p_uhash_get_h_##T(h, key, (uhash_uint)(hash_func(key)));                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx) {                      \
+        return p_uhash_put_h_##T(h, key, (uhash_uint)(hash_func(key)), idx);                        \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x) {                                       \
+        if (!p_uhc_isfull(h->flags, x) || p_uhash_unshare_##T(h, true)) return;                     \
+                                                                                                    \
+        h->flags[x] = P_UHC_EMPTY;                                                                  \
+        h->count--;                                                                                 \
+        h->removed = true;                                                                          \
+        h->n_occupied--;                                                                            \
+                                                                                                    \
+        /* Stashed keys whose groups are no longer both full move to the freed bucket. */           \
+        uhash_uint const mask = p_uhk_mask(h->n_buckets), g = x / P_UHK_SLOTS;                      \
+        uhash_uint const stash = (mask + 1) * P_UHK_SLOTS;                                          \
+        if (g > mask) return;                                                                       \
+                                                                                                    \
+        uint32_t m = ~p_uhk_match_free(p_uhk_group(h->flags, mask + 1)) & P_UHK_ALL;                \
+        for (; m; m &= m - 1) {                                                                     \
+            uhash_uint const i = stash + p_uhash_ctz32(m);                                          \
+            uhash_uint const hash = (uhash_uint)(hash_func(h->keys[i]));                            \
+            if ((hash & mask) != g && p_uhk_alt(hash, mask) != g) continue;                         \
+                                                                                                    \
+            h->flags[x] = h->flags[i];                                                              \
+            h->keys[x] = h->keys[i];                                                                \
+            if (h->vals) h->vals[x] = h->vals[i];                                                   \
+            h->flags[i] = P_UHC_EMPTY;                                                              \
+            return;                                                                                 \
+        }                                                                                           \
+    }
+
+/*
+ * Generates core function definitions for the specified hash table type
+ * (linear probing over SIMD control bytes, with concurrent readers).
+ *
+ * Buckets are written by a single writer, and are never reused while published:
+ * deleted buckets are only reclaimed by resizing, which publishes new buckets
+ * and frees the old ones once readers stop using them.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ */
+#define P_UHASH_IMPL_CORE_CONC(T, SCOPE, uh_key, uh_val, hash_func, equal_func)                     \
+    P_UHASH_IMPL_STORAGE_BYTES(T, SCOPE, uh_key, uh_val, conc_storage)                              \
+    P_UHASH_IMPL_VALS(T, uh_val, P_UHASH_VS_PLAIN)                                                  \
+                                                                                                    \
+    /* Buckets are never shared. */                                                                 \
+    p_uhash_static_inline bool p_uhash_shareable_##T(UHash_##T const *h) {                          \
+        (void)h;                                                                                    \
+        return false;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_unshare_##T(UHash_##T *h, bool copy) {                  \
+        (void)h;                                                                                    \
+        (void)copy;                                                                                 \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_conc_replace_##T(UHash_##T *h, uhash_uint n_buckets,         \
+                                                        uint8_t *flags, uh_key *keys,               \
+                                                        uh_val *vals) {                             \
+        uhash_uint const old_n_buckets = h->n_buckets;                                              \
+        uint8_t *old_flags = h->flags;                                                              \
+        uh_key *old_keys = h->keys;                                                                 \
+        uh_val *old_vals = h->vals;                                                                 \
+                                                                                                    \
+        h->n_buckets = n_buckets;                                                                   \
+        h->max_occupied = p_uhash_upper_bound(h, h->n_buckets);                                     \
+        h->flags = flags;                                                                           \
+        h->keys = keys;                                                                             \
+        h->vals = vals;                                                                             \
+                                                                                                    \
+        /* Views alternate, and the previous one is not in use once readers are synchronized. */    \
+        UHashView_##T *view = h->view == h->views ? h->views + 1 : h->views;                        \
+        view->n_buckets = n_buckets;                                                                \
+        view->flags = flags;                                                                        \
+        view->keys = keys;                                                                          \
+        view->vals = vals;                                                                          \
+        p_uhash_atomic_store(&h->view, view, RELEASE);                                              \
+        p_uhash_conc_synchronize(h->readers, &h->epoch);                                            \
+                                                                                                    \
+        p_uhash_conc_storage_free_##T(h, old_n_buckets, old_flags, old_keys, old_vals);             \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_storage_fit_vals_##T(UHash_##T *h) {                    \
+        if (h->vals) return UHASH_OK;                                                               \
+                                                                                                    \
+        uint8_t *flags;                                                                             \
+        uh_key *keys;                                                                               \
+        uh_val *vals;                                                                               \
+                                                                                                    \
+        if (p_uhash_conc_storage_alloc_##T(h, h->n_buckets, true, &flags, &keys, &vals)) {          \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        memcpy(flags, h->flags, h->n_buckets);                                                      \
+        memcpy(keys, h->keys, h->n_buckets * sizeof(uh_key));                                       \
+        p_uhash_conc_replace_##T(h, h->n_buckets, flags, keys, vals);                               \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_publish_##T(UHash_##T *h, uhash_uint i) {                    \
+        if (h->flags[i] != P_UHCC_PENDING) return;                                                  \
+        uint8_t const tag = i == h->pending ? h->pending_tag                                        \
+                                            : p_uhc_tag((uhash_uint)(hash_func(h->keys[i])));       \
+        p_uhash_atomic_store(h->flags + i, tag, RELEASE);                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline bool p_uhash_conc_find_##T(UHash_##T const *h, uh_key key,                \
+                                                     uh_val *val) {                                 \
+        uhash_uint const hash = (uhash_uint)(hash_func(key));                                       \
+        uint8_t const tag = p_uhc_tag(hash);                                                        \
+        bool found = false;                                                                         \
+                                                                                                    \
+        /* Reader counters are the only fields modified by readers. */                              \
+        UHash_##T *mh = (UHash_##T *)h;                                                             \
+        unsigned *counter = p_uhash_conc_enter(mh->readers, &mh->epoch);                            \
+        UHashView_##T const *view = p_uhash_atomic_load(&mh->view, ACQUIRE);                        \
+                                                                                                    \
+        if (view && view->n_buckets) {                                                              \
+            uhash_uint const mask = view->n_buckets - 1;                                            \
+            uhash_uint i = hash & mask;                                                             \
+            uint8_t c;                                                                              \
+                                                                                                    \
+            /* Acquiring the control byte makes the key and value stored before it visible. */      \
+            for (; (c = p_uhash_atomic_load(view->flags + i, ACQUIRE)) != P_UHC_EMPTY;              \
+                 i = (i + 1) & mask) {                                                              \
+                if (c == tag && equal_func(view->keys[i], key)) {                                   \
+                    if (val && view->vals) *val = view->vals[i];                                    \
+                    found = true;                                                                   \
+                    break;                                                                          \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_conc_exit(counter);                                                                 \
+        return found;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_free_##T(UHash_##T *h) {                                                       \
+        if (!h) return;                                                                             \
+        UHashAllocator const *a = h->allocator;                                                     \
+        p_uhash_conc_storage_free_##T(h, h->n_buckets, h->flags, h->keys, h->vals);                 \
+        p_uhash_free(a, h, sizeof(*h));                                                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_copy_as_set_##T(UHash_##T const *src, UHash_##T *dest) {                  \
+        uhash_uint n_buckets = src->n_buckets;                                                      \
+        uint8_t *new_flags;                                                                         \
+        uh_key *new_keys;                                                                           \
+        uh_val *new_vals;                                                                           \
+                                                                                                    \
+        if (p_uhash_conc_storage_alloc_##T(dest, n_buckets, dest->vals != NULL,                     \
+                                           &new_flags, &new_keys, &new_vals)) {                     \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        memcpy(new_flags, src->flags, n_buckets);                                                   \
+        memcpy(new_keys, src->keys, n_buckets * sizeof(uh_key));                                    \
+                                                                                                    \
+        /* Readers may access values as soon as the buckets are published: copy them too. */        \
+        if (new_vals && src->vals) memcpy(new_vals, src->vals, n_buckets * sizeof(uh_val));         \
+                                                                                                    \
+        dest->n_occupied = src->n_occupied;                                                         \
+        dest->count = src->count;                                                                   \
+        p_uhash_conc_replace_##T(dest, n_buckets, new_flags, new_keys, new_vals);                   \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_clear_##T(UHash_##T *h) {                                                      \
+        if (!h || !h->flags) return;                                                                \
+                                                                                                    \
+        /* Buckets cannot be reused while published, so they are marked as deleted. */              \
+        for (uhash_uint i = 0; i != h->n_buckets; ++i) {                                            \
+            if (p_uhcc_isused(h->flags[i])) {                                                       \
+                p_uhash_atomic_store(h->flags + i, (uint8_t)P_UHC_DELETED, RELAXED);                \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        h->count = 0;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_get_h_##T(UHash_##T const *h, uh_key key,              \
+                                                       uhash_uint hash) {                           \
+        p_uhash_count(h, gets, 1);                                                                  \
+        if (!h->n_buckets) return UHASH_INDEX_MISSING;                                              \
+                                                                                                    \
+        uint8_t const tag = p_uhc_tag(hash);                                                        \
+        uhash_uint const mask = h->n_buckets - 1;                                                   \
+                                                                                                    \
+        for (uhash_uint i = hash & mask; h->flags[i] != P_UHC_EMPTY; i = (i + 1) & mask) {          \
+            uint8_t const c = h->flags[i];                                                          \
+            if ((c == tag || c == P_UHCC_PENDING) && equal_func(h->keys[i], key)) return i;         \
+            p_uhash_count(h, get_probes, 1);                                                        \
+        }                                                                                           \
+                                                                                                    \
+        return UHASH_INDEX_MISSING;                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_resize_##T(UHash_##T *h, uhash_uint new_n_buckets) {                      \
+        p_uhash_uint_next_power_2(new_n_buckets);                                                   \
+        if (new_n_buckets < 4) new_n_buckets = 4;                                                   \
+                                                                                                    \
+        /* Requested size is too small. */                                                          \
+        if (h->count >= p_uhash_upper_bound(h, new_n_buckets)) return UHASH_OK;                     \
+                                                                                                    \
+        uint8_t *new_flags;                                                                         \
+        uh_key *new_keys;                                                                           \
+        uh_val *new_vals;                                                                           \
+                                                                                                    \
+        if (p_uhash_conc_storage_alloc_##T(h, new_n_buckets, h->vals != NULL,                       \
+                                           &new_flags, &new_keys, &new_vals)) {                     \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_timer_start(t0);                                                                    \
+        memset(new_flags, P_UHC_EMPTY, new_n_buckets);                                              \
+        uhash_uint const mask = new_n_buckets - 1;                                                  \
+                                                                                                    \
+        for (uhash_uint j = 0; j != h->n_buckets; ++j) {                                            \
+            if (!p_uhcc_isused(h->flags[j])) continue;                                              \
+                                                                                                    \
+            /* Keys are unique and there are no deleted buckets: take the first empty one. */       \
+            uhash_uint const hash = (uhash_uint)(hash_func(h->keys[j]));                            \
+            uhash_uint i = hash & mask;                                                             \
+            while (new_flags[i] != P_UHC_EMPTY) i = (i + 1) & mask;                                 \
+                                                                                                    \
+            /* Pending buckets are published along with the new buckets. */                         \
+            new_flags[i] = p_uhc_tag(hash);                                                         \
+            new_keys[i] = h->keys[j];                                                               \
+            if (new_vals) new_vals[i] = h->vals[j];                                                 \
+        }                                                                                           \
+                                                                                                    \
+        h->n_occupied = h->count;                                                                   \
+        h->removed = false;                                                                         \
+        p_uhash_conc_replace_##T(h, new_n_buckets, new_flags, new_keys, new_vals);                  \
+        p_uhash_count(h, rehashes, 1);                                                              \
+        p_uhash_count_time(h, t0);                                                                  \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_ret p_uhash_put_h_##T(UHash_##T *h, uh_key key, uhash_uint hash,    \
+                                                      uhash_uint *idx) {                            \
+        p_uhash_count(h, puts, 1);                                                                  \
+        if (h->n_occupied >= h->max_occupied) {                                                     \
+            /* Clear deleted buckets if there are enough of them, otherwise expand. */              \
+            uhash_uint const n = p_uhash_should_compact(h) ? h->n_buckets : h->n_buckets + 1;       \
+            if (uhash_resize_##T(h, n)) {                                                           \
+                if (idx) *idx = UHASH_INDEX_MISSING;                                                \
+                return UHASH_ERR;                                                                   \
+            }                                                                                       \
+        } else if (p_uhash_should_shrink(h)) {                                                      \
+            /* Shrink the hash table; on failure, keep using the current buckets. */                \
+            (void)uhash_resize_##T(h, h->count << 1U);                                              \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_analyzer_assert(h->flags);                                                          \
+                                                                                                    \
+        uint8_t const tag = p_uhc_tag(hash);                                                        \
+        uhash_uint const mask = h->n_buckets - 1;                                                   \
+        uhash_uint i = hash & mask;                                                                 \
+                                                                                                    \
+        for (; h->flags[i] != P_UHC_EMPTY; i = (i + 1) & mask) {                                    \
+            uint8_t const c = h->flags[i];                                                          \
+            if ((c == tag || c == P_UHCC_PENDING) && equal_func(h->keys[i], key)) {                 \
+                /* Don't touch h->keys[i] if present. */                                            \
+                if (idx) *idx = i;                                                                  \
+                return UHASH_PRESENT;                                                               \
+            }                                                                                       \
+            p_uhash_count(h, put_probes, 1);                                                        \
+        }                                                                                           \
+                                                                                                    \
+        /* Readers ignore the key until the control byte is stored. */                              \
+        h->keys[i] = key;                                                                           \
+        h->count++;                                                                                 \
+        h->n_occupied++;                                                                            \
+                                                                                                    \
+        if (h->vals) {                                                                              \
+            /* Maps are published by p_uhash_publish, once the value has been stored. */            \
+            h->pending = i;                                                                         \
+            h->pending_tag = tag;                                                                   \
+            p_uhash_atomic_store(h->flags + i, (uint8_t)P_UHCC_PENDING, RELAXED);                   \
+        } else {                                                                                    \
+            p_uhash_atomic_store(h->flags + i, tag, RELEASE);                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (idx) *idx = i;                                                                          \
+        return UHASH_INSERTED;                                                                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline unsigned p_uhash_layout_##T(void) {                                       \
+        return P_UHASH_LAYOUT_NONE;                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the number of buckets needed to hold the specified number of keys. */                \
+    p_uhash_static_inline uhash_uint p_uhash_fit_##T(UHash_##T const *h, uhash_uint count) {        \
+        return p_uhash_fit(count, p_uhash_load(h, UHASH_MAX_LOAD));                                 \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_home_##T(UHash_##T const *h, uhash_uint hash) {        \
+        return hash & (h->n_buckets - 1);                                                           \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline uhash_uint p_uhash_key_hash_##T(UHash_##T const *h, UHash_##T const *src, \
+                                                         uhash_uint i) {                            \
+        (void)h;                                                                                    \
+        return (uhash_uint)(hash_func(src->keys[i]));                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Returns the probe length of the key in bucket i. */                                          \
+    p_uhash_static_inline uhash_uint p_uhash_probe_len_##T(UHash_##T const *h, uhash_uint i) {      \
+        return (i - p_uhash_key_hash_##T(h, h, i)) & (h->n_buckets - 1);                            \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline size_t p_uhash_bytes_##T(UHash_##T const *h) {                            \
+        return h->n_buckets * (1 + sizeof(uh_key) + (h->vals ? sizeof(uh_val) : 0));                \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline void p_uhash_prefetch_##T(UHash_##T const *h, uhash_uint hash) {          \
+        if (!h->n_buckets) return;                                                                  \
+        uhash_uint const i = hash & (h->n_buckets - 1);                                             \
+        p_uhash_prefetch(h->flags + i);                                                             \
+        p_uhash_prefetch(h->keys + i);                                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_get_##T(UHash_##T const *h, uh_key key) {                                \
+        return p_uhash_get_h_##T(h, key, (uhash_uint)(hash_func(key)));                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_put_##T(UHash_##T *h, uh_key key, uhash_uint *idx) {                      \
+        return p_uhash_put_h_##T(h, key, (uhash_uint)(hash_func(key)), idx);                        \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_delete_##T(UHash_##T *h, uhash_uint x) {                                       \
+        if (!p_uhcc_isused(h->flags[x])) return;                                                    \
+        /* The key is left in place, as readers may still be comparing it. */                       \
+        p_uhash_atomic_store(h->flags + x, (uint8_t)P_UHC_DELETED, RELAXED);                        \
+        h->count--;                                                                                 \
+        h->removed = true;                                                                          \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhash_conc_contains_##T(UHash_##T const *h, uh_key key) {                            \
+        return p_uhash_conc_find_##T(h, key, NULL);                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uh_val uhmap_conc_get_##T(UHash_##T const *h, uh_key key, uh_val if_missing) {            \
+        uh_val val = if_missing;                                                                    \
+        p_uhash_conc_find_##T(h, key, &val);                                                        \
+        return val;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_conc_publish_##T(UHash_##T *h, uhash_uint i) {                                 \
+        p_uhash_publish_##T(h, i);                                                                  \
+    }
+
+/*
+ * Generates function definitions for the specified string interning table type.
+ * Table keys are views with precomputed hashes, so that comparisons only access
+ * the arena if both hash and length match.
+ *
+ * @param T [symbol] Interning table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ */
+#define P_UHASH_IMPL_INTERN(T, SCOPE)                                                               \
+                                                                                                    \
+    /* Allocates a block of bytes from the arena, which never moves. */                             \
+    p_uhash_static_inline char *p_uhash_arena_alloc_##T(UHashArena *a,                              \
+                                                        UHashAllocator const *allocator,            \
+                                                        size_t size) {                              \
+        UHashArenaChunk *chunk = a->head;                                                           \
+                                                                                                    \
+        if (!chunk || chunk->size - a->used < size) {                                               \
+            size_t chunk_size = UHASH_ARENA_CHUNK;                                                  \
+            if (chunk) chunk_size = chunk->size * (chunk->size < 128U * UHASH_ARENA_CHUNK ? 2 : 1); \
+            bool const dedicated = chunk && size > chunk_size;                                      \
+            if (size > chunk_size) chunk_size = size;                                               \
+                                                                                                    \
+            chunk = p_uhash_malloc(allocator, sizeof(*chunk) + chunk_size);                         \
+            if (!chunk) return NULL;                                                                \
+            chunk->size = chunk_size;                                                               \
+                                                                                                    \
+            if (dedicated) {                                                                        \
+                /* Large blocks get their own chunk, so that the free space of the head is kept. */ \
+                chunk->next = a->head->next;                                                        \
+                a->head->next = chunk;                                                              \
+                return (char *)(chunk + 1);                                                         \
+            }                                                                                       \
+                                                                                                    \
+            chunk->next = a->head;                                                                  \
+            a->head = chunk;                                                                        \
+            a->used = 0;                                                                            \
+        }                                                                                           \
+                                                                                                    \
+        char *block = (char *)(chunk + 1) + a->used;                                                \
+        a->used += size;                                                                            \
+        return block;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    /* Releases all the chunks of the arena, leaving it empty. */                                   \
+    p_uhash_static_inline void p_uhash_arena_free_##T(UHashArena *a,                                \
+                                                      UHashAllocator const *allocator) {            \
+        for (UHashArenaChunk *chunk = a->head, *next; chunk; chunk = next) {                        \
+            next = chunk->next;                                                                     \
+            p_uhash_free(allocator, chunk, sizeof(*chunk) + chunk->size);                           \
+        }                                                                                           \
+        a->head = NULL;                                                                             \
+        a->used = 0;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHashIntern_##T *uhash_intern_alloc_with_##T(UHashAllocator const *allocator) {           \
+        UHashIntern_##T *h = p_uhash_malloc(allocator, sizeof(*h));                                 \
+        if (!h) return NULL;                                                                        \
+                                                                                                    \
+        *h = (UHashIntern_##T) { .table = uhset_alloc_with_##T##_table(allocator) };                \
+                                                                                                    \
+        if (!h->table) {                                                                            \
+            p_uhash_free(allocator, h, sizeof(*h));                                                 \
+            return NULL;                                                                            \
+        }                                                                                           \
+                                                                                                    \
+        return h;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHashIntern_##T *uhash_intern_alloc_##T(void) {                                           \
+        return uhash_intern_alloc_with_##T(NULL);                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_intern_free_##T(UHashIntern_##T *h) {                                          \
+        if (!h) return;                                                                             \
+        UHashAllocator const *allocator = h->table->allocator;                                      \
+        p_uhash_arena_free_##T(&h->arena, allocator);                                               \
+        uhash_free_##T##_table(h->table);                                                           \
+        p_uhash_free(allocator, h, sizeof(*h));                                                     \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_intern_clear_##T(UHashIntern_##T *h) {                                         \
+        uhash_clear_##T##_table(h->table);                                                          \
+        p_uhash_arena_free_##T(&h->arena, h->table->allocator);                                     \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE char const *uhash_intern_##T(UHashIntern_##T *h, char const *str, size_t length) {        \
+        UHashStrView const view = uhash_strv_hashed(str, length);                                   \
+        uhash_uint k;                                                                               \
+        uhash_ret const ret = p_uhash_put_h_##T##_table(h->table, view,                             \
+                                                        uhash_strv_hash(view), &k);                 \
+        if (ret == UHASH_ERR) return NULL;                                                          \
+                                                                                                    \
+        if (ret == UHASH_INSERTED) {                                                                \
+            /* Only the keys of new strings are copied, NULL-terminated. */                         \
+            char *copy = p_uhash_arena_alloc_##T(&h->arena, h->table->allocator, length + 1);       \
+                                                                                                    \
+            if (!copy) {                                                                            \
+                uhash_delete_##T##_table(h->table, k);                                              \
+                return NULL;                                                                        \
+            }                                                                                       \
+                                                                                                    \
+            if (length) memcpy(copy, str, length);                                                  \
+            copy[length] = '\0';                                                                    \
+            h->table->keys[k].data = copy;                                                          \
+        }                                                                                           \
+                                                                                                    \
+        return h->table->keys[k].data;                                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE char const *uhash_intern_get_##T(UHashIntern_##T const *h, char const *str,               \
+                                           size_t length) {                                         \
+        UHashStrView const view = uhash_strv_hashed(str, length);                                   \
+        uhash_uint k = p_uhash_get_h_##T##_table(h->table, view, uhash_strv_hash(view));            \
+        return k == UHASH_INDEX_MISSING ? NULL : h->table->keys[k].data;                            \
+    }
+
+/*
+ * Generates function definitions for the specified cache type. Entries are evicted by the clock
+ * algorithm: a hand sweeps the buckets of the table, sparing and unmarking those used since
+ * it last passed, and evicting the first unmarked one.
+ *
+ * @param T [symbol] Cache name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Cache key type.
+ * @param uh_val [type] Cache value type.
+ */
+#define P_UHASH_IMPL_CACHE(T, SCOPE, uh_key, uh_val)                                                \
+                                                                                                    \
+    /* Evicts the entry under the clock hand, sparing the one in bucket spare. */                   \
+    p_uhash_static_inline void p_uhcache_evict_##T(UHashCache_##T *h, uhash_uint spare) {           \
+        UHash_##T##_table *t = h->table;                                                            \
+        uhash_uint const n = t->n_buckets;                                                          \
+        uhash_uint i = h->hand;                                                                     \
+                                                                                                    \
+        /* The table holds more entries than the capacity, so at least two can be evicted. */       \
+        while (true) {                                                                              \
+            i = p_uhash_next(t->flags, n, i < n ? i : 0);                                           \
+            if (i == n) continue;                                                                   \
+            if (i != spare) {                                                                       \
+                if (!t->vals[i].used) break;                                                        \
+                t->vals[i].used = false;                                                            \
+            }                                                                                       \
+            ++i;                                                                                    \
+        }                                                                                           \
+                                                                                                    \
+        h->hand = i + 1;                                                                            \
+        if (h->evict) h->evict(t->keys[i], t->vals[i].val, h->evict_data);                          \
+        uhash_delete_##T##_table(t, i);                                                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHashCache_##T *uhcache_alloc_with_##T(uhash_uint capacity,                               \
+                                                 UHashAllocator const *allocator) {                 \
+        if (!capacity || capacity > (UHASH_UINT_MAX >> 2U)) return NULL;                            \
+        UHashCache_##T *h = p_uhash_malloc(allocator, sizeof(*h));                                  \
+        if (!h) return NULL;                                                                        \
+                                                                                                    \
+        *h = (UHashCache_##T) {                                                                     \
+            .table = uhmap_alloc_with_##T##_table(allocator),                                       \
+            .capacity = capacity                                                                    \
+        };                                                                                          \
+                                                                                                    \
+        /* Using at most half of the buckets, the deleted buckets left by evictions are cleared     \
+           by rehashing at the same size rather than by growing (see p_uhash_should_compact). */    \
+        if (!h->table || uhash_resize_##T##_table(h->table, (uhash_uint)((capacity << 1U) + 1U))) { \
+            uhash_free_##T##_table(h->table);                                                       \
+            p_uhash_free(allocator, h, sizeof(*h));                                                 \
+            return NULL;                                                                            \
+        }                                                                                           \
+                                                                                                    \
+        return h;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHashCache_##T *uhcache_alloc_##T(uhash_uint capacity) {                                  \
+        return uhcache_alloc_with_##T(capacity, NULL);                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhcache_free_##T(UHashCache_##T *h) {                                                \
+        if (!h) return;                                                                             \
+        UHashAllocator const *allocator = h->table->allocator;                                      \
+        uhash_free_##T##_table(h->table);                                                           \
+        p_uhash_free(allocator, h, sizeof(*h));                                                     \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhcache_clear_##T(UHashCache_##T *h) {                                               \
+        uhash_clear_##T##_table(h->table);                                                          \
+        h->hand = 0;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhcache_set_evict_##T(UHashCache_##T *h,                                             \
+                                     void (*func)(uh_key key, uh_val val, void *data),              \
+                                     void *data) {                                                  \
+        h->evict = func;                                                                            \
+        h->evict_data = data;                                                                       \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uh_val uhcache_get_##T(UHashCache_##T *h, uh_key key, uh_val if_missing) {                \
+        uhash_uint const i = uhash_get_##T##_table(h->table, key);                                  \
+        if (i == UHASH_INDEX_MISSING) return if_missing;                                            \
+        UHashCacheEntry_##T *entry = h->table->vals + i;                                            \
+        /* Entries are only written to on their first use since the hand passed. */                 \
+        if (!entry->used) entry->used = true;                                                       \
+        return entry->val;                                                                          \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhcache_contains_##T(UHashCache_##T const *h, uh_key key) {                          \
+        return uhash_get_##T##_table(h->table, key) != UHASH_INDEX_MISSING;                         \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhcache_put_##T(UHashCache_##T *h, uh_key key, uh_val val) {                    \
+        uhash_uint k;                                                                               \
+        uhash_ret const ret = uhash_put_##T##_table(h->table, key, &k);                             \
+        if (ret == UHASH_ERR) return ret;                                                           \
+        h->table->vals[k] = (UHashCacheEntry_##T) { .val = val, .used = true };                     \
+        if (ret == UHASH_INSERTED && h->table->count > h->capacity) p_uhcache_evict_##T(h, k);      \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhcache_remove_##T(UHashCache_##T *h, uh_key key, uh_val *r_val) {                   \
+        uhash_uint const i = uhash_get_##T##_table(h->table, key);                                  \
+        if (i == UHASH_INDEX_MISSING) return false;                                                 \
+        if (r_val) *r_val = h->table->vals[i].val;                                                  \
+        uhash_delete_##T##_table(h->table, i);                                                      \
+        return true;                                                                                \
+    }
+
+/*
+ * Generates function definitions for the specified sharded hash table type.
+ * Shards are accessed via their private functions, so that keys are only hashed once.
+ *
+ * @param T [symbol] Sharded hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ */
+#define P_UHASH_IMPL_SHARDED(T, SCOPE, uh_key, uh_val, hash_func)                                   \
+                                                                                                    \
+    p_uhash_static_inline UHashShard_##T *p_uhash_shard_##T(UHashSharded_##T *h,                    \
+                                                           uhash_uint hash) {                       \
+        /* Shards index buckets by the low bits of the hash: use the high bits of its mix. */       \
+        uint32_t const mix = (uint32_t)hash * 0x9e3779b1U;                                          \
+        return h->shards + (mix >> 16U) % p_uhash_n_shards(h);                                      \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline UHashSharded_##T *p_uhash_sharded_alloc_##T(bool map) {                   \
+        UHashSharded_##T *h = UHASH_MALLOC(sizeof(*h));                                             \
+        if (!h) return NULL;                                                                        \
+        memset(h, 0, sizeof(*h));                                                                   \
+                                                                                                    \
+        for (size_t i = 0; i != p_uhash_n_shards(h); ++i) {                                         \
+            UHash_##T##_shard *table = map ? uhmap_alloc_##T##_shard()                              \
+                                           : uhset_alloc_##T##_shard();                             \
+            if (!table) {                                                                           \
+                uhash_sharded_free_##T(h);                                                          \
+                return NULL;                                                                        \
+            }                                                                                       \
+            h->shards[i].table = table;                                                             \
+        }                                                                                           \
+                                                                                                    \
+        return h;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHashSharded_##T *uhmap_sharded_alloc_##T(void) {                                         \
+        return p_uhash_sharded_alloc_##T(true);                                                     \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHashSharded_##T *uhset_sharded_alloc_##T(void) {                                         \
+        return p_uhash_sharded_alloc_##T(false);                                                    \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_sharded_free_##T(UHashSharded_##T *h) {                                        \
+        if (!h) return;                                                                             \
+        for (size_t i = 0; i != p_uhash_n_shards(h); ++i) {                                         \
+            uhash_free_##T##_shard(h->shards[i].table);                                             \
+        }                                                                                           \
+        UHASH_FREE(h);                                                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_sharded_count_##T(UHashSharded_##T *h) {                                 \
+        uhash_uint count = 0;                                                                       \
+                                                                                                    \
+        for (size_t i = 0; i != p_uhash_n_shards(h); ++i) {                                         \
+            p_uhash_spin_lock(&h->shards[i].lock);                                                  \
+            count += h->shards[i].table->count;                                                     \
+            p_uhash_spin_unlock(&h->shards[i].lock);                                                \
+        }                                                                                           \
+                                                                                                    \
+        return count;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_sharded_lock_##T(UHashSharded_##T *h, uh_key key) {                      \
+        UHashShard_##T *s = p_uhash_shard_##T(h, (uhash_uint)(hash_func(key)));                     \
+        p_uhash_spin_lock(&s->lock);                                                                \
+        return (uhash_uint)(s - h->shards);                                                         \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_sharded_unlock_##T(UHashSharded_##T *h, uhash_uint i) {                        \
+        p_uhash_spin_unlock(&h->shards[i].lock);                                                    \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhash_sharded_contains_##T(UHashSharded_##T *h, uh_key key) {                        \
+        uhash_uint const hash = (uhash_uint)(hash_func(key));                                       \
+        UHashShard_##T *s = p_uhash_shard_##T(h, hash);                                             \
+        p_uhash_spin_lock(&s->lock);                                                                \
+        bool const found = p_uhash_get_h_##T##_shard(s->table, key, hash) != UHASH_INDEX_MISSING;   \
+        p_uhash_spin_unlock(&s->lock);                                                              \
+        return found;                                                                               \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uh_val uhmap_sharded_get_##T(UHashSharded_##T *h, uh_key key, uh_val if_missing) {        \
+        uhash_uint const hash = (uhash_uint)(hash_func(key));                                       \
+        UHashShard_##T *s = p_uhash_shard_##T(h, hash);                                             \
+        p_uhash_spin_lock(&s->lock);                                                                \
+        uhash_uint const k = p_uhash_get_h_##T##_shard(s->table, key, hash);                        \
+        uh_val const val = k == UHASH_INDEX_MISSING ? if_missing : s->table->vals[k];               \
+        p_uhash_spin_unlock(&s->lock);                                                              \
+        return val;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhmap_sharded_set_##T(UHashSharded_##T *h, uh_key key, uh_val value,            \
+                                          uh_val *existing) {                                       \
+        uhash_uint const hash = (uhash_uint)(hash_func(key));                                       \
+        UHashShard_##T *s = p_uhash_shard_##T(h, hash);                                             \
+        uhash_uint k;                                                                               \
+                                                                                                    \
+        p_uhash_spin_lock(&s->lock);                                                                \
+        uhash_ret const ret = p_uhash_put_h_##T##_shard(s->table, key, hash, &k);                   \
+                                                                                                    \
+        if (ret != UHASH_ERR) {                                                                     \
+            if (ret == UHASH_PRESENT && existing) *existing = s->table->vals[k];                    \
+            s->table->vals[k] = value;                                                              \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_spin_unlock(&s->lock);                                                              \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhmap_sharded_add_##T(UHashSharded_##T *h, uh_key key, uh_val value,            \
+                                          uh_val *existing) {                                       \
+        uhash_uint const hash = (uhash_uint)(hash_func(key));                                       \
+        UHashShard_##T *s = p_uhash_shard_##T(h, hash);                                             \
+        uhash_uint k;                                                                               \
+                                                                                                    \
+        p_uhash_spin_lock(&s->lock);                                                                \
+        uhash_ret const ret = p_uhash_put_h_##T##_shard(s->table, key, hash, &k);                   \
+                                                                                                    \
+        if (ret == UHASH_INSERTED) {                                                                \
+            s->table->vals[k] = value;                                                              \
+        } else if (ret == UHASH_PRESENT && existing) {                                              \
+            *existing = s->table->vals[k];                                                          \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_spin_unlock(&s->lock);                                                              \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhmap_sharded_remove_##T(UHashSharded_##T *h, uh_key key, uh_val *r_val) {           \
+        uhash_uint const hash = (uhash_uint)(hash_func(key));                                       \
+        UHashShard_##T *s = p_uhash_shard_##T(h, hash);                                             \
+                                                                                                    \
+        p_uhash_spin_lock(&s->lock);                                                                \
+        uhash_uint const k = p_uhash_get_h_##T##_shard(s->table, key, hash);                        \
+                                                                                                    \
+        if (k != UHASH_INDEX_MISSING) {                                                             \
+            if (r_val) *r_val = s->table->vals[k];                                                  \
+            uhash_delete_##T##_shard(s->table, k);                                                  \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_spin_unlock(&s->lock);                                                              \
+        return k != UHASH_INDEX_MISSING;                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhset_sharded_insert_##T(UHashSharded_##T *h, uh_key key) {                     \
+        uhash_uint const hash = (uhash_uint)(hash_func(key));                                       \
+        UHashShard_##T *s = p_uhash_shard_##T(h, hash);                                             \
+        p_uhash_spin_lock(&s->lock);                                                                \
+        uhash_ret const ret = p_uhash_put_h_##T##_shard(s->table, key, hash, NULL);                 \
+        p_uhash_spin_unlock(&s->lock);                                                              \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhset_sharded_remove_##T(UHashSharded_##T *h, uh_key key) {                          \
+        return uhmap_sharded_remove_##T(h, key, NULL);                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_sharded_merge_##T(UHashSharded_##T *dest, UHashSharded_##T *src) {        \
+        if (dest == src) return UHASH_OK;                                                           \
+                                                                                                    \
+        /* Keys map to the same shard in both tables, so shards can be merged pairwise. */          \
+        for (size_t i = 0; i != p_uhash_n_shards(dest); ++i) {                                      \
+            UHashShard_##T *d = dest->shards + i, *s = src->shards + i;                             \
+            UHash_##T##_shard *dt = d->table, *st = s->table;                                       \
+            uhash_ret ret = UHASH_OK;                                                               \
+                                                                                                    \
+            /* Shards are locked in address order, so that opposite merges cannot deadlock. */      \
+            p_uhash_spin_lock(d < s ? &d->lock : &s->lock);                                         \
+            p_uhash_spin_lock(d < s ? &s->lock : &d->lock);                                         \
+                                                                                                    \
+            if (dt->vals && st->vals) {                                                             \
+                p_uhash_for_buckets(st, j) {                                                        \
+                    ret = uhmap_set_##T##_shard(dt, st->keys[j], st->vals[j], NULL);                \
+                    if (ret == UHASH_ERR) break;                                                    \
+                }                                                                                   \
+            } else {                                                                                \
+                ret = uhset_union_##T##_shard(dt, st);                                              \
+            }                                                                                       \
+                                                                                                    \
+            p_uhash_spin_unlock(&s->lock);                                                          \
+            p_uhash_spin_unlock(&d->lock);                                                          \
+            if (ret == UHASH_ERR) return UHASH_ERR;                                                 \
+        }                                                                                           \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }
+
+/*
+ * Generates parallel set operations for the specified hash table type.
+ * Workers hash keys and probe tables concurrently, while the table being modified
+ * is only written to by the calling thread: probe sequences cross any partition
+ * of the bucket range, so concurrent insertions would need per-bucket synchronization.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ */
+#define P_UHASH_IMPL_PAR(T, SCOPE, uh_key, hash_func)                                               \
+                                                                                                    \
+    /** @cond */                                                                                    \
+    typedef struct UHashParTask_##T {                                                               \
+        UHash_##T const *lookup;                                                                    \
+        UHash_##T const *scan;                                                                      \
+        uh_key const *items;                                                                        \
+        uh_key *keys;                                                                               \
+        uhash_uint *hashes;                                                                         \
+        uhash_uint *sorted;                                                                         \
+        uhash_uint *counts;                                                                         \
+        uint8_t *marks;                                                                             \
+        uhash_uint n;                                                                               \
+        uhash_uint width;                                                                           \
+        unsigned n_tasks;                                                                           \
+    } UHashParTask_##T;                                                                             \
+    /** @endcond */                                                                                 \
+                                                                                                    \
+    /* Looks up the keys of the scanned table in the other one, counting the missing ones. */       \
+    p_uhash_static_inline void p_uhash_par_probe_##T(void *arg, unsigned t) {                       \
+        UHashParTask_##T *task = arg;                                                               \
+        UHash_##T const *h = task->lookup, *s = task->scan;                                         \
+        uhash_uint i = p_uhash_par_bound(s->n_buckets, task->n_tasks, t);                           \
+        uhash_uint const end = p_uhash_par_bound(s->n_buckets, task->n_tasks, t + 1);               \
+        uhash_uint missing = 0;                                                                     \
+                                                                                                    \
+        for (; i != end; ++i) {                                                                     \
+            bool miss = false;                                                                      \
+                                                                                                    \
+            if (uhash_exists(s, i)) {                                                               \
+                uhash_uint const hash = p_uhash_key_hash_##T(h, s, i);                              \
+                miss = p_uhash_get_h_##T(h, s->keys[i], hash) == UHASH_INDEX_MISSING;               \
+                if (task->hashes) task->hashes[i] = hash;                                           \
+            }                                                                                       \
+                                                                                                    \
+            missing += miss;                                                                        \
+            if (task->marks) {                                                                      \
+                task->marks[i] = miss;                                                              \
+            } else if (miss) {                                                                      \
+                /* Without marks, only the presence of missing keys matters. */                     \
+                break;                                                                              \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        task->counts[t] = missing;                                                                  \
+    }                                                                                               \
+                                                                                                    \
+    /* Hashes the items, counting how many fall into each bucket range. */                          \
+    p_uhash_static_inline void p_uhash_par_hash_##T(void *arg, unsigned t) {                        \
+        UHashParTask_##T *task = arg;                                                               \
+        UHash_##T const *h = task->lookup;                                                          \
+        uhash_uint *counts = task->counts + t * P_UHASH_PAR_PARTS;                                  \
+        uhash_uint i = p_uhash_par_bound(task->n, task->n_tasks, t);                                \
+        uhash_uint const end = p_uhash_par_bound(task->n, task->n_tasks, t + 1);                    \
+                                                                                                    \
+        for (; i != end; ++i) {                                                                     \
+            uhash_uint const hash = (uhash_uint)(hash_func(task->items[i]));                        \
+            task->hashes[i] = hash;                                                                 \
+            ++counts[p_uhash_home_##T(h, hash) / task->width];                                      \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    /* Moves the items to their bucket range, starting at the offsets computed for each task. */    \
+    p_uhash_static_inline void p_uhash_par_scatter_##T(void *arg, unsigned t) {                     \
+        UHashParTask_##T *task = arg;                                                               \
+        uhash_uint *offsets = task->counts + t * P_UHASH_PAR_PARTS;                                 \
+        uhash_uint i = p_uhash_par_bound(task->n, task->n_tasks, t);                                \
+        uhash_uint const end = p_uhash_par_bound(task->n, task->n_tasks, t + 1);                    \
+                                                                                                    \
+        for (; i != end; ++i) {                                                                     \
+            uhash_uint const hash = task->hashes[i];                                                \
+            uhash_uint const j = offsets[p_uhash_home_##T(task->lookup, hash) / task->width]++;     \
+            task->keys[j] = task->items[i];                                                         \
+            task->sorted[j] = hash;                                                                 \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhset_insert_all_par_##T(UHash_##T *h, uh_key const *items, uhash_uint n,       \
+                                             UHashExecutor const *ex) {                             \
+        unsigned const n_tasks = p_uhash_par_tasks(ex);                                             \
+        if (n_tasks == 1 || !n) return uhset_insert_all_##T(h, items, n);                           \
+                                                                                                    \
+        uhash_uint const n_buckets = p_uhash_fit_##T(h, h->count + n);                              \
+        if (n_buckets > h->n_buckets && uhash_resize_##T(h, n_buckets)) return UHASH_ERR;           \
+                                                                                                    \
+        size_t const n_counts = (size_t)n_tasks * P_UHASH_PAR_PARTS;                                \
+        size_t const size = (n_counts + 2 * (size_t)n) * sizeof(uhash_uint);                        \
+        uhash_uint *block = p_uhash_malloc(h->allocator, size);                                     \
+        uh_key *keys = p_uhash_malloc(h->allocator, n * sizeof(*keys));                             \
+                                                                                                    \
+        if (!(block && keys)) {                                                                     \
+            p_uhash_free(h->allocator, block, size);                                                \
+            p_uhash_free(h->allocator, keys, n * sizeof(*keys));                                    \
+            return uhset_insert_all_##T(h, items, n);                                               \
+        }                                                                                           \
+                                                                                                    \
+        UHashParTask_##T task = {                                                                   \
+            .lookup = h, .items = items, .keys = keys, .counts = block,                             \
+            .hashes = block + n_counts, .sorted = block + n_counts + n, .n = n,                     \
+            .width = (h->n_buckets + P_UHASH_PAR_PARTS - 1) / P_UHASH_PAR_PARTS,                    \
+            .n_tasks = n_tasks                                                                      \
+        };                                                                                          \
+                                                                                                    \
+        memset(block, 0, n_counts * sizeof(*block));                                                \
+        ex->run_fn(ex->ctx, n_tasks, p_uhash_par_hash_##T, &task);                                  \
+                                                                                                    \
+        /* Ranges are laid out in bucket order, each one split between tasks in task order. */      \
+        uhash_uint offset = 0;                                                                      \
+        for (size_t p = 0; p != P_UHASH_PAR_PARTS; ++p) {                                           \
+            for (size_t t = 0; t != n_tasks; ++t) {                                                 \
+                uhash_uint const count = block[t * P_UHASH_PAR_PARTS + p];                          \
+                block[t * P_UHASH_PAR_PARTS + p] = offset;                                          \
+                offset += count;                                                                    \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        ex->run_fn(ex->ctx, n_tasks, p_uhash_par_scatter_##T, &task);                               \
+                                                                                                    \
+        /* Keys are now sorted by home bucket range, so insertion sweeps through the table. */      \
+        uhash_ret ret = UHASH_PRESENT;                                                              \
+        for (uhash_uint i = 0; i != n; ++i) {                                                       \
+            uhash_uint k;                                                                           \
+            uhash_ret l_ret = p_uhash_put_h_##T(h, keys[i], task.sorted[i], &k);                    \
+            if (l_ret == UHASH_ERR) {                                                               \
+                ret = UHASH_ERR;                                                                    \
+                break;                                                                              \
+            }                                                                                       \
+            if (l_ret == UHASH_INSERTED) {                                                          \
+                p_uhash_publish_##T(h, k);                                                          \
+                ret = UHASH_INSERTED;                                                               \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_free(h->allocator, block, size);                                                    \
+        p_uhash_free(h->allocator, keys, n * sizeof(*keys));                                        \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhset_is_superset_par_##T(UHash_##T const *h1, UHash_##T const *h2,                  \
+                                         UHashExecutor const *ex) {                                 \
+        unsigned const n_tasks = p_uhash_par_tasks(ex);                                             \
+        if (n_tasks == 1) return uhset_is_superset_##T(h1, h2);                                     \
+                                                                                                    \
+        size_t const size = n_tasks * sizeof(uhash_uint);                                           \
+        uhash_uint *counts = p_uhash_malloc(h1->allocator, size);                                   \
+        if (!counts) return uhset_is_superset_##T(h1, h2);                                          \
+                                                                                                    \
+        p_uhash_iter_prepare_##T(h1);                                                               \
+        p_uhash_iter_prepare_##T(h2);                                                               \
+        UHashParTask_##T task = { .lookup = h1, .scan = h2, .counts = counts, .n_tasks = n_tasks }; \
+        ex->run_fn(ex->ctx, n_tasks, p_uhash_par_probe_##T, &task);                                 \
+                                                                                                    \
+        bool superset = true;                                                                       \
+        for (unsigned t = 0; t != n_tasks; ++t) superset = superset && !counts[t];                  \
+        p_uhash_free(h1->allocator, counts, size);                                                  \
+        return superset;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhset_union_par_##T(UHash_##T *h1, UHash_##T const *h2,                         \
+                                        UHashExecutor const *ex) {                                  \
+        unsigned const n_tasks = p_uhash_par_tasks(ex);                                             \
+        if (n_tasks == 1 || h1 == h2) return uhset_union_##T(h1, h2);                               \
+                                                                                                    \
+        uhash_uint const n = h2->n_buckets;                                                         \
+        size_t const size = (n_tasks + (size_t)n) * sizeof(uhash_uint) + n;                         \
+        uhash_uint *block = p_uhash_malloc(h1->allocator, size);                                    \
+        if (!block) return uhset_union_##T(h1, h2);                                                 \
+                                                                                                    \
+        p_uhash_iter_prepare_##T(h1);                                                               \
+        p_uhash_iter_prepare_##T(h2);                                                               \
+        UHashParTask_##T task = {                                                                   \
+            .lookup = h1, .scan = h2, .counts = block, .hashes = block + n_tasks,                   \
+            .marks = (uint8_t *)(block + n_tasks + n), .n_tasks = n_tasks                           \
+        };                                                                                          \
+        ex->run_fn(ex->ctx, n_tasks, p_uhash_par_probe_##T, &task);                                 \
+                                                                                                    \
+        uhash_uint missing = 0;                                                                     \
+        for (unsigned t = 0; t != n_tasks; ++t) missing += block[t];                                \
+                                                                                                    \
+        uhash_ret ret = UHASH_OK;                                                                   \
+        uhash_uint const n_buckets = p_uhash_fit_##T(h1, h1->count + missing);                      \
+        if (missing && n_buckets > h1->n_buckets && uhash_resize_##T(h1, n_buckets)) {              \
+            ret = UHASH_ERR;                                                                        \
+        }                                                                                           \
+                                                                                                    \
+        /* Hashes were computed by the workers, so keys are only hashed once. */                    \
+        for (uhash_uint i = 0; ret == UHASH_OK && missing && i != n; ++i) {                         \
+            if (!task.marks[i]) continue;                                                           \
+            uhash_uint k;                                                                           \
+            if (p_uhash_put_h_##T(h1, h2->keys[i], task.hashes[i], &k) == UHASH_ERR) {              \
+                ret = UHASH_ERR;                                                                    \
+            } else {                                                                                \
+                p_uhash_publish_##T(h1, k);                                                         \
+                --missing;                                                                          \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_free(h1->allocator, block, size);                                                   \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhset_intersect_par_##T(UHash_##T *h1, UHash_##T const *h2,                          \
+                                       UHashExecutor const *ex) {                                   \
+        unsigned const n_tasks = p_uhash_par_tasks(ex);                                             \
+        if (n_tasks == 1 || h1 == h2) {                                                             \
+            uhset_intersect_##T(h1, h2);                                                            \
+            return;                                                                                 \
+        }                                                                                           \
+                                                                                                    \
+        uhash_uint const n = h1->n_buckets;                                                         \
+        size_t const size = n_tasks * sizeof(uhash_uint) + n;                                       \
+        uhash_uint *block = p_uhash_malloc(h1->allocator, size);                                    \
+                                                                                                    \
+        if (!block) {                                                                               \
+            uhset_intersect_##T(h1, h2);                                                            \
+            return;                                                                                 \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_iter_prepare_##T(h1);                                                               \
+        p_uhash_iter_prepare_##T(h2);                                                               \
+        UHashParTask_##T task = {                                                                   \
+            .lookup = h2, .scan = h1, .counts = block,                                              \
+            .marks = (uint8_t *)(block + n_tasks), .n_tasks = n_tasks                               \
+        };                                                                                          \
+        ex->run_fn(ex->ctx, n_tasks, p_uhash_par_probe_##T, &task);                                 \
+                                                                                                    \
+        uhash_uint missing = 0;                                                                     \
+        for (unsigned t = 0; t != n_tasks; ++t) missing += block[t];                                \
+                                                                                                    \
+        /* Deletion may move keys between buckets, so keys are collected before removal. */         \
+        uh_key *keys = missing ? p_uhash_malloc(h1->allocator, missing * sizeof(*keys)) : NULL;     \
+                                                                                                    \
+        if (keys) {                                                                                 \
+            for (uhash_uint i = 0, j = 0; j != missing; ++i) {                                      \
+                if (task.marks[i]) keys[j++] = h1->keys[i];                                         \
+            }                                                                                       \
+            for (uhash_uint j = 0; j != missing; ++j) uhset_remove_##T(h1, keys[j], NULL);          \
+            p_uhash_free(h1->allocator, keys, missing * sizeof(*keys));                             \
+        } else if (missing) {                                                                       \
+            uhset_intersect_##T(h1, h2);                                                            \
+        }                                                                                           \
+                                                                                                    \
+        p_uhash_free(h1->allocator, block, size);                                                   \
+    }
+
+/*
+ * Generates functions reading and writing images of the specified hash table type.
+ * Images store the buckets as they are laid out in memory, so that they can be
+ * used in place by read-only tables.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_IMPL_IMAGE(T, SCOPE, uh_key, uh_val)                                                \
+                                                                                                    \
+    p_uhash_static_inline uint64_t p_uhash_image_flags_size_##T(uint64_t n_buckets) {               \
+        if (!n_buckets) return 0;                                                                   \
+        if (sizeof(*((UHash_##T *)0)->flags) == 1) return n_buckets;                                \
+        return p_uhf_size(n_buckets) * sizeof(uint32_t);                                            \
+    }                                                                                               \
+                                                                                                    \
+    /* Computes the offsets of flags, keys and values, returning the size of the image. */          \
+    p_uhash_static_inline size_t p_uhash_image_offsets_##T(UHashImageHeader const *header,          \
+                                                          size_t off[3]) {                          \
+        size_t const n = (size_t)header->n_buckets;                                                 \
+        off[0] = p_uhash_image_align(sizeof(*header));                                              \
+        off[1] = off[0] + p_uhash_image_align((size_t)header->flags_size);                          \
+        off[2] = off[1] + p_uhash_image_align(n * header->key_size);                                \
+        return off[2] + p_uhash_image_align(header->val_size ? p_uhash_vals_size_##T(n) : 0);       \
+    }                                                                                               \
+                                                                                                    \
+    p_uhash_static_inline UHashImageHeader p_uhash_image_header_##T(UHash_##T const *h,             \
+                                                                   uint32_t hash_id) {              \
+        UHashImageHeader const header = {                                                           \
+            .magic = P_UHASH_IMAGE_MAGIC,                                                           \
+            .version = P_UHASH_IMAGE_VERSION,                                                       \
+            .layout = (uint8_t)p_uhash_layout_##T(),                                                \
+            .uint_size = sizeof(uhash_uint),                                                        \
+            .hash_id = hash_id,                                                                     \
+            .key_size = sizeof(uh_key),                                                             \
+            .val_size = h->vals ? sizeof(uh_val) : 0,                                               \
+            .n_buckets = h->n_buckets,                                                              \
+            .n_occupied = h->n_occupied,                                                            \
+            .count = h->count,                                                                      \
+            .flags_size = p_uhash_image_flags_size_##T(h->n_buckets)                                \
+        };                                                                                          \
+        return header;                                                                              \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE size_t uhash_image_size_##T(UHash_##T const *h) {                                         \
+        if (!p_uhash_layout_##T()) return 0;                                                        \
+        UHashImageHeader const header = p_uhash_image_header_##T(h, 0);                             \
+        size_t off[3];                                                                              \
+        return p_uhash_image_offsets_##T(&header, off);                                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_image_write_##T(UHash_##T const *h, uint32_t hash_id, void *buf,          \
+                                          size_t size) {                                            \
+        if (!p_uhash_layout_##T()) return UHASH_ERR;                                                \
+        p_uhash_iter_prepare_##T(h);                                                                \
+                                                                                                    \
+        UHashImageHeader const header = p_uhash_image_header_##T(h, hash_id);                       \
+        size_t off[3];                                                                              \
+        size_t const image_size = p_uhash_image_offsets_##T(&header, off);                          \
+        if (image_size > size) return UHASH_ERR;                                                    \
+                                                                                                    \
+        /* Padding is zeroed, so that equal tables have equal images. */                            \
+        uint8_t *image = buf;                                                                       \
+        memset(image, 0, image_size);                                                               \
+        memcpy(image, &header, sizeof(header));                                                     \
+                                                                                                    \
+        if (h->n_buckets) {                                                                         \
+            memcpy(image + off[0], h->flags, (size_t)header.flags_size);                            \
+            memcpy(image + off[1], h->keys, h->n_buckets * sizeof(uh_key));                         \
+            if (h->vals) memcpy(image + off[2], h->vals, p_uhash_vals_size_##T(h->n_buckets));      \
+        }                                                                                           \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_image_load_##T(UHash_##T *h, uint32_t hash_id, void const *image,         \
+                                         size_t size) {                                             \
+        UHashImageHeader header;                                                                    \
+        if (!p_uhash_layout_##T() || size < sizeof(header)) return UHASH_ERR;                       \
+        memcpy(&header, image, sizeof(header));                                                     \
+                                                                                                    \
+        if (header.magic != P_UHASH_IMAGE_MAGIC || header.version != P_UHASH_IMAGE_VERSION ||       \
+            header.layout != p_uhash_layout_##T() || header.uint_size != sizeof(uhash_uint) ||      \
+            header.hash_id != hash_id || header.key_size != sizeof(uh_key) ||                       \
+            (header.val_size && header.val_size != sizeof(uh_val)) || header.reserved ||            \
+            header.n_buckets > size || header.n_buckets > p_uhash_idx_max(T) ||                     \
+            !p_uhash_layout_fits(header.layout, header.n_buckets) ||                                \
+            header.n_occupied > header.n_buckets || header.count > header.n_occupied ||             \
+            header.flags_size != p_uhash_image_flags_size_##T(header.n_buckets)) {                  \
+            return UHASH_ERR;                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        size_t off[3];                                                                              \
+        if (p_uhash_image_offsets_##T(&header, off) > size) return UHASH_ERR;                       \
+                                                                                                    \
+        /* Buckets are used in place: the table must never be modified. */                          \
+        uintptr_t const base = (uintptr_t)image;                                                    \
+        bool const empty = !header.n_buckets;                                                       \
+        h->n_buckets = (uhash_##T##_idx)header.n_buckets;                                           \
+        h->n_occupied = (uhash_##T##_idx)header.n_occupied;                                         \
+        h->count = (uhash_##T##_idx)header.count;                                                   \
+        h->flags = empty ? NULL : (void *)(base + off[0]);                                          \
+        h->keys = empty ? NULL : (uh_key *)(base + off[1]);                                         \
+        h->vals = empty || !header.val_size ? NULL : (uh_val *)(base + off[2]);                     \
+        return UHASH_OK;                                                                            \
+    }
+
+/*
+ * Generates functions streaming the contents of the specified hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ */
+#define P_UHASH_IMPL_STREAM(T, SCOPE, uh_key, uh_val)                                               \
+                                                                                                    \
+    /* Checks whether bucket i must be streamed, either from h or, for deletions, from prev. */     \
+    p_uhash_static_inline bool p_uhash_stream_selected_##T(UHash_##T const *h,                      \
+                                                           UHash_##T const *prev,                   \
+                                                           bool deletion, uhash_uint i) {           \
+        if (deletion) {                                                                             \
+            if (!uhash_exists(prev, i)) return false;                                               \
+            uhash_uint const hash = p_uhash_key_hash_##T(h, prev, i);                               \
+            return p_uhash_get_h_##T(h, prev->keys[i], hash) == UHASH_INDEX_MISSING;                \
+        }                                                                                           \
+        if (!uhash_exists(h, i)) return false;                                                      \
+        if (!prev) return true;                                                                     \
+        uhash_uint const j = p_uhash_get_h_##T(prev, h->keys[i], p_uhash_key_hash_##T(prev, h, i)); \
+        if (j == UHASH_INDEX_MISSING) return true;                                                  \
+        if (!h->vals || !prev->vals) return false;                                                  \
+        uh_val const val = p_uhash_val_##T(h, i), prev_val = p_uhash_val_##T(prev, j);              \
+        return memcmp(&val, &prev_val, sizeof(uh_val));                                             \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_stream_write_##T(UHash_##T const *h, UHash_##T const *prev,               \
+                                           UHashStream *s) {                                        \
+        p_uhash_iter_prepare_##T(h);                                                                \
+        if (prev) p_uhash_iter_prepare_##T(prev);                                                   \
+                                                                                                    \
+        uhash_uint const end = h->n_buckets + (prev ? prev->n_buckets : 0);                         \
+        if (s->cursor >= end) {                                                                     \
+            s->done = true;                                                                         \
+            return UHASH_OK;                                                                        \
+        }                                                                                           \
+                                                                                                    \
+        /* Updates are followed by deletions, which never share a chunk. */                         \
+        bool const deletion = s->cursor >= h->n_buckets;                                            \
+        uhash_uint const phase_end = deletion ? end : h->n_buckets;                                 \
+        UHashStreamChunk chunk = {                                                                  \
+            .magic = P_UHASH_STREAM_MAGIC,                                                          \
+            .deletion = deletion,                                                                   \
+            .key_size = sizeof(uh_key),                                                             \
+            .val_size = !deletion && h->vals ? sizeof(uh_val) : 0                                   \
+        };                                                                                          \
+                                                                                                    \
+        enum {                                                                                      \
+            MAX_RECORD = sizeof(uh_key) + sizeof(uh_val),                                           \
+            MIN_SIZE = sizeof(UHashStreamChunk) + MAX_RECORD,                                       \
+            BUF_SIZE = UHASH_STREAM_BUF > MIN_SIZE ? UHASH_STREAM_BUF : MIN_SIZE                    \
+        };                                                                                          \
+        uint8_t buf[BUF_SIZE];                                                                      \
+        size_t const record = chunk.key_size + chunk.val_size;                                      \
+        size_t const max_count = (BUF_SIZE - sizeof(chunk)) / record;                               \
+        size_t used = sizeof(chunk);                                                                \
+                                                                                                    \
+        uhash_uint i = s->cursor;                                                                   \
+        for (; i != phase_end && chunk.count != max_count; ++i) {                                   \
+            uhash_uint const b = deletion ? i - h->n_buckets : i;                                   \
+            if (!p_uhash_stream_selected_##T(h, prev, deletion, b)) continue;                       \
+            memcpy(buf + used, deletion ? &prev->keys[b] : &h->keys[b], sizeof(uh_key));            \
+            if (chunk.val_size) {                                                                   \
+                uh_val const val = p_uhash_val_##T(h, b);                                           \
+                memcpy(buf + used + sizeof(uh_key), &val, sizeof(val));                             \
+            }                                                                                       \
+            used += record;                                                                         \
+            chunk.count++;                                                                          \
+        }                                                                                           \
+                                                                                                    \
+        if (chunk.count) {                                                                          \
+            memcpy(buf, &chunk, sizeof(chunk));                                                     \
+            if (s->write_fn(s->ctx, buf, used) == UHASH_ERR) return UHASH_ERR;                      \
+        }                                                                                           \
+                                                                                                    \
+        s->cursor = i;                                                                              \
+        s->done = i == end;                                                                         \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_stream_apply_##T(UHash_##T *h, void const *data, size_t size,             \
+                                           size_t *consumed) {                                      \
+        uint8_t const *bytes = data;                                                                \
+        size_t off = 0;                                                                             \
+        uhash_ret ret = UHASH_OK;                                                                   \
+                                                                                                    \
+        while (size - off >= sizeof(UHashStreamChunk)) {                                            \
+            UHashStreamChunk chunk;                                                                 \
+            memcpy(&chunk, bytes + off, sizeof(chunk));                                             \
+            size_t const val_size = h->vals && !chunk.deletion ? sizeof(uh_val) : 0;                \
+                                                                                                    \
+            if (chunk.magic != P_UHASH_STREAM_MAGIC || chunk.key_size != sizeof(uh_key) ||          \
+                chunk.val_size != val_size) {                                                       \
+                ret = UHASH_ERR;                                                                    \
+                break;                                                                              \
+            }                                                                                       \
+                                                                                                    \
+            /* Incomplete chunks are left to the next call. */                                      \
+            size_t const record = sizeof(uh_key) + val_size;                                        \
+            size_t const avail = size - off - sizeof(chunk);                                        \
+            if (avail / record < chunk.count) break;                                                \
+                                                                                                    \
+            uint8_t const *r = bytes + off + sizeof(chunk);                                         \
+            for (uint32_t j = 0; j != chunk.count; ++j, r += record) {                              \
+                uh_key key;                                                                         \
+                memcpy(&key, r, sizeof(key));                                                       \
+                if (chunk.deletion) {                                                               \
+                    uhash_uint const i = uhash_get_##T(h, key);                                     \
+                    if (i != UHASH_INDEX_MISSING) uhash_delete_##T(h, i);                           \
+                } else if (val_size) {                                                              \
+                    uh_val val;                                                                     \
+                    memcpy(&val, r + sizeof(key), sizeof(val));                                     \
+                    ret = uhmap_set_##T(h, key, val, NULL);                                         \
+                } else {                                                                            \
+                    ret = uhset_insert_##T(h, key, NULL);                                           \
+                }                                                                                   \
+                if (ret == UHASH_ERR) break;                                                        \
+            }                                                                                       \
+                                                                                                    \
+            /* Records of partially applied chunks can be applied again. */                         \
+            if (ret == UHASH_ERR) break;                                                            \
+            off += sizeof(chunk) + chunk.count * record;                                            \
+        }                                                                                           \
+                                                                                                    \
+        if (consumed) *consumed = off;                                                              \
+        return ret == UHASH_ERR ? UHASH_ERR : UHASH_OK;                                             \
+    }
+
+/*
+ * Generates functions computing statistics about the buckets of the specified hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ */
+#define P_UHASH_IMPL_STATS(T, SCOPE)                                                                \
+                                                                                                    \
+    SCOPE void uhash_stats_##T(UHash_##T const *h, UHashStats *stats) {                             \
+        p_uhash_iter_prepare_##T(h);                                                                \
+        memset(stats, 0, sizeof(*stats));                                                           \
+        p_uhash_get_counters(h, &stats->counters);                                                  \
+                                                                                                    \
+        stats->count = h->count;                                                                    \
+        stats->n_buckets = h->n_buckets;                                                            \
+        stats->tombstones = h->n_occupied - h->count;                                               \
+        stats->bytes = p_uhash_bytes_##T(h);                                                        \
+        if (!h->n_buckets) return;                                                                  \
+                                                                                                    \
+        uint64_t probes = 0, runs = 0;                                                              \
+        uhash_uint run = 0;                                                                         \
+                                                                                                    \
+        for (uhash_uint i = 0; i != h->n_buckets; ++i) {                                            \
+            if (!uhash_exists(h, i)) {                                                              \
+                if (run) runs++;                                                                    \
+                run = 0;                                                                            \
+                continue;                                                                           \
+            }                                                                                       \
+            uhash_uint const len = p_uhash_probe_len_##T(h, i);                                     \
+            probes += len;                                                                          \
+            if (len > stats->max_probe) stats->max_probe = len;                                     \
+            stats->probe_hist[len < UHASH_STATS_BINS - 1 ? len : UHASH_STATS_BINS - 1]++;           \
+            if (++run > stats->max_run) stats->max_run = run;                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (run) runs++;                                                                            \
+        stats->load_factor = (double)h->count / h->n_buckets;                                       \
+        stats->tombstone_ratio = (double)stats->tombstones / h->n_buckets;                          \
+        if (!h->count) return;                                                                      \
+        stats->bytes_per_entry = (double)stats->bytes / h->count;                                   \
+        stats->mean_probe = (double)probes / h->count;                                              \
+        stats->mean_run = (double)h->count / (double)runs;                                          \
+    }
+
+/*
+ * Generates common function definitions for the specified hash table type.
+ * These functions do not depend on the bucket layout, and are shared by all hash table variants.
+ *
+ * @param T [symbol] Hash table name.
+ * @param SCOPE [scope] Scope of the definitions.
+ * @param uh_key [type] Hash table key type.
+ * @param uh_val [type] Hash table value type.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ */
+#define P_UHASH_IMPL_COMMON(T, SCOPE, uh_key, uh_val, hash_func, equal_func)                        \
+                                                                                                    \
+    SCOPE uhash_ret uhash_copy_##T(UHash_##T const *src, UHash_##T *dest) {                         \
+        uhash_ret ret = uhash_copy_as_set_##T(src, dest);                                           \
+                                                                                                    \
+        if (ret == UHASH_OK && src->vals) {                                                         \
+            if (p_uhash_storage_fit_vals_##T(dest)) return UHASH_ERR;                               \
+            memcpy(dest->vals, src->vals, p_uhash_vals_size_##T(src->n_buckets));                   \
+        }                                                                                           \
+                                                                                                    \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_copy_into_##T(UHash_##T const *src, UHash_##T *dest) {                    \
+        if (src == dest) return UHASH_OK;                                                           \
+                                                                                                    \
+        /* Buckets of the same size are copied bytewise, smaller ones are reallocated. */           \
+        if (dest->n_buckets <= src->n_buckets || (src->vals && !dest->vals) ||                      \
+            dest->refs) {                                                                           \
+            return uhash_copy_##T(src, dest);                                                       \
+        }                                                                                           \
+                                                                                                    \
+        /* Larger buckets are kept, and the keys are rehashed into them. */                         \
+        p_uhash_iter_prepare_##T(src);                                                              \
+        uhash_clear_##T(dest);                                                                      \
+                                                                                                    \
+        p_uhash_for_buckets(src, i) {                                                               \
+            uhash_uint k;                                                                           \
+            uhash_uint const hash = p_uhash_key_hash_##T(dest, src, i);                             \
+            if (p_uhash_put_h_##T(dest, src->keys[i], hash, &k) == UHASH_ERR) return UHASH_ERR;     \
+            if (src->vals) p_uhash_set_val_##T(dest, k, p_uhash_val_##T(src, i));                   \
+            p_uhash_publish_##T(dest, k);                                                           \
+        }                                                                                           \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T *uhash_clone_##T(UHash_##T *src) {                                              \
+        UHash_##T *h = p_uhash_malloc(src->allocator, sizeof(*h));                                  \
+        if (!h) return NULL;                                                                        \
+                                                                                                    \
+        if (!p_uhash_shareable_##T(src)) {                                                          \
+            *h = (UHash_##T) { .allocator = src->allocator, .max_load = src->max_load };            \
+            if (uhash_copy_##T(src, h) == UHASH_OK) return h;                                       \
+            uhash_free_##T(h);                                                                      \
+            return NULL;                                                                            \
+        }                                                                                           \
+                                                                                                    \
+        if (src->n_buckets && !src->refs) {                                                         \
+            src->refs = p_uhash_malloc(src->allocator, sizeof(*src->refs));                         \
+            if (!src->refs) {                                                                       \
+                p_uhash_free(src->allocator, h, sizeof(*h));                                        \
+                return NULL;                                                                        \
+            }                                                                                       \
+            *src->refs = 1;                                                                         \
+        }                                                                                           \
+                                                                                                    \
+        /* Tables without buckets have nothing to share. */                                         \
+        if (src->refs) p_uhash_ref_add(src->refs);                                                  \
+        *h = *src;                                                                                  \
+        uhash_reset_counters(h);                                                                    \
+        return h;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_unshare_##T(UHash_##T *h) {                                               \
+        return p_uhash_unshare_##T(h, true);                                                        \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_reserve_##T(UHash_##T *h, uhash_uint count) {                             \
+        uhash_uint const n_buckets = p_uhash_fit_##T(h, count);                                     \
+        return n_buckets > h->n_buckets ? uhash_resize_##T(h, n_buckets) : UHASH_OK;                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_set_max_load_##T(UHash_##T *h, double max_load) {                         \
+        if (!(max_load > 0 && max_load < 1)) return UHASH_ERR;                                      \
+        h->max_load = max_load;                                                                     \
+        h->max_occupied = (uhash_##T##_idx)p_uhash_bound(h->n_buckets, max_load);                   \
+        if (!h->n_buckets || h->n_occupied <= h->max_occupied) return UHASH_OK;                     \
+        return uhash_resize_##T(h, p_uhash_fit_##T(h, h->count));                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T* uhset_alloc_load_##T(double max_load) {                                        \
+        UHash_##T *set = uhset_alloc_##T();                                                         \
+        if (set && uhash_set_max_load_##T(set, max_load)) {                                         \
+            uhash_free_##T(set);                                                                    \
+            return NULL;                                                                            \
+        }                                                                                           \
+        return set;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T* uhmap_alloc_load_##T(double max_load) {                                        \
+        UHash_##T *map = uhmap_alloc_##T();                                                         \
+        if (map && uhash_set_max_load_##T(map, max_load)) {                                         \
+            uhash_free_##T(map);                                                                    \
+            return NULL;                                                                            \
+        }                                                                                           \
+        return map;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_compact_##T(UHash_##T *h) {                                               \
+        /* Rehashing at the same size clears deleted buckets. */                                    \
+        if (!h->n_buckets || h->n_occupied == h->count) return UHASH_OK;                            \
+        return uhash_resize_##T(h, h->n_buckets);                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T* uhmap_alloc_with_##T(UHashAllocator const *allocator) {                        \
+        UHash_##T *map = uhset_alloc_with_##T(allocator);                                           \
+        if (!map) return NULL;                                                                      \
+                                                                                                    \
+        if (uhash_resize_##T(map, 1) || p_uhash_storage_fit_vals_##T(map)) {                        \
+            uhash_free_##T(map);                                                                    \
+            return NULL;                                                                            \
+        }                                                                                           \
+                                                                                                    \
+        return map;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T* uhmap_alloc_##T(void) {                                                        \
+        return uhmap_alloc_with_##T(NULL);                                                          \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhash_get_with_hash_##T(UHash_##T const *h, uh_key key, uhash_uint hash) {     \
+        return p_uhash_get_h_##T(h, key, hash);                                                     \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhash_put_with_hash_##T(UHash_##T *h, uh_key key, uhash_uint hash,              \
+                                            uhash_uint *idx) {                                      \
+        return p_uhash_put_h_##T(h, key, hash, idx);                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uh_val uhmap_get_##T(UHash_##T const *h, uh_key key, uh_val if_missing) {                 \
+        p_uhash_analyzer_assert(h->vals);                                                           \
+        uhash_uint k = uhash_get_##T(h, key);                                                       \
+        return k == UHASH_INDEX_MISSING ? if_missing : p_uhash_val_##T(h, k);                       \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uh_val uhmap_get_with_hash_##T(UHash_##T const *h, uh_key key, uhash_uint hash,           \
+                                         uh_val if_missing) {                                       \
+        p_uhash_analyzer_assert(h->vals);                                                           \
+        uhash_uint k = uhash_get_with_hash_##T(h, key, hash);                                       \
+        return k == UHASH_INDEX_MISSING ? if_missing : p_uhash_val_##T(h, k);                       \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhmap_set_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *existing) {       \
+        p_uhash_analyzer_assert(h->vals);                                                           \
+                                                                                                    \
+        uhash_uint k;                                                                               \
+        uhash_ret ret = uhash_put_##T(h, key, &k);                                                  \
+                                                                                                    \
+        if (ret != UHASH_ERR) {                                                                     \
+            if (ret == UHASH_PRESENT && existing) *existing = p_uhash_val_##T(h, k);                \
+            p_uhash_set_val_##T(h, k, value);                                                       \
+            if (ret == UHASH_INSERTED) p_uhash_publish_##T(h, k);                                   \
+        }                                                                                           \
+                                                                                                    \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhmap_add_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *existing) {       \
+        p_uhash_analyzer_assert(h->vals);                                                           \
+                                                                                                    \
+        uhash_uint k;                                                                               \
+        uhash_ret ret = uhash_put_##T(h, key, &k);                                                  \
+                                                                                                    \
+        if (ret == UHASH_INSERTED) {                                                                \
+            p_uhash_set_val_##T(h, k, value);                                                       \
+            p_uhash_publish_##T(h, k);                                                              \
+        } else if (ret == UHASH_PRESENT && existing) {                                              \
+            *existing = p_uhash_val_##T(h, k);                                                      \
+        }                                                                                           \
+                                                                                                    \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhmap_replace_##T(UHash_##T *h, uh_key key, uh_val value, uh_val *replaced) {        \
+        p_uhash_analyzer_assert(h->vals);                                                           \
+        uhash_uint k = uhash_get_##T(h, key);                                                       \
+        if (k == UHASH_INDEX_MISSING || p_uhash_unshare_##T(h, true)) return false;                 \
+        if (replaced) *replaced = p_uhash_val_##T(h, k);                                            \
+        p_uhash_set_val_##T(h, k, value);                                                           \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhmap_remove_##T(UHash_##T *h, uh_key key, uh_key *r_key, uh_val *r_val) {           \
+        uhash_uint k = uhash_get_##T(h, key);                                                       \
+        if (k == UHASH_INDEX_MISSING || p_uhash_unshare_##T(h, true)) return false;                 \
+        if (r_key) *r_key = h->keys[k];                                                             \
+        if (r_val) *r_val = p_uhash_val_##T(h, k);                                                  \
+        uhash_delete_##T(h, k);                                                                     \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhset_insert_##T(UHash_##T *h, uh_key key, uh_key *existing) {                  \
+        uhash_uint k;                                                                               \
+        uhash_ret ret = uhash_put_##T(h, key, &k);                                                  \
+        if (ret == UHASH_PRESENT && existing) *existing = h->keys[k];                               \
+        if (ret == UHASH_INSERTED) p_uhash_publish_##T(h, k);                                       \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhash_get_batch_##T(UHash_##T const *h, uh_key const *keys, uhash_uint n,            \
+                                   uhash_uint *idx) {                                               \
+        uhash_uint hashes[P_UHASH_BATCH_SIZE];                                                      \
+                                                                                                    \
+        for (uhash_uint b = 0; b < n; b += P_UHASH_BATCH_SIZE) {                                    \
+            uhash_uint const len = n - b < P_UHASH_BATCH_SIZE ? n - b : P_UHASH_BATCH_SIZE;         \
+                                                                                                    \
+            /* Hash the whole batch first, so that all its buckets are fetched in parallel. */      \
+            for (uhash_uint i = 0; i < len; ++i) {                                                  \
+                hashes[i] = (uhash_uint)(hash_func(keys[b + i]));                                   \
+                p_uhash_prefetch_##T(h, hashes[i]);                                                 \
+            }                                                                                       \
+                                                                                                    \
+            for (uhash_uint i = 0; i < len; ++i) {                                                  \
+                idx[b + i] = p_uhash_get_h_##T(h, keys[b + i], hashes[i]);                          \
+            }                                                                                       \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhmap_get_batch_##T(UHash_##T const *h, uh_key const *keys, uhash_uint n,            \
+                                   uh_val *vals, uh_val if_missing) {                               \
+        p_uhash_analyzer_assert(h->vals);                                                           \
+        uhash_uint idx[P_UHASH_BATCH_SIZE];                                                         \
+                                                                                                    \
+        for (uhash_uint b = 0; b < n; b += P_UHASH_BATCH_SIZE) {                                    \
+            uhash_uint const len = n - b < P_UHASH_BATCH_SIZE ? n - b : P_UHASH_BATCH_SIZE;         \
+            uhash_get_batch_##T(h, keys + b, len, idx);                                             \
+                                                                                                    \
+            for (uhash_uint i = 0; i < len; ++i) {                                                  \
+                uhash_uint const k = idx[i];                                                        \
+                vals[b + i] = k == UHASH_INDEX_MISSING ? if_missing : p_uhash_val_##T(h, k);        \
+            }                                                                                       \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhset_insert_batch_##T(UHash_##T *h, uh_key const *items, uhash_uint n) {       \
+        uhash_uint hashes[P_UHASH_BATCH_SIZE];                                                      \
+        uhash_ret ret = UHASH_PRESENT;                                                              \
+                                                                                                    \
+        for (uhash_uint b = 0; b < n; b += P_UHASH_BATCH_SIZE) {                                    \
+            uhash_uint const len = n - b < P_UHASH_BATCH_SIZE ? n - b : P_UHASH_BATCH_SIZE;         \
+                                                                                                    \
+            for (uhash_uint i = 0; i < len; ++i) {                                                  \
+                hashes[i] = (uhash_uint)(hash_func(items[b + i]));                                  \
+                p_uhash_prefetch_##T(h, hashes[i]);                                                 \
+            }                                                                                       \
+                                                                                                    \
+            for (uhash_uint i = 0; i < len; ++i) {                                                  \
+                /* Resizing only makes the prefetched lines useless, the hashes are still valid. */ \
+                uhash_uint k;                                                                       \
+                uhash_ret l_ret = p_uhash_put_h_##T(h, items[b + i], hashes[i], &k);                \
+                if (l_ret == UHASH_ERR) return UHASH_ERR;                                           \
+                if (l_ret == UHASH_INSERTED) {                                                      \
+                    p_uhash_publish_##T(h, k);                                                      \
+                    ret = UHASH_INSERTED;                                                           \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        return ret;                                                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhset_insert_all_##T(UHash_##T *h, uh_key const *items, uhash_uint n) {         \
+        if (uhash_reserve_##T(h, h->count + n)) return UHASH_ERR;                                   \
+        return uhset_insert_batch_##T(h, items, n);                                                 \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhset_replace_##T(UHash_##T *h, uh_key key, uh_key *replaced) {                      \
+        uhash_uint k = uhash_get_##T(h, key);                                                       \
+        if (k == UHASH_INDEX_MISSING || p_uhash_unshare_##T(h, true)) return false;                 \
+        if (replaced) *replaced = h->keys[k];                                                       \
+        h->keys[k] = key;                                                                           \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhset_remove_##T(UHash_##T *h, uh_key key, uh_key *removed) {                        \
+        uhash_uint k = uhash_get_##T(h, key);                                                       \
+        if (k == UHASH_INDEX_MISSING || p_uhash_unshare_##T(h, true)) return false;                 \
+        if (removed) *removed = h->keys[k];                                                         \
+        uhash_delete_##T(h, k);                                                                     \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE bool uhset_is_superset_##T(UHash_##T const *h1, UHash_##T const *h2) {                    \
+        p_uhash_iter_prepare_##T(h2);                                                               \
+        p_uhash_for_buckets(h2, i) {                                                                \
+            uhash_uint const hash = p_uhash_key_hash_##T(h1, h2, i);                                \
+            if (p_uhash_get_h_##T(h1, h2->keys[i], hash) == UHASH_INDEX_MISSING) return false;      \
+        }                                                                                           \
+        return true;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_ret uhset_union_##T(UHash_##T *h1, UHash_##T const *h2) {                           \
+        p_uhash_iter_prepare_##T(h2);                                                               \
+        p_uhash_for_buckets(h2, i) {                                                                \
+            uhash_uint k, hash = p_uhash_key_hash_##T(h1, h2, i);                                   \
+            uhash_ret ret = p_uhash_put_h_##T(h1, h2->keys[i], hash, &k);                           \
+            if (ret == UHASH_ERR) return UHASH_ERR;                                                 \
+            if (ret == UHASH_INSERTED) p_uhash_publish_##T(h1, k);                                  \
+        }                                                                                           \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE void uhset_intersect_##T(UHash_##T *h1, UHash_##T const *h2) {                            \
+        p_uhash_iter_prepare_##T(h1);                                                               \
+        uhash_uint const n = h1->n_buckets;                                                         \
+        for (uhash_uint i = p_uhash_next(h1->flags, n, 0); i != n;) {                               \
+            if (p_uhash_get_h_##T(h2, h1->keys[i], p_uhash_key_hash_##T(h2, h1, i)) ==              \
+                UHASH_INDEX_MISSING) {                                                              \
+                /* Deletion may move another key into bucket i, so it must be checked again. */     \
+                uhash_delete_##T(h1, i);                                                            \
+                i = p_uhash_next(h1->flags, n, i);                                                  \
+            } else {                                                                                \
+                i = p_uhash_next(h1->flags, n, i + 1);                                              \
+            }                                                                                       \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    /* Inserts the keys of the sets into h, sized for the largest one: the others usually           \
+       overlap it, and their remaining keys grow the table as they are inserted. */                 \
+    p_uhash_static_inline uhash_ret p_uhash_union_many_##T(UHash_##T *h,                            \
+                                                           UHash_##T const *const *sets,            \
+                                                           uhash_uint n) {                          \
+        uhash_uint count = 0;                                                                       \
+        for (uhash_uint j = 0; j < n; ++j) {                                                        \
+            if (sets[j]->count > count) count = sets[j]->count;                                     \
+        }                                                                                           \
+        if (uhash_reserve_##T(h, count)) return UHASH_ERR;                                          \
+                                                                                                    \
+        for (uhash_uint j = 0; j < n; ++j) {                                                        \
+            UHash_##T const *s = sets[j];                                                           \
+            p_uhash_iter_prepare_##T(s);                                                            \
+            p_uhash_for_buckets(s, i) {                                                             \
+                uhash_uint k, hash = p_uhash_key_hash_##T(h, s, i);                                 \
+                uhash_ret ret = p_uhash_put_h_##T(h, s->keys[i], hash, &k);                         \
+                if (ret == UHASH_ERR) return UHASH_ERR;                                             \
+                if (ret == UHASH_INSERTED) p_uhash_publish_##T(h, k);                               \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    /* Inserts the keys of sorted[0] found in all the other sets, sorted by count, into h. */       \
+    p_uhash_static_inline uhash_ret p_uhash_intersect_many_##T(UHash_##T *h,                        \
+                                                               UHash_##T const **sorted,            \
+                                                               uhash_uint n) {                      \
+        /* The intersection is empty if any set is, and at most as large as the smallest one. */    \
+        UHash_##T const *s = sorted[0];                                                             \
+        if (!s->count) return UHASH_OK;                                                             \
+        if (uhash_reserve_##T(h, s->count)) return UHASH_ERR;                                       \
+                                                                                                    \
+        p_uhash_iter_prepare_##T(s);                                                                \
+        p_uhash_for_buckets(s, i) {                                                                 \
+            uhash_uint j = 1;                                                                       \
+            for (; j < n; ++j) {                                                                    \
+                UHash_##T const *o = sorted[j];                                                     \
+                if (o == s) continue;                                                               \
+                uhash_uint const hash = p_uhash_key_hash_##T(o, s, i);                              \
+                if (p_uhash_get_h_##T(o, s->keys[i], hash) == UHASH_INDEX_MISSING) break;           \
+            }                                                                                       \
+            if (j < n) continue;                                                                    \
+                                                                                                    \
+            uhash_uint k;                                                                           \
+            uhash_uint const hash = p_uhash_key_hash_##T(h, s, i);                                  \
+            if (p_uhash_put_h_##T(h, s->keys[i], hash, &k) == UHASH_ERR) return UHASH_ERR;          \
+            p_uhash_publish_##T(h, k);                                                              \
+        }                                                                                           \
+                                                                                                    \
+        return UHASH_OK;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T *uhset_union_many_##T(UHash_##T const *const *sets, uhash_uint n) {             \
+        if (!n) return NULL;                                                                        \
+        UHash_##T *h = uhset_alloc_with_##T(sets[0]->allocator);                                    \
+        if (h && p_uhash_union_many_##T(h, sets, n)) {                                              \
+            uhash_free_##T(h);                                                                      \
+            return NULL;                                                                            \
+        }                                                                                           \
+        return h;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE UHash_##T *uhset_intersect_many_##T(UHash_##T const *const *sets, uhash_uint n) {         \
+        if (!n) return NULL;                                                                        \
+        UHashAllocator const *allocator = sets[0]->allocator;                                       \
+        UHash_##T *h = uhset_alloc_with_##T(allocator);                                             \
+        if (!h) return NULL;                                                                        \
+                                                                                                    \
+        /* Sets are probed by increasing count, so that most missing keys are rejected early. */    \
+        size_t const size = n * sizeof(*sets);                                                      \
+        UHash_##T const **sorted = p_uhash_malloc(allocator, size);                                 \
+                                                                                                    \
+        if (sorted) {                                                                               \
+            for (uhash_uint j = 0; j < n; ++j) {                                                    \
+                uhash_uint l = j;                                                                   \
+                for (; l && sorted[l - 1]->count > sets[j]->count; --l) sorted[l] = sorted[l - 1];  \
+                sorted[l] = sets[j];                                                                \
+            }                                                                                       \
+        }                                                                                           \
+                                                                                                    \
+        if (!sorted || p_uhash_intersect_many_##T(h, sorted, n)) {                                  \
+            uhash_free_##T(h);                                                                      \
+            h = NULL;                                                                               \
+        }                                                                                           \
+                                                                                                    \
+        if (sorted) p_uhash_free(allocator, sorted, size);                                          \
+        return h;                                                                                   \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uhash_uint uhset_hash_##T(UHash_##T const *src) {                                         \
+        /* Keys are hashed with the same seed by all tables, so that equal sets hash equally. */    \
+        UHash_##T tmp;                                                                              \
+        UHash_##T const *h = p_uhash_unseeded_##T(src, &tmp);                                       \
+        p_uhash_iter_prepare_##T(h);                                                                \
+        uhash_uint hash = 0;                                                                        \
+        p_uhash_for_buckets(h, i) {                                                                 \
+            hash ^= hash_func(h->keys[i]);                                                          \
+        }                                                                                           \
+        return hash;                                                                                \
+    }                                                                                               \
+                                                                                                    \
+    SCOPE uh_key uhset_get_any_##T(UHash_##T const *h, uh_key if_empty) {                           \
+        p_uhash_iter_prepare_##T(h);                                                                \
+        uhash_uint const i = p_uhash_next(h->flags, h->n_buckets, 0);                               \
+        return i == h->n_buckets ? if_empty : h->keys[i];                                           \
+    }                                                                                               \
+                                                                                                    \
+    P_UHASH_IMPL_PAR(T, SCOPE, uh_key, hash_func)                                                   \
+    P_UHASH_IMPL_IMAGE(T, SCOPE, uh_key, uh_val)                                                    \
+    P_UHASH_IMPL_STREAM(T, SCOPE, uh_key, uh_val)                                                   \
+    P_UHASH_IMPL_STATS(T, SCOPE)
+
+// ##############
+// # Public API #
+// ##############
+
+/// @name Type definitions
+
+/**
+ * Declares a new hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL(T, uh_key, uh_val)                                                               \
+    P_UHASH_DEF_TYPE(T, uh_key, uh_val)                                                             \
+    P_UHASH_DECL(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type, prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SPEC(T, uh_key, uh_val, SPEC)                                                    \
+    P_UHASH_DEF_TYPE(T, uh_key, uh_val)                                                             \
+    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type storing its bucket and element counts as the specified type,
+ * rather than as uhash_uint. Implement it via UHASH_IMPL.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param uh_idx [symbol] Unsigned integer type of the stored counts, no wider than uhash_uint.
+ *
+ * @note The hash table API is the same as that of regular hash tables, and still takes and
+ *       returns uhash_uint. Tables grow up to the largest number of buckets that fits uh_idx,
+ *       after which insertions fail with UHASH_ERR.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_IDX(T, uh_key, uh_val, uh_idx)                                                   \
+    P_UHASH_DEF_TYPE_IDX(T, uh_key, uh_val, uh_idx)                                                 \
+    P_UHASH_DECL(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type storing its bucket and element counts as the specified type,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param uh_idx [symbol] Unsigned integer type of the stored counts, no wider than uhash_uint.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_IDX_SPEC(T, uh_key, uh_val, uh_idx, SPEC)                                        \
+    P_UHASH_DEF_TYPE_IDX(T, uh_key, uh_val, uh_idx)                                                 \
+    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type with per-instance hash and equality functions.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_PI(T, uh_key, uh_val)                                                            \
+    P_UHASH_DEF_TYPE_PI(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL_PI(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type with per-instance hash and equality functions,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_PI_SPEC(T, uh_key, uh_val, SPEC)                                                 \
+    P_UHASH_DEF_TYPE_PI(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL_PI(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type that caches the hash of each key (CH).
+ *
+ * These tables store the hash of each key in an array next to the keys and values.
+ * Resizing reuses the stored hashes instead of recomputing them, and lookups only call the
+ * equality function on buckets whose hash matches, which pays off for keys that are
+ * expensive to hash or compare (e.g. strings), at the cost of sizeof(uhash_uint) bytes per bucket.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_CH(T, uh_key, uh_val)                                                            \
+    P_UHASH_DEF_TYPE_CH(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type that caches the hash of each key,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_CH_SPEC(T, uh_key, uh_val, SPEC)                                                 \
+    P_UHASH_DEF_TYPE_CH(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type using the SIMD control byte layout.
+ *
+ * Instead of the packed 2-bit flags, these tables keep one control byte per bucket
+ * holding 7 bits of the hash of its key, and probe buckets in groups of 16 via SSE2/NEON
+ * instructions, so that keys are only compared on tag matches.
+ * This makes lookups faster when key comparisons are expensive, and allows the table
+ * to run at a higher load factor (see UHASH_SIMD_MAX_LOAD).
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @note The hash table API is the same as that of regular hash tables.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SIMD(T, uh_key, uh_val)                                                          \
+    P_UHASH_DEF_TYPE_SIMD(T, uh_key, uh_val)                                                        \
+    P_UHASH_DECL(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type using the SIMD control byte layout,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SIMD_SPEC(T, uh_key, uh_val, SPEC)                                               \
+    P_UHASH_DEF_TYPE_SIMD(T, uh_key, uh_val)                                                        \
+    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type using the SIMD control byte layout,
+ * storing the buckets of small tables inline.
+ *
+ * Tables holding up to a single group of buckets (16 buckets, of which 14 can be used
+ * at the default UHASH_SIMD_MAX_LOAD) keep them in a buffer embedded in the table,
+ * so that allocating such a table takes a single allocation, and lookups a single
+ * group probe. Larger tables move their buckets to the heap, and move them back
+ * inline if they shrink enough.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @note The hash table API is the same as that of regular hash tables.
+ * @note Tables must not be copied or moved by value, as they may reference their own buffer.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SBO(T, uh_key, uh_val)                                                           \
+    P_UHASH_DEF_TYPE_SBO(T, uh_key, uh_val)                                                         \
+    P_UHASH_DECL(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type using the SIMD control byte layout,
+ * storing the buckets of small tables inline,
+ * and prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SBO_SPEC(T, uh_key, uh_val, SPEC)                                                \
+    P_UHASH_DEF_TYPE_SBO(T, uh_key, uh_val)                                                         \
+    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type with incremental resizing.
+ *
+ * When these tables grow, the previous buckets are kept alongside the new ones and
+ * migrated UHASH_INC_STEP at a time by subsequent gets, puts and deletes, so that no single
+ * operation has to rehash the whole table. Lookups check both bucket arrays while migrating.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @note The hash table API is the same as that of regular hash tables. Explicit resizing,
+ *       copying and iteration complete any pending migration; iterating the buckets without
+ *       the iteration macros requires calling uhash_rehash_finish first.
+ * @note Lookups and iteration modify the table while it is migrating, even through const
+ *       pointers, since keys found in the old buckets are moved to the new ones so that the
+ *       returned indices are valid. Unlike regular tables, these ones therefore require
+ *       exclusive access for reads as well, and must not be looked up from multiple threads.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_INC(T, uh_key, uh_val)                                                           \
+    P_UHASH_DEF_TYPE_INC(T, uh_key, uh_val)                                                         \
+    P_UHASH_DECL_INC(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type with incremental resizing,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_INC_SPEC(T, uh_key, uh_val, SPEC)                                                \
+    P_UHASH_DEF_TYPE_INC(T, uh_key, uh_val)                                                         \
+    P_UHASH_DECL_INC(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type using Robin Hood probing.
+ *
+ * These tables use linear probing, moving keys closer to their home bucket on insertion,
+ * which bounds the variance of probe lengths and lets lookups for missing keys stop early.
+ * Deleted keys are removed by shifting the following ones back, so tables never
+ * accumulate deleted buckets.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @note The hash table API is the same as that of regular hash tables, except that
+ *       deleting a key may move others to different buckets: when deleting while iterating,
+ *       the current bucket must be checked again.
+ * @note Keys are stored at most 127 buckets away from their home bucket: inserting more than
+ *       128 keys having the same hash fails, and so may inserting keys hashed by a poor hash
+ *       function. Tables are only grown to make room for such keys while dense.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_RH(T, uh_key, uh_val)                                                            \
+    P_UHASH_DEF_TYPE_RH(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type using Robin Hood probing,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_RH_SPEC(T, uh_key, uh_val, SPEC)                                                 \
+    P_UHASH_DEF_TYPE_RH(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type supporting lock-free concurrent readers.
+ *
+ * A single writer thread can use the regular hash table API, while any number of reader
+ * threads look keys up via uhash_conc_contains and uhmap_conc_get without locking.
+ * Keys are published to readers by storing their control byte after the key (and value),
+ * and deleted buckets are not reused, so that readers never observe a partially written
+ * key. Resizing publishes new buckets by swapping a pointer, then waits for readers still
+ * using the old buckets to finish before freeing them.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @note Requires GCC or Clang atomic builtins.
+ * @note Writes must be serialized by the caller. Readers must not use any other function,
+ *       including iteration macros, and the table must not be freed while being read.
+ * @note Map values inserted via uhash_put must be published via uhash_conc_publish once set.
+ *       Other insertion functions do it automatically.
+ * @note Overwriting the value of a key that is already present, as well as uhset_replace,
+ *       is not atomic with respect to readers, unless the key and value types can be
+ *       written atomically by the platform.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_CONC(T, uh_key, uh_val)                                                          \
+    P_UHASH_DEF_TYPE_CONC(T, uh_key, uh_val)                                                        \
+    P_UHASH_DECL_CONC(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type supporting lock-free concurrent readers,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_CONC_SPEC(T, uh_key, uh_val, SPEC)                                               \
+    P_UHASH_DEF_TYPE_CONC(T, uh_key, uh_val)                                                        \
+    P_UHASH_DECL_CONC(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type whose values are unsigned integers of the specified
+ * number of bits, packed together rather than stored in a uh_val array.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param bits [integer] Bits per value (1, 2 or 4).
+ *
+ * @note The value type is uint8_t, and excess bits of stored values are discarded.
+ *       Values must be accessed via the map-specific API or the iteration macros,
+ *       since packed tables do not support uhash_value.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_PACKED(T, uh_key, bits)                                                          \
+    P_UHASH_DEF_TYPE_PACKED(T, uh_key, bits)                                                        \
+    P_UHASH_DECL(T, p_uhash_unused, uh_key, uint8_t)
+
+/**
+ * Declares a new hash table type with bit-packed values,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param bits [integer] Bits per value (1, 2 or 4).
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_PACKED_SPEC(T, uh_key, bits, SPEC)                                               \
+    P_UHASH_DEF_TYPE_PACKED(T, uh_key, bits)                                                        \
+    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uint8_t)
+
+/**
+ * Declares a new hash table type using bucketized cuckoo hashing.
+ *
+ * Buckets are split into groups of 8, and each key can be stored in either of the two
+ * groups selected by its hash, so that lookups compare the tags of at most two groups,
+ * each 8 bytes of metadata, in a single SIMD or word comparison. Insertions into two
+ * full groups evict keys to their other group, and keys still lacking room after a bounded
+ * number of evictions go to a small stash, probed only by lookups whose groups are both full.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @note The hash table API is the same as that of regular hash tables, except that
+ *       deleting a key may move others to different buckets: when deleting while iterating,
+ *       the current bucket must be checked again.
+ * @note Keys are hashed again when evicted, so the hash function should be cheap.
+ * @note Each pair of groups holds at most 24 keys, including the stash: inserting more keys
+ *       having the same hash fails, and so may inserting keys hashed by a poor hash function.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_CUCKOO(T, uh_key, uh_val)                                                        \
+    P_UHASH_DEF_TYPE_CUCKOO(T, uh_key, uh_val)                                                      \
+    P_UHASH_DECL(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type using bucketized cuckoo hashing,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_CUCKOO_SPEC(T, uh_key, uh_val, SPEC)                                             \
+    P_UHASH_DEF_TYPE_CUCKOO(T, uh_key, uh_val)                                                      \
+    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type with a per-instance hash seed, protecting from hash flooding.
+ * Tables are seeded when allocated, and their keys are hashed by a seeded hash function
+ * (e.g. uhash_str_seeded_hash), so that colliding keys cannot be crafted in advance.
+ * Insertions probing more than UHASH_FLOOD_PROBES buckets cause the next uhash_put
+ * to reseed the table and rehash its keys.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @note The hash table API is the same as that of regular hash tables. Hashes depend on the seed,
+ *       so those passed to uhash_put_with_hash must be computed by the table, and they are
+ *       invalidated by reseeding. uhset_hash hashes keys with the zero seed instead,
+ *       so that equal sets have equal hashes across tables.
+ * @note Images are not supported, as keys are placed based on the seed.
+ * @note After reseeding, flooding is only acted upon again once the table has doubled in size,
+ *       so that a weak hash function cannot cause a rehash on each insertion.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SEEDED(T, uh_key, uh_val)                                                        \
+    P_UHASH_DEF_TYPE_SEEDED(T, uh_key, uh_val)                                                      \
+    P_UHASH_DECL_SEEDED(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new hash table type with a per-instance hash seed,
+ * prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SEEDED_SPEC(T, uh_key, uh_val, SPEC)                                             \
+    P_UHASH_DEF_TYPE_SEEDED(T, uh_key, uh_val)                                                      \
+    P_UHASH_DECL_SEEDED(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Implements a previously declared hash table type, declared via UHASH_DECL or UHASH_DECL_IDX.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL(T, hash_func, equal_func)                                                        \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func,   \
+                      P_UHASH_HC_NONE, P_UHASH_VS_PLAIN)                                            \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type with per-instance hash and equality functions.
+ *
+ * @param T [symbol] Hash table name.
+ * @param default_hfunc [(uh_key) -> uhash_uint] Default hash function (can be NULL).
+ * @param default_efunc [(uh_key, uh_key) -> bool] Default equality function (can be NULL).
+ *
+ * @note Tables using the default functions call them directly rather than through pointers,
+ *       so that they can be inlined in the probe loops. This is the case for tables allocated
+ *       without explicit functions, or with the same function pointers: built-in functions
+ *       such as uhash_pi_int32_hash and uhash_pi_int32_equals make good defaults.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_PI(T, default_hfunc, default_efunc)                                              \
+    P_UHASH_IMPL_ALLOC_PI(T, p_uhash_unused, uhash_##T##_key, default_hfunc, default_efunc)         \
+    P_UHASH_IMPL_CORE(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                          \
+                      p_uhash_pi_hash_##T P_UHASH_H_ARGS, p_uhash_pi_equal_##T P_UHASH_H_ARGS,      \
+                      P_UHASH_HC_NONE, P_UHASH_VS_PLAIN)                                            \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                        \
+                        p_uhash_pi_hash_##T P_UHASH_H_ARGS, p_uhash_pi_equal_##T P_UHASH_H_ARGS)
+
+/**
+ * Implements a previously declared hash table type that caches the hash of each key.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_CH(T, hash_func, equal_func)                                                     \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func,   \
+                      P_UHASH_HC_BUCKETS, P_UHASH_VS_PLAIN)                                         \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type using the SIMD control byte layout.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_SIMD(T, hash_func, equal_func)                                                   \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE_SIMD(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                     \
+                           hash_func, equal_func, P_UHASH_IMPL_STORAGE_BYTES)                       \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type using the SIMD control byte layout,
+ * storing the buckets of small tables inline.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_SBO(T, hash_func, equal_func)                                                    \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE_SIMD(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                     \
+                           hash_func, equal_func, P_UHASH_IMPL_STORAGE_INLINE)                      \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type with incremental resizing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_INC(T, hash_func, equal_func)                                                    \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE_INC(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                      \
+                          hash_func, equal_func)                                                    \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type using Robin Hood probing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_RH(T, hash_func, equal_func)                                                     \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE_RH(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                       \
+                         hash_func, equal_func)                                                     \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type supporting lock-free concurrent readers.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_CONC(T, hash_func, equal_func)                                                   \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE_CONC(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                     \
+                           hash_func, equal_func)                                                   \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type with bit-packed values.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_PACKED(T, hash_func, equal_func)                                                 \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE(T, p_uhash_unused, uhash_##T##_key, uint8_t, hash_func, equal_func,           \
+                      P_UHASH_HC_NONE, P_UHASH_VS_PACKED)                                           \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uint8_t, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type using bucketized cuckoo hashing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_CUCKOO(T, hash_func, equal_func)                                                 \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
+    P_UHASH_IMPL_CORE_CUCKOO(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                   \
+                             hash_func, equal_func)                                                 \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+
+/**
+ * Implements a previously declared hash table type with a per-instance hash seed.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key, uint64_t) -> uhash_uint] Seeded hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_SEEDED(T, hash_func, equal_func)                                                 \
+    P_UHASH_IMPL_ALLOC_SEEDED(T, p_uhash_unused, uhash_##T##_key, hash_func)                        \
+    P_UHASH_IMPL_CORE(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                          \
+                      p_uhash_seeded_hash_##T P_UHASH_H_ARGS, equal_func,                           \
+                      P_UHASH_HC_NONE, P_UHASH_VS_SEEDED)                                           \
+    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val,                        \
+                        p_uhash_seeded_hash_##T P_UHASH_H_ARGS, equal_func)
+
+/**
+ * Defines a new static hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT(T, uh_key, uh_val, hash_func, equal_func)                                        \
+    P_UHASH_DEF_TYPE(T, uh_key, uh_val)                                                             \
+    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uh_val)                                          \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func,              \
+                      P_UHASH_HC_NONE, P_UHASH_VS_PLAIN)                                            \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type storing its bucket and element counts
+ * as the specified type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ * @param uh_idx [symbol] Unsigned integer type of the stored counts, no wider than uhash_uint.
+ *
+ * @note See UHASH_DECL_IDX.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_IDX(T, uh_key, uh_val, hash_func, equal_func, uh_idx)                            \
+    P_UHASH_DEF_TYPE_IDX(T, uh_key, uh_val, uh_idx)                                                 \
+    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uh_val)                                          \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func,              \
+                      P_UHASH_HC_NONE, P_UHASH_VS_PLAIN)                                            \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type with per-instance hash and equality functions.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param default_hfunc [(uh_key) -> uhash_uint] Default hash function (can be NULL).
+ * @param default_efunc [(uh_key, uh_key) -> bool] Default equality function (can be NULL).
+ *
+ * @note See UHASH_IMPL_PI.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_PI(T, uh_key, uh_val, default_hfunc, default_efunc)                              \
+    P_UHASH_DEF_TYPE_PI(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL_PI(T, p_uhash_static_inline, uh_key, uh_val)                                       \
+    P_UHASH_IMPL_ALLOC_PI(T, p_uhash_static_inline, uh_key, default_hfunc, default_efunc)           \
+    P_UHASH_IMPL_CORE(T, p_uhash_static_inline, uh_key, uh_val,                                     \
+                      p_uhash_pi_hash_##T P_UHASH_H_ARGS, p_uhash_pi_equal_##T P_UHASH_H_ARGS,      \
+                      P_UHASH_HC_NONE, P_UHASH_VS_PLAIN)                                            \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val,                                   \
+                        p_uhash_pi_hash_##T P_UHASH_H_ARGS, p_uhash_pi_equal_##T P_UHASH_H_ARGS)
+
+/**
+ * Defines a new static hash table type that caches the hash of each key.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_CH(T, uh_key, uh_val, hash_func, equal_func)                                     \
+    P_UHASH_DEF_TYPE_CH(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uh_val)                                          \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func,              \
+                      P_UHASH_HC_BUCKETS, P_UHASH_VS_PLAIN)                                         \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type using the SIMD control byte layout.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_SIMD(T, uh_key, uh_val, hash_func, equal_func)                                   \
+    P_UHASH_DEF_TYPE_SIMD(T, uh_key, uh_val)                                                        \
+    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uh_val)                                          \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE_SIMD(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func,         \
+                           P_UHASH_IMPL_STORAGE_BYTES)                                              \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type using the SIMD control byte layout,
+ * storing the buckets of small tables inline.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_SBO(T, uh_key, uh_val, hash_func, equal_func)                                    \
+    P_UHASH_DEF_TYPE_SBO(T, uh_key, uh_val)                                                         \
+    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uh_val)                                          \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE_SIMD(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func,         \
+                           P_UHASH_IMPL_STORAGE_INLINE)                                             \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type with incremental resizing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_INC(T, uh_key, uh_val, hash_func, equal_func)                                    \
+    P_UHASH_DEF_TYPE_INC(T, uh_key, uh_val)                                                         \
+    P_UHASH_DECL_INC(T, p_uhash_static_inline, uh_key, uh_val)                                      \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE_INC(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)          \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type using Robin Hood probing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_RH(T, uh_key, uh_val, hash_func, equal_func)                                     \
+    P_UHASH_DEF_TYPE_RH(T, uh_key, uh_val)                                                          \
+    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uh_val)                                          \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE_RH(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)           \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type supporting lock-free concurrent readers.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_CONC(T, uh_key, uh_val, hash_func, equal_func)                                   \
+    P_UHASH_DEF_TYPE_CONC(T, uh_key, uh_val)                                                        \
+    P_UHASH_DECL_CONC(T, p_uhash_static_inline, uh_key, uh_val)                                     \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE_CONC(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)         \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type whose values are unsigned integers
+ * of the specified number of bits, packed together rather than stored in a uh_val array.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param bits [integer] Bits per value (1, 2 or 4).
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @note See UHASH_DECL_PACKED.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_PACKED(T, uh_key, bits, hash_func, equal_func)                                   \
+    P_UHASH_DEF_TYPE_PACKED(T, uh_key, bits)                                                        \
+    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uint8_t)                                         \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE(T, p_uhash_static_inline, uh_key, uint8_t, hash_func, equal_func,             \
+                      P_UHASH_HC_NONE, P_UHASH_VS_PACKED)                                           \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uint8_t, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type using bucketized cuckoo hashing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @note See UHASH_DECL_CUCKOO.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_CUCKOO(T, uh_key, uh_val, hash_func, equal_func)                                 \
+    P_UHASH_DEF_TYPE_CUCKOO(T, uh_key, uh_val)                                                      \
+    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uh_val)                                          \
+    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
+    P_UHASH_IMPL_CORE_CUCKOO(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)       \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+
+/**
+ * Defines a new static hash table type with a per-instance hash seed.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key, uint64_t) -> uhash_uint] Seeded hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @note See UHASH_DECL_SEEDED.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_SEEDED(T, uh_key, uh_val, hash_func, equal_func)                                 \
+    P_UHASH_DEF_TYPE_SEEDED(T, uh_key, uh_val)                                                      \
+    P_UHASH_DECL_SEEDED(T, p_uhash_static_inline, uh_key, uh_val)                                   \
+    P_UHASH_IMPL_ALLOC_SEEDED(T, p_uhash_static_inline, uh_key, hash_func)                          \
+    P_UHASH_IMPL_CORE(T, p_uhash_static_inline, uh_key, uh_val,                                     \
+                      p_uhash_seeded_hash_##T P_UHASH_H_ARGS, equal_func,                           \
+                      P_UHASH_HC_NONE, P_UHASH_VS_SEEDED)                                           \
+    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val,                                   \
+                        p_uhash_seeded_hash_##T P_UHASH_H_ARGS, equal_func)
+
+/**
+ * Declares a new sharded hash table type, made of a fixed number of independently
+ * locked shards. Keys are assigned to shards based on their hash, so that threads
+ * inserting or removing different keys rarely contend for the same lock.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param n_shards [integer] Number of shards.
+ *
+ * @note Shards are hash tables of type T_shard, and are declared as well.
+ * @note Requires atomic builtins (GCC 4.7 or clang).
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SHARDED(T, uh_key, uh_val, n_shards)                                             \
+    UHASH_DECL(T##_shard, uh_key, uh_val)                                                           \
+    P_UHASH_DEF_TYPE_SHARDED(T, n_shards)                                                           \
+    P_UHASH_DECL_SHARDED(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new sharded hash table type, prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param n_shards [integer] Number of shards.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_SHARDED_SPEC(T, uh_key, uh_val, n_shards, SPEC)                                  \
+    UHASH_DECL_SPEC(T##_shard, uh_key, uh_val, SPEC)                                                \
+    P_UHASH_DEF_TYPE_SHARDED(T, n_shards)                                                           \
+    P_UHASH_DECL_SHARDED(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Implements a previously declared sharded hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_SHARDED(T, hash_func, equal_func)                                                \
+    UHASH_IMPL(T##_shard, hash_func, equal_func)                                                    \
+    P_UHASH_IMPL_SHARDED(T, p_uhash_unused, uhash_##T##_shard_key, uhash_##T##_shard_val,           \
+                         hash_func)
+
+/**
+ * Defines a new static sharded hash table type.
+ *
+ * @param T [symbol] Hash table name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ * @param n_shards [integer] Number of shards.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_SHARDED(T, uh_key, uh_val, hash_func, equal_func, n_shards)                      \
+    UHASH_INIT(T##_shard, uh_key, uh_val, hash_func, equal_func)                                    \
+    P_UHASH_DEF_TYPE_SHARDED(T, n_shards)                                                           \
+    P_UHASH_DECL_SHARDED(T, p_uhash_static_inline, uh_key, uh_val)                                  \
+    P_UHASH_IMPL_SHARDED(T, p_uhash_static_inline, uh_key, uh_val, hash_func)
+
+/**
+ * Declares a new string interning table type. Interned strings are copied into
+ * an arena owned by the table, and indexed by a hash table of type T_table,
+ * which is declared as well.
+ *
+ * @param T [symbol] Interning table name.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_INTERN(T)                                                                        \
+    UHASH_DECL(T##_table, UHashStrView, UHASH_VAL_IGNORE)                                           \
+    P_UHASH_DEF_TYPE_INTERN(T)                                                                      \
+    P_UHASH_DECL_INTERN(T, p_uhash_unused)
+
+/**
+ * Declares a new string interning table type, prepending a specifier to the generated
+ * declarations.
+ *
+ * @param T [symbol] Interning table name.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_INTERN_SPEC(T, SPEC)                                                             \
+    UHASH_DECL_SPEC(T##_table, UHashStrView, UHASH_VAL_IGNORE, SPEC)                                \
+    P_UHASH_DEF_TYPE_INTERN(T)                                                                      \
+    P_UHASH_DECL_INTERN(T, SPEC p_uhash_unused)
+
+/**
+ * Implements a previously declared string interning table type.
+ *
+ * @param T [symbol] Interning table name.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_INTERN(T)                                                                        \
+    UHASH_IMPL(T##_table, uhash_strv_hash, uhash_strv_equals)                                       \
+    P_UHASH_IMPL_INTERN(T, p_uhash_unused)
+
+/**
+ * Defines a new static string interning table type.
+ *
+ * @param T [symbol] Interning table name.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_INTERN(T)                                                                        \
+    UHASH_INIT(T##_table, UHashStrView, UHASH_VAL_IGNORE, uhash_strv_hash, uhash_strv_equals)       \
+    P_UHASH_DEF_TYPE_INTERN(T)                                                                      \
+    P_UHASH_DECL_INTERN(T, p_uhash_static_inline)                                                   \
+    P_UHASH_IMPL_INTERN(T, p_uhash_static_inline)
+
+/**
+ * Declares a new cache type, holding at most a fixed number of entries. Entries are stored
+ * in a hash table of type T_table, which is declared as well, along with a flag marking
+ * their use. When full, caches evict entries that were not used recently (see uhcache_put).
+ *
+ * @param T [symbol] Cache name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_CACHE(T, uh_key, uh_val)                                                         \
+    P_UHASH_DEF_TYPE_CACHE_ENTRY(T, uh_val)                                                         \
+    UHASH_DECL(T##_table, uh_key, UHashCacheEntry_##T)                                              \
+    P_UHASH_DEF_TYPE_CACHE(T, uh_key, uh_val)                                                       \
+    P_UHASH_DECL_CACHE(T, p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Declares a new cache type, prepending a specifier to the generated declarations.
+ *
+ * @param T [symbol] Cache name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param SPEC [specifier] Specifier.
+ *
+ * @public @related UHash
+ */
+#define UHASH_DECL_CACHE_SPEC(T, uh_key, uh_val, SPEC)                                              \
+    P_UHASH_DEF_TYPE_CACHE_ENTRY(T, uh_val)                                                         \
+    UHASH_DECL_SPEC(T##_table, uh_key, UHashCacheEntry_##T, SPEC)                                   \
+    P_UHASH_DEF_TYPE_CACHE(T, uh_key, uh_val)                                                       \
+    P_UHASH_DECL_CACHE(T, SPEC p_uhash_unused, uh_key, uh_val)
+
+/**
+ * Implements a previously declared cache type.
+ *
+ * @param T [symbol] Cache name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_IMPL_CACHE(T, hash_func, equal_func)                                                  \
+    UHASH_IMPL(T##_table, hash_func, equal_func)                                                    \
+    P_UHASH_IMPL_CACHE(T, p_uhash_unused, uhcache_##T##_key, uhcache_##T##_val)
+
+/**
+ * Defines a new static cache type.
+ *
+ * @param T [symbol] Cache name.
+ * @param uh_key [symbol] Type of the keys.
+ * @param uh_val [symbol] Type of the values.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ *
+ * @public @related UHash
+ */
+#define UHASH_INIT_CACHE(T, uh_key, uh_val, hash_func, equal_func)                                  \
+    P_UHASH_DEF_TYPE_CACHE_ENTRY(T, uh_val)                                                         \
+    UHASH_INIT(T##_table, uh_key, UHashCacheEntry_##T, hash_func, equal_func)                       \
+    P_UHASH_DEF_TYPE_CACHE(T, uh_key, uh_val)                                                       \
+    P_UHASH_DECL_CACHE(T, p_uhash_static_inline, uh_key, uh_val)                                    \
+    P_UHASH_IMPL_CACHE(T, p_uhash_static_inline, uh_key, uh_val)
+
+/// @name Memory allocation
+
+/// malloc override.
+#ifndef UHASH_MALLOC
+    #define UHASH_MALLOC malloc
+#endif
+
+/// realloc override.
+#ifndef UHASH_REALLOC
+    #define UHASH_REALLOC realloc
+#endif
+
+/// free override.
+#ifndef UHASH_FREE
+    #define UHASH_FREE free
+#endif
+
+/// @name Hash and equality functions
+
+/**
+ * Identity macro.
+ *
+ * @param a LHS of the identity.
+ * @param b RHS of the identity.
+ * @return a == b
+ *
+ * @public @related UHash
+ */
+#define uhash_identical(a, b) ((a) == (b))
+
+/**
+ * Equality function for strings.
+ *
+ * @param a [char const *] LHS of the equality relation (NULL terminated string).
+ * @param b [char const *] RHS of the equality relation (NULL terminated string).
+ * @return [bool] True if a is equal to b, false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhash_str_equals(a, b) (strcmp(a, b) == 0)
+
+/**
+ * Equality function for string views, comparing lengths and precomputed hashes before
+ * the characters.
+ *
+ * @param a [UHashStrView] LHS of the equality relation.
+ * @param b [UHashStrView] RHS of the equality relation.
+ * @return [bool] True if a is equal to b, false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhash_strv_equals(a, b) p_uhash_strv_equals(a, b)
+
+/**
+ * Hash function for 8 bit integers.
+ *
+ * @param key [int8_t/uint8_t] The integer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_int8_hash(key) p_uhash_int8_hash(key)
+
+/**
+ * Hash function for 16 bit integers.
+ *
+ * @param key [int16_t/uint16_t] The integer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_int16_hash(key) p_uhash_int16_hash(key)
+
+/**
+ * Hash function for 32 bit integers.
+ *
+ * @param key [int32_t/uint32_t] The integer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_int32_hash(key) p_uhash_int32_hash(key)
+
+/**
+ * Hash function for 64 bit integers.
+ *
+ * @param key [int64_t/uint64_t] The integer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_int64_hash(key) p_uhash_int64_hash(key)
+
+/**
+ * Hash function for strings.
+ *
+ * @param key [char const *] Pointer to a NULL-terminated string.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_str_hash(key) p_uhash_x31_str_hash(key)
+
+/**
+ * Hash function for byte arrays, based on wyhash.
+ *
+ * @param ptr [void const *] Pointer to the bytes to hash.
+ * @param len [size_t] Number of bytes.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_bytes_hash(ptr, len) p_uhash_fold64(p_uhash_wyhash(ptr, len, 0))
+
+/**
+ * Hash function for strings, based on wyhash. Slower than uhash_str_hash on very short strings,
+ * but with far fewer collisions, especially on keys drawn from small alphabets.
+ *
+ * @param key [char const *] Pointer to a NULL-terminated string.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_str_mix_hash(key) uhash_bytes_hash(key, strlen(key))
+
+/**
+ * Seeded hash function for byte arrays, based on wyhash.
+ *
+ * @param ptr [void const *] Pointer to the bytes to hash.
+ * @param len [size_t] Number of bytes.
+ * @param seed [uint64_t] Seed.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_bytes_seeded_hash(ptr, len, seed) p_uhash_fold64(p_uhash_wyhash(ptr, len, seed))
+
+/**
+ * Seeded hash function for strings, based on wyhash (see UHASH_DECL_SEEDED).
+ *
+ * @param key [char const *] Pointer to a NULL-terminated string.
+ * @param seed [uint64_t] Seed.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_str_seeded_hash(key, seed) uhash_bytes_seeded_hash(key, strlen(key), seed)
+
+/**
+ * Hash function for string views, returning the precomputed hash if present.
+ * Computed hashes match those of uhash_bytes_hash.
+ *
+ * @param key [UHashStrView] The string view.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_strv_hash(key) p_uhash_strv_hash(key)
+
+/**
+ * Creates a view over the specified characters, which need not be NULL-terminated.
+ *
+ * @param data [char const *] Pointer to the first character.
+ * @param length [size_t] Number of characters.
+ * @return [UHashStrView] The string view.
+ *
+ * @public @related UHash
+ */
+#define uhash_strv(data, length) p_uhash_strv(data, length, false)
+
+/**
+ * Creates a view over the specified characters, precomputing its hash.
+ * Useful for keys that are looked up more than once, or stored in hash tables,
+ * since both hashing and failed comparisons become cheaper.
+ *
+ * @param data [char const *] Pointer to the first character.
+ * @param length [size_t] Number of characters.
+ * @return [UHashStrView] The string view.
+ *
+ * @public @related UHash
+ */
+#define uhash_strv_hashed(data, length) p_uhash_strv(data, length, true)
+
+/**
+ * Creates a view over a NULL-terminated string.
+ *
+ * @param str [char const *] The string.
+ * @return [UHashStrView] The string view.
+ *
+ * @public @related UHash
+ */
+#define uhash_strv_cstr(str) p_uhash_strv(str, strlen(str), false)
+
+/**
+ * Hash function for 32 bit integers, mixing all bits of the key (MurmurHash3's finalizer).
+ * Unlike uhash_int32_hash, it suits keys that only differ in their high bits.
+ *
+ * @param key [int32_t/uint32_t] The integer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_int32_mix_hash(key) p_uhash_fold64((uint64_t)p_uhash_fmix32((uint32_t)(key)))
+
+/**
+ * Hash function for 64 bit integers, mixing all bits of the key (MurmurHash3's finalizer).
+ *
+ * @param key [int64_t/uint64_t] The integer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_int64_mix_hash(key) p_uhash_fold64(p_uhash_fmix64((uint64_t)(key)))
+
+/**
+ * Seeded hash function for 32 bit integers (see UHASH_DECL_SEEDED).
+ *
+ * @param key [int32_t/uint32_t] The integer.
+ * @param seed [uint64_t] Seed.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_int32_seeded_hash(key, seed)                                                          \
+    p_uhash_fold64(p_uhash_int_seeded_hash((uint32_t)(key), seed))
+
+/**
+ * Seeded hash function for 64 bit integers (see UHASH_DECL_SEEDED).
+ *
+ * @param key [int64_t/uint64_t] The integer.
+ * @param seed [uint64_t] Seed.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_int64_seeded_hash(key, seed)                                                          \
+    p_uhash_fold64(p_uhash_int_seeded_hash((uint64_t)(key), seed))
+
+/**
+ * Hash function for pointers.
+ *
+ * @param key [pointer] The pointer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#if UINTPTR_MAX <= 0xffffffff
+    #define uhash_ptr_hash(key) p_uhash_int32_hash((uint32_t)(key))
+#else
+    #define uhash_ptr_hash(key) p_uhash_int64_hash((uint64_t)(key))
+#endif
+
+/**
+ * Hash function for pointers, mixing all bits of the address.
+ *
+ * @param key [pointer] The pointer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_ptr_mix_hash(key) uhash_int64_mix_hash((uintptr_t)(key))
+
+/**
+ * Combines two hashes.
+ *
+ * @param hash_1 [uhash_uint] First hash.
+ * @param hash_2 [uhash_uint] Second hash.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+#define uhash_combine_hash(hash_1, hash_2) (                                                        \
+    ((hash_1) ^ (hash_2)) + P_UHASH_COMBINE_MAGIC +                                                 \
+    ((hash_1) << P_UHASH_COMBINE_LS) + ((hash_1) >> P_UHASH_COMBINE_RS)                             \
+)
+
+/**
+ * Hash function for 32 bit integers, usable as a function pointer
+ * by hash tables with per-instance functions (see UHASH_IMPL_PI).
+ *
+ * @param key [uint32_t] The integer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+p_uhash_static_inline uhash_uint uhash_pi_int32_hash(uint32_t key) {
+    return uhash_int32_hash(key);
+}
+
+/**
+ * Hash function for 64 bit integers, usable as a function pointer
+ * by hash tables with per-instance functions (see UHASH_IMPL_PI).
+ *
+ * @param key [uint64_t] The integer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+p_uhash_static_inline uhash_uint uhash_pi_int64_hash(uint64_t key) {
+    return uhash_int64_hash(key);
+}
+
+/**
+ * Hash function for pointers, usable as a function pointer
+ * by hash tables with per-instance functions (see UHASH_IMPL_PI).
+ *
+ * @param key [void const *] The pointer.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+p_uhash_static_inline uhash_uint uhash_pi_ptr_hash(void const *key) {
+    return uhash_ptr_hash((uintptr_t)key);
+}
+
+/**
+ * Hash function for strings, usable as a function pointer
+ * by hash tables with per-instance functions (see UHASH_IMPL_PI).
+ *
+ * @param key [char const *] Pointer to a NULL-terminated string.
+ * @return [uhash_uint] The hash value.
+ *
+ * @public @related UHash
+ */
+p_uhash_static_inline uhash_uint uhash_pi_str_hash(char const *key) {
+    return uhash_str_hash(key);
+}
+
+/**
+ * Equality function for 32 bit integers, usable as a function pointer
+ * by hash tables with per-instance functions (see UHASH_IMPL_PI).
+ *
+ * @param a [uint32_t] LHS of the equality relation.
+ * @param b [uint32_t] RHS of the equality relation.
+ * @return [bool] True if a is equal to b, false otherwise.
+ *
+ * @public @related UHash
+ */
+p_uhash_static_inline bool uhash_pi_int32_equals(uint32_t a, uint32_t b) {
+    return a == b;
+}
+
+/**
+ * Equality function for 64 bit integers, usable as a function pointer
+ * by hash tables with per-instance functions (see UHASH_IMPL_PI).
+ *
+ * @param a [uint64_t] LHS of the equality relation.
+ * @param b [uint64_t] RHS of the equality relation.
+ * @return [bool] True if a is equal to b, false otherwise.
+ *
+ * @public @related UHash
+ */
+p_uhash_static_inline bool uhash_pi_int64_equals(uint64_t a, uint64_t b) {
+    return a == b;
+}
+
+/**
+ * Equality function for pointers, usable as a function pointer
+ * by hash tables with per-instance functions (see UHASH_IMPL_PI).
+ *
+ * @param a [void const *] LHS of the equality relation.
+ * @param b [void const *] RHS of the equality relation.
+ * @return [bool] True if a is equal to b, false otherwise.
+ *
+ * @public @related UHash
+ */
+p_uhash_static_inline bool uhash_pi_ptr_equals(void const *a, void const *b) {
+    return a == b;
+}
+
+/**
+ * Equality function for strings, usable as a function pointer
+ * by hash tables with per-instance functions (see UHASH_IMPL_PI).
+ *
+ * @param a [char const *] LHS of the equality relation.
+ * @param b [char const *] RHS of the equality relation.
+ * @return [bool] True if a is equal to b, false otherwise.
+ *
+ * @public @related UHash
+ */
+p_uhash_static_inline bool uhash_pi_str_equals(char const *a, char const *b) {
+    return uhash_str_equals(a, b);
+}
+
+/// @name Declaration
+
+/**
+ * Declares a new hash table variable.
+ *
+ * @param T [symbol] Hash table name.
+ *
+ * @public @related UHash
+ */
+#define UHash(T) UHash_##T
+
+/**
+ * Expands to 'struct UHash_T', useful for forward-declarations.
+ *
+ * @param T [symbol] Hash table name.
+ *
+ * @public @related UHash
+ */
+#define uhash_struct(T) struct UHash_##T
+
+/// @name Memory management
+
+/**
+ * Deallocates the specified hash table.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table to deallocate.
+ *
+ * @public @related UHash
+ */
+#define uhash_free(T, h) uhash_free_##T(h)
+
+/**
+ * Copies the specified hash table.
+ *
+ * @param T [symbol] Hash table name.
+ * @param src [UHash(T)*] Hash table to copy.
+ * @param dest [UHash(T)*] Hash table to copy into.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ *
+ * @public @related UHash
+ */
+#define uhash_copy(T, src, dest) uhash_copy_##T(src, dest)
+
+/**
+ * Returns a new hash set obtained by copying the keys of another hash table.
+ *
+ * @param T [symbol] Hash table name.
+ * @param src [UHash(T)*] Hash table to copy.
+ * @param dest [UHash(T)*] Hash table to copy into.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ *
+ * @public @related UHash
+ */
+#define uhash_copy_as_set(T, src, dest) uhash_copy_as_set_##T(src, dest)
+
+/**
+ * Copies the specified hash table, reusing the buckets of the destination if possible.
+ *
+ * Unlike uhash_copy, destination buckets larger than those of the source table are kept,
+ * and the keys are rehashed into them without allocating memory.
+ *
+ * @param T [symbol] Hash table name.
+ * @param src [UHash(T)*] Hash table to copy.
+ * @param dest [UHash(T)*] Hash table to copy into.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ *
+ * @public @related UHash
+ */
+#define uhash_copy_into(T, src, dest) uhash_copy_into_##T(src, dest)
+
+/**
+ * Returns a copy-on-write clone of the specified hash table.
+ *
+ * The clone shares the buckets of the source table, which are duplicated by whichever
+ * of the two is modified first. Tables whose buckets cannot be shared (incremental,
+ * concurrent, or using inline storage) are copied right away.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table to clone.
+ * @return [UHash(T)*] Clone, or NULL on error. Must be freed via uhash_free.
+ *
+ * @note Functions that do not report errors, such as uhash_delete and uhash_clear,
+ *       do nothing if the shared buckets cannot be duplicated. Writing through uhash_key
+ *       or uhash_value requires calling uhash_unshare first.
+ * @note The reference count of shared buckets is atomic, so clones can be handed to other
+ *       threads, though each table must still be used by a single thread at a time.
+ *
+ * @public @related UHash
+ */
+#define uhash_clone(T, h) uhash_clone_##T(h)
+
+/**
+ * Makes sure the buckets of the specified hash table are not shared with its clones,
+ * duplicating them if needed.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ *
+ * @public @related UHash
+ */
+#define uhash_unshare(T, h) uhash_unshare_##T(h)
+
+/**
+ * Resizes the specified hash table.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table to resize.
+ * @param s [uhash_uint] Hash table size.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ *
+ * @public @related UHash
+ */
+#define uhash_resize(T, h, s) uhash_resize_##T(h, s)
+
+/**
+ * Resizes the specified hash table so that it can hold the specified number of elements
+ * without growing, accounting for its maximum load factor.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param count [uhash_uint] Expected number of elements.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ *
+ * @note Tables are never shrunk. Unless UHASH_GROWTH_FACTOR is defined, the number of buckets
+ *       is rounded up to a power of 2.
+ *
+ * @public @related UHash
+ */
+#define uhash_reserve(T, h, count) uhash_reserve_##T(h, count)
+
+/**
+ * Sets the maximum load factor of the specified hash table, overriding UHASH_MAX_LOAD
+ * (or UHASH_SIMD_MAX_LOAD). The table is expanded right away if it exceeds the new maximum.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param f [double] Maximum load factor, greater than 0 and lower than 1.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error
+ *                     or if the load factor is out of range.
+ *
+ * @note The resulting threshold is computed once per resize, so that insertions
+ *       do not need floating point math.
+ *
+ * @public @related UHash
+ */
+#define uhash_set_max_load(T, h, f) uhash_set_max_load_##T(h, f)
+
+/**
+ * Removes deleted buckets from the specified hash table, without changing its size.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ *
+ * @note Deleted buckets are also cleared by insertions once they fill the table,
+ *       and tables are automatically shrunk according to UHASH_SHRINK_LOAD.
+ *
+ * @public @related UHash
+ */
+#define uhash_compact(T, h) uhash_compact_##T(h)
+
+/**
+ * Reseeds the specified hash table with a per-instance hash seed, rehashing its keys.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error,
+ *                     in which case the table keeps its previous seed.
+ *
+ * @note Tables are reseeded automatically on hash flooding (see UHASH_DECL_SEEDED).
+ *
+ * @public @related UHash
+ */
+#define uhash_reseed(T, h) uhash_reseed_##T(h)
+
+/**
+ * Completes any pending migration of a hash table with incremental resizing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ *
+ * @note Only available for hash tables declared via UHASH_DECL_INC or UHASH_INIT_INC.
+ *
+ * @public @related UHash
+ */
+#define uhash_rehash_finish(T, h) uhash_rehash_finish_##T(h)
+
+/**
+ * Checks whether a key is present in a hash table supporting concurrent readers.
+ * Can be called by any number of threads while the table is being modified by another one.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @return [bool] True if the key is present, false otherwise.
+ *
+ * @note Only available for hash tables declared via UHASH_DECL_CONC or UHASH_INIT_CONC.
+ *
+ * @public @related UHash
+ */
+#define uhash_conc_contains(T, h, k) uhash_conc_contains_##T(h, k)
+
+/**
+ * Returns the value associated with the specified key in a map supporting concurrent readers.
+ * Can be called by any number of threads while the map is being modified by another one.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @param m [uhash_T_val] Value to return if the key is missing.
+ * @return [uhash_T_val] Value associated with the specified key.
+ *
+ * @note Only available for hash tables declared via UHASH_DECL_CONC or UHASH_INIT_CONC.
+ *
+ * @public @related UHash
+ */
+#define uhmap_conc_get(T, h, k, m) uhmap_conc_get_##T(h, k, m)
+
+/**
+ * Publishes the bucket at the specified index to concurrent readers, after its value
+ * has been set. Only needed for map keys inserted via uhash_put.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param i [uhash_uint] Index of the bucket, as returned by uhash_put.
+ *
+ * @note Only available for hash tables declared via UHASH_DECL_CONC or UHASH_INIT_CONC.
+ *
+ * @public @related UHash
+ */
+#define uhash_conc_publish(T, h, i) uhash_conc_publish_##T(h, i)
+
+/// @name Primitives
+
+/**
+ * Inserts a key into the specified hash table.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Key to insert.
+ * @param[out] i [uhash_uint*] Index of the inserted element.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @public @related UHash
+ */
+#define uhash_put(T, h, k, i) uhash_put_##T(h, k, i)
+
+/**
+ * Retrieves the index of the bucket associated with the specified key.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Key whose index should be retrieved.
+ * @return [uhash_uint] Index of the key, or UHASH_INDEX_MISSING if it is absent.
+ *
+ * @public @related UHash
+ */
+#define uhash_get(T, h, k) uhash_get_##T(h, k)
+
+/**
+ * Inserts a key into the specified hash table, given its precomputed hash.
+ * Useful to hash a key once, then insert it into or look it up in multiple tables.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Key to insert.
+ * @param hash [uhash_uint] Hash of the key, which must match that of the table's hash function.
+ * @param[out] i [uhash_uint*] Index of the inserted element.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @public @related UHash
+ */
+#define uhash_put_with_hash(T, h, k, hash, i) uhash_put_with_hash_##T(h, k, hash, i)
+
+/**
+ * Retrieves the index of the bucket associated with the specified key,
+ * given its precomputed hash.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Key whose index should be retrieved.
+ * @param hash [uhash_uint] Hash of the key, which must match that of the table's hash function.
+ * @return [uhash_uint] Index of the key, or UHASH_INDEX_MISSING if it is absent.
+ *
+ * @public @related UHash
+ */
+#define uhash_get_with_hash(T, h, k, hash) uhash_get_with_hash_##T(h, k, hash)
+
+/**
+ * Retrieves the indices of the buckets associated with the specified keys.
+ * Memory accesses for different keys are overlapped, which is faster than
+ * looking up the keys one at a time on tables that do not fit in the cache.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key const *] Keys whose indices should be retrieved.
+ * @param n [uhash_uint] Number of keys.
+ * @param[out] i [uhash_uint *] Indices of the keys, or UHASH_INDEX_MISSING for absent ones.
+ *
+ * @public @related UHash
+ */
+#define uhash_get_batch(T, h, k, n, i) uhash_get_batch_##T(h, k, n, i)
+
+/**
+ * Deletes the bucket at the specified index.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_uint] Index of the bucket to delete.
+ *
+ * @public @related UHash
+ */
+#define uhash_delete(T, h, k) uhash_delete_##T(h, k)
+
+/**
+ * Checks whether the hash table contains the specified key.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Key to test.
+ * @return [bool] True if the hash table contains the specified key, false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhash_contains(T, h, k) (uhash_get_##T(h, k) != UHASH_INDEX_MISSING)
+
+/**
+ * Tests whether a bucket contains data.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @param x [uhash_uint] Index of the bucket to test.
+ * @return [bool] True if the bucket contains data, false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhash_exists(h, x) p_uhash_exists((h)->flags, (x))
+
+/**
+ * Retrieves the key at the specified index.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @param x [uhash_uint] Index of the bucket whose key should be retrieved.
+ * @return [uhash_T_key] Key.
+ *
+ * @public @related UHash
+ */
+#define uhash_key(h, x) ((h)->keys[x])
+
+/**
+ * Retrieves the value at the specified index.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @param x [uhash_uint] Index of the bucket whose value should be retrieved.
+ * @return [T value type] Value.
+ *
+ * @note Undefined behavior if used on hash sets, or on tables with bit-packed values.
+ *
+ * @public @related UHash
+ */
+#define uhash_value(h, x) ((h)->vals[x])
+
+/**
+ * Retrieves the start index.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [uhash_uint] Start index.
+ *
+ * @public @related UHash
+ */
+#define uhash_begin(h) (uhash_uint)(0)
+
+/**
+ * Retrieves the end index.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [uhash_uint] End index.
+ *
+ * @public @related UHash
+ */
+#define uhash_end(h) ((h)->n_buckets)
+
+/**
+ * Returns the number of elements in the hash table.
+ *
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [uhash_uint] Number of elements.
+ *
+ * @note For convenience, this macro returns '0' for NULL hash tables.
+ *
+ * @public @related UHash
+ */
+#define uhash_count(h) ((h) ? (h)->count : 0)
+
+/**
+ * Resets the specified hash table without deallocating it.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhash_clear(T, h) uhash_clear_##T(h)
+
+/// @name Map-specific API
+
+/**
+ * Allocates a new hash map.
+ *
+ * @param T [symbol] Hash table name.
+ * @return [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhmap_alloc(T) uhmap_alloc_##T()
+
+/**
+ * Allocates a new hash map, whose memory is managed by the specified allocator.
+ *
+ * @param T [symbol] Hash table name.
+ * @param a [UHashAllocator const *] Allocator, which must outlive the hash table.
+ *          If NULL, UHASH_MALLOC, UHASH_REALLOC and UHASH_FREE are used.
+ * @return [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhmap_alloc_with(T, a) uhmap_alloc_with_##T(a)
+
+/**
+ * Allocates a new hash map with the specified maximum load factor.
+ *
+ * @param T [symbol] Hash table name.
+ * @param f [double] Maximum load factor, greater than 0 and lower than 1.
+ * @return [UHash(T)*] Hash table instance, or NULL on error or if the load factor is out of range.
+ *
+ * @public @related UHash
+ */
+#define uhmap_alloc_load(T, f) uhmap_alloc_load_##T(f)
+
+/**
+ * Allocates a new hash map with per-instance hash and equality functions.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function pointer.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function pointer.
+ * @return [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhmap_alloc_pi(T, hash_func, equal_func) uhmap_alloc_pi_##T(hash_func, equal_func)
+
+/**
+ * Allocates a new hash map with per-instance hash and equality functions,
+ * whose memory is managed by the specified allocator.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function pointer.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function pointer.
+ * @param a [UHashAllocator const *] Allocator, which must outlive the hash table.
+ *          If NULL, UHASH_MALLOC, UHASH_REALLOC and UHASH_FREE are used.
+ * @return [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhmap_alloc_pi_with(T, hash_func, equal_func, a)                                            \
+    uhmap_alloc_pi_with_##T(hash_func, equal_func, a)
+
+/**
+ * Returns the value associated with the specified key.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @param m [uhash_T_val] Value to return if the key is missing.
+ * @return [uhash_T_val] Value associated with the specified key.
+ *
+ * @public @related UHash
+ */
+#define uhmap_get(T, h, k, m) uhmap_get_##T(h, k, m)
 
-/// @name Type definitions
+/**
+ * Returns the value associated with the specified key, given its precomputed hash.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @param hash [uhash_uint] Hash of the key, which must match that of the table's hash function.
+ * @param m [uhash_T_val] Value to return if the key is missing.
+ * @return [uhash_T_val] Value associated with the specified key.
+ *
+ * @public @related UHash
+ */
+#define uhmap_get_with_hash(T, h, k, hash, m) uhmap_get_with_hash_##T(h, k, hash, m)
 
 /**
- * Declares a new hash table type.
+ * Returns the values associated with the specified keys.
  *
  * @param T [symbol] Hash table name.
- * @param uh_key [symbol] Type of the keys.
- * @param uh_val [symbol] Type of the values.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key const *] The keys.
+ * @param n [uhash_uint] Number of keys.
+ * @param[out] v [uhash_T_val *] Values associated with the keys.
+ * @param m [uhash_T_val] Value to output for missing keys.
+ *
+ * @note See uhash_get_batch.
  *
  * @public @related UHash
  */
-#define UHASH_DECL(T, uh_key, uh_val)                                                               \
-    P_UHASH_DEF_TYPE(T, uh_key, uh_val)                                                             \
-    P_UHASH_DECL(T, p_uhash_unused, uh_key, uh_val)
+#define uhmap_get_batch(T, h, k, n, v, m) uhmap_get_batch_##T(h, k, n, v, m)
 
 /**
- * Declares a new hash table type, prepending a specifier to the generated declarations.
+ * Adds a key:value pair to the map, returning the replaced value (if any).
  *
  * @param T [symbol] Hash table name.
- * @param uh_key [symbol] Type of the keys.
- * @param uh_val [symbol] Type of the values.
- * @param SPEC [specifier] Specifier.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @param v [uhash_T_val] The value.
+ * @param[out] e [uhash_T_val*] Existing value, only set if key was already in the map.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @public @related UHash
+ */
+#define uhmap_set(T, h, k, v, e) uhmap_set_##T(h, k, v, e)
+
+/**
+ * Adds a key:value pair to the map, only if the key is missing.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @param v [uhash_T_val] The value.
+ * @param[out] e [uhash_T_val*] Existing value, only set if key was already in the map.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @public @related UHash
+ */
+#define uhmap_add(T, h, k, v, e) uhmap_add_##T(h, k, v, e)
+
+/**
+ * Replaces a value in the map, only if its associated key exists.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @param v [uhash_T_val] The value.
+ * @param[out] r [uhash_T_val*] Replaced value, only set if the return value is true.
+ * @return [bool] True if the value was replaced (its key was present), false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhmap_replace(T, h, k, v, r) uhmap_replace_##T(h, k, v, r)
+
+/**
+ * Removes a key:value pair from the map.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @return [bool] True if the key was present (it was deleted), false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhmap_remove(T, h, k) uhmap_remove_##T(h, k, NULL, NULL)
+
+/**
+ * Removes a key:value pair from the map, returning the deleted key and value.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @param[out] dk [uhash_T_key*] Deleted key, only set if key was present in the map.
+ * @param[out] dv [uhash_T_val*] Deleted value, only set if key was present in the map.
+ * @return [bool] True if the key was present (it was deleted), false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhmap_pop(T, h, k, dk, dv) uhmap_remove_##T(h, k, dk, dv)
+
+/// @name Set-specific API
+
+/**
+ * Allocates a new hash set.
+ *
+ * @param T [symbol] Hash table name.
+ * @return [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhset_alloc(T) uhset_alloc_##T()
+
+/**
+ * Allocates a new hash set, whose memory is managed by the specified allocator.
+ *
+ * @param T [symbol] Hash table name.
+ * @param a [UHashAllocator const *] Allocator, which must outlive the hash table.
+ *          If NULL, UHASH_MALLOC, UHASH_REALLOC and UHASH_FREE are used.
+ * @return [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhset_alloc_with(T, a) uhset_alloc_with_##T(a)
+
+/**
+ * Allocates a new hash set with the specified maximum load factor.
+ *
+ * @param T [symbol] Hash table name.
+ * @param f [double] Maximum load factor, greater than 0 and lower than 1.
+ * @return [UHash(T)*] Hash table instance, or NULL on error or if the load factor is out of range.
+ *
+ * @public @related UHash
+ */
+#define uhset_alloc_load(T, f) uhset_alloc_load_##T(f)
+
+/**
+ * Allocates a new hash set with per-instance hash and equality functions.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function pointer.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function pointer.
+ * @return [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhset_alloc_pi(T, hash_func, equal_func) uhset_alloc_pi_##T(hash_func, equal_func)
+
+/**
+ * Allocates a new hash set with per-instance hash and equality functions,
+ * whose memory is managed by the specified allocator.
+ *
+ * @param T [symbol] Hash table name.
+ * @param hash_func [(uh_key) -> uhash_uint] Hash function pointer.
+ * @param equal_func [(uh_key, uh_key) -> bool] Equality function pointer.
+ * @param a [UHashAllocator const *] Allocator, which must outlive the hash table.
+ *          If NULL, UHASH_MALLOC, UHASH_REALLOC and UHASH_FREE are used.
+ * @return [UHash(T)*] Hash table instance.
+ *
+ * @public @related UHash
+ */
+#define uhset_alloc_pi_with(T, hash_func, equal_func, a)                                            \
+    uhset_alloc_pi_with_##T(hash_func, equal_func, a)
+
+/**
+ * Inserts an element in the set.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Element to insert.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @public @related UHash
+ */
+#define uhset_insert(T, h, k) uhset_insert_##T(h, k, NULL)
+
+/**
+ * Inserts an element in the set, returning the existing element if it was already present.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Element to insert.
+ * @param[out] e [uhash_T_key*] Existing element, only set if it was already in the set.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @public @related UHash
+ */
+#define uhset_insert_get_existing(T, h, k, e) uhset_insert_##T(h, k, e)
+
+/**
+ * Populates the set with elements from an array.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param a [uhash_T_key*] Array of elements.
+ * @param n [uhash_uint] Size of the array.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @note This function returns UHASH_INSERTED if at least one element in the array
+ *       was missing from the set.
+ *
+ * @public @related UHash
+ */
+#define uhset_insert_all(T, h, a, n) uhset_insert_all_##T(h, a, n)
+
+/**
+ * Inserts elements from an array into the set, overlapping memory accesses
+ * for different elements. Unlike uhset_insert_all, the set is not resized upfront.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param a [uhash_T_key const *] Array of elements.
+ * @param n [uhash_uint] Size of the array.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @note This function returns UHASH_INSERTED if at least one element in the array
+ *       was missing from the set.
+ *
+ * @public @related UHash
+ */
+#define uhset_insert_batch(T, h, a, n) uhset_insert_batch_##T(h, a, n)
+
+/**
+ * Replaces an element in the set, only if it exists.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Element to replace.
+ * @param[out] r [uhash_T_key*] Replaced element, only set if the return value is true.
+ * @return [bool] True if the element was replaced (it was present), false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhset_replace(T, h, k, r) uhset_replace_##T(h, k, r)
+
+/**
+ * Removes an element from the set.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Element to remove.
+ * @return [bool] True if the element was removed (it was present), false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhset_remove(T, h, k) uhset_remove_##T(h, k, NULL)
+
+/**
+ * Removes an element from the set, returning the deleted element.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param k [uhash_T_key] Element to remove.
+ * @param[out] d [uhash_T_key*] Deleted element, only set if element was present in the set.
+ * @return [bool] True if the element was removed (it was present), false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhset_pop(T, h, k, d) uhset_remove_##T(h, k, d)
+
+/**
+ * Checks whether the set is a superset of another set.
+ *
+ * @param T [symbol] Hash table name.
+ * @param h1 [UHash(T)*] Superset.
+ * @param h2 [UHash(T)*] Subset.
+ * @return [bool] True if the superset relation holds, false otherwise.
  *
  * @public @related UHash
  */
-#define UHASH_DECL_SPEC(T, uh_key, uh_val, SPEC)                                                    \
-    P_UHASH_DEF_TYPE(T, uh_key, uh_val)                                                             \
-    P_UHASH_DECL(T, SPEC p_uhash_unused, uh_key, uh_val)
+#define uhset_is_superset(T, h1, h2) uhset_is_superset_##T(h1, h2)
 
 /**
- * Declares a new hash table type with per-instance hash and equality functions.
+ * Performs the union between two sets, mutating the first.
  *
  * @param T [symbol] Hash table name.
- * @param uh_key [symbol] Type of the keys.
- * @param uh_val [symbol] Type of the values.
+ * @param h1 [UHash(T)*] Set to mutate.
+ * @param h2 [UHash(T)*] Other set.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
  *
  * @public @related UHash
  */
-#define UHASH_DECL_PI(T, uh_key, uh_val)                                                            \
-    P_UHASH_DEF_TYPE_PI(T, uh_key, uh_val)                                                          \
-    P_UHASH_DECL_PI(T, p_uhash_unused, uh_key, uh_val)
+#define uhset_union(T, h1, h2) uhset_union_##T(h1, h2)
 
 /**
- * Declares a new hash table type with per-instance hash and equality functions,
- * prepending a specifier to the generated declarations.
+ * Performs the intersection between two sets, mutating the first.
  *
  * @param T [symbol] Hash table name.
- * @param uh_key [symbol] Type of the keys.
- * @param uh_val [symbol] Type of the values.
- * @param SPEC [specifier] Specifier.
+ * @param h1 [UHash(T)*] Set to mutate.
+ * @param h2 [UHash(T)*] Other set.
  *
  * @public @related UHash
  */
-#define UHASH_DECL_PI_SPEC(T, uh_key, uh_val, SPEC)                                                 \
-    P_UHASH_DEF_TYPE_PI(T, uh_key, uh_val)                                                          \
-    P_UHASH_DECL_PI(T, SPEC p_uhash_unused, uh_key, uh_val)
+#define uhset_intersect(T, h1, h2) uhset_intersect_##T(h1, h2)
 
 /**
- * Implements a previously declared hash table type.
+ * Returns a new set containing the union of the specified sets. The result is sized once
+ * for the largest set, and keys are inserted reusing their cached hashes, if any.
  *
  * @param T [symbol] Hash table name.
- * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
- * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ * @param s [UHash(T) const *const *] Array of sets.
+ * @param n [uhash_uint] Number of sets, greater than zero.
+ * @return [UHash(T)*] New set, allocated via the allocator of the first set, or NULL on error.
+ *
+ * @note Keys not in the largest set grow the result as they are inserted, so unions of
+ *       mostly disjoint sets are better computed into a set reserved for their total count.
  *
  * @public @related UHash
  */
-#define UHASH_IMPL(T, hash_func, equal_func)                                                        \
-    P_UHASH_IMPL_ALLOC(T, p_uhash_unused)                                                           \
-    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, hash_func, equal_func)
+#define uhset_union_many(T, s, n) uhset_union_many_##T(s, n)
 
 /**
- * Implements a previously declared hash table type with per-instance hash and equality functions.
+ * Returns a new set containing the intersection of the specified sets. Only the keys of the
+ * smallest set are visited, and they are looked up in the other sets by increasing size,
+ * reusing their cached hashes, if any. If any set is empty, no key is visited at all.
  *
  * @param T [symbol] Hash table name.
- * @param default_hfunc [(uh_key) -> uhash_uint] Default hash function (can be NULL).
- * @param default_efunc [(uh_key, uh_key) -> bool] Default equality function (can be NULL).
+ * @param s [UHash(T) const *const *] Array of sets.
+ * @param n [uhash_uint] Number of sets, greater than zero.
+ * @return [UHash(T)*] New set, allocated via the allocator of the first set, or NULL on error.
  *
  * @public @related UHash
  */
-#define UHASH_IMPL_PI(T, default_hfunc, default_efunc)                                              \
-    P_UHASH_IMPL_ALLOC_PI(T, p_uhash_unused, uhash_##T##_key, default_hfunc, default_efunc)         \
-    P_UHASH_IMPL_COMMON(T, p_uhash_unused, uhash_##T##_key, uhash_##T##_val, h->hfunc, h->efunc)
+#define uhset_intersect_many(T, s, n) uhset_intersect_many_##T(s, n)
 
 /**
- * Defines a new static hash table type.
+ * Populates the set with elements from an array, hashing them in parallel.
+ * Elements are sorted by the bucket range they belong to before being inserted,
+ * so that the table is filled in a single sweep.
  *
  * @param T [symbol] Hash table name.
- * @param uh_key [symbol] Type of the keys.
- * @param uh_val [symbol] Type of the values.
- * @param hash_func [(uh_key) -> uhash_uint] Hash function or expression.
- * @param equal_func [(uh_key, uh_key) -> bool] Equality function or expression.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param a [uhash_T_key*] Array of elements.
+ * @param n [uhash_uint] Size of the array.
+ * @param ex [UHashExecutor*] Executor, can be NULL.
+ * @return [uhash_ret] Return code (see uhash_ret).
+ *
+ * @note Work is done by the calling thread if the executor is NULL, if it only has one task,
+ *       or if the temporary buffers cannot be allocated.
  *
  * @public @related UHash
  */
-#define UHASH_INIT(T, uh_key, uh_val, hash_func, equal_func)                                        \
-    P_UHASH_DEF_TYPE(T, uh_key, uh_val)                                                             \
-    P_UHASH_DECL(T, p_uhash_static_inline, uh_key, uh_val)                                          \
-    P_UHASH_IMPL_ALLOC(T, p_uhash_static_inline)                                                    \
-    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, hash_func, equal_func)
+#define uhset_insert_all_par(T, h, a, n, ex) uhset_insert_all_par_##T(h, a, n, ex)
 
 /**
- * Defines a new static hash table type with per-instance hash and equality functions.
+ * Checks whether the set is a superset of another set, probing it in parallel.
  *
  * @param T [symbol] Hash table name.
- * @param uh_key [symbol] Type of the keys.
- * @param uh_val [symbol] Type of the values.
- * @param default_hfunc [(uh_key) -> uhash_uint] Default hash function (can be NULL).
- * @param default_efunc [(uh_key, uh_key) -> bool] Default equality function (can be NULL).
+ * @param h1 [UHash(T)*] Superset.
+ * @param h2 [UHash(T)*] Subset.
+ * @param ex [UHashExecutor*] Executor, can be NULL.
+ * @return [bool] True if the superset relation holds, false otherwise.
  *
  * @public @related UHash
  */
-#define UHASH_INIT_PI(T, uh_key, uh_val, default_hfunc, default_efunc)                              \
-    P_UHASH_DEF_TYPE_PI(T, uh_key, uh_val)                                                          \
-    P_UHASH_DECL_PI(T, p_uhash_static_inline, uh_key, uh_val)                                       \
-    P_UHASH_IMPL_ALLOC_PI(T, p_uhash_static_inline, uh_key, default_hfunc, default_efunc)           \
-    P_UHASH_IMPL_COMMON(T, p_uhash_static_inline, uh_key, uh_val, h->hfunc, h->efunc)
-
-/// @name Memory allocation
-
-/// malloc override.
-#ifndef UHASH_MALLOC
-    #define UHASH_MALLOC malloc
-#endif
-
-/// realloc override.
-#ifndef UHASH_REALLOC
-    #define UHASH_REALLOC realloc
-#endif
-
-/// free override.
-#ifndef UHASH_FREE
-    #define UHASH_FREE free
-#endif
-
-/// @name Hash and equality functions
+#define uhset_is_superset_par(T, h1, h2, ex) uhset_is_superset_par_##T(h1, h2, ex)
 
 /**
- * Identity macro.
+ * Performs the union between two sets, mutating the first. Keys of the second set
+ * are hashed and looked up in parallel, then the missing ones are inserted.
  *
- * @param a LHS of the identity.
- * @param b RHS of the identity.
- * @return a == b
+ * @param T [symbol] Hash table name.
+ * @param h1 [UHash(T)*] Set to mutate.
+ * @param h2 [UHash(T)*] Other set.
+ * @param ex [UHashExecutor*] Executor, can be NULL.
+ * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
  *
  * @public @related UHash
  */
-#define uhash_identical(a, b) ((a) == (b))
+#define uhset_union_par(T, h1, h2, ex) uhset_union_par_##T(h1, h2, ex)
 
 /**
- * Equality function for strings.
+ * Performs the intersection between two sets, mutating the first. Keys of the first set
+ * are looked up in parallel, then the missing ones are removed.
  *
- * @param a [char const *] LHS of the equality relation (NULL terminated string).
- * @param b [char const *] RHS of the equality relation (NULL terminated string).
- * @return [bool] True if a is equal to b, false otherwise.
+ * @param T [symbol] Hash table name.
+ * @param h1 [UHash(T)*] Set to mutate.
+ * @param h2 [UHash(T)*] Other set.
+ * @param ex [UHashExecutor*] Executor, can be NULL.
  *
  * @public @related UHash
  */
-#define uhash_str_equals(a, b) (strcmp(a, b) == 0)
+#define uhset_intersect_par(T, h1, h2, ex) uhset_intersect_par_##T(h1, h2, ex)
 
 /**
- * Hash function for 8 bit integers.
+ * Expands to an executor running the specified number of tasks via OpenMP.
  *
- * @param key [int8_t/uint8_t] The integer.
- * @return [uhash_uint] The hash value.
+ * @param n [unsigned] Number of tasks.
+ * @return [UHashExecutor] Executor.
+ *
+ * @note Only available when compiling with OpenMP support.
  *
  * @public @related UHash
  */
-#define uhash_int8_hash(key) p_uhash_int8_hash(key)
+#define uhash_executor_omp(n) ((UHashExecutor) { .n_tasks = (n), .run_fn = p_uhash_omp_run })
 
 /**
- * Hash function for 16 bit integers.
+ * Checks whether the set is equal to another set.
  *
- * @param key [int16_t/uint16_t] The integer.
- * @return [uhash_uint] The hash value.
+ * @param T [symbol] Hash table name.
+ * @param h1 [UHash(T)*] LHS of the equality relation.
+ * @param h2 [UHash(T)*] RHS of the equality relation.
+ * @return [bool] True if the equality relation holds, false otherwise.
  *
  * @public @related UHash
  */
-#define uhash_int16_hash(key) p_uhash_int16_hash(key)
+#define uhset_equals(T, h1, h2) ((h1)->count == (h2)->count && uhset_is_superset_##T(h1, h2))
 
 /**
- * Hash function for 32 bit integers.
+ * Computes the hash of the set.
+ * The computed hash does not depend on the order of the elements, nor on the seed of the set.
  *
- * @param key [int32_t/uint32_t] The integer.
- * @return [uhash_uint] The hash value.
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [uhash_uint] Hash of the set.
  *
  * @public @related UHash
  */
-#define uhash_int32_hash(key) p_uhash_int32_hash(key)
+#define uhset_hash(T, h) uhset_hash_##T(h)
 
 /**
- * Hash function for 64 bit integers.
+ * Returns one of the elements in the set.
  *
- * @param key [int64_t/uint64_t] The integer.
- * @return [uhash_uint] The hash value.
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param m [uhash_T_key] Value returned if the set is empty.
+ * @return [uhash_T_key] One of the elements in the set.
  *
  * @public @related UHash
  */
-#define uhash_int64_hash(key) p_uhash_int64_hash(key)
+#define uhset_get_any(T, h, m) uhset_get_any_##T(h, m)
+
+/// @name Iteration
 
 /**
- * Hash function for strings.
+ * Iterates over the entries in the hash table.
  *
- * @param key [char const *] Pointer to a NULL-terminated string.
- * @return [uhash_uint] The hash value.
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param key_name [symbol] Name of the variable to which the key will be assigned.
+ * @param val_name [symbol] Name of the variable to which the value will be assigned.
+ * @param code [code] Code block to execute.
  *
  * @public @related UHash
  */
-#define uhash_str_hash(key) p_uhash_x31_str_hash(key)
+#define uhash_foreach(T, h, key_name, val_name, code) do {                                          \
+    if (h) {                                                                                        \
+        p_uhash_iter_prepare_##T(h);                                                                \
+        uhash_uint p_n_##key_name = (h)->n_buckets;                                                 \
+        for (uhash_uint p_i_##key_name = p_uhash_next((h)->flags, p_n_##key_name, 0);               \
+             p_i_##key_name != p_n_##key_name;                                                      \
+             p_i_##key_name = p_uhash_next((h)->flags, p_n_##key_name, p_i_##key_name + 1)) {       \
+            uhash_##T##_key key_name = (h)->keys[p_i_##key_name];                                   \
+            uhash_##T##_val val_name = p_uhash_val_##T(h, p_i_##key_name);                          \
+            code;                                                                                   \
+        }                                                                                           \
+    }                                                                                               \
+} while(0)
 
 /**
- * Hash function for pointers.
+ * Iterates over the keys in the hash table.
  *
- * @param key [pointer] The pointer.
- * @return [uhash_uint] The hash value.
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param key_name [symbol] Name of the variable to which the key will be assigned.
+ * @param code [code] Code block to execute.
  *
  * @public @related UHash
  */
-#if UINTPTR_MAX <= 0xffffffff
-    #define uhash_ptr_hash(key) p_uhash_int32_hash((uint32_t)(key))
-#else
-    #define uhash_ptr_hash(key) p_uhash_int64_hash((uint64_t)(key))
-#endif
+#define uhash_foreach_key(T, h, key_name, code) do {                                                \
+    if (h) {                                                                                        \
+        p_uhash_iter_prepare_##T(h);                                                                \
+        uhash_uint p_n_##key_name = (h)->n_buckets;                                                 \
+        for (uhash_uint p_i_##key_name = p_uhash_next((h)->flags, p_n_##key_name, 0);               \
+             p_i_##key_name != p_n_##key_name;                                                      \
+             p_i_##key_name = p_uhash_next((h)->flags, p_n_##key_name, p_i_##key_name + 1)) {       \
+            uhash_##T##_key key_name = (h)->keys[p_i_##key_name];                                   \
+            code;                                                                                   \
+        }                                                                                           \
+    }                                                                                               \
+} while(0)
 
 /**
- * Combines two hashes.
+ * Iterates over the values in the hash table.
  *
- * @param hash_1 [uhash_uint] First hash.
- * @param hash_2 [uhash_uint] Second hash.
- * @return [uhash_uint] The hash value.
+ * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param val_name [symbol] Name of the variable to which the value will be assigned.
+ * @param code [code] Code block to execute.
  *
  * @public @related UHash
  */
-#define uhash_combine_hash(hash_1, hash_2) (                                                        \
-    ((hash_1) ^ (hash_2)) + P_UHASH_COMBINE_MAGIC +                                                 \
-    ((hash_1) << P_UHASH_COMBINE_LS) + ((hash_1) >> P_UHASH_COMBINE_RS)                             \
-)
+#define uhash_foreach_value(T, h, val_name, code) do {                                              \
+    if (h) {                                                                                        \
+        p_uhash_iter_prepare_##T(h);                                                                \
+        uhash_uint p_n_##val_name = (h)->n_buckets;                                                 \
+        for (uhash_uint p_i_##val_name = p_uhash_next((h)->flags, p_n_##val_name, 0);               \
+             p_i_##val_name != p_n_##val_name;                                                      \
+             p_i_##val_name = p_uhash_next((h)->flags, p_n_##val_name, p_i_##val_name + 1)) {       \
+            uhash_##T##_val val_name = p_uhash_val_##T(h, p_i_##val_name);                          \
+            code;                                                                                   \
+        }                                                                                           \
+    }                                                                                               \
+} while(0)
 
-/// @name Declaration
+/// @name Statistics
 
 /**
- * Declares a new hash table variable.
+ * Computes statistics about the buckets of the specified hash table, such as
+ * its probe length distribution, in time linear in the number of buckets.
  *
  * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param[out] stats [UHashStats*] Statistics.
+ *
+ * @note Define UHASH_ENABLE_COUNTERS to also have tables count their operations,
+ *       which are reported in the 'counters' field of the statistics.
  *
  * @public @related UHash
  */
-#define UHash(T) UHash_##T
+#define uhash_stats(T, h, stats) uhash_stats_##T(h, stats)
 
 /**
- * Expands to 'struct UHash_T', useful for forward-declarations.
+ * Resets the operation counters of the specified hash table.
  *
- * @param T [symbol] Hash table name.
+ * @param h [UHash(T)*] Hash table instance.
  *
  * @public @related UHash
  */
-#define uhash_struct(T) struct UHash_##T
+#ifdef UHASH_ENABLE_COUNTERS
+    #define uhash_reset_counters(h) memset(&(h)->counters, 0, sizeof((h)->counters))
+#else
+    #define uhash_reset_counters(h) ((void)(h))
+#endif
 
-/// @name Memory management
+/// @name Images
 
 /**
- * Deallocates the specified hash table.
+ * Returns the size of the image of the specified hash table.
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table to deallocate.
+ * @param h [UHash(T)*] Hash table instance.
+ * @return [size_t] Size of the image in bytes, or zero if the table does not support images.
+ *
+ * @note Images are not supported by tables with cached hashes, concurrent readers or seeds.
  *
  * @public @related UHash
  */
-#define uhash_free(T, h) uhash_free_##T(h)
+#define uhash_image_size(T, h) uhash_image_size_##T(h)
 
 /**
- * Copies the specified hash table.
+ * Writes the image of the specified hash table to a buffer. The image is made of a
+ * UHashImageHeader followed by a copy of the buckets, and can be stored in a file
+ * to be loaded, possibly via mmap, without rehashing.
  *
  * @param T [symbol] Hash table name.
- * @param src [UHash(T)*] Hash table to copy.
- * @param dest [UHash(T)*] Hash table to copy into.
- * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ * @param h [UHash(T)*] Hash table instance.
+ * @param id [uint32_t] Identifier of the hash function, checked when loading the image.
+ * @param buf [void*] Buffer.
+ * @param size [size_t] Size of the buffer, at least uhash_image_size.
+ * @return [uhash_ret] UHASH_OK on success, UHASH_ERR if the buffer is too small
+ *                     or the table does not support images.
+ *
+ * @note Keys and values are copied bytewise, so their types must be trivially copyable,
+ *       and must not point to memory that will not be available when loading the image.
  *
  * @public @related UHash
  */
-#define uhash_copy(T, src, dest) uhash_copy_##T(src, dest)
+#define uhash_image_write(T, h, id, buf, size) uhash_image_write_##T(h, id, buf, size)
 
 /**
- * Returns a new hash set obtained by copying the keys of another hash table.
+ * Loads a hash table image, using its buckets in place.
  *
  * @param T [symbol] Hash table name.
- * @param src [UHash(T)*] Hash table to copy.
- * @param dest [UHash(T)*] Hash table to copy into.
- * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ * @param h [UHash(T)*] Zero-initialized hash table, with its hash and equality functions set
+ *                      if they are specified per instance. Must not be allocated via
+ *                      uhmap_alloc or uhset_alloc.
+ * @param id [uint32_t] Identifier of the hash function, which must match that of the image.
+ * @param image [void const*] Image, aligned to 64 bytes, such as a memory-mapped file.
+ * @param size [size_t] Size of the image.
+ * @return [uhash_ret] UHASH_OK on success, UHASH_ERR if the image is invalid, or was written
+ *                     by a different hash table type, platform or hash function.
+ *
+ * @note The loaded table is read-only: it must not be modified nor freed, and it remains
+ *       valid as long as the image does. Any number of threads can read it concurrently.
  *
  * @public @related UHash
  */
-#define uhash_copy_as_set(T, src, dest) uhash_copy_as_set_##T(src, dest)
+#define uhash_image_load(T, h, id, image, size) uhash_image_load_##T(h, id, image, size)
+
+/// @name Streams
 
 /**
- * Resizes the specified hash table.
+ * Initializes a stream writing chunks via the specified callback.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table to resize.
- * @param s [uhash_uint] Hash table size.
- * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ * @param fn [uhash_ret (*)(void *, void const *, size_t)] Callback writing chunks.
+ * @param data [void*] User data, passed to the callback.
+ * @return [UHashStream] Stream.
  *
  * @public @related UHash
  */
-#define uhash_resize(T, h, s) uhash_resize_##T(h, s)
-
-/// @name Primitives
+#define uhash_stream(fn, data) ((UHashStream){ .write_fn = (fn), .ctx = (data) })
 
 /**
- * Inserts a key into the specified hash table.
+ * Writes the next chunk of a snapshot of the specified hash table. Chunks contain at most
+ * as many records as fit in UHASH_STREAM_BUF bytes, so that memory usage is bounded
+ * regardless of the size of the table. Call repeatedly until the stream is done.
  *
  * @param T [symbol] Hash table name.
  * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_T_key] Key to insert.
- * @param[out] i [uhash_uint*] Index of the inserted element.
- * @return [uhash_ret] Return code (see uhash_ret).
+ * @param s [UHashStream*] Stream.
+ * @return [uhash_ret] UHASH_OK on success, UHASH_ERR if the callback failed,
+ *                     in which case the chunk can be written again.
+ *
+ * @note If the table is modified between chunks, entries may be duplicated or missed.
+ *       Duplicates are harmless, while missed entries are captured by a following delta.
  *
  * @public @related UHash
  */
-#define uhash_put(T, h, k, i) uhash_put_##T(h, k, i)
+#define uhash_stream_write(T, h, s) uhash_stream_write_##T(h, NULL, s)
 
 /**
- * Retrieves the index of the bucket associated with the specified key.
+ * Writes the next chunk of the changes of the specified hash table since a previous snapshot,
+ * which is a copy of the table made when it was streamed (see uhash_copy).
+ * Inserted and updated entries are written first, followed by deleted keys.
  *
  * @param T [symbol] Hash table name.
  * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_T_key] Key whose index should be retrieved.
- * @return [uhash_uint] Index of the key, or UHASH_INDEX_MISSING if it is absent.
+ * @param prev [UHash(T)*] Previous snapshot of the table.
+ * @param s [UHashStream*] Stream.
+ * @return [uhash_ret] UHASH_OK on success, UHASH_ERR if the callback failed,
+ *                     in which case the chunk can be written again.
+ *
+ * @note Values are compared bytewise, so padding bytes may cause unchanged entries
+ *       to be written, which is harmless.
  *
  * @public @related UHash
  */
-#define uhash_get(T, h, k) uhash_get_##T(h, k)
+#define uhash_stream_delta(T, h, prev, s) uhash_stream_write_##T(h, prev, s)
 
 /**
- * Deletes the bucket at the specified index.
+ * Applies the complete chunks in the specified buffer to a hash table, such as a replica.
  *
  * @param T [symbol] Hash table name.
  * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_uint] Index of the bucket to delete.
+ * @param data [void const*] Chunks.
+ * @param size [size_t] Size of the buffer.
+ * @param[out] consumed [size_t*] Number of bytes used, which only excludes a trailing
+ *                                incomplete chunk on success. Can be NULL.
+ * @return [uhash_ret] UHASH_OK on success, UHASH_ERR if a chunk is invalid
+ *                     or memory could not be allocated.
  *
  * @public @related UHash
  */
-#define uhash_delete(T, h, k) uhash_delete_##T(h, k)
+#define uhash_stream_apply(T, h, data, size, consumed)                                              \
+    uhash_stream_apply_##T(h, data, size, consumed)
+
+/// @name Sharded hash tables
 
 /**
- * Checks whether the hash table contains the specified key.
+ * Declares a new sharded hash table variable.
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_T_key] Key to test.
- * @return [bool] True if the hash table contains the specified key, false otherwise.
  *
  * @public @related UHash
  */
-#define uhash_contains(T, h, k) (uhash_get_##T(h, k) != UHASH_INDEX_MISSING)
+#define UHashSharded(T) UHashSharded_##T
 
 /**
- * Tests whether a bucket contains data.
+ * Allocates a new sharded map.
  *
- * @param h [UHash(T)*] Hash table instance.
- * @param x [uhash_uint] Index of the bucket to test.
- * @return [bool] True if the bucket contains data, false otherwise.
+ * @param T [symbol] Hash table name.
+ * @return [UHashSharded(T)*] Map instance, or NULL on error.
  *
  * @public @related UHash
  */
-#define uhash_exists(h, x) (!p_uhf_iseither((h)->flags, (x)))
+#define uhmap_sharded_alloc(T) uhmap_sharded_alloc_##T()
 
 /**
- * Retrieves the key at the specified index.
+ * Allocates a new sharded set.
  *
- * @param h [UHash(T)*] Hash table instance.
- * @param x [uhash_uint] Index of the bucket whose key should be retrieved.
- * @return [uhash_T_key] Key.
+ * @param T [symbol] Hash table name.
+ * @return [UHashSharded(T)*] Set instance, or NULL on error.
  *
  * @public @related UHash
  */
-#define uhash_key(h, x) ((h)->keys[x])
+#define uhset_sharded_alloc(T) uhset_sharded_alloc_##T()
 
 /**
- * Retrieves the value at the specified index.
- *
- * @param h [UHash(T)*] Hash table instance.
- * @param x [uhash_uint] Index of the bucket whose value should be retrieved.
- * @return [T value type] Value.
+ * Deallocates the specified sharded hash table.
  *
- * @note Undefined behavior if used on hash sets.
+ * @param T [symbol] Hash table name.
+ * @param h [UHashSharded(T)*] Hash table instance.
  *
  * @public @related UHash
  */
-#define uhash_value(h, x) ((h)->vals[x])
+#define uhash_sharded_free(T, h) uhash_sharded_free_##T(h)
 
 /**
- * Retrieves the start index.
+ * Returns the number of shards of the specified sharded hash table.
  *
- * @param h [UHash(T)*] Hash table instance.
- * @return [uhash_uint] Start index.
+ * @param h [UHashSharded(T)*] Hash table instance.
+ * @return [size_t] Number of shards.
  *
  * @public @related UHash
  */
-#define uhash_begin(h) (uhash_uint)(0)
+#define uhash_sharded_n_shards(h) p_uhash_n_shards(h)
 
 /**
- * Retrieves the end index.
+ * Returns the shard at the specified index. The shard must be locked
+ * via uhash_sharded_lock if other threads may access the table.
  *
- * @param h [UHash(T)*] Hash table instance.
- * @return [uhash_uint] End index.
+ * @param h [UHashSharded(T)*] Hash table instance.
+ * @param i [uhash_uint] Shard index.
+ * @return [UHash(T_shard)*] Shard.
  *
  * @public @related UHash
  */
-#define uhash_end(h) ((h)->n_buckets)
+#define uhash_sharded_shard(h, i) ((h)->shards[i].table)
 
 /**
- * Returns the number of elements in the hash table.
+ * Locks the shard the specified key belongs to, allowing it to be accessed
+ * via the regular hash table API on type T_shard.
  *
- * @param h [UHash(T)*] Hash table instance.
- * @return [uhash_uint] Number of elements.
+ * @param T [symbol] Hash table name.
+ * @param h [UHashSharded(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @return [uhash_uint] Index of the locked shard.
  *
- * @note For convenience, this macro returns '0' for NULL hash tables.
+ * @note Other sharded functions must not be called by the locking thread until
+ *       the shard is unlocked via uhash_sharded_unlock.
  *
  * @public @related UHash
  */
-#define uhash_count(h) ((h) ? (h)->count : 0)
+#define uhash_sharded_lock(T, h, k) uhash_sharded_lock_##T(h, k)
 
 /**
- * Resets the specified hash table without deallocating it.
+ * Unlocks a shard previously locked via uhash_sharded_lock.
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
+ * @param i [uhash_uint] Index of the locked shard.
  *
  * @public @related UHash
  */
-#define uhash_clear(T, h) uhash_clear_##T(h)
-
-/// @name Map-specific API
+#define uhash_sharded_unlock(T, h, i) uhash_sharded_unlock_##T(h, i)
 
 /**
- * Allocates a new hash map.
+ * Returns the number of elements in the sharded hash table.
  *
  * @param T [symbol] Hash table name.
- * @return [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
+ * @return [uhash_uint] Number of elements.
+ *
+ * @note Shards are counted one at a time: if the table is being modified concurrently,
+ *       the result may not match the size of the table at any given time.
  *
  * @public @related UHash
  */
-#define uhmap_alloc(T) uhmap_alloc_##T()
+#define uhash_sharded_count(T, h) uhash_sharded_count_##T(h)
 
 /**
- * Allocates a new hash map with per-instance hash and equality functions.
+ * Checks whether the sharded hash table contains the specified key.
  *
  * @param T [symbol] Hash table name.
- * @param hash_func [(uh_key) -> uhash_uint] Hash function pointer.
- * @param equal_func [(uh_key, uh_key) -> bool] Equality function pointer.
- * @return [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
+ * @param k [uhash_T_key] The key.
+ * @return [bool] True if the key is present, false otherwise.
  *
  * @public @related UHash
  */
-#define uhmap_alloc_pi(T, hash_func, equal_func) uhmap_alloc_pi_##T(hash_func, equal_func)
+#define uhash_sharded_contains(T, h, k) uhash_sharded_contains_##T(h, k)
 
 /**
- * Returns the value associated with the specified key.
+ * Returns the value associated with the specified key in a sharded map.
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
  * @param k [uhash_T_key] The key.
  * @param m [uhash_T_val] Value to return if the key is missing.
  * @return [uhash_T_val] Value associated with the specified key.
  *
  * @public @related UHash
  */
-#define uhmap_get(T, h, k, m) uhmap_get_##T(h, k, m)
+#define uhmap_sharded_get(T, h, k, m) uhmap_sharded_get_##T(h, k, m)
 
 /**
- * Adds a key:value pair to the map, returning the replaced value (if any).
+ * Adds a key:value pair to a sharded map, returning the replaced value (if any).
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
  * @param k [uhash_T_key] The key.
  * @param v [uhash_T_val] The value.
  * @param[out] e [uhash_T_val*] Existing value, only set if key was already in the map.
- * @return [uhash_ret] Return code (see uhash_ret).
+ * @return [uhash_ret] Return code.
  *
  * @public @related UHash
  */
-#define uhmap_set(T, h, k, v, e) uhmap_set_##T(h, k, v, e)
+#define uhmap_sharded_set(T, h, k, v, e) uhmap_sharded_set_##T(h, k, v, e)
 
 /**
- * Adds a key:value pair to the map, only if the key is missing.
+ * Adds a key:value pair to a sharded map, only if the key is missing.
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
  * @param k [uhash_T_key] The key.
  * @param v [uhash_T_val] The value.
  * @param[out] e [uhash_T_val*] Existing value, only set if key was already in the map.
- * @return [uhash_ret] Return code (see uhash_ret).
+ * @return [uhash_ret] Return code.
  *
  * @public @related UHash
  */
-#define uhmap_add(T, h, k, v, e) uhmap_add_##T(h, k, v, e)
+#define uhmap_sharded_add(T, h, k, v, e) uhmap_sharded_add_##T(h, k, v, e)
 
 /**
- * Replaces a value in the map, only if its associated key exists.
+ * Removes a key from a sharded map.
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
  * @param k [uhash_T_key] The key.
- * @param v [uhash_T_val] The value.
- * @param[out] r [uhash_T_val*] Replaced value, only set if the return value is true.
- * @return [bool] True if the value was replaced (its key was present), false otherwise.
+ * @param[out] v [uhash_T_val*] Removed value.
+ * @return [bool] True if the key was found, false otherwise.
  *
  * @public @related UHash
  */
-#define uhmap_replace(T, h, k, v, r) uhmap_replace_##T(h, k, v, r)
+#define uhmap_sharded_remove(T, h, k, v) uhmap_sharded_remove_##T(h, k, v)
 
 /**
- * Removes a key:value pair from the map.
+ * Inserts a key into a sharded set.
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
  * @param k [uhash_T_key] The key.
- * @return [bool] True if the key was present (it was deleted), false otherwise.
+ * @return [uhash_ret] Return code.
  *
  * @public @related UHash
  */
-#define uhmap_remove(T, h, k) uhmap_remove_##T(h, k, NULL, NULL)
+#define uhset_sharded_insert(T, h, k) uhset_sharded_insert_##T(h, k)
 
 /**
- * Removes a key:value pair from the map, returning the deleted key and value.
+ * Removes a key from a sharded set.
  *
  * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
  * @param k [uhash_T_key] The key.
- * @param[out] dk [uhash_T_key*] Deleted key, only set if key was present in the map.
- * @param[out] dv [uhash_T_val*] Deleted value, only set if key was present in the map.
- * @return [bool] True if the key was present (it was deleted), false otherwise.
+ * @return [bool] True if the key was found, false otherwise.
  *
  * @public @related UHash
  */
-#define uhmap_pop(T, h, k, dk, dv) uhmap_remove_##T(h, k, dk, dv)
-
-/// @name Set-specific API
+#define uhset_sharded_remove(T, h, k) uhset_sharded_remove_##T(h, k)
 
 /**
- * Allocates a new hash set.
+ * Merges two sharded hash tables with the same number of shards, shard by shard.
+ * Values of keys that are present in both maps are taken from the source map.
  *
  * @param T [symbol] Hash table name.
- * @return [UHash(T)*] Hash table instance.
+ * @param dest [UHashSharded(T)*] Destination hash table.
+ * @param src [UHashSharded(T)*] Source hash table.
+ * @return [uhash_ret] Return code.
  *
  * @public @related UHash
  */
-#define uhset_alloc(T) uhset_alloc_##T()
+#define uhash_sharded_merge(T, dest, src) uhash_sharded_merge_##T(dest, src)
 
 /**
- * Allocates a new hash set with per-instance hash and equality functions.
+ * Iterates over the entries in the sharded hash table, locking one shard at a time.
  *
  * @param T [symbol] Hash table name.
- * @param hash_func [(uh_key) -> uhash_uint] Hash function pointer.
- * @param equal_func [(uh_key, uh_key) -> bool] Equality function pointer.
- * @return [UHash(T)*] Hash table instance.
+ * @param h [UHashSharded(T)*] Hash table instance.
+ * @param key_name [symbol] Name of the variable to which the key will be assigned.
+ * @param val_name [symbol] Name of the variable to which the value will be assigned.
+ * @param code [code] Code block to execute.
+ *
+ * @note The code block must not call other sharded functions, nor exit the loop
+ *       via goto or return, as the current shard would remain locked.
+ *       Break only stops iterating over the current shard.
  *
  * @public @related UHash
  */
-#define uhset_alloc_pi(T, hash_func, equal_func) uhset_alloc_pi_##T(hash_func, equal_func)
+#define uhash_sharded_foreach(T, h, key_name, val_name, code) do {                                  \
+    for (uhash_uint p_s_##key_name = 0; p_s_##key_name != p_uhash_n_shards(h); ++p_s_##key_name) {  \
+        p_uhash_spin_lock(&(h)->shards[p_s_##key_name].lock);                                       \
+        uhash_foreach(T##_shard, (h)->shards[p_s_##key_name].table, key_name, val_name, code);      \
+        p_uhash_spin_unlock(&(h)->shards[p_s_##key_name].lock);                                     \
+    }                                                                                               \
+} while(0)
+
+/// @name String interning tables
 
 /**
- * Inserts an element in the set.
+ * Declares a new string interning table variable.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_T_key] Element to insert.
- * @return [uhash_ret] Return code (see uhash_ret).
+ * @param T [symbol] Interning table name.
  *
  * @public @related UHash
  */
-#define uhset_insert(T, h, k) uhset_insert_##T(h, k, NULL)
+#define UHashIntern(T) UHashIntern_##T
 
 /**
- * Inserts an element in the set, returning the existing element if it was already present.
+ * Allocates a new string interning table.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_T_key] Element to insert.
- * @param[out] e [uhash_T_key*] Existing element, only set if it was already in the set.
- * @return [uhash_ret] Return code (see uhash_ret).
+ * @param T [symbol] Interning table name.
+ * @return [UHashIntern(T)*] Interning table instance, or NULL on error.
  *
  * @public @related UHash
  */
-#define uhset_insert_get_existing(T, h, k, e) uhset_insert_##T(h, k, e)
+#define uhash_intern_alloc(T) uhash_intern_alloc_##T()
 
 /**
- * Populates the set with elements from an array.
+ * Allocates a new string interning table, whose buckets and strings are allocated
+ * via the specified allocator.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param a [uhash_T_key*] Array of elements.
- * @param n [uhash_uint] Size of the array.
- * @return [uhash_ret] Return code (see uhash_ret).
+ * @param T [symbol] Interning table name.
+ * @param a [UHashAllocator const *] Allocator, must outlive the table. Can be NULL.
+ * @return [UHashIntern(T)*] Interning table instance, or NULL on error.
  *
- * @note This function returns UHASH_INSERTED if at least one element in the array
- *       was missing from the set.
+ * @public @related UHash
+ */
+#define uhash_intern_alloc_with(T, a) uhash_intern_alloc_with_##T(a)
+
+/**
+ * Deallocates the specified string interning table, along with all its strings.
+ *
+ * @param T [symbol] Interning table name.
+ * @param h [UHashIntern(T)*] Interning table instance.
  *
  * @public @related UHash
  */
-#define uhset_insert_all(T, h, a, n) uhset_insert_all_##T(h, a, n)
+#define uhash_intern_free(T, h) uhash_intern_free_##T(h)
 
 /**
- * Replaces an element in the set, only if it exists.
+ * Removes all the strings from the interning table, invalidating pointers to them.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_T_key] Element to replace.
- * @param[out] r [uhash_T_key*] Replaced element, only set if the return value is true.
- * @return [bool] True if the element was replaced (it was present), false otherwise.
+ * @param T [symbol] Interning table name.
+ * @param h [UHashIntern(T)*] Interning table instance.
  *
  * @public @related UHash
  */
-#define uhset_replace(T, h, k, r) uhset_replace_##T(h, k, r)
+#define uhash_intern_clear(T, h) uhash_intern_clear_##T(h)
 
 /**
- * Removes an element from the set.
+ * Returns the number of strings in the interning table.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_T_key] Element to remove.
- * @return [bool] True if the element was removed (it was present), false otherwise.
+ * @param h [UHashIntern(T)*] Interning table instance.
+ * @return [uhash_uint] Number of strings.
  *
  * @public @related UHash
  */
-#define uhset_remove(T, h, k) uhset_remove_##T(h, k, NULL)
+#define uhash_intern_count(h) ((h)->table->count)
 
 /**
- * Removes an element from the set, returning the deleted element.
+ * Interns a string, copying it into the table if it is missing.
+ * The string need not be NULL-terminated.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param k [uhash_T_key] Element to remove.
- * @param[out] d [uhash_T_key*] Deleted element, only set if element was present in the set.
- * @return [bool] True if the element was removed (it was present), false otherwise.
+ * @param T [symbol] Interning table name.
+ * @param h [UHashIntern(T)*] Interning table instance.
+ * @param s [char const *] Pointer to the first character.
+ * @param l [size_t] Number of characters.
+ * @return [char const *] NULL-terminated interned copy of the string, or NULL on error.
+ *
+ * @note Interned copies never move, and remain valid until the table is cleared or freed.
  *
  * @public @related UHash
  */
-#define uhset_pop(T, h, k, d) uhset_remove_##T(h, k, d)
+#define uhash_intern(T, h, s, l) uhash_intern_##T(h, s, l)
 
 /**
- * Checks whether the set is a superset of another set.
+ * Interns a NULL-terminated string, copying it into the table if it is missing.
  *
- * @param T [symbol] Hash table name.
- * @param h1 [UHash(T)*] Superset.
- * @param h2 [UHash(T)*] Subset.
- * @return [bool] True if the superset relation holds, false otherwise.
+ * @param T [symbol] Interning table name.
+ * @param h [UHashIntern(T)*] Interning table instance.
+ * @param s [char const *] The string.
+ * @return [char const *] Interned copy of the string, or NULL on error.
  *
  * @public @related UHash
  */
-#define uhset_is_superset(T, h1, h2) uhset_is_superset_##T(h1, h2)
+#define uhash_intern_cstr(T, h, s) uhash_intern_##T(h, s, strlen(s))
 
 /**
- * Performs the union between two sets, mutating the first.
+ * Returns the interned copy of a string, if any.
  *
- * @param T [symbol] Hash table name.
- * @param h1 [UHash(T)*] Set to mutate.
- * @param h2 [UHash(T)*] Other set.
- * @return [uhash_ret] UHASH_OK if the operation succeeded, UHASH_ERR on error.
+ * @param T [symbol] Interning table name.
+ * @param h [UHashIntern(T)*] Interning table instance.
+ * @param s [char const *] Pointer to the first character.
+ * @param l [size_t] Number of characters.
+ * @return [char const *] Interned copy of the string, or NULL if it was never interned.
  *
  * @public @related UHash
  */
-#define uhset_union(T, h1, h2) uhset_union_##T(h1, h2)
+#define uhash_intern_get(T, h, s, l) uhash_intern_get_##T(h, s, l)
 
 /**
- * Performs the intersection between two sets, mutating the first.
+ * Iterates over the strings in the interning table.
  *
- * @param T [symbol] Hash table name.
- * @param h1 [UHash(T)*] Set to mutate.
- * @param h2 [UHash(T)*] Other set.
+ * @param T [symbol] Interning table name.
+ * @param h [UHashIntern(T)*] Interning table instance.
+ * @param key_name [symbol] Name of the UHashStrView variable to which strings will be assigned.
+ * @param code [code] Code block to execute.
  *
  * @public @related UHash
  */
-#define uhset_intersect(T, h1, h2) uhset_intersect_##T(h1, h2)
+#define uhash_intern_foreach(T, h, key_name, code)                                                  \
+    uhash_foreach_key(T##_table, (h)->table, key_name, code)
+
+/// @name Caches
 
 /**
- * Checks whether the set is equal to another set.
+ * Declares a new cache variable.
  *
- * @param T [symbol] Hash table name.
- * @param h1 [UHash(T)*] LHS of the equality relation.
- * @param h2 [UHash(T)*] RHS of the equality relation.
- * @return [bool] True if the equality relation holds, false otherwise.
+ * @param T [symbol] Cache name.
  *
  * @public @related UHash
  */
-#define uhset_equals(T, h1, h2) ((h1)->count == (h2)->count && uhset_is_superset_##T(h1, h2))
+#define UHashCache(T) UHashCache_##T
 
 /**
- * Computes the hash of the set.
- * The computed hash does not depend on the order of the elements.
+ * Allocates a new cache.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @return [uhash_uint] Hash of the set.
+ * @param T [symbol] Cache name.
+ * @param c [uhash_uint] Maximum number of entries, greater than zero.
+ * @return [UHashCache(T)*] Cache instance, or NULL on error.
+ *
+ * @note Buckets for twice as many entries are allocated right away, so that the ones
+ *       left deleted by evictions can be cleared without growing the table.
  *
  * @public @related UHash
  */
-#define uhset_hash(T, h) uhset_hash_##T(h)
+#define uhcache_alloc(T, c) uhcache_alloc_##T(c)
 
 /**
- * Returns one of the elements in the set.
+ * Allocates a new cache, whose buckets are allocated via the specified allocator.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param m [uhash_T_key] Value returned if the set is empty.
- * @return [uhash_T_key] One of the elements in the set.
+ * @param T [symbol] Cache name.
+ * @param c [uhash_uint] Maximum number of entries, greater than zero.
+ * @param a [UHashAllocator const *] Allocator, must outlive the cache. Can be NULL.
+ * @return [UHashCache(T)*] Cache instance, or NULL on error.
  *
  * @public @related UHash
  */
-#define uhset_get_any(T, h, m) uhset_get_any_##T(h, m)
+#define uhcache_alloc_with(T, c, a) uhcache_alloc_with_##T(c, a)
 
-/// @name Iteration
+/**
+ * Deallocates the specified cache, without calling its eviction function.
+ *
+ * @param T [symbol] Cache name.
+ * @param h [UHashCache(T)*] Cache instance.
+ *
+ * @public @related UHash
+ */
+#define uhcache_free(T, h) uhcache_free_##T(h)
 
 /**
- * Iterates over the entries in the hash table.
+ * Removes all the entries from the cache, without calling its eviction function.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param key_name [symbol] Name of the variable to which the key will be assigned.
- * @param val_name [symbol] Name of the variable to which the value will be assigned.
- * @param code [code] Code block to execute.
+ * @param T [symbol] Cache name.
+ * @param h [UHashCache(T)*] Cache instance.
  *
  * @public @related UHash
  */
-#define uhash_foreach(T, h, key_name, val_name, code) do {                                          \
-    if (h) {                                                                                        \
-        uhash_uint p_n_##key_name = (h)->n_buckets;                                                 \
-        for (uhash_uint p_i_##key_name = 0; p_i_##key_name != p_n_##key_name; ++p_i_##key_name) {   \
-            if (!uhash_exists(h, p_i_##key_name)) continue;                                         \
-            uhash_##T##_key key_name = (h)->keys[p_i_##key_name];                                   \
-            uhash_##T##_val val_name = (h)->vals[p_i_##key_name];                                   \
-            code;                                                                                   \
-        }                                                                                           \
-    }                                                                                               \
-} while(0)
+#define uhcache_clear(T, h) uhcache_clear_##T(h)
 
 /**
- * Iterates over the keys in the hash table.
+ * Returns the number of entries in the cache.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param key_name [symbol] Name of the variable to which the key will be assigned.
- * @param code [code] Code block to execute.
+ * @param h [UHashCache(T)*] Cache instance.
+ * @return [uhash_uint] Number of entries.
  *
  * @public @related UHash
  */
-#define uhash_foreach_key(T, h, key_name, code) do {                                                \
-    if (h) {                                                                                        \
-        uhash_uint p_n_##key_name = (h)->n_buckets;                                                 \
-        for (uhash_uint p_i_##key_name = 0; p_i_##key_name != p_n_##key_name; ++p_i_##key_name) {   \
-            if (!uhash_exists(h, p_i_##key_name)) continue;                                         \
-            uhash_##T##_key key_name = (h)->keys[p_i_##key_name];                                   \
-            code;                                                                                   \
-        }                                                                                           \
-    }                                                                                               \
-} while(0)
+#define uhcache_count(h) ((h)->table->count)
 
 /**
- * Iterates over the values in the hash table.
+ * Returns the maximum number of entries in the cache.
  *
- * @param T [symbol] Hash table name.
- * @param h [UHash(T)*] Hash table instance.
- * @param val_name [symbol] Name of the variable to which the value will be assigned.
- * @param code [code] Code block to execute.
+ * @param h [UHashCache(T)*] Cache instance.
+ * @return [uhash_uint] Capacity of the cache.
  *
  * @public @related UHash
  */
-#define uhash_foreach_value(T, h, val_name, code) do {                                              \
-    if (h) {                                                                                        \
-        uhash_uint p_n_##val_name = (h)->n_buckets;                                                 \
-        for (uhash_uint p_i_##val_name = 0; p_i_##val_name != p_n_##val_name; ++p_i_##val_name) {   \
-            if (!uhash_exists(h, p_i_##val_name)) continue;                                         \
-            uhash_##T##_val val_name = (h)->vals[p_i_##val_name];                                   \
-            code;                                                                                   \
-        }                                                                                           \
-    }                                                                                               \
-} while(0)
+#define uhcache_capacity(h) ((h)->capacity)
+
+/**
+ * Sets the function called on every evicted entry.
+ *
+ * @param T [symbol] Cache name.
+ * @param h [UHashCache(T)*] Cache instance.
+ * @param f [(uh_key, uh_val, void *) -> void] Eviction function, or NULL.
+ * @param d [void *] User data passed to the eviction function.
+ *
+ * @note The eviction function is called before the entry is removed,
+ *       and must not access the cache.
+ *
+ * @public @related UHash
+ */
+#define uhcache_set_evict(T, h, f, d) uhcache_set_evict_##T(h, f, d)
+
+/**
+ * Returns the value associated with the specified key, marking the entry as used.
+ *
+ * @param T [symbol] Cache name.
+ * @param h [UHashCache(T)*] Cache instance.
+ * @param k [uhcache_T_key] The key.
+ * @param m [uhcache_T_val] Value to return if the key is missing.
+ * @return [uhcache_T_val] Value associated with the specified key.
+ *
+ * @public @related UHash
+ */
+#define uhcache_get(T, h, k, m) uhcache_get_##T(h, k, m)
+
+/**
+ * Checks whether the cache contains the specified key, without marking its entry as used.
+ *
+ * @param T [symbol] Cache name.
+ * @param h [UHashCache(T)*] Cache instance.
+ * @param k [uhcache_T_key] The key.
+ * @return [bool] True if the cache contains the key, false otherwise.
+ *
+ * @public @related UHash
+ */
+#define uhcache_contains(T, h, k) uhcache_contains_##T(h, k)
+
+/**
+ * Associates a value with the specified key, marking the entry as used. If the cache is full,
+ * the first entry found by the clock hand that was not used since it last passed is evicted.
+ *
+ * @param T [symbol] Cache name.
+ * @param h [UHashCache(T)*] Cache instance.
+ * @param k [uhcache_T_key] The key.
+ * @param v [uhcache_T_val] The value.
+ * @return [uhash_ret] UHASH_INSERTED if the key was inserted, UHASH_PRESENT if its value
+ *                     was replaced, UHASH_ERR on error.
+ *
+ * @note Evicted entries are deleted from the table, and their buckets are reused by later
+ *       insertions, or cleared by rehashing the table once they accumulate.
+ *
+ * @public @related UHash
+ */
+#define uhcache_put(T, h, k, v) uhcache_put_##T(h, k, v)
+
+/**
+ * Removes the specified key from the cache, without calling its eviction function.
+ *
+ * @param T [symbol] Cache name.
+ * @param h [UHashCache(T)*] Cache instance.
+ * @param k [uhcache_T_key] The key.
+ * @param[out] r [uhcache_T_val*] Removed value. Can be NULL.
+ * @return [bool] True if the key was removed, false if it was missing.
+ *
+ * @public @related UHash
+ */
+#define uhcache_remove(T, h, k, r) uhcache_remove_##T(h, k, r)
 
 #endif // UHASH_H
@@ -1,6 +1,17 @@
 /**
  * Benchmarks for the uHash library.
  *
+ * Usage: uhash-bench [-n size] [-r runs] [-s seed] [-j]
+ *
+ * -n: number of buckets of the benchmarked tables (rounded up to a power of 2).
+ * -r: number of runs of each benchmark.
+ * -s: seed of the key generator, so that results are reproducible.
+ * -j: output results as JSON.
+ *
+ * Each benchmark runs over a range of key distributions and load factors, reporting
+ * the mean time per operation and the percentiles of the time per operation measured
+ * over batches of BENCH_BATCH operations.
+ *
  * @author Attractive Chaos (khash)
  * @author Ivano Bilenchi (uhash)
  *
@@ -11,182 +22,495 @@
  * @file
  */
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <time.h>
 
 #include "uhash.h"
 
-UHASH_INIT(str, char*, UHASH_VAL_IGNORE, uhash_str_hash, uhash_str_equals)
-UHASH_INIT(int, uint32_t, unsigned char, uhash_int32_hash, uhash_identical)
+UHASH_INIT(Int, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT(IntMix, uint32_t, uint32_t, uhash_int32_mix_hash, uhash_identical)
+UHASH_INIT_SIMD(IntSimd, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT_RH(IntRh, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT_INC(IntInc, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT_PI(IntPi, uint32_t, uint32_t, NULL, NULL)
+UHASH_INIT_PI(IntPiDef, uint32_t, uint32_t, uhash_pi_int32_hash, uhash_pi_int32_equals)
+UHASH_INIT(Str, char const *, UHASH_VAL_IGNORE, uhash_str_hash, uhash_str_equals)
+UHASH_INIT(StrMix, char const *, UHASH_VAL_IGNORE, uhash_str_mix_hash, uhash_str_equals)
 
 static uhash_uint int_hash(uint32_t num) { return uhash_int32_hash(num); }
 static bool int_eq(uint32_t lhs, uint32_t rhs) { return lhs == rhs; }
-UHASH_INIT_PI(intpi, uint32_t, unsigned char, NULL, NULL)
-
-static uhash_uint str_hash(char *str) { return uhash_str_hash(str); }
-static bool str_eq(char *lhs, char *rhs) { return strcmp(lhs, rhs) == 0; }
-UHASH_INIT_PI(strpi, char*, UHASH_VAL_IGNORE, NULL, NULL)
-
-typedef struct {
-    uint32_t key;
-    unsigned char val;
-} int_unpack_t;
-
-#if defined __GNUC__
-    #define UHASH_PACKED_STRUCT(NAME, FIELDS) typedef struct __attribute__((packed)) FIELDS NAME
-#elif defined _MSC_VER
-    #define UHASH_PACKED_STRUCT(NAME, FIELDS) \
-        __pragma(pack(push, 1)) typedef struct FIELDS NAME __pragma(pack(pop))
-#else
-    #define UHASH_PACKED_STRUCT(NAME, FIELDS) typedef struct FIELDS NAME
-#endif
 
-UHASH_PACKED_STRUCT(int_packed_t, {
-    uint32_t key;
-    unsigned char val;
-});
+// Number of operations timed together, as timing single operations is too coarse.
+#define BENCH_BATCH 256
+
+// Maximum number of buckets for adversarial keys, whose operations take quadratic time.
+#define BENCH_ADVERSARIAL_MAX 4096
 
-#define hash_eq(a, b) ((a).key == (b).key)
-#define hash_func(a) ((a).key)
+// Maximum number of benchmark results.
+#define BENCH_MAX_RESULTS 1024
 
-UHASH_INIT(iun, int_unpack_t, UHASH_VAL_IGNORE, hash_func, hash_eq)
-UHASH_INIT(ipk, int_packed_t, UHASH_VAL_IGNORE, hash_func, hash_eq)
+// Prevents the compiler from optimizing away benchmarked operations.
+static volatile uint64_t sink;
 
-static uint32_t data_size = 5000000;
-static uint32_t *int_data;
-static char **str_data;
+// ##########
+// # Timing #
+// ##########
 
-void ht_init_data(void) {
-    char buf[256];
-    uint32_t x = 11;
+static double now_ns(void) {
+#if defined CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#else
+    return (double)clock() * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
 
-    int_data = calloc(data_size, sizeof(*int_data));
-    str_data = calloc(data_size, sizeof(*str_data));
+// ###########
+// # Results #
+// ###########
+
+typedef struct Result {
+    char const *table;
+    char const *dist;
+    char const *op;
+    double load;
+    uint64_t n_buckets;
+    uint64_t ops;
+    double total_ns;
+    double bytes_per_entry;
+    double *samples;
+    size_t n_samples;
+    size_t cap_samples;
+} Result;
+
+typedef struct Bench {
+    uint64_t size;
+    unsigned runs;
+    uint64_t seed;
+    bool json;
+    char const *dist;
+    double load;
+    uint64_t n_buckets;
+    Result results[BENCH_MAX_RESULTS];
+    size_t n_results;
+} Bench;
+
+static Result *bench_result(Bench *b, char const *table, char const *op) {
+    for (size_t i = 0; i < b->n_results; ++i) {
+        Result *r = b->results + i;
+        if (strcmp(r->table, table) == 0 && strcmp(r->op, op) == 0 && r->dist == b->dist &&
+            r->load == b->load) {
+            return r;
+        }
+    }
 
-    for (uint32_t i = 0; i < data_size; ++i) {
-        int_data[i] = (uint32_t)(data_size * ((double)x / UINT32_MAX) / 4) * 271828183U;
-        snprintf(buf, sizeof(buf), "%x", int_data[i]);
-        str_data[i] = malloc(sizeof(buf));
-        memcpy(str_data[i], buf, sizeof(buf));
-        x = 1664525 * x + 1013904223;
+    if (b->n_results == BENCH_MAX_RESULTS) {
+        fprintf(stderr, "Too many results.\n");
+        exit(EXIT_FAILURE);
     }
-}
 
-void ht_destroy_data(void) {
-    for (uint32_t i = 0; i < data_size; ++i) free(str_data[i]);
-    free(str_data);
-    free(int_data);
+    Result *r = b->results + b->n_results++;
+    *r = (Result){ .table = table, .dist = b->dist, .op = op, .load = b->load,
+                   .n_buckets = b->n_buckets };
+    return r;
 }
 
-void ht_uhash_int(void) {
-    uint32_t *data = int_data;
-    UHash(int) *h = uhmap_alloc(int);
+static void result_add(Result *r, double ns, size_t ops) {
+    if (!ops) return;
 
-    for (uint32_t i = 0; i < data_size; ++i) {
-        uhash_uint k;
-        uhash_put(int, h, data[i], &k);
-        uhash_value(h, k) = (unsigned char)(i & 0xffU);
+    if (r->n_samples == r->cap_samples) {
+        r->cap_samples = r->cap_samples ? r->cap_samples * 2 : 64;
+        r->samples = realloc(r->samples, r->cap_samples * sizeof(*r->samples));
+        if (!r->samples) exit(EXIT_FAILURE);
     }
 
-    uint64_t count = uhash_count(h);
-    printf("[ht_uhash_int] size: %llu\n", count);
-    uhash_free(int, h);
+    r->samples[r->n_samples++] = ns / (double)ops;
+    r->total_ns += ns;
+    r->ops += ops;
 }
 
-void ht_uhash_int_pi(void) {
-    uint32_t *data = int_data;
-    UHash(intpi) *h = uhmap_alloc_pi(intpi, int_hash, int_eq);
+static int double_cmp(void const *lhs, void const *rhs) {
+    double const a = *(double const *)lhs, b = *(double const *)rhs;
+    return (a > b) - (a < b);
+}
 
-    for (uint32_t i = 0; i < data_size; ++i) {
-        uhash_uint k;
-        uhash_put(intpi, h, data[i], &k);
-        uhash_value(h, k) = (unsigned char)(i & 0xffU);
-    }
+static double result_percentile(Result const *r, double p) {
+    if (!r->n_samples) return 0;
+    size_t const i = (size_t)(p * (double)(r->n_samples - 1) + 0.5);
+    return r->samples[i];
+}
 
-    uint64_t count = uhash_count(h);
-    printf("[ht_uhash_int] size: %llu\n", count);
-    uhash_free(intpi, h);
+/*
+ * Times the specified code for each i in [0, count), in batches of BENCH_BATCH iterations.
+ *
+ * @param r [Result *] Result the timings are added to.
+ * @param count [size_t] Number of iterations.
+ * @param i [symbol] Name of the iteration index.
+ * @param code [code] Benchmarked code.
+ */
+#define bench_ops(r, count, i, code) do {                                                           \
+    size_t const p_count = (count);                                                                 \
+    for (size_t p_start = 0; p_start < p_count; p_start += BENCH_BATCH) {                           \
+        size_t const p_end = p_count - p_start > BENCH_BATCH ? p_start + BENCH_BATCH : p_count;     \
+        double const p_t = now_ns();                                                                \
+        for (size_t i = p_start; i < p_end; ++i) { code; }                                          \
+        result_add(r, now_ns() - p_t, p_end - p_start);                                             \
+    }                                                                                               \
+} while (0)
+
+/*
+ * Times the specified code once, as count operations.
+ *
+ * @param r [Result *] Result the timing is added to.
+ * @param count [size_t] Number of operations performed by the code.
+ * @param code [code] Benchmarked code.
+ */
+#define bench_once(r, count, code) do {                                                             \
+    double const p_t = now_ns();                                                                    \
+    code;                                                                                           \
+    result_add(r, now_ns() - p_t, count);                                                           \
+} while (0)
+
+// ########
+// # Keys #
+// ########
+
+typedef struct Keys {
+    // Distinct keys that are inserted.
+    uint32_t *keys;
+    // Distinct keys that are never inserted.
+    uint32_t *misses;
+    // Inserted keys, in the order they are looked up.
+    uint32_t *lookups;
+    size_t n;
+} Keys;
+
+static uint64_t rng_next(uint64_t *state) {
+    // SplitMix64.
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27U)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31U);
 }
 
-void ht_uhash_str(void) {
-    char **data = str_data;
-    UHash(str) *h = uhset_alloc(str);
+// Bijective mixer, so that distinct inputs yield distinct keys.
+static uint32_t key_mix(uint32_t x, uint32_t seed) {
+    x ^= seed;
+    x ^= x >> 16U;
+    x *= 0x85ebca6bU;
+    x ^= x >> 13U;
+    x *= 0xc2b2ae35U;
+    x ^= x >> 16U;
+    return x;
+}
+
+static uint32_t key_at(char const *dist, size_t i, uint32_t seed) {
+    if (strcmp(dist, "sequential") == 0) return (uint32_t)i;
+    // Keys sharing their low bits all have the same home bucket with the default hash.
+    if (strcmp(dist, "adversarial") == 0) return (uint32_t)i << 16U;
+    return key_mix((uint32_t)i, seed);
+}
 
-    for (uint32_t i = 0; i < data_size; ++i) {
-        uhash_put(str, h, data[i], NULL);
+static void keys_init(Keys *k, char const *dist, size_t n, uint64_t seed) {
+    k->n = n;
+    k->keys = malloc(n * sizeof(*k->keys));
+    k->misses = malloc(n * sizeof(*k->misses));
+    k->lookups = malloc(n * sizeof(*k->lookups));
+    if (!(k->keys && k->misses && k->lookups)) exit(EXIT_FAILURE);
+
+    for (size_t i = 0; i < n; ++i) {
+        k->keys[i] = key_at(dist, i, (uint32_t)seed);
+        k->misses[i] = key_at(dist, n + i, (uint32_t)seed);
     }
 
-    uint64_t count = uhash_count(h);
-    printf("[ht_uhash_int] size: %llu\n", count);
-    uhash_free(str, h);
+    uint64_t state = seed;
+
+    if (strcmp(dist, "zipf") == 0) {
+        // Lookups follow Zipf's law with exponent 1 over the inserted keys.
+        double *cdf = malloc(n * sizeof(*cdf));
+        if (!cdf) exit(EXIT_FAILURE);
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) cdf[i] = (sum += 1.0 / (double)(i + 1));
+
+        for (size_t i = 0; i < n; ++i) {
+            double const u = (double)(rng_next(&state) >> 11U) / 9007199254740992.0 * sum;
+            size_t lo = 0, hi = n - 1;
+            while (lo < hi) {
+                size_t const mid = lo + (hi - lo) / 2;
+                if (cdf[mid] < u) lo = mid + 1; else hi = mid;
+            }
+            k->lookups[i] = k->keys[lo];
+        }
+
+        free(cdf);
+    } else {
+        for (size_t i = 0; i < n; ++i) k->lookups[i] = k->keys[rng_next(&state) % n];
+    }
 }
 
-void ht_uhash_str_pi(void) {
-    char **data = str_data;
-    UHash(strpi) *h = uhset_alloc_pi(strpi, str_hash, str_eq);
+static void keys_deinit(Keys *k) {
+    free(k->keys);
+    free(k->misses);
+    free(k->lookups);
+}
+
+// ##############
+// # Benchmarks #
+// ##############
 
-    for (uint32_t i = 0; i < data_size; ++i) {
-        uhash_put(strpi, h, data[i], NULL);
+/*
+ * Defines the benchmarks of a hash table type with uint32_t keys and values.
+ *
+ * @param T [symbol] Hash table name.
+ * @param alloc [expression] Allocates a hash table instance.
+ */
+#define bench_define_int(T, alloc)                                                                  \
+    static void bench_##T(Bench *b, Keys const *k) {                                                \
+        size_t const n = k->n;                                                                      \
+                                                                                                    \
+        for (unsigned run = 0; run < b->runs; ++run) {                                              \
+            UHash(T) *h = alloc;                                                                    \
+            if (!h || uhash_resize(T, h, (uhash_uint)b->n_buckets)) exit(EXIT_FAILURE);             \
+                                                                                                    \
+            Result *r = bench_result(b, #T, "insert");                                              \
+            bench_ops(r, n, i, {                                                                    \
+                uhash_ret const ret = uhmap_set(T, h, k->keys[i], (uint32_t)i, NULL);               \
+                if (ret == UHASH_ERR) exit(EXIT_FAILURE);                                           \
+            });                                                                                     \
+                                                                                                    \
+            UHashStats stats;                                                                       \
+            uhash_stats(T, h, &stats);                                                              \
+            r->bytes_per_entry = stats.bytes_per_entry;                                             \
+                                                                                                    \
+            uint64_t sum = 0;                                                                       \
+            r = bench_result(b, #T, "lookup_hit");                                                  \
+            bench_ops(r, n, i, sum += uhmap_get(T, h, k->lookups[i], 0));                           \
+            r = bench_result(b, #T, "lookup_miss");                                                 \
+            bench_ops(r, n, i, sum += uhash_get(T, h, k->misses[i]));                               \
+            r = bench_result(b, #T, "iterate");                                                     \
+            bench_once(r, n, uhash_foreach_value(T, h, val, sum += val));                           \
+                                                                                                    \
+            /* Churn: each operation replaces a key with a new one, keeping the load constant. */   \
+            r = bench_result(b, #T, "churn");                                                       \
+            bench_ops(r, n, i, {                                                                    \
+                sum += uhmap_remove(T, h, k->keys[i]);                                              \
+                uhash_ret const ret = uhmap_set(T, h, k->misses[i], (uint32_t)i, NULL);             \
+                if (ret == UHASH_ERR) exit(EXIT_FAILURE);                                           \
+                sum += (uint64_t)ret;                                                               \
+            });                                                                                     \
+                                                                                                    \
+            r = bench_result(b, #T, "delete");                                                      \
+            bench_ops(r, n, i, sum += uhmap_remove(T, h, k->misses[i]));                            \
+                                                                                                    \
+            sink += sum;                                                                            \
+            uhash_free(T, h);                                                                       \
+        }                                                                                           \
     }
 
-    uint64_t count = uhash_count(h);
-    printf("[ht_uhash_int] size: %llu\n", count);
-    uhash_free(strpi, h);
+bench_define_int(Int, uhmap_alloc(Int))
+bench_define_int(IntMix, uhmap_alloc(IntMix))
+bench_define_int(IntSimd, uhmap_alloc(IntSimd))
+bench_define_int(IntRh, uhmap_alloc(IntRh))
+bench_define_int(IntInc, uhmap_alloc(IntInc))
+bench_define_int(IntPi, uhmap_alloc_pi(IntPi, int_hash, int_eq))
+bench_define_int(IntPiDef, uhmap_alloc(IntPiDef))
+
+static void bench_set_algebra(Bench *b, Keys const *k) {
+    size_t const n = k->n, half = n / 2;
+
+    for (unsigned run = 0; run < b->runs; ++run) {
+        // The second set shares half of its keys with the first one.
+        UHash(Int) *s1 = uhset_alloc(Int), *s2 = uhset_alloc(Int), *tmp = uhset_alloc(Int);
+        if (!(s1 && s2 && tmp)) exit(EXIT_FAILURE);
+
+        for (size_t i = 0; i < n; ++i) {
+            if (uhset_insert(Int, s1, k->keys[i]) == UHASH_ERR) exit(EXIT_FAILURE);
+            uint32_t const key = i < half ? k->keys[i] : k->misses[i];
+            if (uhset_insert(Int, s2, key) == UHASH_ERR) exit(EXIT_FAILURE);
+        }
+
+        bool superset = false;
+        bench_once(bench_result(b, "Int", "superset"), n, superset = uhset_is_superset(Int, s1, s2));
+        sink += superset;
+
+        if (uhash_copy(Int, s1, tmp)) exit(EXIT_FAILURE);
+        bench_once(bench_result(b, "Int", "union"), n, (void)uhset_union(Int, tmp, s2));
+        sink += uhash_count(tmp);
+
+        if (uhash_copy(Int, s1, tmp)) exit(EXIT_FAILURE);
+        bench_once(bench_result(b, "Int", "intersect"), n, uhset_intersect(Int, tmp, s2));
+        sink += uhash_count(tmp);
+
+        uhash_free(Int, s1);
+        uhash_free(Int, s2);
+        uhash_free(Int, tmp);
+    }
 }
 
-void ht_uhash_unpack(void) {
-    uint32_t *data = int_data;
-    UHash(iun) *h = uhset_alloc(iun);
+/*
+ * Defines the benchmarks of a string set type.
+ *
+ * @param T [symbol] Hash table name.
+ */
+#define bench_define_str(T)                                                                         \
+    static void bench_##T(Bench *b, char **keys, char **misses, char **lookups, size_t n) {         \
+        for (unsigned run = 0; run < b->runs; ++run) {                                              \
+            UHash(T) *h = uhset_alloc(T);                                                           \
+            if (!h || uhash_resize(T, h, (uhash_uint)b->n_buckets)) exit(EXIT_FAILURE);             \
+                                                                                                    \
+            Result *r = bench_result(b, #T, "insert");                                              \
+            bench_ops(r, n, i, {                                                                    \
+                if (uhset_insert(T, h, keys[i]) == UHASH_ERR) exit(EXIT_FAILURE);                   \
+            });                                                                                     \
+                                                                                                    \
+            UHashStats stats;                                                                       \
+            uhash_stats(T, h, &stats);                                                              \
+            r->bytes_per_entry = stats.bytes_per_entry;                                             \
+                                                                                                    \
+            uint64_t sum = 0;                                                                       \
+            r = bench_result(b, #T, "lookup_hit");                                                  \
+            bench_ops(r, n, i, sum += uhash_get(T, h, lookups[i]));                                 \
+            r = bench_result(b, #T, "lookup_miss");                                                 \
+            bench_ops(r, n, i, sum += uhash_get(T, h, misses[i]));                                  \
+            r = bench_result(b, #T, "delete");                                                      \
+            bench_ops(r, n, i, sum += uhset_remove(T, h, keys[i]));                                 \
+                                                                                                    \
+            sink += sum;                                                                            \
+            uhash_free(T, h);                                                                       \
+        }                                                                                           \
+    }
+
+bench_define_str(Str)
+bench_define_str(StrMix)
 
-    for (uint32_t i = 0; i < data_size; ++i) {
-        int_unpack_t x;
-        x.key = data[i];
-        x.val = (unsigned char)(i & 0xffU);
-        uhash_put(iun, h, x, NULL);
+static char **str_keys(uint32_t const *keys, size_t n) {
+    char **strs = malloc(n * sizeof(*strs));
+    if (!strs) exit(EXIT_FAILURE);
+
+    for (size_t i = 0; i < n; ++i) {
+        char buf[16];
+        int const len = snprintf(buf, sizeof(buf), "%" PRIx32, keys[i]);
+        strs[i] = malloc((size_t)len + 1);
+        if (!strs[i]) exit(EXIT_FAILURE);
+        memcpy(strs[i], buf, (size_t)len + 1);
     }
 
-    uint64_t count = uhash_count(h);
-    printf("[ht_uhash_unpack] size: %llu (sizeof=%u)\n", count, (unsigned)sizeof(int_unpack_t));
-    uhash_free(iun, h);
+    return strs;
+}
+
+static void str_keys_free(char **strs, size_t n) {
+    for (size_t i = 0; i < n; ++i) free(strs[i]);
+    free(strs);
 }
 
-void ht_uhash_packed(void) {
-    uint32_t *data = int_data;
-    UHash(ipk) *h = uhset_alloc(ipk);
+static void bench_strings(Bench *b, Keys const *k) {
+    size_t const n = k->n;
+    char **keys = str_keys(k->keys, n), **misses = str_keys(k->misses, n);
 
-    for (uint32_t i = 0; i < data_size; ++i) {
-        int_packed_t x;
-        x.key = data[i];
-        x.val = (unsigned char)(i & 0xffU);
-        uhash_put(ipk, h, x, NULL);
-    }
+    // Lookups compare strings by value, so they do not use the inserted pointers.
+    char **lookups = str_keys(k->lookups, n);
+
+    bench_Str(b, keys, misses, lookups, n);
+    bench_StrMix(b, keys, misses, lookups, n);
 
-    uint64_t count = uhash_count(h);
-    printf("[ht_uhash_packed] size: %llu (sizeof=%u)\n", count, (unsigned)sizeof(int_packed_t));
-    uhash_free(ipk, h);
+    str_keys_free(keys, n);
+    str_keys_free(misses, n);
+    str_keys_free(lookups, n);
 }
 
-void ht_timing(void (*f)(void)) {
-    clock_t t = clock();
-    (*f)();
-    printf("[ht_timing] %.3lf sec\n", (double)(clock() - t) / CLOCKS_PER_SEC);
+// ##########
+// # Output #
+// ##########
+
+static void print_results(Bench const *b) {
+    if (b->json) {
+        printf("{\n  \"config\": { \"size\": %" PRIu64 ", \"runs\": %u, \"seed\": %" PRIu64
+               ", \"batch\": %d },\n  \"results\": [\n", b->size, b->runs, b->seed, BENCH_BATCH);
+    } else {
+        printf("%-10s %-12s %5s %-12s %10s %10s %10s %10s %10s\n", "table", "keys", "load", "op",
+               "ns/op", "p50", "p90", "p99", "B/entry");
+    }
+
+    for (size_t i = 0; i < b->n_results; ++i) {
+        Result const *r = b->results + i;
+        qsort(r->samples, r->n_samples, sizeof(*r->samples), double_cmp);
+        double const ns_op = r->ops ? r->total_ns / (double)r->ops : 0;
+        double const p50 = result_percentile(r, 0.5), p90 = result_percentile(r, 0.9);
+        double const p99 = result_percentile(r, 0.99);
+
+        if (b->json) {
+            printf("    { \"table\": \"%s\", \"keys\": \"%s\", \"load\": %.2f, \"op\": \"%s\", "
+                   "\"n_buckets\": %" PRIu64 ", \"ops\": %" PRIu64 ", \"ns_per_op\": %.3f, "
+                   "\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"bytes_per_entry\": %.2f }%s\n",
+                   r->table, r->dist, r->load, r->op, r->n_buckets, r->ops, ns_op, p50, p90, p99,
+                   r->bytes_per_entry, i + 1 < b->n_results ? "," : "");
+        } else {
+            printf("%-10s %-12s %5.2f %-12s %10.2f %10.2f %10.2f %10.2f", r->table, r->dist,
+                   r->load, r->op, ns_op, p50, p90, p99);
+            if (r->bytes_per_entry > 0) printf(" %10.2f", r->bytes_per_entry);
+            printf("\n");
+        }
+    }
+
+    if (b->json) printf("  ]\n}\n");
 }
 
 int main(int argc, char *argv[]) {
-    if (argc > 1) data_size = (uint32_t)strtoul(argv[1], NULL, 10);
-
-    printf("Starting benchmark...\n");
+    static Bench b = { .size = 1U << 18U, .runs = 3, .seed = 11 };
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            b.json = true;
+        } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+            b.size = strtoull(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+            b.runs = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            b.seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [-n size] [-r runs] [-s seed] [-j]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
-    ht_init_data();
-    ht_timing(ht_uhash_int);
-    ht_timing(ht_uhash_int_pi);
-    ht_timing(ht_uhash_str);
-    ht_timing(ht_uhash_str_pi);
-    ht_timing(ht_uhash_unpack);
-    ht_timing(ht_uhash_packed);
-    ht_destroy_data();
+    if (b.size < 16 || b.size > UHASH_UINT_MAX / 2 || !b.runs) {
+        fprintf(stderr, "Invalid size or number of runs.\n");
+        return EXIT_FAILURE;
+    }
 
-    printf("Benchmark finished.\n");
+    char const *dists[] = { "uniform", "sequential", "zipf", "adversarial" };
+    double const loads[] = { 0.25, 0.5, 0.75 };
+
+    for (size_t d = 0; d < sizeof(dists) / sizeof(*dists); ++d) {
+        for (size_t l = 0; l < sizeof(loads) / sizeof(*loads); ++l) {
+            b.dist = dists[d];
+            b.load = loads[l];
+            b.n_buckets = 16;
+            while (b.n_buckets < b.size) b.n_buckets <<= 1U;
+            bool const adversarial = strcmp(b.dist, "adversarial") == 0;
+            if (adversarial && b.n_buckets > BENCH_ADVERSARIAL_MAX) {
+                b.n_buckets = BENCH_ADVERSARIAL_MAX;
+            }
+
+            Keys k;
+            keys_init(&k, b.dist, (size_t)(b.load * (double)b.n_buckets), b.seed);
+            bench_Int(&b, &k);
+            bench_IntMix(&b, &k);
+            bench_IntSimd(&b, &k);
+            // Robin Hood tables reject keys once too many of them share a home bucket.
+            if (!adversarial) bench_IntRh(&b, &k);
+            bench_IntInc(&b, &k);
+            bench_IntPi(&b, &k);
+            bench_IntPiDef(&b, &k);
+            bench_set_algebra(&b, &k);
+            if (!adversarial) bench_strings(&b, &k);
+            keys_deinit(&k);
+        }
+    }
 
-    return 0;
+    print_results(&b);
+    for (size_t i = 0; i < b.n_results; ++i) free(b.results[i].samples);
+    return EXIT_SUCCESS;
 }
@@ -27,6 +27,185 @@
 
 UHASH_INIT(IntHash, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
 UHASH_INIT_PI(IntHashPi, uint32_t, uint32_t, NULL, NULL)
+UHASH_INIT_PI(IntHashPiDef, uint32_t, uint32_t, uhash_pi_int32_hash, uhash_pi_int32_equals)
+UHASH_INIT_PI(StrHashPi, char const *, uint32_t, uhash_pi_str_hash, uhash_pi_str_equals)
+UHASH_INIT_SIMD(IntHashSimd, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT_CH(StrHashCh, char const *, uint32_t, uhash_str_hash, uhash_str_equals)
+UHASH_INIT_RH(IntHashRh, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT_SBO(IntHashSbo, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT_CONC(IntHashConc, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT_INC(IntHashInc, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT(StrHashMix, char const *, uint32_t, uhash_str_mix_hash, uhash_str_equals)
+UHASH_INIT(StrViewHash, UHashStrView, uint32_t, uhash_strv_hash, uhash_strv_equals)
+UHASH_INIT_INTERN(Strings)
+UHASH_INIT_PACKED(IntFlags, uint32_t, 1, uhash_int32_hash, uhash_identical)
+UHASH_INIT_PACKED(IntNibbles, uint32_t, 4, uhash_int32_hash, uhash_identical)
+UHASH_INIT_CUCKOO(IntHashCuckoo, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+
+// Groups of 32 consecutive keys have the same hash.
+#define test_collide_hash(key) ((uhash_uint)((key) >> 5U))
+UHASH_INIT_CUCKOO(IntHashCollide, uint32_t, uint32_t, test_collide_hash, uhash_identical)
+
+// All keys have the same hash.
+#define test_same_hash(key) ((uhash_uint)((key) & 0U))
+UHASH_INIT_RH(IntHashRhSame, uint32_t, uint32_t, test_same_hash, uhash_identical)
+UHASH_INIT_SEEDED(IntHashSeeded, uint32_t, uint32_t, uhash_int32_seeded_hash, uhash_identical)
+
+// All keys collide under the zero seed.
+#define test_flood_hash(key, seed) ((seed) ? uhash_int32_seeded_hash(key, seed) : 0)
+UHASH_INIT_SEEDED(IntHashFlood, uint32_t, uint32_t, test_flood_hash, uhash_identical)
+UHASH_INIT_SHARDED(IntHashSh, uint32_t, uint32_t, uhash_int32_hash, uhash_identical, 8)
+UHASH_INIT_CACHE(IntCache, uint32_t, uint32_t, uhash_int32_hash, uhash_identical)
+UHASH_INIT_IDX(IntHashIdx, uint32_t, uint32_t, uhash_int32_hash, uhash_identical, uint16_t)
+
+/// @name Layout-generic operations
+
+/*
+ * Operations of a table type mapping uint32_t keys to uint32_t values, so that tests
+ * covering every layout are plain functions whose failures report the failing line.
+ */
+typedef struct TestOps {
+    void *(*map_alloc_with)(UHashAllocator const *a);
+    void *(*set_alloc_with)(UHashAllocator const *a);
+    void *(*clone)(void *h);
+    void (*free)(void *h);
+    void (*clear)(void *h);
+    uhash_uint (*count)(void const *h);
+    uhash_ret (*resize)(void *h, uhash_uint n_buckets);
+    uhash_ret (*copy)(void const *src, void *dest);
+    uhash_ret (*copy_as_set)(void const *src, void *dest);
+    bool (*contains)(void const *h, uint32_t key);
+    uint32_t (*get)(void const *h, uint32_t key, uint32_t if_missing);
+    uhash_ret (*set)(void *h, uint32_t key, uint32_t val);
+    bool (*map_remove)(void *h, uint32_t key);
+    uhash_ret (*insert)(void *h, uint32_t key);
+    bool (*set_remove)(void *h, uint32_t key);
+    bool (*equals)(void const *h1, void const *h2);
+    uhash_uint (*hash)(void const *h);
+    uint32_t (*get_any)(void const *h, uint32_t if_empty);
+    uhash_uint (*items)(void const *h, uint32_t *keys, uint32_t *vals);
+    uhash_ret (*insert_all_par)(void *h, uint32_t const *items, uhash_uint n,
+                                UHashExecutor const *ex);
+    bool (*is_superset_par)(void const *h1, void const *h2, UHashExecutor const *ex);
+    uhash_ret (*union_par)(void *h1, void const *h2, UHashExecutor const *ex);
+    void (*intersect_par)(void *h1, void const *h2, UHashExecutor const *ex);
+    size_t (*image_size)(void const *h);
+    uhash_ret (*image_write)(void const *h, uint32_t id, void *buf, size_t size);
+    uhash_ret (*image_load)(void *h, uint32_t id, void const *image, size_t size);
+    size_t size;
+} TestOps;
+
+#define test_define_ops(T)                                                                          \
+    static void *ops_map_alloc_with_##T(UHashAllocator const *a) {                                  \
+        return uhmap_alloc_with(T, a);                                                              \
+    }                                                                                               \
+    static void *ops_set_alloc_with_##T(UHashAllocator const *a) {                                  \
+        return uhset_alloc_with(T, a);                                                              \
+    }                                                                                               \
+    static void *ops_clone_##T(void *h) { return uhash_clone(T, (UHash(T) *)h); }                   \
+    static void ops_free_##T(void *h) { uhash_free(T, (UHash(T) *)h); }                             \
+    static void ops_clear_##T(void *h) { uhash_clear(T, (UHash(T) *)h); }                           \
+    static uhash_uint ops_count_##T(void const *h) { return uhash_count((UHash(T) const *)h); }     \
+    static uhash_ret ops_resize_##T(void *h, uhash_uint n_buckets) {                                \
+        return uhash_resize(T, (UHash(T) *)h, n_buckets);                                           \
+    }                                                                                               \
+    static uhash_ret ops_copy_##T(void const *src, void *dest) {                                    \
+        return uhash_copy(T, (UHash(T) const *)src, (UHash(T) *)dest);                              \
+    }                                                                                               \
+    static uhash_ret ops_copy_as_set_##T(void const *src, void *dest) {                             \
+        return uhash_copy_as_set(T, (UHash(T) const *)src, (UHash(T) *)dest);                       \
+    }                                                                                               \
+    static bool ops_contains_##T(void const *h, uint32_t key) {                                     \
+        return uhash_contains(T, (UHash(T) const *)h, key);                                         \
+    }                                                                                               \
+    static uint32_t ops_get_##T(void const *h, uint32_t key, uint32_t if_missing) {                 \
+        return uhmap_get(T, (UHash(T) const *)h, key, if_missing);                                  \
+    }                                                                                               \
+    static uhash_ret ops_set_##T(void *h, uint32_t key, uint32_t val) {                             \
+        return uhmap_set(T, (UHash(T) *)h, key, val, NULL);                                         \
+    }                                                                                               \
+    static bool ops_map_remove_##T(void *h, uint32_t key) {                                         \
+        return uhmap_remove(T, (UHash(T) *)h, key);                                                 \
+    }                                                                                               \
+    static uhash_ret ops_insert_##T(void *h, uint32_t key) {                                        \
+        return uhset_insert(T, (UHash(T) *)h, key);                                                 \
+    }                                                                                               \
+    static bool ops_set_remove_##T(void *h, uint32_t key) {                                         \
+        return uhset_remove(T, (UHash(T) *)h, key);                                                 \
+    }                                                                                               \
+    static bool ops_equals_##T(void const *h1, void const *h2) {                                    \
+        return uhset_equals(T, (UHash(T) const *)h1, (UHash(T) const *)h2);                         \
+    }                                                                                               \
+    static uhash_uint ops_hash_##T(void const *h) { return uhset_hash(T, (UHash(T) const *)h); }    \
+    static uint32_t ops_get_any_##T(void const *h, uint32_t if_empty) {                             \
+        return uhset_get_any(T, (UHash(T) const *)h, if_empty);                                     \
+    }                                                                                               \
+    static uhash_uint ops_items_##T(void const *h, uint32_t *keys, uint32_t *vals) {                \
+        UHash(T) const *t = h;                                                                      \
+        uhash_uint n = 0;                                                                           \
+        uhash_foreach(T, t, key, val, { keys[n] = key; vals[n++] = val; });                         \
+        return n;                                                                                   \
+    }                                                                                               \
+    static uhash_ret ops_insert_all_par_##T(void *h, uint32_t const *items, uhash_uint n,           \
+                                            UHashExecutor const *ex) {                              \
+        return uhset_insert_all_par(T, (UHash(T) *)h, items, n, ex);                                \
+    }                                                                                               \
+    static bool ops_is_superset_par_##T(void const *h1, void const *h2, UHashExecutor const *ex) {  \
+        return uhset_is_superset_par(T, (UHash(T) const *)h1, (UHash(T) const *)h2, ex);            \
+    }                                                                                               \
+    static uhash_ret ops_union_par_##T(void *h1, void const *h2, UHashExecutor const *ex) {         \
+        return uhset_union_par(T, (UHash(T) *)h1, (UHash(T) const *)h2, ex);                        \
+    }                                                                                               \
+    static void ops_intersect_par_##T(void *h1, void const *h2, UHashExecutor const *ex) {          \
+        uhset_intersect_par(T, (UHash(T) *)h1, (UHash(T) const *)h2, ex);                           \
+    }                                                                                               \
+    static size_t ops_image_size_##T(void const *h) {                                               \
+        return uhash_image_size(T, (UHash(T) const *)h);                                            \
+    }                                                                                               \
+    static uhash_ret ops_image_write_##T(void const *h, uint32_t id, void *buf, size_t size) {      \
+        return uhash_image_write(T, (UHash(T) const *)h, id, buf, size);                            \
+    }                                                                                               \
+    static uhash_ret ops_image_load_##T(void *h, uint32_t id, void const *image, size_t size) {     \
+        return uhash_image_load(T, (UHash(T) *)h, id, image, size);                                 \
+    }                                                                                               \
+    static TestOps const ops_##T = {                                                                \
+        .map_alloc_with = ops_map_alloc_with_##T,                                                   \
+        .set_alloc_with = ops_set_alloc_with_##T,                                                   \
+        .clone = ops_clone_##T,                                                                     \
+        .free = ops_free_##T,                                                                       \
+        .clear = ops_clear_##T,                                                                     \
+        .count = ops_count_##T,                                                                     \
+        .resize = ops_resize_##T,                                                                   \
+        .copy = ops_copy_##T,                                                                       \
+        .copy_as_set = ops_copy_as_set_##T,                                                         \
+        .contains = ops_contains_##T,                                                               \
+        .get = ops_get_##T,                                                                         \
+        .set = ops_set_##T,                                                                         \
+        .map_remove = ops_map_remove_##T,                                                           \
+        .insert = ops_insert_##T,                                                                   \
+        .set_remove = ops_set_remove_##T,                                                           \
+        .equals = ops_equals_##T,                                                                   \
+        .hash = ops_hash_##T,                                                                       \
+        .get_any = ops_get_any_##T,                                                                 \
+        .items = ops_items_##T,                                                                     \
+        .insert_all_par = ops_insert_all_par_##T,                                                   \
+        .is_superset_par = ops_is_superset_par_##T,                                                 \
+        .union_par = ops_union_par_##T,                                                             \
+        .intersect_par = ops_intersect_par_##T,                                                     \
+        .image_size = ops_image_size_##T,                                                           \
+        .image_write = ops_image_write_##T,                                                         \
+        .image_load = ops_image_load_##T,                                                           \
+        .size = sizeof(UHash(T))                                                                    \
+    };
+
+test_define_ops(IntHash)
+test_define_ops(IntHashSimd)
+test_define_ops(IntHashInc)
+test_define_ops(IntHashRh)
+test_define_ops(IntHashSbo)
+test_define_ops(IntHashConc)
+test_define_ops(IntHashCuckoo)
+test_define_ops(IntHashSeeded)
 
 static bool test_memory(void) {
     UHash(IntHash) *set = uhset_alloc(IntHash);
@@ -135,7 +314,7 @@ static bool test_map(void) {
 static bool test_set(void) {
     UHash(IntHash) *set = uhset_alloc(IntHash);
     uhash_assert(set);
-    
+
     for (uint32_t i = 0; i < MAX_VAL; ++i) {
         uhash_assert(uhset_insert(IntHash, set, i) == UHASH_INSERTED);
     }
@@ -251,30 +430,1899 @@ static bool test_per_instance(void) {
     }
 
     uhash_free(IntHashPi, map);
+
+    // Tables using the default functions behave the same as those using other pointers.
+    UHash(IntHashPiDef) *def = uhmap_alloc(IntHashPiDef);
+    UHash(IntHashPiDef) *custom = uhmap_alloc_pi(IntHashPiDef, int32_hash, int32_eq);
+    uhash_assert(def && custom && def->hfunc == uhash_pi_int32_hash);
+
+    for (uint32_t i = 0; i < MAX_VAL; ++i) {
+        uhash_assert(uhmap_set(IntHashPiDef, def, i, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_set(IntHashPiDef, custom, i, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhset_equals(IntHashPiDef, def, custom));
+    uhash_assert(uhmap_get(IntHashPiDef, def, MAX_VAL - 1, UINT32_MAX) == MAX_VAL - 1);
+    uhash_assert(!uhash_contains(IntHashPiDef, def, MAX_VAL));
+    uhash_free(IntHashPiDef, def);
+    uhash_free(IntHashPiDef, custom);
+
+    UHash(StrHashPi) *strs = uhmap_alloc(StrHashPi);
+    char key[] = "key";
+    uhash_assert(strs && uhmap_set(StrHashPi, strs, "key", 1, NULL) == UHASH_INSERTED);
+    uhash_assert(uhmap_get(StrHashPi, strs, key, 0) == 1);
+    uhash_assert(!uhash_contains(StrHashPi, strs, "other"));
+    uhash_free(StrHashPi, strs);
     return true;
 }
 
-int main(void) {
-    printf("Starting tests...\n");
-    
-    int exit_code = EXIT_SUCCESS;
-    bool (*tests[])(void) = {
-        test_memory,
-        test_base,
-        test_map,
-        test_set,
-        test_per_instance
+#define MAX_VAL_SIMD 10000
+
+static bool test_simd(void) {
+    UHash(IntHashSimd) *map = uhmap_alloc(IntHashSimd);
+    uhash_assert(map);
+
+    for (uint32_t i = 0; i < MAX_VAL_SIMD; ++i) {
+        uhash_assert(uhmap_set(IntHashSimd, map, i, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhash_count(map) == MAX_VAL_SIMD);
+    uhash_assert(uhmap_add(IntHashSimd, map, 0, 1, NULL) == UHASH_PRESENT);
+
+    for (uint32_t i = 0; i < MAX_VAL_SIMD; ++i) {
+        uhash_assert(uhmap_get(IntHashSimd, map, i, UINT32_MAX) == i);
+    }
+
+    uhash_assert(!uhash_contains(IntHashSimd, map, MAX_VAL_SIMD));
+
+    for (uint32_t i = 0; i < MAX_VAL_SIMD; i += 2) {
+        uhash_assert(uhmap_remove(IntHashSimd, map, i));
+    }
+
+    uhash_assert(uhash_count(map) == MAX_VAL_SIMD / 2);
+
+    for (uint32_t i = 0; i < MAX_VAL_SIMD; ++i) {
+        uhash_assert(uhash_contains(IntHashSimd, map, i) == (i % 2 == 1));
+    }
+
+    uhash_uint count = 0;
+    uhash_foreach(IntHashSimd, map, key, val, {
+        if (key != val || key % 2 != 1) return false;
+        ++count;
+    });
+    uhash_assert(count == MAX_VAL_SIMD / 2);
+
+    // Churn through deleted buckets.
+    for (uint32_t i = 0; i < MAX_VAL_SIMD; i += 2) {
+        uhash_assert(uhmap_set(IntHashSimd, map, i, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_remove(IntHashSimd, map, i + 1));
+    }
+
+    for (uint32_t i = 0; i < MAX_VAL_SIMD; ++i) {
+        uhash_assert(uhash_contains(IntHashSimd, map, i) == (i % 2 == 0));
+    }
+
+    UHash(IntHashSimd) *set = uhset_alloc(IntHashSimd);
+    uhash_assert(set);
+    uhash_assert(uhash_copy_as_set(IntHashSimd, map, set) == UHASH_OK);
+    uhash_assert(uhset_equals(IntHashSimd, set, map));
+    uhash_assert(uhset_insert(IntHashSimd, set, 1) == UHASH_INSERTED);
+    uhash_assert(uhset_is_superset(IntHashSimd, set, map));
+    uhset_intersect(IntHashSimd, set, map);
+    uhash_assert(uhset_equals(IntHashSimd, set, map));
+
+    uhash_clear(IntHashSimd, set);
+    uhash_assert(uhash_count(set) == 0);
+    uhash_assert(uhset_get_any(IntHashSimd, set, UINT32_MAX) == UINT32_MAX);
+
+    uhash_free(IntHashSimd, set);
+    uhash_free(IntHashSimd, map);
+    return true;
+}
+
+#define MAX_VAL_CH 1000
+
+static bool test_cached_hash(void) {
+    static char strings[MAX_VAL_CH][16];
+    UHash(StrHashCh) *map = uhmap_alloc(StrHashCh);
+    uhash_assert(map);
+
+    for (uint32_t i = 0; i < MAX_VAL_CH; ++i) {
+        snprintf(strings[i], sizeof(strings[i]), "%x", i * 2654435761U);
+        uhash_assert(uhmap_set(StrHashCh, map, strings[i], i, NULL) == UHASH_INSERTED);
+    }
+
+    for (uhash_uint i = uhash_begin(map); i != uhash_end(map); ++i) {
+        if (!uhash_exists(map, i)) continue;
+        uhash_assert(map->hashes[i] == uhash_str_hash(uhash_key(map, i)));
+    }
+
+    for (uint32_t i = 0; i < MAX_VAL_CH; i += 2) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%x", i * 2654435761U);
+        uhash_assert(uhmap_get(StrHashCh, map, buf, UINT32_MAX) == i);
+        uhash_assert(uhmap_remove(StrHashCh, map, buf));
+    }
+
+    uhash_assert(uhash_resize(StrHashCh, map, MAX_VAL_CH * 4) == UHASH_OK);
+    uhash_assert(uhash_count(map) == MAX_VAL_CH / 2);
+
+    for (uint32_t i = 0; i < MAX_VAL_CH; ++i) {
+        uint32_t expected = i % 2 ? i : UINT32_MAX;
+        uhash_assert(uhmap_get(StrHashCh, map, strings[i], UINT32_MAX) == expected);
+    }
+
+    UHash(StrHashCh) *copy = uhmap_alloc(StrHashCh);
+    uhash_assert(copy);
+    uhash_assert(uhash_copy(StrHashCh, map, copy) == UHASH_OK);
+    uhash_assert(uhset_equals(StrHashCh, copy, map));
+    uhash_assert(uhash_resize(StrHashCh, copy, MAX_VAL_CH / 2) == UHASH_OK);
+    uhash_assert(uhset_equals(StrHashCh, copy, map));
+
+    uhash_free(StrHashCh, copy);
+    uhash_free(StrHashCh, map);
+    return true;
+}
+
+#define MAX_VAL_INC 10000
+
+static bool test_incremental(void) {
+    UHash(IntHashInc) *map = uhmap_alloc(IntHashInc);
+    uhash_assert(map);
+
+    bool migrated = false;
+
+    for (uint32_t i = 0; i < MAX_VAL_INC; ++i) {
+        uhash_assert(uhmap_set(IntHashInc, map, i, i, NULL) == UHASH_INSERTED);
+
+        if (map->old_flags) {
+            // Keys must be reachable while migrating.
+            migrated = true;
+            uhash_assert(uhmap_get(IntHashInc, map, i / 2, UINT32_MAX) == i / 2);
+            uhash_assert(uhmap_add(IntHashInc, map, i, 0, NULL) == UHASH_PRESENT);
+        }
+    }
+
+    uhash_assert(migrated);
+    uhash_assert(uhash_count(map) == MAX_VAL_INC);
+
+    for (uint32_t i = 0; i < MAX_VAL_INC; ++i) {
+        uhash_assert(uhmap_get(IntHashInc, map, i, UINT32_MAX) == i);
+    }
+
+    for (uint32_t i = 0; i < MAX_VAL_INC; i += 2) {
+        uhash_assert(uhmap_remove(IntHashInc, map, i));
+    }
+
+    uhash_assert(uhash_count(map) == MAX_VAL_INC / 2);
+
+    // Start a migration and iterate before it completes.
+    for (uint32_t i = MAX_VAL_INC; !map->old_flags; ++i) {
+        uhash_assert(uhmap_set(IntHashInc, map, i, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_remove(IntHashInc, map, i));
+    }
+
+    uhash_uint count = 0;
+    uhash_foreach(IntHashInc, map, key, val, {
+        if (key != val || key % 2 != 1) return false;
+        ++count;
+    });
+    uhash_assert(count == MAX_VAL_INC / 2);
+    uhash_assert(!map->old_flags);
+
+    UHash(IntHashInc) *set = uhset_alloc(IntHashInc);
+    uhash_assert(set);
+    uhash_assert(uhash_copy_as_set(IntHashInc, map, set) == UHASH_OK);
+    uhash_assert(uhset_equals(IntHashInc, set, map));
+
+    for (uint32_t i = MAX_VAL_INC; !set->old_flags; ++i) {
+        uhash_assert(uhset_insert(IntHashInc, set, i) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhset_is_superset(IntHashInc, set, map));
+    uhset_intersect(IntHashInc, set, map);
+    uhash_assert(uhset_equals(IntHashInc, set, map));
+
+    uhash_rehash_finish(IntHashInc, map);
+    uhash_assert(!map->old_flags);
+    uhash_assert(uhash_resize(IntHashInc, map, MAX_VAL_INC * 4) == UHASH_OK);
+    uhash_assert(!map->old_flags);
+
+    for (uint32_t i = 0; i < MAX_VAL_INC; ++i) {
+        uhash_assert(uhash_contains(IntHashInc, map, i) == (i % 2 == 1));
+    }
+
+    // Shrinking migrations must complete before the smaller buckets fill up.
+    uhash_clear(IntHashInc, set);
+    for (uint32_t i = 0; i < 2000; ++i) {
+        uhash_assert(uhset_insert(IntHashInc, set, i) == UHASH_INSERTED);
+    }
+    for (uint32_t i = 0; i < 1984; ++i) uhash_assert(uhset_remove(IntHashInc, set, i));
+
+    for (uint32_t i = 2000; i < 2500; ++i) {
+        uhash_assert(uhset_insert(IntHashInc, set, i) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhash_count(set) == 516);
+    for (uint32_t i = 1984; i < 2500; ++i) uhash_assert(uhash_contains(IntHashInc, set, i));
+
+    uhash_free(IntHashInc, set);
+    uhash_free(IntHashInc, map);
+    return true;
+}
+
+#define MAX_VAL_SHRINK 10000
+
+static bool test_shrink(void) {
+    UHash(IntHash) *set = uhset_alloc(IntHash);
+    uhash_assert(set);
+
+    // Explicitly resized tables are not shrunk.
+    uhash_assert(uhash_reserve(IntHash, set, MAX_VAL_SHRINK) == UHASH_OK);
+    uhash_uint const n_buckets = set->n_buckets;
+    uhash_assert(uhset_insert(IntHash, set, 0) == UHASH_INSERTED);
+    uhash_assert(set->n_buckets == n_buckets);
+
+    for (uint32_t i = 1; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhset_insert(IntHash, set, i) == UHASH_INSERTED);
+    }
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; i += 2) {
+        uhash_assert(uhset_remove(IntHash, set, i));
+    }
+
+    uhash_uint const count = uhash_count(set);
+    uhash_assert(set->n_occupied > count);
+    uhash_assert(uhash_compact(IntHash, set) == UHASH_OK);
+    uhash_assert(set->n_occupied == count);
+    uhash_assert(set->n_buckets == n_buckets);
+
+    for (uint32_t i = 1; i < MAX_VAL_SHRINK - 10; i += 2) {
+        uhash_assert(uhset_remove(IntHash, set, i));
+    }
+
+    uhash_assert(set->n_buckets == n_buckets);
+    uhash_assert(uhset_insert(IntHash, set, 0) == UHASH_INSERTED);
+    uhash_assert(set->n_buckets < n_buckets);
+    uhash_assert(set->n_occupied == uhash_count(set));
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        bool expected = i == 0 || (i % 2 == 1 && i >= MAX_VAL_SHRINK - 10);
+        uhash_assert(uhash_contains(IntHash, set, i) == expected);
+    }
+
+    uhash_free(IntHash, set);
+
+    // Tables without deleted buckets are shrunk as well.
+    UHash(IntHashSimd) *simd = uhset_alloc(IntHashSimd);
+    uhash_assert(simd);
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhset_insert(IntHashSimd, simd, i) == UHASH_INSERTED);
+    }
+
+    uhash_uint const simd_buckets = simd->n_buckets;
+
+    for (uint32_t i = 10; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhset_remove(IntHashSimd, simd, i));
+    }
+
+    uhash_assert(uhset_insert(IntHashSimd, simd, 10) == UHASH_INSERTED);
+    uhash_assert(simd->n_buckets < simd_buckets);
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhash_contains(IntHashSimd, simd, i) == (i <= 10));
+    }
+
+    uhash_free(IntHashSimd, simd);
+
+    UHash(IntHashSbo) *sbo = uhset_alloc(IntHashSbo);
+    uhash_assert(sbo);
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhset_insert(IntHashSbo, sbo, i) == UHASH_INSERTED);
+    }
+
+    uhash_uint const sbo_buckets = sbo->n_buckets;
+
+    for (uint32_t i = 10; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhset_remove(IntHashSbo, sbo, i));
+    }
+
+    uhash_assert(uhset_insert(IntHashSbo, sbo, 10) == UHASH_INSERTED);
+    uhash_assert(sbo->n_buckets < sbo_buckets);
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhash_contains(IntHashSbo, sbo, i) == (i <= 10));
+    }
+
+    uhash_free(IntHashSbo, sbo);
+
+    UHash(IntHashRh) *rh = uhmap_alloc(IntHashRh);
+    uhash_assert(rh);
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhmap_set(IntHashRh, rh, i, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_uint const rh_buckets = rh->n_buckets;
+
+    for (uint32_t i = 10; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhmap_remove(IntHashRh, rh, i));
+    }
+
+    uhash_assert(uhmap_set(IntHashRh, rh, 10, 10, NULL) == UHASH_INSERTED);
+    uhash_assert(rh->n_buckets < rh_buckets);
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhmap_get(IntHashRh, rh, i, UINT32_MAX) == (i <= 10 ? i : UINT32_MAX));
+    }
+
+    uhash_free(IntHashRh, rh);
+
+    UHash(IntHashCuckoo) *cuckoo = uhmap_alloc(IntHashCuckoo);
+    uhash_assert(cuckoo);
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhmap_set(IntHashCuckoo, cuckoo, i, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_uint const cuckoo_buckets = cuckoo->n_buckets;
+
+    for (uint32_t i = 10; i < MAX_VAL_SHRINK; ++i) {
+        uhash_assert(uhmap_remove(IntHashCuckoo, cuckoo, i));
+    }
+
+    uhash_assert(uhmap_set(IntHashCuckoo, cuckoo, 10, 10, NULL) == UHASH_INSERTED);
+    uhash_assert(cuckoo->n_buckets < cuckoo_buckets);
+
+    for (uint32_t i = 0; i < MAX_VAL_SHRINK; ++i) {
+        uint32_t const expected = i <= 10 ? i : UINT32_MAX;
+        uhash_assert(uhmap_get(IntHashCuckoo, cuckoo, i, UINT32_MAX) == expected);
+    }
+
+    uhash_free(IntHashCuckoo, cuckoo);
+    return true;
+}
+
+#define MAX_VAL_RH 10000
+
+static bool test_robin_hood(void) {
+    UHash(IntHashRh) *map = uhmap_alloc(IntHashRh);
+    uhash_assert(map);
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; ++i) {
+        uhash_assert(uhmap_set(IntHashRh, map, i * 64, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhash_count(map) == MAX_VAL_RH);
+    uhash_assert(uhmap_add(IntHashRh, map, 0, 1, NULL) == UHASH_PRESENT);
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; ++i) {
+        uhash_assert(uhmap_get(IntHashRh, map, i * 64, UINT32_MAX) == i);
+        uhash_assert(!uhash_contains(IntHashRh, map, i * 64 + 1));
+    }
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; i += 2) {
+        uhash_assert(uhmap_remove(IntHashRh, map, i * 64));
+    }
+
+    // Deletion leaves no deleted buckets.
+    uhash_assert(uhash_count(map) == MAX_VAL_RH / 2);
+    uhash_assert(map->n_occupied == uhash_count(map));
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; ++i) {
+        uhash_assert(uhash_contains(IntHashRh, map, i * 64) == (i % 2 == 1));
+    }
+
+    // Stored distances must match the actual ones.
+    uhash_uint const mask = map->n_buckets - 1;
+    for (uhash_uint i = uhash_begin(map); i != uhash_end(map); ++i) {
+        if (!uhash_exists(map, i)) continue;
+        uhash_uint home = uhash_int32_hash(uhash_key(map, i)) & mask;
+        uhash_assert(map->flags[i] == ((i - home) & mask));
+    }
+
+    uhash_uint count = 0;
+    uhash_foreach(IntHashRh, map, key, val, {
+        if (key != val * 64 || val % 2 != 1) return false;
+        ++count;
+    });
+    uhash_assert(count == MAX_VAL_RH / 2);
+
+    UHash(IntHashRh) *set = uhset_alloc(IntHashRh);
+    uhash_assert(set);
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; ++i) {
+        uhash_assert(uhset_insert(IntHashRh, set, i * 64) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhset_is_superset(IntHashRh, set, map));
+    uhset_intersect(IntHashRh, set, map);
+    uhash_assert(uhset_equals(IntHashRh, set, map));
+
+    uhash_assert(uhash_resize(IntHashRh, set, MAX_VAL_RH * 4) == UHASH_OK);
+    uhash_assert(uhset_equals(IntHashRh, set, map));
+
+    uhash_free(IntHashRh, set);
+    uhash_free(IntHashRh, map);
+
+    // At most 128 keys can share a home bucket, and failing to insert more keeps the table small.
+    UHash(IntHashRhSame) *same = uhset_alloc(IntHashRhSame);
+    uhash_assert(same);
+
+    for (uint32_t i = 0; i < 128; ++i) {
+        uhash_assert(uhset_insert(IntHashRhSame, same, i) == UHASH_INSERTED);
+    }
+
+    for (uint32_t i = 128; i < 200; ++i) {
+        uhash_assert(uhset_insert(IntHashRhSame, same, i) == UHASH_ERR);
+    }
+
+    uhash_assert(uhash_count(same) == 128 && same->n_buckets <= 1024);
+    for (uint32_t i = 0; i < 200; ++i) {
+        uhash_assert(uhash_contains(IntHashRhSame, same, i) == (i < 128));
+    }
+
+    uhash_free(IntHashRhSame, same);
+    return true;
+}
+
+#define MAX_VAL_BATCH 1000
+
+static bool test_batch(void) {
+    static uint32_t keys[MAX_VAL_BATCH];
+    static uint32_t vals[MAX_VAL_BATCH];
+    static uhash_uint idx[MAX_VAL_BATCH];
+
+    for (uint32_t i = 0; i < MAX_VAL_BATCH; ++i) keys[i] = i * 3;
+
+    // Only the first half of the keys is in the map.
+    UHash(IntHash) *map = uhmap_alloc(IntHash);
+    uhash_assert(map);
+
+    for (uint32_t i = 0; i < MAX_VAL_BATCH / 2; ++i) {
+        uhash_assert(uhmap_set(IntHash, map, keys[i], i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_get_batch(IntHash, map, keys, MAX_VAL_BATCH, idx);
+    uhmap_get_batch(IntHash, map, keys, MAX_VAL_BATCH, vals, UINT32_MAX);
+
+    for (uint32_t i = 0; i < MAX_VAL_BATCH; ++i) {
+        uhash_assert(idx[i] == uhash_get(IntHash, map, keys[i]));
+        uhash_assert(vals[i] == (i < MAX_VAL_BATCH / 2 ? i : UINT32_MAX));
+    }
+
+    UHash(IntHashSimd) *set = uhset_alloc(IntHashSimd);
+    uhash_assert(set);
+    uhash_assert(uhset_insert_batch(IntHashSimd, set, keys, MAX_VAL_BATCH / 2) == UHASH_INSERTED);
+    uhash_assert(uhset_insert_batch(IntHashSimd, set, keys, MAX_VAL_BATCH / 2) == UHASH_PRESENT);
+    uhash_assert(uhset_insert_batch(IntHashSimd, set, keys, MAX_VAL_BATCH) == UHASH_INSERTED);
+    uhash_assert(uhash_count(set) == MAX_VAL_BATCH);
+
+    uhash_get_batch(IntHashSimd, set, keys, MAX_VAL_BATCH, idx);
+
+    for (uint32_t i = 0; i < MAX_VAL_BATCH; ++i) {
+        uhash_assert(idx[i] != UHASH_INDEX_MISSING && uhash_key(set, idx[i]) == keys[i]);
+    }
+
+    uhash_free(IntHashSimd, set);
+    uhash_free(IntHash, map);
+    return true;
+}
+
+// Bump allocator checking that sizes passed to the callbacks are correct.
+#define ARENA_SIZE (4U << 20U)
+#define ARENA_BLOCKS 4096U
+
+typedef struct TestArena {
+    unsigned char *buf;
+    size_t used;
+    size_t live;
+    size_t n_blocks;
+    uintptr_t block_ptr[ARENA_BLOCKS];
+    size_t block_size[ARENA_BLOCKS];
+    bool size_mismatch;
+} TestArena;
+
+static void *arena_alloc(void *ctx, size_t size) {
+    TestArena *arena = ctx;
+    size = (size + 15U) & ~(size_t)15U;
+    if (arena->used + size > ARENA_SIZE || arena->n_blocks == ARENA_BLOCKS) return NULL;
+    void *ptr = arena->buf + arena->used;
+    arena->block_ptr[arena->n_blocks] = (uintptr_t)ptr;
+    arena->block_size[arena->n_blocks++] = size;
+    arena->used += size;
+    arena->live += size;
+    return ptr;
+}
+
+static void arena_free(void *ctx, void *ptr, size_t size) {
+    TestArena *arena = ctx;
+    size = (size + 15U) & ~(size_t)15U;
+    for (size_t i = 0; i < arena->n_blocks; ++i) {
+        if (arena->block_ptr[i] != (uintptr_t)ptr) continue;
+        if (arena->block_size[i] != size) arena->size_mismatch = true;
+        arena->live -= arena->block_size[i];
+        return;
+    }
+    arena->size_mismatch = true;
+}
+
+static void *arena_realloc(void *ctx, void *ptr, size_t old_size, size_t size) {
+    void *new_ptr = arena_alloc(ctx, size);
+    if (!new_ptr || !ptr) return new_ptr;
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    arena_free(ctx, ptr, old_size);
+    return new_ptr;
+}
+
+static bool test_allocator_type(TestOps const *t, UHashAllocator const *a) {
+    void *map = t->map_alloc_with(a);
+    uhash_assert(map);
+    for (uint32_t i = 0; i < 1000; ++i) uhash_assert(t->set(map, i, i) == UHASH_INSERTED);
+    for (uint32_t i = 0; i < 1000; i += 2) uhash_assert(t->map_remove(map, i));
+    void *set = t->set_alloc_with(a);
+    uhash_assert(set);
+    uhash_assert(t->copy(map, set) == UHASH_OK);
+    uhash_assert(t->equals(set, map));
+    void *copy = t->map_alloc_with(a);
+    uhash_assert(copy);
+    uhash_assert(t->copy(map, copy) == UHASH_OK);
+    uhash_assert(t->get(copy, 1, 0) == 1);
+    t->free(copy);
+    for (uint32_t i = 1; i < 1000; i += 2) uhash_assert(t->set_remove(set, i));
+    uhash_assert(t->insert(set, 0) == UHASH_INSERTED);
+    uhash_assert(t->resize(map, 10) == UHASH_OK);
+    t->free(set);
+    t->free(map);
+    return true;
+}
+
+static bool test_allocator(void) {
+    static TestArena arena;
+    arena.buf = malloc(ARENA_SIZE);
+    uhash_assert(arena.buf);
+
+    UHashAllocator const allocator = {
+        .ctx = &arena,
+        .alloc_fn = arena_alloc,
+        .realloc_fn = arena_realloc,
+        .free_fn = arena_free
     };
 
-    for (uint32_t i = 0; i < array_size(tests); ++i) {
-        if (!tests[i]()) exit_code = EXIT_FAILURE;
+    uhash_assert(test_allocator_type(&ops_IntHash, &allocator));
+    uhash_assert(test_allocator_type(&ops_IntHashSimd, &allocator));
+    uhash_assert(test_allocator_type(&ops_IntHashInc, &allocator));
+    uhash_assert(test_allocator_type(&ops_IntHashRh, &allocator));
+    uhash_assert(test_allocator_type(&ops_IntHashSbo, &allocator));
+    uhash_assert(test_allocator_type(&ops_IntHashConc, &allocator));
+    uhash_assert(test_allocator_type(&ops_IntHashCuckoo, &allocator));
+    uhash_assert(test_allocator_type(&ops_IntHashSeeded, &allocator));
+
+    UHashIntern(Strings) *strings = uhash_intern_alloc_with(Strings, &allocator);
+    uhash_assert(strings);
+    for (uint32_t i = 0; i < 1000; ++i) {
+        char str[16];
+        snprintf(str, sizeof(str), "%u", i);
+        uhash_assert(uhash_intern_cstr(Strings, strings, str));
     }
+    uhash_intern_free(Strings, strings);
 
-    if (exit_code == EXIT_SUCCESS) {
-        printf("All tests passed.\n");
-    } else {
-        printf("Some tests failed.\n");
+    UHash(IntHashPi) *pi_map = uhmap_alloc_pi_with(IntHashPi, int32_hash, int32_eq, &allocator);
+    uhash_assert(pi_map);
+    UHash(IntHashPi) *pi_set = uhset_alloc_pi_with(IntHashPi, int32_hash, int32_eq, &allocator);
+    uhash_assert(pi_set);
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_set(IntHashPi, pi_map, i, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhset_insert(IntHashPi, pi_set, i) == UHASH_INSERTED);
     }
-    
+    uhash_assert(uhset_equals(IntHashPi, pi_set, pi_map));
+    uhash_free(IntHashPi, pi_set);
+    uhash_free(IntHashPi, pi_map);
+
+    // Allocation failures are reported rather than dereferenced.
+    static TestArena full = { .used = ARENA_SIZE };
+    UHashAllocator const full_allocator = {
+        .ctx = &full,
+        .alloc_fn = arena_alloc,
+        .realloc_fn = arena_realloc,
+        .free_fn = arena_free
+    };
+    uhash_assert(!uhmap_alloc_pi_with(IntHashPi, int32_hash, int32_eq, &full_allocator));
+    uhash_assert(!uhset_alloc_pi_with(IntHashPi, int32_hash, int32_eq, &full_allocator));
+
+    uhash_assert(arena.used > 0);
+    uhash_assert(arena.live == 0);
+    uhash_assert(!arena.size_mismatch);
+
+    free(arena.buf);
+    return true;
+}
+
+static bool test_copy_values_type(TestOps const *t) {
+    void *src = t->map_alloc_with(NULL);
+    uhash_assert(src);
+    for (uint32_t i = 0; i < 100; ++i) uhash_assert(t->set(src, i, i + 1) == UHASH_INSERTED);
+    void *set = t->set_alloc_with(NULL);
+    uhash_assert(set);
+    uhash_assert(t->insert(set, 0) == UHASH_INSERTED);
+    void *map = t->map_alloc_with(NULL);
+    uhash_assert(map);
+    uhash_assert(t->copy(src, set) == UHASH_OK);
+    uhash_assert(t->copy(src, map) == UHASH_OK);
+    for (uint32_t i = 0; i < 100; ++i) {
+        uhash_assert(t->get(set, i, 0) == i + 1);
+        uhash_assert(t->get(map, i, 0) == i + 1);
+    }
+    uhash_assert(t->copy_as_set(set, map) == UHASH_OK);
+    uhash_assert(t->set(map, 1000, 1) == UHASH_INSERTED);
+    uhash_assert(t->resize(map, 1000) == UHASH_OK);
+    uhash_assert(t->get(map, 1000, 0) == 1);
+    t->free(src);
+    t->free(set);
+    t->free(map);
+    return true;
+}
+
+static bool test_copy_values(void) {
+    uhash_assert(test_copy_values_type(&ops_IntHash));
+    uhash_assert(test_copy_values_type(&ops_IntHashSimd));
+    uhash_assert(test_copy_values_type(&ops_IntHashInc));
+    uhash_assert(test_copy_values_type(&ops_IntHashRh));
+    uhash_assert(test_copy_values_type(&ops_IntHashSbo));
+    uhash_assert(test_copy_values_type(&ops_IntHashConc));
+    uhash_assert(test_copy_values_type(&ops_IntHashCuckoo));
+    uhash_assert(test_copy_values_type(&ops_IntHashSeeded));
+    return true;
+}
+
+static bool test_sbo(void) {
+    static TestArena arena;
+    arena.buf = malloc(ARENA_SIZE);
+    uhash_assert(arena.buf);
+
+    UHashAllocator const allocator = {
+        .ctx = &arena,
+        .alloc_fn = arena_alloc,
+        .realloc_fn = arena_realloc,
+        .free_fn = arena_free
+    };
+
+    UHash(IntHashSbo) *map = uhmap_alloc_with(IntHashSbo, &allocator);
+    uhash_assert(map);
+    size_t const table_size = arena.live;
+
+    // Small tables only allocate the table itself.
+    for (uint32_t i = 0; i < 14; ++i) {
+        uhash_assert(uhmap_set(IntHashSbo, map, i, i, NULL) == UHASH_INSERTED);
+    }
+    uhash_assert(arena.n_blocks == 1);
+    uhash_assert(uhmap_remove(IntHashSbo, map, 0));
+    uhash_assert(uhmap_set(IntHashSbo, map, 0, 0, NULL) == UHASH_INSERTED);
+    uhash_assert(arena.n_blocks == 1);
+
+    // Growing moves the buckets to the heap.
+    for (uint32_t i = 14; i < 1000; ++i) {
+        uhash_assert(uhmap_set(IntHashSbo, map, i, i, NULL) == UHASH_INSERTED);
+    }
+    uhash_assert(arena.live > table_size);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_get(IntHashSbo, map, i, UINT32_MAX) == i);
+    }
+
+    // Shrinking moves them back inline.
+    for (uint32_t i = 4; i < 1000; ++i) uhash_assert(uhmap_remove(IntHashSbo, map, i));
+    uhash_assert(uhash_resize(IntHashSbo, map, 4) == UHASH_OK);
+    uhash_assert(arena.live == table_size);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_get(IntHashSbo, map, i, UINT32_MAX) == (i < 4 ? i : UINT32_MAX));
+    }
+
+    uhash_assert(uhash_compact(IntHashSbo, map) == UHASH_OK);
+    uhash_assert(uhash_count(map) == 4);
+
+    uhash_free(IntHashSbo, map);
+    uhash_assert(arena.live == 0);
+    uhash_assert(!arena.size_mismatch);
+
+    free(arena.buf);
+    return true;
+}
+
+static bool test_concurrent(void) {
+    UHash(IntHashConc) *map = uhmap_alloc(IntHashConc);
+    uhash_assert(map);
+    uhash_assert(!uhash_conc_contains(IntHashConc, map, 0));
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_set(IntHashConc, map, i, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_conc_get(IntHashConc, map, i, UINT32_MAX) == i);
+    }
+
+    for (uint32_t i = 0; i < 1000; i += 2) uhash_assert(uhmap_remove(IntHashConc, map, i));
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uint32_t const expected = i % 2 ? i : UINT32_MAX;
+        uhash_assert(uhmap_get(IntHashConc, map, i, UINT32_MAX) == expected);
+        uhash_assert(uhmap_conc_get(IntHashConc, map, i, UINT32_MAX) == expected);
+    }
+
+    // Keys inserted via uhash_put are only visible to readers once published.
+    uhash_uint k;
+    uhash_assert(uhash_put(IntHashConc, map, 0, &k) == UHASH_INSERTED);
+    uhash_value(map, k) = 42;
+    uhash_assert(uhash_contains(IntHashConc, map, 0));
+    uhash_assert(!uhash_conc_contains(IntHashConc, map, 0));
+    uhash_conc_publish(IntHashConc, map, k);
+    uhash_assert(uhmap_conc_get(IntHashConc, map, 0, UINT32_MAX) == 42);
+
+    // Deleted buckets are reclaimed by resizing.
+    for (uint32_t i = 0; i < 10000; ++i) {
+        uhash_assert(uhmap_set(IntHashConc, map, 1000, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_remove(IntHashConc, map, 1000));
+    }
+    uhash_assert(uhash_count(map) == 501);
+
+    uhash_clear(IntHashConc, map);
+    uhash_assert(uhash_count(map) == 0);
+    uhash_assert(!uhash_conc_contains(IntHashConc, map, 1));
+    uhash_assert(uhmap_set(IntHashConc, map, 1, 1, NULL) == UHASH_INSERTED);
+    uhash_assert(uhash_conc_contains(IntHashConc, map, 1));
+
+    UHash(IntHashConc) *set = uhset_alloc(IntHashConc);
+    uhash_assert(set);
+    uhash_assert(uhset_insert(IntHashConc, set, 7) == UHASH_INSERTED);
+    uhash_assert(uhash_conc_contains(IntHashConc, set, 7));
+    uhash_assert(!uhash_conc_contains(IntHashConc, set, 1));
+
+    uhash_free(IntHashConc, set);
+    uhash_free(IntHashConc, map);
+    return true;
+}
+
+static bool test_sharded(void) {
+    UHashSharded(IntHashSh) *map = uhmap_sharded_alloc(IntHashSh);
+    uhash_assert(map);
+    uhash_assert(uhash_sharded_n_shards(map) == 8);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_sharded_set(IntHashSh, map, i, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhash_sharded_count(IntHashSh, map) == 1000);
+    uhash_assert(uhmap_sharded_get(IntHashSh, map, 1000, UINT32_MAX) == UINT32_MAX);
+
+    uint32_t existing;
+    uhash_assert(uhmap_sharded_add(IntHashSh, map, 0, 1, &existing) == UHASH_PRESENT);
+    uhash_assert(existing == 0);
+    uhash_assert(uhmap_sharded_set(IntHashSh, map, 0, 1, &existing) == UHASH_PRESENT);
+    uhash_assert(existing == 0);
+    uhash_assert(uhmap_sharded_remove(IntHashSh, map, 0, &existing));
+    uhash_assert(existing == 1);
+    uhash_assert(!uhmap_sharded_remove(IntHashSh, map, 0, NULL));
+
+    // Keys are spread across all shards.
+    for (uhash_uint i = 0; i < uhash_sharded_n_shards(map); ++i) {
+        uhash_assert(uhash_count(uhash_sharded_shard(map, i)) > 0);
+    }
+
+    uint64_t sum = 0;
+    uint32_t mismatches = 0;
+    uhash_sharded_foreach(IntHashSh, map, key, val, {
+        if (key != val) mismatches++;
+        sum += val;
+    });
+    uhash_assert(!mismatches);
+    uhash_assert(sum == 999 * 1000 / 2);
+
+    uhash_uint s = uhash_sharded_lock(IntHashSh, map, 5);
+    uhash_assert(uhmap_get(IntHashSh_shard, uhash_sharded_shard(map, s), 5, UINT32_MAX) == 5);
+    uhash_sharded_unlock(IntHashSh, map, s);
+
+    UHashSharded(IntHashSh) *other = uhmap_sharded_alloc(IntHashSh);
+    uhash_assert(other);
+
+    for (uint32_t i = 0; i < 2000; i += 2) {
+        uhash_assert(uhmap_sharded_set(IntHashSh, other, i, i + 1, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhash_sharded_merge(IntHashSh, map, other) == UHASH_OK);
+    uhash_assert(uhash_sharded_count(IntHashSh, map) == 1500);
+    uhash_assert(uhmap_sharded_get(IntHashSh, map, 1, UINT32_MAX) == 1);
+    uhash_assert(uhmap_sharded_get(IntHashSh, map, 2, UINT32_MAX) == 3);
+    uhash_assert(uhmap_sharded_get(IntHashSh, map, 1998, UINT32_MAX) == 1999);
+    uhash_sharded_free(IntHashSh, other);
+    uhash_sharded_free(IntHashSh, map);
+
+    UHashSharded(IntHashSh) *set = uhset_sharded_alloc(IntHashSh);
+    UHashSharded(IntHashSh) *set_other = uhset_sharded_alloc(IntHashSh);
+    uhash_assert(set && set_other);
+
+    for (uint32_t i = 0; i < 100; ++i) {
+        uhash_assert(uhset_sharded_insert(IntHashSh, set, i) == UHASH_INSERTED);
+        uhash_assert(uhset_sharded_insert(IntHashSh, set_other, i + 50) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhset_sharded_insert(IntHashSh, set, 0) == UHASH_PRESENT);
+    uhash_assert(uhset_sharded_remove(IntHashSh, set, 0));
+    uhash_assert(!uhash_sharded_contains(IntHashSh, set, 0));
+    uhash_assert(uhash_sharded_merge(IntHashSh, set, set_other) == UHASH_OK);
+    uhash_assert(uhash_sharded_count(IntHashSh, set) == 149);
+    uhash_assert(uhash_sharded_contains(IntHashSh, set, 149));
+
+    uhash_sharded_free(IntHashSh, set_other);
+    uhash_sharded_free(IntHashSh, set);
+    return true;
+}
+
+// Runs tasks in reverse order, so that results do not depend on them running sequentially.
+static void reverse_run(void *ctx, unsigned n, void (*task)(void *arg, unsigned i), void *arg) {
+    (void)ctx;
+    while (n) task(arg, --n);
+}
+
+static bool test_parallel_type(TestOps const *t) {
+    UHashExecutor const ex = { .n_tasks = 7, .run_fn = reverse_run };
+    uint32_t items[5000];
+    for (uint32_t i = 0; i < array_size(items); ++i) items[i] = (i * 7919U) % 4000U;
+
+    void *set = t->set_alloc_with(NULL);
+    uhash_assert(set);
+    uhash_assert(t->insert(set, 3999) == UHASH_INSERTED);
+    uhash_assert(t->insert_all_par(set, items, array_size(items), &ex) == UHASH_INSERTED);
+    uhash_assert(t->count(set) == 4000);
+    uhash_assert(t->insert_all_par(set, items, 100, &ex) == UHASH_PRESENT);
+
+    void *other = t->set_alloc_with(NULL);
+    uhash_assert(other);
+    for (uint32_t i = 2000; i < 6000; ++i) uhash_assert(t->insert(other, i) == UHASH_INSERTED);
+
+    uhash_assert(t->is_superset_par(set, set, &ex));
+    uhash_assert(!t->is_superset_par(set, other, &ex));
+    uhash_assert(t->union_par(set, other, &ex) == UHASH_OK);
+    uhash_assert(t->count(set) == 6000);
+    uhash_assert(t->is_superset_par(set, other, &ex));
+
+    t->intersect_par(other, set, &ex);
+    uhash_assert(t->count(other) == 4000);
+    uhash_assert(t->set_remove(other, 5999));
+    t->intersect_par(set, other, &ex);
+    uhash_assert(t->count(set) == 3999);
+    uhash_assert(t->equals(set, other));
+
+    t->intersect_par(set, other, NULL);
+    uhash_assert(t->count(set) == 3999);
+    t->free(set);
+    t->free(other);
+    return true;
+}
+
+static bool test_parallel(void) {
+    uhash_assert(test_parallel_type(&ops_IntHash));
+    uhash_assert(test_parallel_type(&ops_IntHashSimd));
+    uhash_assert(test_parallel_type(&ops_IntHashInc));
+    uhash_assert(test_parallel_type(&ops_IntHashRh));
+    uhash_assert(test_parallel_type(&ops_IntHashSbo));
+    uhash_assert(test_parallel_type(&ops_IntHashConc));
+    uhash_assert(test_parallel_type(&ops_IntHashCuckoo));
+    uhash_assert(test_parallel_type(&ops_IntHashSeeded));
+    return true;
+}
+
+static bool test_hash_functions(void) {
+    char const str[] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+    char buf[sizeof(str) + 1];
+
+    // Hashes do not depend on alignment, and every length yields a different hash.
+    UHash(IntHash) *hashes = uhset_alloc(IntHash);
+    uhash_assert(hashes);
+
+    for (size_t len = 0; len < sizeof(str); ++len) {
+        uhash_uint const hash = uhash_bytes_hash(str, len);
+        memcpy(buf + 1, str, len);
+        uhash_assert(uhash_bytes_hash(buf + 1, len) == hash);
+        uhash_assert(uhset_insert(IntHash, hashes, (uint32_t)hash) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhash_str_mix_hash(str) == uhash_bytes_hash(str, strlen(str)));
+    uhash_clear(IntHash, hashes);
+
+    // Sequential and high-bit only keys are spread across all low bits.
+    for (uint32_t i = 0; i < 4096; ++i) {
+        uhset_insert(IntHash, hashes, (uint32_t)(uhash_int32_mix_hash(i) & 0xffU));
+        uhset_insert(IntHash, hashes, (uint32_t)(uhash_int64_mix_hash((uint64_t)i << 40U) & 0xffU));
+    }
+    uhash_assert(uhash_count(hashes) == 256);
+    uhash_free(IntHash, hashes);
+
+    UHash(StrHashMix) *set = uhset_alloc(StrHashMix);
+    uhash_assert(set);
+    char keys[1000][12];
+
+    for (uint32_t i = 0; i < array_size(keys); ++i) {
+        snprintf(keys[i], sizeof(keys[i]), "%x", i * 271828183U);
+        uhash_assert(uhset_insert(StrHashMix, set, keys[i]) == UHASH_INSERTED);
+    }
+
+    for (uint32_t i = 0; i < array_size(keys); ++i) {
+        uhash_assert(uhash_contains(StrHashMix, set, keys[i]));
+    }
+
+    uhash_free(StrHashMix, set);
+    return true;
+}
+
+static bool test_str_view(void) {
+    char const buf[] = "alpha beta gamma alphabet beta";
+    UHash(StrViewHash) *map = uhmap_alloc(StrViewHash);
+    uhash_assert(map);
+
+    uhash_assert(uhmap_set(StrViewHash, map, uhash_strv_hashed(buf, 5), 1, NULL) == UHASH_INSERTED);
+    uhash_assert(uhmap_set(StrViewHash, map, uhash_strv(buf + 6, 4), 2, NULL) == UHASH_INSERTED);
+    uhash_assert(uhmap_set(StrViewHash, map, uhash_strv_cstr("gamma"), 3, NULL) == UHASH_INSERTED);
+    uhash_assert(uhmap_set(StrViewHash, map, uhash_strv(buf, 0), 4, NULL) == UHASH_INSERTED);
+
+    // Lookups run on slices of the buffer, whether their hash is precomputed or not.
+    uhash_assert(uhmap_get(StrViewHash, map, uhash_strv(buf + 17, 5), 0) == 1);
+    uhash_assert(uhmap_get(StrViewHash, map, uhash_strv_hashed(buf + 17, 5), 0) == 1);
+    uhash_assert(uhmap_get(StrViewHash, map, uhash_strv_hashed(buf + 26, 4), 0) == 2);
+    uhash_assert(uhmap_get(StrViewHash, map, uhash_strv(buf + 11, 5), 0) == 3);
+    uhash_assert(uhmap_get(StrViewHash, map, uhash_strv(buf + 17, 8), 0) == 0);
+    uhash_assert(uhmap_get(StrViewHash, map, uhash_strv("", 0), 0) == 4);
+
+    uhash_assert(uhash_strv_hash(uhash_strv(buf, 5)) == uhash_bytes_hash("alpha", 5));
+    uhash_assert(uhash_strv_hashed(buf, 5).hash == uhash_strv_hash(uhash_strv(buf + 17, 5)));
+    uhash_assert(!uhash_strv_equals(uhash_strv(buf, 5), uhash_strv(buf, 4)));
+
+    uhash_free(StrViewHash, map);
+    return true;
+}
+
+static bool test_intern(void) {
+    UHashIntern(Strings) *h = uhash_intern_alloc(Strings);
+    uhash_assert(h);
+
+    // Strings are interned from slices, and their copies never move.
+    char const buf[] = "keyvalue";
+    char const *key = uhash_intern(Strings, h, buf, 3);
+    uhash_assert(key && strcmp(key, "key") == 0 && key != buf);
+    uhash_assert(uhash_intern_cstr(Strings, h, "key") == key);
+    uhash_assert(uhash_intern_get(Strings, h, buf, 3) == key);
+    uhash_assert(!uhash_intern_get(Strings, h, buf, 4));
+    uhash_assert(strcmp(uhash_intern(Strings, h, buf, 0), "") == 0);
+
+    char const *strs[2000];
+    char large[3 * UHASH_ARENA_CHUNK];
+    memset(large, 'x', sizeof(large));
+
+    for (uint32_t i = 0; i < array_size(strs); ++i) {
+        char str[16];
+        snprintf(str, sizeof(str), "%u", i);
+        // Every 500 strings, intern one larger than a chunk.
+        if (!(i % 500)) uhash_assert(uhash_intern(Strings, h, large, sizeof(large) - i));
+        strs[i] = uhash_intern_cstr(Strings, h, str);
+        uhash_assert(strs[i] && strcmp(strs[i], str) == 0);
+    }
+
+    uhash_assert(uhash_intern_count(h) == array_size(strs) + 6);
+
+    for (uint32_t i = 0; i < array_size(strs); ++i) {
+        char str[16];
+        snprintf(str, sizeof(str), "%u", i);
+        uhash_assert(uhash_intern_get(Strings, h, str, strlen(str)) == strs[i]);
+    }
+
+    size_t total = 0;
+    uhash_intern_foreach(Strings, h, str, total += str.length);
+    uhash_assert(total == 3 + (3 * UHASH_ARENA_CHUNK) * 4 - 3000 + 6890);
+
+    uhash_intern_clear(Strings, h);
+    uhash_assert(uhash_intern_count(h) == 0);
+    uhash_assert(!uhash_intern_get(Strings, h, "key", 3));
+    uhash_assert(strcmp(uhash_intern_cstr(Strings, h, "key"), "key") == 0);
+
+    uhash_intern_free(Strings, h);
+    return true;
+}
+
+static bool test_with_hash(void) {
+    UHash(IntHash) *map = uhmap_alloc(IntHash);
+    UHash(IntHashRh) *rh = uhmap_alloc(IntHashRh);
+    uhash_assert(map && rh);
+
+    for (uint32_t i = 0; i < 100; ++i) {
+        uhash_uint const hash = uhash_int32_hash(i);
+        uhash_uint k;
+        uhash_assert(uhash_put_with_hash(IntHash, map, i, hash, &k) == UHASH_INSERTED);
+        uhash_value(map, k) = i;
+        uhash_assert(uhash_put_with_hash(IntHashRh, rh, i, hash, &k) == UHASH_INSERTED);
+        uhash_value(rh, k) = i + 1;
+    }
+
+    for (uint32_t i = 0; i < 200; ++i) {
+        uhash_uint const hash = uhash_int32_hash(i);
+        uint32_t const expected = i < 100 ? i : UINT32_MAX;
+        uhash_assert(uhash_get_with_hash(IntHash, map, i, hash) == uhash_get(IntHash, map, i));
+        uhash_assert(uhmap_get_with_hash(IntHash, map, i, hash, UINT32_MAX) == expected);
+        uhash_assert(uhmap_get(IntHashRh, rh, i, UINT32_MAX) == (i < 100 ? i + 1 : UINT32_MAX));
+    }
+
+    uhash_free(IntHash, map);
+    uhash_free(IntHashRh, rh);
+
+    // Set operations on tables with cached hashes reuse the hashes of the other table.
+    UHash(StrHashCh) *s1 = uhset_alloc(StrHashCh), *s2 = uhset_alloc(StrHashCh);
+    uhash_assert(s1 && s2);
+    char const *strs[] = { "a", "b", "c", "d", "e" };
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        uhash_assert(uhset_insert(StrHashCh, s1, strs[i]) == UHASH_INSERTED);
+        uhash_assert(uhset_insert(StrHashCh, s2, strs[i + 2]) == UHASH_INSERTED);
+    }
+
+    uhash_assert(!uhset_is_superset(StrHashCh, s1, s2));
+    uhash_assert(uhset_union(StrHashCh, s1, s2) == UHASH_OK);
+    uhash_assert(uhash_count(s1) == 5);
+    uhash_assert(uhset_is_superset(StrHashCh, s1, s2));
+    uhash_assert(uhash_get_with_hash(StrHashCh, s1, "e", uhash_str_hash("e")) != UHASH_INDEX_MISSING);
+    uhash_assert(uhset_remove(StrHashCh, s2, "c"));
+    uhset_intersect(StrHashCh, s1, s2);
+    uhash_assert(uhash_count(s1) == 2);
+    uhash_assert(uhset_equals(StrHashCh, s1, s2));
+
+    uhash_free(StrHashCh, s1);
+    uhash_free(StrHashCh, s2);
+    return true;
+}
+
+static bool test_image_roundtrip(TestOps const *t, uint32_t n) {
+    void *src = t->map_alloc_with(NULL);
+    uhash_assert(src);
+    for (uint32_t i = 0; i < n; ++i) uhash_assert(t->set(src, i, i * 3) != UHASH_ERR);
+
+    size_t const size = t->image_size(src);
+    uhash_assert(size);
+    void *buf = malloc(size);
+    uhash_assert(buf);
+    uhash_assert(t->image_write(src, 1, buf, size - 1) == UHASH_ERR);
+    uhash_assert(t->image_write(src, 1, buf, size) == UHASH_OK);
+    t->free(src);
+
+    void *view = calloc(1, t->size);
+    uhash_assert(view);
+    uhash_assert(t->image_load(view, 2, buf, size) == UHASH_ERR);
+    uhash_assert(t->image_load(view, 1, buf, size - 1) == UHASH_ERR);
+    uhash_assert(t->image_load(view, 1, buf, size) == UHASH_OK);
+    uhash_assert(t->count(view) == n);
+    for (uint32_t i = 0; i < 2 * n; ++i) {
+        uhash_assert(t->get(view, i, UINT32_MAX) == (i < n ? i * 3 : UINT32_MAX));
+    }
+    free(view);
+    free(buf);
+    return true;
+}
+
+static bool test_image(void) {
+    uhash_assert(test_image_roundtrip(&ops_IntHash, 1000));
+    uhash_assert(test_image_roundtrip(&ops_IntHashSimd, 1000));
+    uhash_assert(test_image_roundtrip(&ops_IntHashRh, 1000));
+    uhash_assert(test_image_roundtrip(&ops_IntHashInc, 1000));
+    uhash_assert(test_image_roundtrip(&ops_IntHashSbo, 3));
+    uhash_assert(test_image_roundtrip(&ops_IntHashCuckoo, 1000));
+
+    // Images of empty tables contain the header only.
+    UHash(IntHash) *empty = uhmap_alloc(IntHash);
+    uhash_assert(empty);
+    size_t const size = uhash_image_size(IntHash, empty);
+    uhash_assert(size && size % 64 == 0);
+    void *buf = malloc(size);
+    uhash_assert(buf);
+    uhash_assert(uhash_image_write(IntHash, empty, 0, buf, size) == UHASH_OK);
+    UHash(IntHash) view_s = { 0 }, *view = &view_s;
+    uhash_assert(uhash_image_load(IntHash, view, 0, buf, size) == UHASH_OK);
+    uhash_assert(!uhash_count(view) && !uhash_contains(IntHash, view, 1));
+
+    // Images of a different table type are rejected.
+    UHash(IntHashSimd) simd = { 0 };
+    uhash_assert(uhash_image_load(IntHashSimd, &simd, 0, buf, size) == UHASH_ERR);
+    free(buf);
+    uhash_free(IntHash, empty);
+
+    // Tables with cached hashes do not support images.
+    UHash(StrHashCh) *ch = uhset_alloc(StrHashCh);
+    uhash_assert(ch && !uhash_image_size(StrHashCh, ch));
+    uhash_free(StrHashCh, ch);
+    return true;
+}
+
+typedef struct StreamBuf {
+    uint8_t *data;
+    size_t size;
+    bool fail;
+} StreamBuf;
+
+static uhash_ret stream_buf_write(void *ctx, void const *data, size_t size) {
+    StreamBuf *buf = ctx;
+    if (buf->fail) return UHASH_ERR;
+    uint8_t *new_data = realloc(buf->data, buf->size + size);
+    if (!new_data) return UHASH_ERR;
+    memcpy(new_data + buf->size, data, size);
+    buf->data = new_data;
+    buf->size += size;
+    return UHASH_OK;
+}
+
+// Applies the stream in small pieces, as if it was received from a socket.
+static bool stream_buf_apply(StreamBuf *buf, UHash(IntHash) *h) {
+    size_t off = 0, end = 0;
+    while (end < buf->size) {
+        end = end + 100 < buf->size ? end + 100 : buf->size;
+        size_t consumed;
+        uhash_ret ret = uhash_stream_apply(IntHash, h, buf->data + off, end - off, &consumed);
+        uhash_assert(ret == UHASH_OK);
+        off += consumed;
+    }
+    uhash_assert(off == buf->size);
+    free(buf->data);
+    buf->data = NULL;
+    buf->size = 0;
+    return true;
+}
+
+static bool maps_equal(UHash(IntHash) const *h1, UHash(IntHash) const *h2) {
+    if (uhash_count(h1) != uhash_count(h2)) return false;
+    uhash_foreach(IntHash, h1, key, val, {
+        if (uhmap_get(IntHash, h2, key, UINT32_MAX) != val) return false;
+    });
+    return true;
+}
+
+static bool test_stream(void) {
+    UHash(IntHash) *map = uhmap_alloc(IntHash), *replica = uhmap_alloc(IntHash);
+    uhash_assert(map && replica);
+    for (uint32_t i = 0; i < 2000; ++i) {
+        uhash_assert(uhmap_set(IntHash, map, i, i, NULL) != UHASH_ERR);
+    }
+
+    StreamBuf buf = { 0 };
+    UHashStream s = uhash_stream(stream_buf_write, &buf);
+    uhash_assert(uhash_stream_write(IntHash, map, &s) == UHASH_OK);
+    uhash_assert(!s.done && buf.size);
+
+    // Failed writes can be retried, and streams can be resumed from the cursor.
+    buf.fail = true;
+    uhash_uint const cursor = s.cursor;
+    uhash_assert(uhash_stream_write(IntHash, map, &s) == UHASH_ERR);
+    uhash_assert(s.cursor == cursor);
+    buf.fail = false;
+    UHashStream resumed = uhash_stream(stream_buf_write, &buf);
+    resumed.cursor = cursor;
+    while (!resumed.done) uhash_assert(uhash_stream_write(IntHash, map, &resumed) == UHASH_OK);
+    uhash_assert(stream_buf_apply(&buf, replica));
+    uhash_assert(maps_equal(map, replica));
+
+    // Deltas only contain the changes since the previous snapshot.
+    UHash(IntHash) *prev = uhmap_alloc(IntHash);
+    uhash_assert(prev && uhash_copy(IntHash, map, prev) == UHASH_OK);
+    uhash_assert(uhmap_set(IntHash, map, 5000, 1, NULL) == UHASH_INSERTED);
+    uhash_assert(uhmap_set(IntHash, map, 7, 1, NULL) == UHASH_PRESENT);
+    uhash_assert(uhmap_remove(IntHash, map, 8));
+
+    s = uhash_stream(stream_buf_write, &buf);
+    while (!s.done) uhash_assert(uhash_stream_delta(IntHash, map, prev, &s) == UHASH_OK);
+    uhash_assert(buf.size == 2 * sizeof(UHashStreamChunk) + 2 * 8 + 4);
+    uhash_assert(stream_buf_apply(&buf, replica));
+    uhash_assert(maps_equal(map, replica));
+
+    // Chunks written for other table types are rejected.
+    UHash(IntHash) *set = uhset_alloc(IntHash);
+    uhash_assert(set);
+    s = uhash_stream(stream_buf_write, &buf);
+    while (!s.done) uhash_assert(uhash_stream_write(IntHash, map, &s) == UHASH_OK);
+    uhash_assert(uhash_stream_apply(IntHash, set, buf.data, buf.size, NULL) == UHASH_ERR);
+    free(buf.data);
+
+    uhash_free(IntHash, set);
+    uhash_free(IntHash, prev);
+    uhash_free(IntHash, replica);
+    uhash_free(IntHash, map);
+    return true;
+}
+
+static bool test_stats(void) {
+    UHash(IntHash) *map = uhmap_alloc(IntHash);
+    UHash(IntHashRh) *rh = uhmap_alloc(IntHashRh);
+    UHash(IntHashSimd) *simd = uhmap_alloc(IntHashSimd);
+    uhash_assert(map && rh && simd);
+
+    UHashStats stats;
+    uhash_stats(IntHash, map, &stats);
+    uhash_assert(!stats.count && !stats.max_probe && stats.mean_probe == 0);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_set(IntHash, map, i * 7919, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_set(IntHashRh, rh, i * 7919, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_set(IntHashSimd, simd, i * 7919, i, NULL) == UHASH_INSERTED);
+    }
+
+    for (uint32_t i = 0; i < 100; ++i) uhash_assert(uhmap_remove(IntHash, map, i * 7919));
+
+    uhash_stats(IntHash, map, &stats);
+    uhash_assert(stats.count == 900 && stats.tombstones == 100);
+    uhash_assert(stats.load_factor == (double)stats.count / stats.n_buckets);
+    uhash_assert(stats.bytes_per_entry >= 2 * sizeof(uint32_t));
+    uhash_assert(stats.max_run >= 1 && stats.mean_run >= 1 && stats.mean_run <= stats.max_run);
+
+    uhash_uint total = 0;
+    for (uhash_uint i = 0; i < UHASH_STATS_BINS; ++i) total += stats.probe_hist[i];
+    uhash_assert(total == stats.count);
+    uhash_assert(stats.mean_probe <= stats.max_probe);
+
+    // Probe lengths of Robin Hood tables match the distances they store.
+    uhash_stats(IntHashRh, rh, &stats);
+    uhash_uint max_dist = 0;
+    for (uhash_uint i = 0; i < rh->n_buckets; ++i) {
+        if (uhash_exists(rh, i) && rh->flags[i] > max_dist) max_dist = rh->flags[i];
+    }
+    uhash_assert(stats.count == 1000 && stats.max_probe == max_dist && !stats.tombstones);
+
+    uhash_stats(IntHashSimd, simd, &stats);
+    uhash_assert(stats.count == 1000 && stats.probe_hist[0] + stats.probe_hist[1] > 0);
+
+#ifdef UHASH_ENABLE_COUNTERS
+    uhash_assert(stats.counters.puts == 1000 && stats.counters.rehashes > 0);
+    uhash_reset_counters(simd);
+    for (uint32_t i = 0; i < 10; ++i) uhash_assert(uhmap_get(IntHashSimd, simd, i, 0) == 0);
+    uhash_stats(IntHashSimd, simd, &stats);
+    uhash_assert(stats.counters.gets == 10 && !stats.counters.puts);
+#endif
+
+    uhash_free(IntHash, map);
+    uhash_free(IntHashRh, rh);
+    uhash_free(IntHashSimd, simd);
+    return true;
+}
+
+static bool test_iteration_sparse(TestOps const *t, uint32_t n, uint32_t keep) {
+    void *h = t->map_alloc_with(NULL);
+    uhash_assert(h && t->get_any(h, UINT32_MAX) == UINT32_MAX);
+    for (uint32_t i = 0; i < n; ++i) uhash_assert(t->set(h, i, i) == UHASH_INSERTED);
+    uhash_uint expected_hash = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (i % keep) uhash_assert(t->map_remove(h, i));
+        else expected_hash ^= (uhash_uint)uhash_int32_hash(i);
+    }
+    uhash_uint const count = t->count(h);
+    uint32_t *keys = malloc(count * sizeof(*keys));
+    uint32_t *vals = malloc(count * sizeof(*vals));
+    uhash_assert(keys && vals);
+    uhash_uint const visited = t->items(h, keys, vals);
+    for (uhash_uint i = 0; i < visited; ++i) {
+        uhash_assert(keys[i] == vals[i] && keys[i] % keep == 0);
+    }
+    uhash_assert(visited == count && visited == (n + keep - 1) / keep);
+    uhash_assert(t->hash(h) == expected_hash);
+    uhash_assert(t->get_any(h, UINT32_MAX) % keep == 0);
+    free(keys);
+    free(vals);
+    t->free(h);
+    return true;
+}
+
+static bool test_iteration(void) {
+    // Sparse tables skip whole runs of free buckets.
+    uhash_assert(test_iteration_sparse(&ops_IntHash, 5000, 97));
+    uhash_assert(test_iteration_sparse(&ops_IntHashSimd, 5000, 97));
+    uhash_assert(test_iteration_sparse(&ops_IntHashRh, 5000, 97));
+    uhash_assert(test_iteration_sparse(&ops_IntHashInc, 5000, 97));
+    uhash_assert(test_iteration_sparse(&ops_IntHashSbo, 5000, 97));
+    uhash_assert(test_iteration_sparse(&ops_IntHashConc, 5000, 97));
+    uhash_assert(test_iteration_sparse(&ops_IntHashCuckoo, 5000, 97));
+
+    // Tables smaller than a flags word or a control byte group.
+    uhash_assert(test_iteration_sparse(&ops_IntHash, 5, 2));
+    uhash_assert(test_iteration_sparse(&ops_IntHashRh, 5, 2));
+    uhash_assert(test_iteration_sparse(&ops_IntHashCuckoo, 5, 2));
+    uhash_assert(test_iteration_sparse(&ops_IntHashSbo, 3, 2));
+    return true;
+}
+
+static bool test_clone_cow(TestOps const *t, uint32_t n) {
+    void *h = t->map_alloc_with(NULL);
+    uhash_assert(h);
+    for (uint32_t i = 0; i < n; ++i) uhash_assert(t->set(h, i, i) == UHASH_INSERTED);
+
+    // Modifying the clone leaves the source untouched.
+    void *c = t->clone(h);
+    uhash_assert(c && t->count(c) == n);
+    uhash_assert(t->set(c, 0, 42) == UHASH_PRESENT);
+    uhash_assert(t->get(h, 0, 0) == 0 && t->get(c, 0, 0) == 42);
+    uhash_assert(t->map_remove(c, 1) && t->contains(h, 1) && !t->contains(c, 1));
+
+    // So does modifying the source, even after it is freed.
+    void *c2 = t->clone(h);
+    uhash_assert(c2 && t->resize(h, 4 * n) == UHASH_OK);
+    uhash_assert(t->set(h, n, n) == UHASH_INSERTED);
+    t->free(h);
+    uhash_assert(t->count(c2) == n && !t->contains(c2, n));
+    for (uint32_t i = 0; i < n; ++i) uhash_assert(t->get(c2, i, UINT32_MAX) == i);
+
+    t->clear(c2);
+    uhash_assert(!t->count(c2) && t->count(c) == n - 1);
+    t->free(c);
+    t->free(c2);
+    return true;
+}
+
+static bool test_clone(void) {
+    uhash_assert(test_clone_cow(&ops_IntHash, 1000));
+    uhash_assert(test_clone_cow(&ops_IntHashSimd, 1000));
+    uhash_assert(test_clone_cow(&ops_IntHashRh, 1000));
+    uhash_assert(test_clone_cow(&ops_IntHashInc, 1000));
+    uhash_assert(test_clone_cow(&ops_IntHashConc, 1000));
+    uhash_assert(test_clone_cow(&ops_IntHashCuckoo, 1000));
+    uhash_assert(test_clone_cow(&ops_IntHashSeeded, 1000));
+    uhash_assert(test_clone_cow(&ops_IntHashSbo, 1000));
+    uhash_assert(test_clone_cow(&ops_IntHashSbo, 3));
+
+    // Clones share the buckets until either table is modified.
+    UHash(StrHashCh) *set = uhset_alloc(StrHashCh);
+    uhash_assert(set && uhset_insert(StrHashCh, set, "a") == UHASH_INSERTED);
+    UHash(StrHashCh) *clone = uhash_clone(StrHashCh, set);
+    uhash_assert(clone && clone->keys == set->keys && clone->hashes == set->hashes);
+    uhash_assert(uhset_insert(StrHashCh, clone, "b") == UHASH_INSERTED);
+    uhash_assert(clone->keys != set->keys && clone->hashes != set->hashes);
+    uhash_assert(uhash_count(set) == 1 && uhash_contains(StrHashCh, clone, "a"));
+    uhash_free(StrHashCh, set);
+    uhash_free(StrHashCh, clone);
+
+    // Buckets must be unshared before writing to them directly.
+    UHash(IntHash) *map = uhmap_alloc(IntHash);
+    uhash_assert(map && uhmap_set(IntHash, map, 1, 1, NULL) == UHASH_INSERTED);
+    UHash(IntHash) *copy = uhash_clone(IntHash, map);
+    uhash_assert(copy && uhash_unshare(IntHash, copy) == UHASH_OK && copy->vals != map->vals);
+    uhash_value(copy, uhash_get(IntHash, copy, 1)) = 2;
+    uhash_assert(uhmap_get(IntHash, map, 1, 0) == 1 && uhmap_get(IntHash, copy, 1, 0) == 2);
+
+    // Copying into larger buckets keeps them.
+    uhash_assert(uhash_resize(IntHash, copy, 1024) == UHASH_OK);
+    uhash_uint const n_buckets = copy->n_buckets;
+    uhash_assert(uhash_copy_into(IntHash, map, copy) == UHASH_OK);
+    uhash_assert(copy->n_buckets == n_buckets && maps_equal(map, copy));
+    uhash_free(IntHash, map);
+    uhash_free(IntHash, copy);
+
+    // Copying into buckets of the same size reuses them.
+    UHash(IntHashSimd) *src = uhmap_alloc(IntHashSimd), *dest = uhmap_alloc(IntHashSimd);
+    uhash_assert(src && dest && uhmap_set(IntHashSimd, src, 1, 1, NULL) == UHASH_INSERTED);
+    uint32_t const *keys = dest->keys;
+    uhash_assert(uhash_copy_into(IntHashSimd, src, dest) == UHASH_OK && dest->keys == keys);
+    uhash_assert(uhmap_get(IntHashSimd, dest, 1, 0) == 1);
+    uhash_free(IntHashSimd, src);
+    uhash_free(IntHashSimd, dest);
+    return true;
+}
+
+static bool test_reserve(void) {
+    UHash(IntHash) *map = uhmap_alloc(IntHash);
+    UHash(IntHashSimd) *simd = uhmap_alloc(IntHashSimd);
+    uhash_assert(map && simd);
+
+    // Reserved tables hold the expected number of elements without growing.
+    uhash_assert(uhash_reserve(IntHash, map, 1000) == UHASH_OK);
+    uhash_assert(uhash_reserve(IntHashSimd, simd, 1000) == UHASH_OK);
+    uhash_uint const n_buckets = map->n_buckets, simd_buckets = simd->n_buckets;
+    uhash_assert(n_buckets * UHASH_MAX_LOAD >= 1000 && simd_buckets * UHASH_SIMD_MAX_LOAD >= 1000);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_set(IntHash, map, i, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_set(IntHashSimd, simd, i, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_assert(map->n_buckets == n_buckets && simd->n_buckets == simd_buckets);
+
+    // Tables are never shrunk.
+    uhash_assert(uhash_reserve(IntHash, map, 10) == UHASH_OK && map->n_buckets == n_buckets);
+
+    uhash_free(IntHash, map);
+    uhash_free(IntHashSimd, simd);
+    return true;
+}
+
+static bool test_max_load(void) {
+    UHash(IntHash) *sparse = uhmap_alloc_load(IntHash, 0.4);
+    UHash(IntHash) *dense = uhset_alloc_load(IntHash, 0.99);
+    UHash(IntHash) *def = uhset_alloc(IntHash);
+    UHash(IntHashRh) *rh = uhset_alloc_load(IntHashRh, 0.95);
+    UHash(IntHashInc) *inc = uhset_alloc_load(IntHashInc, 0.4);
+    UHash(IntHashSimd) *simd = uhset_alloc_load(IntHashSimd, 0.97);
+    uhash_assert(sparse && dense && def && rh && inc && simd);
+
+    // Out of range load factors are rejected.
+    uhash_assert(!uhset_alloc_load(IntHash, 0));
+    uhash_assert(uhash_set_max_load(IntHash, def, 1.0) == UHASH_ERR);
+    uhash_assert(uhash_set_max_load(IntHash, def, -0.5) == UHASH_ERR);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_set(IntHash, sparse, i, i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhset_insert(IntHash, dense, i) == UHASH_INSERTED);
+        uhash_assert(uhset_insert(IntHash, def, i) == UHASH_INSERTED);
+        uhash_assert(uhset_insert(IntHashRh, rh, i) == UHASH_INSERTED);
+        uhash_assert(uhset_insert(IntHashInc, inc, i) == UHASH_INSERTED);
+        uhash_assert(uhset_insert(IntHashSimd, simd, i) == UHASH_INSERTED);
+        uhash_assert(sparse->n_occupied <= sparse->n_buckets * 0.4 + 1);
+        uhash_assert(inc->n_occupied <= inc->n_buckets * 0.4 + 1);
+    }
+
+    // Denser tables need fewer buckets.
+    uhash_assert(dense->n_buckets < def->n_buckets && def->n_buckets < sparse->n_buckets);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_get(IntHash, sparse, i, 0) == i);
+        uhash_assert(uhash_contains(IntHash, dense, i));
+        uhash_assert(uhash_contains(IntHashRh, rh, i));
+        uhash_assert(uhash_contains(IntHashInc, inc, i));
+        uhash_assert(uhash_contains(IntHashSimd, simd, i));
+    }
+
+    // Lowering the load factor expands the table right away.
+    uhash_assert(uhash_set_max_load(IntHash, dense, 0.25) == UHASH_OK);
+    uhash_assert(dense->n_occupied <= dense->n_buckets / 4);
+    for (uint32_t i = 0; i < 1000; ++i) uhash_assert(uhash_contains(IntHash, dense, i));
+
+    // Clones keep the load factor of their source.
+    UHash(IntHash) *clone = uhash_clone(IntHash, sparse);
+    uhash_assert(clone && clone->max_load == 0.4);
+
+    uhash_free(IntHash, clone);
+    uhash_free(IntHash, sparse);
+    uhash_free(IntHash, dense);
+    uhash_free(IntHash, def);
+    uhash_free(IntHashRh, rh);
+    uhash_free(IntHashInc, inc);
+    uhash_free(IntHashSimd, simd);
+    return true;
+}
+
+static bool test_packed(void) {
+    UHash(IntFlags) *flags = uhmap_alloc(IntFlags);
+    UHash(IntNibbles) *nibbles = uhmap_alloc(IntNibbles);
+    UHash(IntHash) *plain = uhmap_alloc(IntHash);
+    uhash_assert(flags && nibbles && plain);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_set(IntFlags, flags, i, (uint8_t)(i % 3 == 0), NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_set(IntNibbles, nibbles, i, (uint8_t)i, NULL) == UHASH_INSERTED);
+        uhash_assert(uhmap_set(IntHash, plain, i, i, NULL) == UHASH_INSERTED);
+    }
+
+    // Values survive resizes, and excess bits are discarded.
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_get(IntFlags, flags, i, 2) == (i % 3 == 0));
+        uhash_assert(uhmap_get(IntNibbles, nibbles, i, 16) == (i & 0xF));
+    }
+    uhash_assert(uhmap_get(IntFlags, flags, 1000, 2) == 2);
+
+    // Neighbouring values are left untouched by updates.
+    uint8_t existing;
+    uhash_assert(uhmap_set(IntFlags, flags, 1, 1, &existing) == UHASH_PRESENT && !existing);
+    uhash_assert(uhmap_replace(IntNibbles, nibbles, 5, 9, &existing) && existing == 5);
+    uhash_assert(uhmap_get(IntFlags, flags, 1, 0) && uhmap_get(IntFlags, flags, 0, 0));
+    uhash_assert(!uhmap_get(IntFlags, flags, 2, 1));
+    uhash_assert(uhmap_get(IntNibbles, nibbles, 5, 0) == 9);
+    uhash_assert(uhmap_get(IntNibbles, nibbles, 4, 0) == 4 && uhmap_get(IntNibbles, nibbles, 6, 0) == 6);
+
+    uint32_t set = 0;
+    uhash_foreach_value(IntFlags, flags, val, set += val);
+    uhash_assert(set == 335);
+
+    // Clones are unshared without losing values.
+    UHash(IntFlags) *clone = uhash_clone(IntFlags, flags);
+    uhash_assert(clone && uhmap_pop(IntFlags, clone, 0, NULL, &existing) && existing);
+    uhash_assert(uhash_count(clone) == 999 && uhmap_get(IntFlags, flags, 0, 0));
+    uhash_assert(uhmap_get(IntFlags, clone, 3, 0) && !uhmap_get(IntFlags, clone, 4, 1));
+    uhash_free(IntFlags, clone);
+
+    // Packed values take a fraction of the space of plain ones.
+    UHashStats packed_stats, plain_stats;
+    uhash_stats(IntFlags, flags, &packed_stats);
+    uhash_stats(IntHash, plain, &plain_stats);
+    uhash_assert(packed_stats.bytes + flags->n_buckets * 3 <= plain_stats.bytes);
+
+    // Images store the packed values as they are.
+    size_t const size = uhash_image_size(IntNibbles, nibbles);
+    void *buf = malloc(size);
+    uhash_assert(buf && uhash_image_write(IntNibbles, nibbles, 1, buf, size) == UHASH_OK);
+    UHash(IntNibbles) view_s = { 0 }, *view = &view_s;
+    uhash_assert(uhash_image_load(IntNibbles, view, 1, buf, size) == UHASH_OK);
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uhash_assert(uhmap_get(IntNibbles, view, i, 16) == (i == 5 ? 9 : (i & 0xF)));
+    }
+    UHash(IntFlags) other = { 0 };
+    uhash_assert(uhash_image_load(IntFlags, &other, 1, buf, size) == UHASH_ERR);
+    free(buf);
+
+    uhash_free(IntFlags, flags);
+    uhash_free(IntNibbles, nibbles);
+    uhash_free(IntHash, plain);
+    return true;
+}
+
+static bool test_cuckoo(void) {
+    UHash(IntHashCuckoo) *map = uhmap_alloc(IntHashCuckoo);
+    uhash_assert(map);
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; ++i) {
+        uhash_assert(uhmap_set(IntHashCuckoo, map, i * 64, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhash_count(map) == MAX_VAL_RH);
+    uhash_assert(uhmap_add(IntHashCuckoo, map, 0, 1, NULL) == UHASH_PRESENT);
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; ++i) {
+        uhash_assert(uhmap_get(IntHashCuckoo, map, i * 64, UINT32_MAX) == i);
+        uhash_assert(!uhash_contains(IntHashCuckoo, map, i * 64 + 1));
+    }
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; i += 2) {
+        uhash_assert(uhmap_remove(IntHashCuckoo, map, i * 64));
+    }
+
+    // Deletion leaves no deleted buckets.
+    uhash_assert(uhash_count(map) == MAX_VAL_RH / 2);
+    uhash_assert(map->n_occupied == uhash_count(map));
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; ++i) {
+        uhash_assert(uhash_contains(IntHashCuckoo, map, i * 64) == (i % 2 == 1));
+    }
+
+    // Keys are either in one of their two groups, or in the stash.
+    UHashStats stats;
+    uhash_stats(IntHashCuckoo, map, &stats);
+    uhash_assert(stats.max_probe <= 2);
+
+    uhash_uint count = 0;
+    uhash_foreach(IntHashCuckoo, map, key, val, {
+        if (key != val * 64 || val % 2 != 1) return false;
+        ++count;
+    });
+    uhash_assert(count == MAX_VAL_RH / 2);
+
+    UHash(IntHashCuckoo) *set = uhset_alloc(IntHashCuckoo);
+    uhash_assert(set);
+
+    for (uint32_t i = 0; i < MAX_VAL_RH; ++i) {
+        uhash_assert(uhset_insert(IntHashCuckoo, set, i * 64) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhset_is_superset(IntHashCuckoo, set, map));
+    uhset_intersect(IntHashCuckoo, set, map);
+    uhash_assert(uhset_equals(IntHashCuckoo, set, map));
+
+    uhash_assert(uhash_resize(IntHashCuckoo, set, MAX_VAL_RH * 4) == UHASH_OK);
+    uhash_assert(uhset_equals(IntHashCuckoo, set, map));
+
+    uhash_free(IntHashCuckoo, set);
+    uhash_free(IntHashCuckoo, map);
+
+    // Keys sharing both of their groups overflow to the stash, until it is full.
+    UHash(IntHashCollide) *col = uhset_alloc(IntHashCollide);
+    uhash_assert(col);
+
+    for (uint32_t i = 0; i < 24; ++i) {
+        uhash_assert(uhset_insert(IntHashCollide, col, i) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhset_insert(IntHashCollide, col, 24) == UHASH_ERR);
+    uhash_assert(uhash_count(col) == 24);
+
+    for (uint32_t i = 0; i < 24; ++i) uhash_assert(uhash_contains(IntHashCollide, col, i));
+    uhash_stats(IntHashCollide, col, &stats);
+    uhash_assert(stats.max_probe == 2 && stats.probe_hist[2] == 8);
+
+    // Deleting a key moves a stashed one into its bucket.
+    uhash_assert(uhset_remove(IntHashCollide, col, 0));
+    uhash_stats(IntHashCollide, col, &stats);
+    uhash_assert(stats.probe_hist[2] == 7);
+    for (uint32_t i = 1; i < 24; ++i) uhash_assert(uhash_contains(IntHashCollide, col, i));
+
+    uhash_assert(uhset_insert(IntHashCollide, col, 24) == UHASH_INSERTED);
+    uhash_assert(uhash_contains(IntHashCollide, col, 24));
+    uhash_assert(!uhash_contains(IntHashCollide, col, 0));
+
+    uhash_free(IntHashCollide, col);
+    return true;
+}
+
+static bool test_seeded(void) {
+    char const *str = "seeded";
+    uhash_assert(uhash_bytes_seeded_hash(str, 6, 0) == uhash_bytes_hash(str, 6));
+    uhash_assert(uhash_str_seeded_hash(str, 1) != uhash_str_seeded_hash(str, 2));
+    uhash_assert(uhash_int32_seeded_hash(1, 1) != uhash_int32_seeded_hash(1, 2));
+    uhash_assert(uhash_int64_seeded_hash(1, 1) != uhash_int64_seeded_hash(2, 1));
+
+    // Tables are seeded independently.
+    UHash(IntHashSeeded) *a = uhmap_alloc(IntHashSeeded);
+    UHash(IntHashSeeded) *b = uhmap_alloc(IntHashSeeded);
+    uhash_assert(a && b && a->seed != b->seed);
+    uhash_assert(!uhash_image_size(IntHashSeeded, a));
+
+    // Equal sets have equal hashes, whatever their seeds.
+    for (uint32_t i = 0; i < MAX_VAL; ++i) {
+        uhash_assert(uhset_insert(IntHashSeeded, a, i) == UHASH_INSERTED);
+        uhash_assert(uhset_insert(IntHashSeeded, b, MAX_VAL - 1 - i) == UHASH_INSERTED);
+    }
+    uhash_assert(uhset_equals(IntHashSeeded, a, b));
+    uhash_assert(uhset_hash(IntHashSeeded, a) == uhset_hash(IntHashSeeded, b));
+    uhash_assert(uhset_remove(IntHashSeeded, b, 0));
+    uhash_assert(uhset_hash(IntHashSeeded, a) != uhset_hash(IntHashSeeded, b));
+    uhash_free(IntHashSeeded, a);
+    uhash_free(IntHashSeeded, b);
+
+    // Long probe sequences cause the table to be reseeded.
+    UHash(IntHashFlood) *map = uhmap_alloc(IntHashFlood);
+    uhash_assert(map);
+    map->seed = 0;
+    uint32_t const n = UHASH_FLOOD_PROBES * 4;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        uhash_assert(uhmap_set(IntHashFlood, map, i, i, NULL) == UHASH_INSERTED);
+    }
+
+    uhash_assert(map->seed != 0);
+    for (uint32_t i = 0; i < n; ++i) uhash_assert(uhmap_get(IntHashFlood, map, i, n) == i);
+
+    UHashStats stats;
+    uhash_stats(IntHashFlood, map, &stats);
+    uhash_assert(stats.max_probe < UHASH_FLOOD_PROBES);
+
+    // Copies and clones keep the seed, explicit reseeding keeps the keys.
+    UHash(IntHashFlood) *copy = uhmap_alloc(IntHashFlood);
+    uhash_assert(copy && uhash_copy(IntHashFlood, map, copy) == UHASH_OK);
+    uhash_assert(copy->seed == map->seed && uhmap_get(IntHashFlood, copy, 7, n) == 7);
+
+    UHash(IntHashFlood) *clone = uhash_clone(IntHashFlood, map);
+    uhash_assert(clone && clone->seed == map->seed);
+    uhash_assert(uhash_reseed(IntHashFlood, clone) == UHASH_OK && clone->seed != map->seed);
+    for (uint32_t i = 0; i < n; ++i) uhash_assert(uhmap_get(IntHashFlood, clone, i, n) == i);
+    uhash_assert(uhset_equals(IntHashFlood, clone, map));
+
+    uhash_free(IntHashFlood, clone);
+    uhash_free(IntHashFlood, copy);
+    uhash_free(IntHashFlood, map);
+    return true;
+}
+
+typedef struct TestEvictions {
+    uint32_t keys[64];
+    uint32_t count;
+} TestEvictions;
+
+static void test_evict(uint32_t key, uint32_t val, void *data) {
+    TestEvictions *ev = data;
+    if (key == val && ev->count < 64) ev->keys[ev->count] = key;
+    ev->count++;
+}
+
+static bool test_cache(void) {
+    uhash_assert(!uhcache_alloc(IntCache, 0));
+
+    uint32_t const capacity = 64;
+    UHashCache(IntCache) *cache = uhcache_alloc(IntCache, capacity);
+    uhash_assert(cache && uhcache_capacity(cache) == capacity);
+
+    TestEvictions ev = { .count = 0 };
+    uhcache_set_evict(IntCache, cache, test_evict, &ev);
+
+    for (uint32_t i = 0; i < capacity; ++i) {
+        uhash_assert(uhcache_put(IntCache, cache, i, i) == UHASH_INSERTED);
+    }
+    uhash_assert(uhcache_count(cache) == capacity && !ev.count);
+
+    // All entries are marked, so the hand sweeps the whole table and evicts an old one.
+    uhash_assert(uhcache_put(IntCache, cache, capacity, capacity) == UHASH_INSERTED);
+    uhash_assert(uhcache_count(cache) == capacity && ev.count == 1 && ev.keys[0] < capacity);
+    uhash_assert(uhcache_contains(IntCache, cache, capacity));
+    uhash_assert(!uhcache_contains(IntCache, cache, ev.keys[0]));
+
+    // Entries used since the hand last passed are spared.
+    for (uint32_t i = 0; i < capacity / 2; ++i) {
+        if (i != ev.keys[0]) uhash_assert(uhcache_get(IntCache, cache, i, capacity) == i);
+    }
+
+    for (uint32_t i = capacity + 1; i < capacity + 27; ++i) {
+        uhash_assert(uhcache_put(IntCache, cache, i, i) == UHASH_INSERTED);
+    }
+
+    uhash_assert(uhcache_count(cache) == capacity && ev.count == 27);
+    for (uint32_t i = 1; i < ev.count; ++i) {
+        uhash_assert(ev.keys[i] >= capacity / 2 && ev.keys[i] < capacity);
+    }
+    for (uint32_t i = 0; i < capacity / 2; ++i) {
+        uhash_assert(i == ev.keys[0] || uhcache_contains(IntCache, cache, i));
+    }
+
+    // Replacing values and removing entries evicts nothing.
+    uhash_assert(uhcache_put(IntCache, cache, capacity, 1) == UHASH_PRESENT);
+    uhash_assert(uhcache_get(IntCache, cache, capacity, 0) == 1);
+
+    uint32_t val = 0;
+    uhash_assert(uhcache_remove(IntCache, cache, capacity, &val) && val == 1);
+    uhash_assert(!uhcache_remove(IntCache, cache, capacity, NULL));
+    uhash_assert(uhcache_get(IntCache, cache, capacity, 0) == 0);
+    uhash_assert(uhcache_count(cache) == capacity - 1 && ev.count == 27);
+
+    // Evicted buckets are reused or compacted, so the table never grows.
+    uhash_uint const n_buckets = cache->table->n_buckets;
+    for (uint32_t i = 0; i < capacity * 64; ++i) {
+        uhash_assert(uhcache_put(IntCache, cache, i, i) != UHASH_ERR);
+        uhash_assert(uhcache_count(cache) <= capacity);
+    }
+    uhash_assert(cache->table->n_buckets == n_buckets);
+
+    uhcache_clear(IntCache, cache);
+    uhash_assert(!uhcache_count(cache));
+    uhcache_free(IntCache, cache);
+    return true;
+}
+
+static bool test_idx(void) {
+    UHash(IntHashIdx) *set = uhset_alloc(IntHashIdx);
+    uhash_assert(set);
+    uhash_assert(sizeof(set->n_buckets) == sizeof(uint16_t));
+
+    // Tables stop growing once their bucket count would not fit the index type.
+    uint32_t n = 0;
+    for (uhash_ret ret; (ret = uhset_insert(IntHashIdx, set, n)) != UHASH_ERR; ++n) {
+        uhash_assert(ret == UHASH_INSERTED);
+    }
+
+    uhash_assert(n > UINT16_MAX / 4 && uhash_count(set) == n);
+    for (uint32_t i = 0; i < n; ++i) uhash_assert(uhash_contains(IntHashIdx, set, i));
+    uhash_assert(!uhash_contains(IntHashIdx, set, n));
+
+    for (uint32_t i = 0; i < n; i += 2) uhash_assert(uhset_remove(IntHashIdx, set, i));
+    uhash_assert(uhset_insert(IntHashIdx, set, n) == UHASH_INSERTED);
+    uhash_assert(uhash_count(set) == n / 2 + 1);
+
+    UHash(IntHashIdx) *copy = uhset_alloc(IntHashIdx);
+    uhash_assert(copy && uhash_copy(IntHashIdx, set, copy) == UHASH_OK);
+    uhash_assert(uhset_equals(IntHashIdx, copy, set));
+
+    uhash_free(IntHashIdx, copy);
+    uhash_free(IntHashIdx, set);
+    return true;
+}
+
+static bool test_set_many(void) {
+    // Set j holds the multiples of j + 1, the last one is empty.
+    UHash(IntHash) *sets[6];
+    UHash(IntHashSeeded) *seeded[5];
+
+    for (uint32_t j = 0; j < 6; ++j) {
+        sets[j] = uhset_alloc(IntHash);
+        uhash_assert(sets[j]);
+        if (j == 5) break;
+
+        seeded[j] = uhset_alloc(IntHashSeeded);
+        uhash_assert(seeded[j]);
+
+        for (uint32_t i = 0; i < MAX_VAL; i += j + 1) {
+            uhash_assert(uhset_insert(IntHash, sets[j], i) == UHASH_INSERTED);
+            uhash_assert(uhset_insert(IntHashSeeded, seeded[j], i) == UHASH_INSERTED);
+        }
+    }
+
+    UHash(IntHash) const *const *all = (UHash(IntHash) const *const *)sets;
+    uhash_assert(!uhset_union_many(IntHash, all, 0));
+    uhash_assert(!uhset_intersect_many(IntHash, all, 0));
+
+    UHash(IntHash) *u = uhset_union_many(IntHash, all, 6);
+    uhash_assert(u && uhset_equals(IntHash, u, sets[0]));
+    uhash_free(IntHash, u);
+
+    // Overlapping sets are not sized for their total count.
+    UHash(IntHash) const *copies[] = { sets[0], sets[0], sets[0], sets[0] };
+    UHash(IntHash) *ref = uhset_alloc(IntHash);
+    uhash_assert(ref && uhash_reserve(IntHash, ref, MAX_VAL) == UHASH_OK);
+    u = uhset_union_many(IntHash, copies, 4);
+    uhash_assert(u && uhset_equals(IntHash, u, sets[0]) && u->n_buckets == ref->n_buckets);
+    uhash_free(IntHash, ref);
+    uhash_free(IntHash, u);
+
+    // The multiples of 2 or 3.
+    u = uhset_union_many(IntHash, all + 1, 2);
+    uhash_assert(u && uhash_count(u) == 67);
+    uhash_foreach_key(IntHash, u, key, uhash_assert(key % 2 == 0 || key % 3 == 0));
+    uhash_free(IntHash, u);
+
+    // The multiples of 1..5 are the multiples of 60.
+    UHash(IntHash) *x = uhset_intersect_many(IntHash, all, 5);
+    uhash_assert(x && uhash_count(x) == (MAX_VAL + 59) / 60);
+    uhash_foreach_key(IntHash, x, key, uhash_assert(key % 60 == 0));
+    uhash_free(IntHash, x);
+
+    x = uhset_intersect_many(IntHash, all, 6);
+    uhash_assert(x && !uhash_count(x));
+    uhash_free(IntHash, x);
+
+    // A set intersected with itself is left unchanged.
+    UHash(IntHash) const *same[] = { sets[1], sets[1] };
+    x = uhset_intersect_many(IntHash, same, 2);
+    uhash_assert(x && uhset_equals(IntHash, x, sets[1]));
+    uhash_free(IntHash, x);
+
+    // Seeded sets are rehashed with the seed of the result.
+    UHash(IntHashSeeded) const *const *sall = (UHash(IntHashSeeded) const *const *)seeded;
+    UHash(IntHashSeeded) *su = uhset_union_many(IntHashSeeded, sall, 5);
+    uhash_assert(su && uhset_equals(IntHashSeeded, su, seeded[0]));
+    UHash(IntHashSeeded) *sx = uhset_intersect_many(IntHashSeeded, sall, 5);
+    uhash_assert(sx && uhash_count(sx) == (MAX_VAL + 59) / 60);
+    uhash_assert(uhash_contains(IntHashSeeded, sx, 60) && !uhash_contains(IntHashSeeded, sx, 30));
+    uhash_free(IntHashSeeded, su);
+    uhash_free(IntHashSeeded, sx);
+
+    for (uint32_t j = 0; j < 5; ++j) {
+        uhash_free(IntHash, sets[j]);
+        uhash_free(IntHashSeeded, seeded[j]);
+    }
+    uhash_free(IntHash, sets[5]);
+    return true;
+}
+
+int main(void) {
+    printf("Starting tests...\n");
+
+    int exit_code = EXIT_SUCCESS;
+    bool (*tests[])(void) = {
+        test_memory,
+        test_base,
+        test_map,
+        test_set,
+        test_per_instance,
+        test_simd,
+        test_cached_hash,
+        test_incremental,
+        test_shrink,
+        test_robin_hood,
+        test_batch,
+        test_allocator,
+        test_copy_values,
+        test_sbo,
+        test_concurrent,
+        test_sharded,
+        test_parallel,
+        test_hash_functions,
+        test_str_view,
+        test_intern,
+        test_with_hash,
+        test_image,
+        test_stream,
+        test_stats,
+        test_iteration,
+        test_clone,
+        test_reserve,
+        test_max_load,
+        test_packed,
+        test_cuckoo,
+        test_seeded,
+        test_cache,
+        test_set_many,
+        test_idx
+    };
+
+    for (uint32_t i = 0; i < array_size(tests); ++i) {
+        if (!tests[i]()) exit_code = EXIT_FAILURE;
+    }
+
+    if (exit_code == EXIT_SUCCESS) {
+        printf("All tests passed.\n");
+    } else {
+        printf("Some tests failed.\n");
+    }
+
     return exit_code;
 }